@@ -164,13 +164,32 @@ typedef struct {
     mtexinfo_t          *texinfo;
 } mbrushside_t;
 
+// brush side planes packed four at a time, one array per axis, so boxes
+// can be clipped against several sides at once
+#define BRUSH_PLANES    4
+
+typedef struct {
+    float               normal[3][BRUSH_PLANES];
+    float               dist[BRUSH_PLANES];
+} mbrushplanes_t;
+
 typedef struct {
     int                 contents;
     int                 numsides;
     mbrushside_t        *firstbrushside;
+    mbrushplanes_t      *planes;           // (numsides + 3) / 4 blocks
     int                 checkcount;        // to avoid repeated testings
 } mbrush_t;
 
+// bounding volume hierarchy over the brushes of the world model, traced
+// instead of the BSP tree when most of the tree would be walked
+typedef struct {
+    vec3_t              mins, maxs;
+    int                 contents;   // of all brushes below
+    int                 first;      // first of two children, or first brush
+    int                 numbrushes; // 0 for inner nodes
+} mbvhnode_t;
+
 typedef struct {
     /* ======> */
     cplane_t            *plane;     // always NULL to differentiate from nodes
@@ -262,6 +281,14 @@ typedef struct bsp_s {
     int             numbrushes;
     mbrush_t        *brushes;
 
+    int             numbrushplanes;
+    mbrushplanes_t  *brushplanes;
+
+    int             numbvhnodes;
+    mbvhnode_t      *bvhnodes;
+    int             numbvhbrushes;
+    mbrush_t        **bvhbrushes;
+
     int             numvisibility;
     int             visrowsize;
     dvis_t          *vis;
@@ -314,6 +341,8 @@ typedef struct bsp_s {
 
 qerror_t BSP_Load(const char *name, bsp_t **bsp_p);
 void BSP_Free(bsp_t *bsp);
+void BSP_PackBrushPlanes(mbrush_t *brush);
+bsp_t *BSP_ForHeadnode(const mnode_t *headNode);
 const char *BSP_GetError(void);
 
 #if USE_REF
@@ -67,6 +67,9 @@ typedef struct {
                                     const vec3_t &origin, const vec3_t &angles);
     void        CM_ClipEntity(trace_t *dst, const trace_t *src, struct entity_s *ent);
 
+    // forces the brush BVH mode for traces, -1 follows map_brushbvh again
+    void        CM_SetBrushBVH(int mode);
+
     // call with topnode set to the headNode, returns with topnode
     // set to the first node that splits the box
     int         CM_BoxLeafs(cm_t *cm, const vec3_t &mins, const vec3_t &maxs, mleaf_t **list,
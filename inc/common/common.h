@@ -152,6 +152,7 @@ extern cvar_t   *sv_running;
 extern cvar_t   *sv_paused;
 extern cvar_t   *com_timedemo;
 extern cvar_t   *com_sleep;
+extern cvar_t   *com_debug_lookups;
 
 extern cvar_t   *allow_download;
 extern cvar_t   *allow_download_players;
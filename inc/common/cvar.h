@@ -79,6 +79,7 @@ void Cvar_WriteVariables(qhandle_t f, int mask, qboolean modified);
 size_t Cvar_BitInfo(char *info, int bit);
 
 cvar_t *Cvar_FindVar(const char *var_name);
+void Cvar_CheckLookups(void);
 xgenerator_t Cvar_FindGenerator(const char *var_name);
 qboolean Cvar_Exists(const char *name, qboolean weak);
 
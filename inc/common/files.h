@@ -143,6 +143,17 @@ ssize_t FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t
 // a NULL buffer will just return the file length without loading
 // length < 0 indicates error
 
+// runs on a job thread, returns decoded data and its size
+typedef void *(*fs_decode_t)(const void *data, size_t len, size_t *size);
+typedef void (*fs_decodefree_t)(void *decoded);
+
+qboolean FS_PrefetchFile(const char *path, unsigned flags, int priority,
+                         fs_decode_t decode, fs_decodefree_t decodefree);
+ssize_t FS_LoadPrefetched(const char *path, void **buffer, unsigned flags, void **decoded);
+void    FS_FlushPrefetch(void);
+void    FS_PrefetchProgress(int *finished, int *total);
+// read files ahead on job threads, FS_LoadFile picks them up
+
 qerror_t FS_WriteFile(const char *path, const void *data, size_t len);
 
 qboolean FS_EasyWriteFile(char *buf, size_t size, unsigned mode,
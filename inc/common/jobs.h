@@ -0,0 +1,49 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef JOBS_H
+#define JOBS_H
+
+//
+// Worker threads for background jobs. Jobs may not use anything that
+// isn't thread safe: no cvars, commands, console output or file system
+// handles. Zone memory is fine.
+//
+
+typedef void (*jobfunc_t)(void *arg);
+
+// higher runs first, jobs of equal priority run in order they were added
+#define JOB_PRIORITY_LOW        0
+#define JOB_PRIORITY_NORMAL     100
+#define JOB_PRIORITY_HIGH       200
+
+void    Job_Init(void);
+void    Job_Shutdown(void);
+
+// returns 0 if jobs run on the calling thread
+int     Job_NumThreads(void);
+
+// runs immediately on the calling thread if there are no workers
+void    Job_Add(jobfunc_t func, void *arg, int priority);
+
+// calls func(arg, i) for i in [0, count) on the workers and the calling
+// thread, returns when all of them are done
+typedef void (*jobrangefunc_t)(void *arg, int index);
+void    Job_ParallelFor(jobrangefunc_t func, void *arg, int count, int priority);
+
+#endif // JOBS_H
@@ -91,7 +91,9 @@ enum EntityStateMessageFlags {
 extern SizeBuffer   msg_write;
 extern byte         msg_write_buffer[MAX_MSGLEN];
 
-extern SizeBuffer   msg_read;
+// thread local so that job threads can decode their own buffers,
+// msg_read_buffer is only filled on the main thread
+extern thread_local SizeBuffer  msg_read;
 extern byte         msg_read_buffer[MAX_MSGLEN];
 
 extern const PackedEntity       nullEntityState;
@@ -110,8 +112,8 @@ void    MSG_WriteString(const char* s);
 void    MSG_WriteVector3(const vec3_t& pos);
 #if USE_CLIENT
 void    MSG_WriteBits(int value, int bits);
-int     MSG_WriteDeltaClientMoveCommand(const ClientMoveCommand* from, const ClientMoveCommand* cmd);
 #endif
+int     MSG_WriteDeltaClientMoveCommand(const ClientMoveCommand* from, const ClientMoveCommand* cmd);
 void    MSG_PackEntity(PackedEntity* out, const EntityState* in);
 void    MSG_WriteDeltaEntity(const PackedEntity* from, const PackedEntity* to, EntityStateMessageFlags flags);
 int     MSG_WriteDeltaPlayerstate(const PlayerState* from, PlayerState* to, PlayerStateMessageFlags flags);
@@ -95,6 +95,14 @@ struct netadr_t {
     uint32_t scope_id;  // IPv6 crap
 };
 
+// one slice of a datagram passed to NET_SendPacketv
+struct netbuf_t {
+    const void *data;
+    size_t len;
+};
+
+#define NET_MAX_BUFS    4
+
 enum NetState {
     NS_DISCONNECTED,// no socket opened
     NS_CONNECTING,  // connect() not yet completed
@@ -230,6 +238,8 @@ qboolean    NET_GetAddress(NetSource sock, netadr_t *adr);
 void        NET_GetPackets(NetSource sock, void (*packet_cb)(void));
 qboolean    NET_SendPacket(NetSource sock, const void *data,
                            size_t len, const netadr_t *to);
+qboolean    NET_SendPacketv(NetSource sock, const netbuf_t *bufs,
+                            int count, const netadr_t *to);
 
 const char *NET_AdrToString(const netadr_t *a);
 qboolean    NET_StringToAdr(const char *s, netadr_t *a, int default_port);
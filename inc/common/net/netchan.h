@@ -86,6 +86,7 @@ public:
     int         deltaFramePacketDrops;  // Between last packet and previous.
     uint32_t    totalDropped;           // For statistics.
     uint32_t    totalReceived;
+    size_t      totalBytesSent;
 
     uint32_t    lastReceivedTime;   // For timeouts.
     uint32_t    lastSentTime;       // For retransmits.
@@ -116,15 +117,22 @@ public:
     SizeBuffer   message;                    // writing buffer for reliable data
     byte        messageBuffer[MAX_MSGLEN];  // leave space for header
 
-    // Message is copied to this buffer when it is first transfered
+    // Message and reliable swap buffers when it is first transfered,
+    // reliableData points to whichever one holds the unacked message
     SizeBuffer   reliable;
-    byte        reliableBuffer[MAX_MSGLEN];   // unacked reliable message
+    byte        reliableBuffer[MAX_MSGLEN];
+    byte        *reliableData;
 
+    // Fragments are reassembled here and read in place
     SizeBuffer   inFragment;
     byte        inFragmentBuffer[MAX_MSGLEN];
 
+    // Fragmented message is sent from reliableData followed by the
+    // unreliable part copied into outFragment
     SizeBuffer   outFragment;
     byte        outFragmentBuffer[MAX_MSGLEN];
+    size_t      fragmentReliableLength;
+    size_t      fragmentOffset;
 };
 
 extern cvar_t       *net_qport;
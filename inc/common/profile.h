@@ -0,0 +1,79 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+//
+// Scoped zone profiler. Each thread records finished zones into its own
+// ring buffer, the main thread aggregates them once per frame. Zone names
+// must be string literals. Enabled with CONFIG_ENABLE_PROFILER, otherwise
+// everything compiles to nothing.
+//
+
+typedef struct {
+    const char  *name;
+    float       calls;      // per frame
+    float       avg_ms;     // per frame
+    float       max_ms;     // worst frame
+} profstat_t;
+
+// monotonic clock in nanoseconds, also available without the profiler for
+// benchmark commands
+uint64_t    Prof_Nanoseconds(void);
+
+// returns the p-th percentile of sorted nanosecond times in milliseconds
+float       Prof_Percentile(const uint64_t *times, int count, int p);
+
+#if USE_PROFILER
+
+void    Prof_Init(void);
+void    Prof_EndFrame(void);
+
+void    Prof_BeginZone(const char *name);
+void    Prof_EndZone(const char *name);
+
+// fills stats sorted by average time, returns number of zones
+int     Prof_GetStats(profstat_t *stats, int max);
+
+class ProfileScope {
+public:
+    ProfileScope(const char *name) : name(name) { Prof_BeginZone(name); }
+    ~ProfileScope() { Prof_EndZone(name); }
+private:
+    const char *name;
+};
+
+#define PROF_CONCAT2(a, b)  a##b
+#define PROF_CONCAT(a, b)   PROF_CONCAT2(a, b)
+#define PROF_ZONE(name)     ProfileScope PROF_CONCAT(prof_scope_, __LINE__)(name)
+
+#else
+
+#define Prof_Init()         (void)0
+#define Prof_EndFrame()     (void)0
+
+// these are exported to game modules, so they need an address
+static inline void Prof_BeginZone(const char *name) {}
+static inline void Prof_EndZone(const char *name) {}
+
+#define PROF_ZONE(name)     (void)0
+
+#endif // USE_PROFILER
+
+#endif // PROFILE_H
@@ -44,9 +44,28 @@ qboolean Com_ParseTimespec(const char *s, int *frames);
 
 void Com_PlayerToEntityState(const PlayerState *ps, EntityState *es);
 
+unsigned Com_HashName(const char *s);
 unsigned Com_HashString(const char *s, unsigned size);
 unsigned Com_HashStringLen(const char *s, size_t len, unsigned size);
 
+// hash table of named objects, names are not copied
+typedef struct {
+    unsigned    hash;   // Com_HashName
+    const char  *name;
+    void        *value;
+} nameslot_t;
+
+typedef struct {
+    nameslot_t  *slots;
+    unsigned    size;
+    unsigned    count;
+    memtag_t    tag;
+} nametable_t;
+
+void *NameTable_Find(const nametable_t *t, const char *name, unsigned hash);
+void NameTable_Insert(nametable_t *t, const char *name, unsigned hash, void *value);
+void NameTable_Remove(nametable_t *t, const char *name, unsigned hash);
+
 size_t Com_FormatTime(char *buffer, size_t size, time_t t);
 size_t Com_FormatTimeLong(char *buffer, size_t size, time_t t);
 size_t Com_TimeDiff(char *buffer, size_t size, time_t *p, time_t now);
@@ -108,6 +108,8 @@ qerror_t MOD_ValidateMD2(struct dmd2header_s *header, size_t length);
 
 qerror_t MOD_LoadIQM_Base(model_t* mod, const void* rawdata, size_t length, const char* mod_name);
 qboolean R_ComputeIQMTransforms(const iqm_model_t* model, const r_entity_t* entity, float* pose_matrices);
+void R_ResetIQMPoseCache(void);
+void IQM_Bench_f(void);
 
 // these are implemented in [gl,sw]_models.c
 typedef qerror_t(*mod_load_t)(model_t*, const void*, size_t, const char*);
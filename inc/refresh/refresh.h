@@ -53,6 +53,8 @@ qhandle_t R_RegisterImage(const char *name, imagetype_t type,
 qhandle_t R_RegisterRawImage(const char *name, int width, int height, byte* pic, imagetype_t type,
                           imageflags_t flags);
 void R_UnregisterImage(qhandle_t handle);
+void R_PrefetchImage(const char *name, imagetype_t type,
+                     imageflags_t flags, int priority);
 
 extern void    (*R_SetSky)(const char *name, float rotate, vec3_t &axis);
 extern void    (*R_EndRegistration)(const char *name);
@@ -98,5 +100,6 @@ void R_RegisterFunctionsGL();
 #if REF_VKPT
 void R_RegisterFunctionsRTX();
 #endif
+void R_RegisterFunctionsNull();
 
 #endif // REFRESH_H
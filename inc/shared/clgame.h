@@ -233,6 +233,16 @@ extern "C" {
         void            (*SetClientLoadState) (LoadState state);
         // Returns the current state of the client.
         uint32_t        (*GetClienState) (void);
+        // Returns how many of the files queued for background loading
+        // have been read so far, for load screen progress.
+        void            (*GetLoadProgress) (int *finished, int *total);
+
+        // Opens and closes a named zone of the engine profiler. Calls must
+        // be paired, and the name must be a string literal. Does nothing
+        // unless the engine was built with the profiler enabled, or
+        // benchmark_demo is running and knows the zone.
+        void            (*ProfileBeginZone) (const char *name);
+        void            (*ProfileEndZone) (const char *name);
 
         // Checks if the name of the player is on the client's ignore list.
         qboolean        (*CheckForIgnore) (const char *s);
@@ -19,7 +19,9 @@
 #define clamp(a,b,c)    ((a)<(b)?(a)=(b):(a)>(c)?(a)=(c):(a))
 #define cclamp(a,b,c)   ((b)>(c)?clamp(a,c,b):clamp(a,b,c))
 
-// These need to be replaced.
+// These need to be replaced. Until then, a source file that uses the standard
+// library must include its standard headers before shared/shared.h, or these
+// macros break std::min, std::max and numeric_limits<>::max() in them.
 #ifndef max
 #define max(a,b) ((a)>(b)?(a):(b))
 #endif
@@ -36,6 +36,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define PRIz    "zu"
 #endif
 
+// SIMD code paths are picked at compile time from the target architecture,
+// code using them must always keep a plain C fallback
+#if (defined __SSE2__) || (defined _M_X64) || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define USE_SSE2    1
+#endif
+#if (defined __AVX2__)
+#define USE_AVX2    1
+#endif
+
 #ifdef _WIN32
 #define LIBSUFFIX   ".dll"
 #else
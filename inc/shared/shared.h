@@ -497,7 +497,7 @@ typedef struct cvar_s {
     char* default_string;
     xchanged_t      changed;
     xgenerator_t    generator;
-    struct cvar_s* hashNext;
+    struct cvar_s* hashNext;    // unused, kept for game module compatibility
 } cvar_t;
 #endif      // CVAR
 
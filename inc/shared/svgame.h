@@ -153,6 +153,9 @@ typedef struct {
 
     // collision detection
     trace_t (* q_gameabi Trace)(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end, Entity *passent, int contentmask);
+    // same as Trace, with clients and monsters where they were msec
+    // milliseconds ago, for hitscan lag compensation
+    trace_t (* q_gameabi TraceRewound)(int msec, const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end, Entity *passent, int contentmask);
     int (*PointContents)(const vec3_t &point);
     qboolean (*InPVS)(const vec3_t &p1, const vec3_t &p2);
     qboolean (*InPHS)(const vec3_t &p1, const vec3_t &p2);
@@ -182,6 +185,14 @@ typedef struct {
     void (*TagFree)(void *block);
     void (*FreeTags)(unsigned tag);
 
+    // savegame snapshots. the game serializes into memory and hands the
+    // whole buffer over at once, the server compresses and writes it on
+    // a background thread. LoadSaveFile returns the decompressed snapshot,
+    // which must be released with FreeSaveFile.
+    qboolean (*WriteSaveFile)(const char *filename, const void *data, size_t len);
+    void *(*LoadSaveFile)(const char *filename, size_t *len);
+    void (*FreeSaveFile)(void *data);
+
     // console variable interaction
     cvar_t *(*cvar)(const char *var_name, const char *value, int flags);
     cvar_t *(*cvar_set)(const char *var_name, const char *value);
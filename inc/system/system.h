@@ -31,6 +31,10 @@ void    Sys_Sleep(int msec);
 qboolean Sys_IsDir(const char *path);
 qboolean Sys_IsFile(const char *path);
 
+// read-only memory mapping of a whole file, returns NULL on failure
+void    *Sys_MapFile(const char *path, size_t *len);
+void    Sys_UnmapFile(void *data, size_t len);
+
 void    Sys_Init(void);
 void    Sys_AddDefaultConfig(void);
 
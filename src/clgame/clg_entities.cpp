@@ -95,6 +95,8 @@ void CLG_AddPacketEntities(void)
     ClientInfo* ci;
     unsigned int        effects, renderEffects;
 
+    clgi.ProfileBeginZone("CLG_AddPacketEntities");
+
     // bonus items rotate at a fixed rate
     autorotate = AngleMod(cl->time * BASE_1_FRAMETIME);
 
@@ -380,6 +382,8 @@ void CLG_AddPacketEntities(void)
 
         //Com_DPrint("[SKIP] entity ID =%i - origin = [%f, %f, %f]\n", ent.id, ent.origin[0], ent.origin[1], ent.origin[1]);
     }
+
+    clgi.ProfileEndZone("CLG_AddPacketEntities");
 }
 
 /*
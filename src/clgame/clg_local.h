@@ -147,6 +147,7 @@ extern cvar_t* cl_noglow;
 extern cvar_t* cl_noskins;
 extern cvar_t* cl_player_model;
 extern cvar_t* cl_predict;
+extern cvar_t* cl_predict_cache;
 extern cvar_t* cl_rollhack;
 extern cvar_t* cl_thirdperson_angle;
 extern cvar_t* cl_thirdperson_range;
@@ -65,6 +65,7 @@ cvar_t *cl_noglow               = nullptr;
 cvar_t *cl_noskins              = nullptr;
 cvar_t *cl_player_model         = nullptr;
 cvar_t *cl_predict              = nullptr;
+cvar_t *cl_predict_cache        = nullptr;
 cvar_t *cl_rollhack             = nullptr;
 cvar_t *cl_thirdperson_angle    = nullptr;
 cvar_t *cl_thirdperson_range    = nullptr;
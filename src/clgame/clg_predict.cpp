@@ -196,6 +196,302 @@ void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm)
     }
 }
 
+//
+//=============================================================================
+//
+//	PREDICTION CACHE
+//
+//=============================================================================
+//
+// Commands between the last acknowledged one and the current one don't
+// change once they are sent, so the pmove results of the previous render
+// frame are kept per command index. As long as the server agrees with
+// what we predicted for the newly acknowledged command, and nothing solid
+// moved near the path the player took, only the commands that weren't
+// simulated yet (and the pending one) have to be run through PMove.
+//
+
+// Distance that the acknowledged server state may differ from our own
+// result for it, and still be considered the same.
+#define PREDICT_CACHE_EPSILON   0.01f
+
+// Extra room around the predicted path when checking for moved entities,
+// covers stepping and ground checks.
+#define PREDICT_CACHE_MARGIN    32.f
+
+typedef struct {
+    int32_t number;
+    vec3_t absMins, absMaxs;
+} PredictSolid;
+
+static struct {
+    qboolean valid;
+    bsp_t* bsp;
+
+    // The chain starts right after ackCommand, from the base state.
+    uint32_t ackCommand;
+    uint32_t lastCommand;
+    PlayerMoveState base;
+
+    // Area swept by the cached moves.
+    vec3_t absMins, absMaxs;
+
+    // Solid entities at the time of the last check.
+    PredictSolid solids[MAX_PACKET_ENTITIES];
+    int32_t numSolids;
+
+    // Results per command index.
+    uint32_t commandNumbers[CMD_BACKUP];
+    PlayerMove moves[CMD_BACKUP];
+
+    // Statistics.
+    uint64_t pmovesRun;
+    uint64_t pmovesAvoided;
+    uint64_t stateResets;
+    uint64_t solidResets;
+} predictCache;
+
+//
+//===============
+// CLG_PredictStatesMatch
+// 
+// Returns true if the server agrees with our prediction of a command.
+//================
+//
+static qboolean CLG_PredictStatesMatch(const PlayerMoveState* a, const PlayerMoveState* b) {
+    if (a->type != b->type || a->flags != b->flags || a->time != b->time || a->gravity != b->gravity) {
+        return false;
+    }
+
+    if (!vec3_equal(a->deltaAngles, b->deltaAngles)) {
+        return false;
+    }
+
+    return vec3_equal_epsilon(a->origin, b->origin, PREDICT_CACHE_EPSILON)
+        && vec3_equal_epsilon(a->velocity, b->velocity, PREDICT_CACHE_EPSILON)
+        && vec3_equal_epsilon(a->viewOffset, b->viewOffset, PREDICT_CACHE_EPSILON);
+}
+
+//
+//===============
+// CLG_PredictSolidBounds
+// 
+// Calculates world space bounds of a solid entity, large enough to hold
+// brush models at any rotation.
+//================
+//
+static void CLG_PredictSolidBounds(const cl_entity_t* ent, PredictSolid* solid) {
+    vec3_t mins = ent->mins, maxs = ent->maxs;
+
+    solid->number = ent->current.number;
+
+    if (ent->current.solid == PACKED_BSP) {
+        mmodel_t* cmodel = cl->clipModels[ent->current.modelIndex];
+
+        if (!cmodel) {
+            solid->absMins = solid->absMaxs = ent->current.origin;
+            return;
+        }
+
+        mins = cmodel->mins;
+        maxs = cmodel->maxs;
+
+        if (!vec3_equal(ent->current.angles, vec3_zero())) {
+            const float radius = vec3_length(vec3_maxf(vec3_fabsf(mins), vec3_fabsf(maxs)));
+
+            mins = vec3_t{ -radius, -radius, -radius };
+            maxs = vec3_t{ radius, radius, radius };
+        }
+    }
+
+    solid->absMins = ent->current.origin + mins;
+    solid->absMaxs = ent->current.origin + maxs;
+}
+
+//
+//===============
+// CLG_PredictSolidTouchesPath
+// 
+//================
+//
+static qboolean CLG_PredictSolidTouchesPath(const PredictSolid* solid) {
+    for (int32_t i = 0; i < 3; i++) {
+        if (solid->absMins[i] > predictCache.absMaxs[i] + PREDICT_CACHE_MARGIN ||
+            solid->absMaxs[i] < predictCache.absMins[i] - PREDICT_CACHE_MARGIN) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+//===============
+// CLG_PredictAddToPath
+// 
+// Grows the swept area by a move from start to where pm ended up.
+//================
+//
+static void CLG_PredictAddToPath(const vec3_t& start, const PlayerMove* pm) {
+    predictCache.absMins = vec3_minf(predictCache.absMins, vec3_minf(start, pm->state.origin) + pm->mins);
+    predictCache.absMaxs = vec3_maxf(predictCache.absMaxs, vec3_maxf(start, pm->state.origin) + pm->maxs);
+}
+
+//
+//===============
+// CLG_PredictSolidsChanged
+// 
+// Takes a new snapshot of the solid entities, and returns true if any
+// entity that appeared, disappeared or moved could touch the cached path.
+// Entities are sorted by number in every frame, anything out of order
+// just counts as changed.
+//================
+//
+static qboolean CLG_PredictSolidsChanged(void) {
+    static PredictSolid solids[MAX_PACKET_ENTITIES];
+    int32_t i, j, numSolids = cl->numSolidEntities;
+    qboolean changed = false;
+
+    for (i = 0; i < numSolids; i++) {
+        CLG_PredictSolidBounds(cl->solidEntities[i], &solids[i]);
+    }
+
+    for (i = 0, j = 0; !changed && (i < numSolids || j < predictCache.numSolids); ) {
+        const PredictSolid* now = i < numSolids ? &solids[i] : nullptr;
+        const PredictSolid* old = j < predictCache.numSolids ? &predictCache.solids[j] : nullptr;
+
+        if (now && old && now->number == old->number) {
+            if (!vec3_equal(now->absMins, old->absMins) || !vec3_equal(now->absMaxs, old->absMaxs)) {
+                changed = CLG_PredictSolidTouchesPath(now) || CLG_PredictSolidTouchesPath(old);
+            }
+            i++, j++;
+        } else if (now && (!old || now->number < old->number)) {
+            changed = CLG_PredictSolidTouchesPath(now);
+            i++;
+        } else {
+            changed = CLG_PredictSolidTouchesPath(old);
+            j++;
+        }
+    }
+
+    memcpy(predictCache.solids, solids, numSolids * sizeof(solids[0]));
+    predictCache.numSolids = numSolids;
+
+    return changed;
+}
+
+//
+//===============
+// CLG_PredictFromCache
+// 
+// Restores the last cached result to continue from, if it is still valid
+// for the new acknowledged command and base state. Returns the command
+// to continue after.
+//================
+//
+static uint32_t CLG_PredictFromCache(uint32_t acknowledgedCommandIndex, uint32_t currentCommandIndex, PlayerMove* pm) {
+    const uint32_t ack = acknowledgedCommandIndex;
+    qboolean valid = predictCache.valid && cl_predict_cache->integer
+        && predictCache.bsp == cl->bsp
+        && ack >= predictCache.ackCommand && ack <= predictCache.lastCommand
+        && predictCache.lastCommand <= currentCommandIndex;
+
+    if (valid) {
+        const PlayerMoveState* predicted = &predictCache.base;
+
+        if (ack != predictCache.ackCommand) {
+            predicted = predictCache.commandNumbers[ack & CMD_MASK] == ack ? &predictCache.moves[ack & CMD_MASK].state : nullptr;
+        }
+
+        if (!predicted || !CLG_PredictStatesMatch(&pm->state, predicted)) {
+            predictCache.stateResets++;
+            valid = false;
+        }
+    }
+
+    // Always take a new snapshot, so entities that moved far away
+    // aren't compared against stale positions later on.
+    if (CLG_PredictSolidsChanged() && valid) {
+        predictCache.solidResets++;
+        valid = false;
+    }
+
+    if (!valid) {
+        predictCache.valid = true;
+        predictCache.bsp = cl->bsp;
+        predictCache.ackCommand = predictCache.lastCommand = ack;
+        predictCache.base = pm->state;
+        predictCache.absMins = vec3_mins();
+        predictCache.absMaxs = vec3_maxs();
+
+        return ack;
+    }
+
+    // Moves before the new acknowledged command no longer matter,
+    // so the swept area is rebuilt from the remaining ones.
+    vec3_t start = pm->state.origin;
+
+    predictCache.absMins = vec3_mins();
+    predictCache.absMaxs = vec3_maxs();
+
+    for (uint32_t i = ack + 1; i <= predictCache.lastCommand; i++) {
+        const PlayerMove* move = &predictCache.moves[i & CMD_MASK];
+
+        if (cl->clientUserCommands[i & CMD_MASK].input.msec) {
+            predictCache.pmovesAvoided++;
+        }
+
+        CLG_PredictAddToPath(start, move);
+        start = move->state.origin;
+    }
+
+    predictCache.ackCommand = ack;
+    predictCache.base = pm->state;
+
+    if (predictCache.lastCommand != ack) {
+        *pm = predictCache.moves[predictCache.lastCommand & CMD_MASK];
+    }
+
+    return predictCache.lastCommand;
+}
+
+//
+//===============
+// CLG_PredictCacheMove
+// 
+// Stores the result of a simulated command.
+//================
+//
+static void CLG_PredictCacheMove(uint32_t commandNumber, const vec3_t& start, const PlayerMove* pm) {
+    predictCache.commandNumbers[commandNumber & CMD_MASK] = commandNumber;
+    predictCache.moves[commandNumber & CMD_MASK] = *pm;
+    predictCache.lastCommand = commandNumber;
+
+    CLG_PredictAddToPath(start, pm);
+}
+
+//
+//===============
+// CLG_PredictStats_f
+// 
+// Prints how much work the prediction cache saved.
+//================
+//
+void CLG_PredictStats_f(void) {
+    const uint64_t total = predictCache.pmovesRun + predictCache.pmovesAvoided;
+
+    Com_Print("%llu pmoves run, %llu avoided (%.1f%%)\n",
+        (unsigned long long)predictCache.pmovesRun, (unsigned long long)predictCache.pmovesAvoided,
+        total ? predictCache.pmovesAvoided * 100.0 / total : 0.0);
+    Com_Print("%llu resets on server state, %llu on moved entities\n",
+        (unsigned long long)predictCache.stateResets, (unsigned long long)predictCache.solidResets);
+
+    if (clgi.Cmd_Argc() > 1 && !strcmp(clgi.Cmd_Argv(1), "reset")) {
+        predictCache.pmovesRun = predictCache.pmovesAvoided = 0;
+        predictCache.stateResets = predictCache.solidResets = 0;
+    }
+}
+
 //
 //===============
 // CLG_PredictMovement
@@ -205,6 +501,7 @@ void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm)
 //
 void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int currentCommandIndex) {
     PlayerMove   pm = {};
+    qboolean     moved = false;
 
     if (!acknowledgedCommandIndex || !currentCommandIndex)
         return;
@@ -222,10 +519,15 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
     pm.state.deltaAngles = cl->deltaAngles;
 #endif
 
+    // Continue from the results of the previous frame, if they still hold.
+    uint32_t commandIndex = CLG_PredictFromCache(acknowledgedCommandIndex, currentCommandIndex, &pm);
+    moved = commandIndex != acknowledgedCommandIndex;
+
     // Run frames in order.
-    while (++acknowledgedCommandIndex <= currentCommandIndex) {
+    while (++commandIndex <= currentCommandIndex) {
         // Fetch the command.
-        ClientMoveCommand* cmd = &cl->clientUserCommands[acknowledgedCommandIndex & CMD_MASK];
+        ClientMoveCommand* cmd = &cl->clientUserCommands[commandIndex & CMD_MASK];
+        const vec3_t start = pm.state.origin;
 
         // Execute a pmove with it.
         if (cmd->input.msec) {
@@ -235,12 +537,14 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
             pm.moveCommand = *cmd;
             PMove(&pm);
 
-            // Update player move client side audio effects.
-            CLG_UpdateClientSoundSpecialEffects(&pm);
+            predictCache.pmovesRun++;
+            moved = true;
         }
 
         // Save for error detection
         cmd->prediction.origin = pm.state.origin;
+
+        CLG_PredictCacheMove(commandIndex, start, &pm);
     }
 
     // Run pending cmd
@@ -254,13 +558,18 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
         pm.moveCommand.input.upMove = cl->localmove[2];
         PMove(&pm);
 
-        // Update player move client side audio effects.
-        CLG_UpdateClientSoundSpecialEffects(&pm);
+        predictCache.pmovesRun++;
+        moved = true;
 
         // Save for error detection
         cl->moveCommand.prediction.origin = pm.state.origin;
     }
 
+    // Update player move client side audio effects.
+    if (moved) {
+        CLG_UpdateClientSoundSpecialEffects(&pm);
+    }
+
     // Copy results out for rendering
     cl->predictedState.viewOrigin  = pm.state.origin;
     //cl->predictedState.velocity    = pm.state.velocity;
@@ -269,4 +578,4 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
     cl->predictedState.viewAngles  = pm.viewAngles;
 
     cl->predictedState.groundEntityPtr = pm.groundEntityPtr;
-}
\ No newline at end of file
+}
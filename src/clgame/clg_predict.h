@@ -12,6 +12,7 @@
 void CLG_CheckPredictionError(ClientMoveCommand* moveCommand);
 void CLG_PredictAngles(void);
 void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int currentCommandIndex);
+void CLG_PredictStats_f(void);
 
 // WID: TODO: Another concern, clean up later.
 void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm);
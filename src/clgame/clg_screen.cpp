@@ -70,6 +70,69 @@ const uint32_t colorTable[8] = {
     U32_BLUE, U32_CYAN, U32_MAGENTA, U32_WHITE
 };
 
+//-----
+// Compiled layout programs, see SCR_CompileLayout.
+//-----
+#define MAX_LAYOUT_OPS      1024
+
+typedef enum {
+    LOP_X,              // args: anchor, offset
+    LOP_Y,              // args: anchor, offset
+    LOP_PIC,            // args: stat
+    LOP_CLIENT,         // args: x, y, client, score string, ping string, time string
+    LOP_CTF,            // args: x, y, client, score, ping
+    LOP_PICN,           // args: handle
+    LOP_NUM,            // args: width, stat
+    LOP_HNUM,
+    LOP_ANUM,
+    LOP_RNUM,
+    LOP_STAT_STRING,    // args: stat
+    LOP_CSTRING,        // args: string
+    LOP_CSTRING2,       // args: string
+    LOP_STRING,         // args: string
+    LOP_STRING2,        // args: string
+    LOP_IF,             // args: stat, op to jump to when zero
+    LOP_COLOR,          // args: color
+    LOP_BADSTAT,        // out of range stat, errors when reached
+    LOP_BADCLIENT       // out of range client, errors when reached
+} layoutopcode_t;
+
+typedef enum {
+    LAYOUT_LEFT,        // xl and yt
+    LAYOUT_RIGHT,       // xr and yb
+    LAYOUT_VIRTUAL      // xv and yv, relative to a centered 320x240 screen
+} layoutanchor_t;
+
+typedef struct {
+    int     op;
+    int     args[6];
+} layoutop_t;
+
+typedef struct {
+    qboolean    compiled;
+    char        source[MAX_NET_STRING];
+    layoutop_t  ops[MAX_LAYOUT_OPS];
+    int         numops;
+    char        strings[MAX_NET_STRING];   // string args are offsets in here
+    int         stringsSize;
+} layoutprog_t;
+
+static const struct {
+    char    name[3];
+    int     op;
+    int     anchor;
+} layout_coords[] = {
+    { "xl", LOP_X, LAYOUT_LEFT },
+    { "xr", LOP_X, LAYOUT_RIGHT },
+    { "xv", LOP_X, LAYOUT_VIRTUAL },
+    { "yt", LOP_Y, LAYOUT_LEFT },
+    { "yb", LOP_Y, LAYOUT_RIGHT },
+    { "yv", LOP_Y, LAYOUT_VIRTUAL }
+};
+
+static layoutprog_t scr_statusbar;
+static layoutprog_t scr_layout;
+
 //
 //=============================================================================
 //
@@ -871,6 +934,10 @@ void SCR_RegisterMedia(void)
 
     // Crosshair chan
     scr_crosshair_changed(scr_crosshair);
+
+    // Layout programs hold image handles, have them compiled again.
+    scr_statusbar.compiled = false;
+    scr_layout.compiled = false;
 }
 
 
@@ -1041,192 +1108,288 @@ static void SCR_DrawSelectedItemName(int x, int y, int item)
     }
 }
 
-static void SCR_ExecuteLayoutString(const char* s)
+//
+//=============================================================================
+//
+// LAYOUT PROGRAMS.
+//
+// Layout strings only change when the server sends a new one, so they are
+// compiled into a list of ops with image handles, stat indices and strings
+// already resolved, and only the ops are executed each frame.
+//
+//=============================================================================
+// 
+static int SCR_LayoutString(layoutprog_t *prog, const char *s)
+{
+    int offset = prog->stringsSize;
+    size_t len = strlen(s) + 1;
+
+    // COM_Parse tokens are shorter than the source, so this fits
+    if (offset + len > sizeof(prog->strings)) {
+        return offset - 1;  // the terminator of the previous string
+    }
+
+    memcpy(prog->strings + offset, s, len);
+    prog->stringsSize += len;
+    return offset;
+}
+
+// Bad indices turn the op into one that errors when executed, so that ops
+// skipped by a false if are as harmless as they were to the interpreter.
+static int SCR_LayoutStat(layoutop_t *op, const char *token)
+{
+    int value = atoi(token);
+
+    if (value < 0 || value >= MAX_STATS) {
+        op->op = LOP_BADSTAT;
+        return 0;
+    }
+
+    return value;
+}
+
+static int SCR_LayoutClient(layoutop_t *op, const char *token)
+{
+    int value = atoi(token);
+
+    if (value < 0 || value >= MAX_CLIENTS) {
+        op->op = LOP_BADCLIENT;
+        return 0;
+    }
+
+    return value;
+}
+
+//
+//===============
+// SCR_CompileLayout
+// 
+// Turns a layout string into ops. Coordinates relative to the screen edges
+// are kept relative, so the program survives resolution changes.
+//===============
+//
+static void SCR_CompileLayout(layoutprog_t *prog, const char *s)
+{
+    const char  *source = s;
+    char        buffer[MAX_QPATH];
+    char        *token;
+    layoutop_t  *op;
+    color_t     color;
+    int         ifs[MAX_LAYOUT_OPS];
+    int         i, numifs = 0;
+
+    // not usable until compiled through
+    prog->compiled = false;
+    prog->numops = 0;
+    prog->stringsSize = 1;  // offset 0 is an empty string
+    prog->strings[0] = 0;
+
+    while (s) {
+        token = COM_Parse(&s);
+
+        if (!strcmp(token, "endif")) {
+            // a false if skips to the first endif, nested or not
+            for (i = 0; i < numifs; i++) {
+                prog->ops[ifs[i]].args[1] = prog->numops;
+            }
+            numifs = 0;
+            continue;
+        }
+
+        if (prog->numops == MAX_LAYOUT_OPS) {
+            Com_WPrint("%s: too many ops\n", __func__);
+            break;
+        }
+
+        op = &prog->ops[prog->numops];
+        memset(op, 0, sizeof(*op));
+
+        for (i = 0; i < Q_COUNTOF(layout_coords); i++) {
+            if (!strcmp(token, layout_coords[i].name)) {
+                break;
+            }
+        }
+
+        if (i < Q_COUNTOF(layout_coords)) {
+            op->op = layout_coords[i].op;
+            op->args[0] = layout_coords[i].anchor;
+            op->args[1] = atoi(COM_Parse(&s));
+        } else if (!strcmp(token, "pic")) {
+            op->op = LOP_PIC;
+            op->args[0] = SCR_LayoutStat(op, COM_Parse(&s));
+        } else if (!strcmp(token, "client")) {
+            op->op = LOP_CLIENT;
+            op->args[0] = atoi(COM_Parse(&s));
+            op->args[1] = atoi(COM_Parse(&s));
+            op->args[2] = SCR_LayoutClient(op, COM_Parse(&s));
+            Q_snprintf(buffer, sizeof(buffer), "%i", atoi(COM_Parse(&s)));
+            op->args[3] = SCR_LayoutString(prog, buffer);
+            Q_snprintf(buffer, sizeof(buffer), "Ping:  %i", atoi(COM_Parse(&s)));
+            op->args[4] = SCR_LayoutString(prog, buffer);
+            Q_snprintf(buffer, sizeof(buffer), "Time:  %i", atoi(COM_Parse(&s)));
+            op->args[5] = SCR_LayoutString(prog, buffer);
+        } else if (!strcmp(token, "ctf")) {
+            op->op = LOP_CTF;
+            op->args[0] = atoi(COM_Parse(&s));
+            op->args[1] = atoi(COM_Parse(&s));
+            op->args[2] = SCR_LayoutClient(op, COM_Parse(&s));
+            op->args[3] = atoi(COM_Parse(&s));
+            op->args[4] = min(atoi(COM_Parse(&s)), 999);
+        } else if (!strcmp(token, "picn")) {
+            op->op = LOP_PICN;
+            op->args[0] = clgi.R_RegisterPic2(COM_Parse(&s));
+        } else if (!strcmp(token, "num")) {
+            op->op = LOP_NUM;
+            op->args[0] = atoi(COM_Parse(&s));
+            op->args[1] = SCR_LayoutStat(op, COM_Parse(&s));
+        } else if (!strcmp(token, "hnum")) {
+            op->op = LOP_HNUM;
+        } else if (!strcmp(token, "anum")) {
+            op->op = LOP_ANUM;
+        } else if (!strcmp(token, "rnum")) {
+            op->op = LOP_RNUM;
+        } else if (!strcmp(token, "stat_string")) {
+            op->op = LOP_STAT_STRING;
+            op->args[0] = SCR_LayoutStat(op, COM_Parse(&s));
+        } else if (!strcmp(token, "cstring")) {
+            op->op = LOP_CSTRING;
+            op->args[0] = SCR_LayoutString(prog, COM_Parse(&s));
+        } else if (!strcmp(token, "cstring2")) {
+            op->op = LOP_CSTRING2;
+            op->args[0] = SCR_LayoutString(prog, COM_Parse(&s));
+        } else if (!strcmp(token, "string")) {
+            op->op = LOP_STRING;
+            op->args[0] = SCR_LayoutString(prog, COM_Parse(&s));
+        } else if (!strcmp(token, "string2")) {
+            op->op = LOP_STRING2;
+            op->args[0] = SCR_LayoutString(prog, COM_Parse(&s));
+        } else if (!strcmp(token, "if")) {
+            op->op = LOP_IF;
+            op->args[0] = SCR_LayoutStat(op, COM_Parse(&s));
+            op->args[1] = -1;   // patched by endif
+            if (op->op == LOP_IF) {
+                ifs[numifs++] = prog->numops;
+            }
+        } else if (!strcmp(token, "color")) {
+            if (!SCR_ParseColor(COM_Parse(&s), &color)) {
+                continue;
+            }
+            op->op = LOP_COLOR;
+            op->args[0] = (int)color.u32;
+        } else {
+            continue;   // unknown tokens are ignored
+        }
+
+        prog->numops++;
+    }
+
+    // no endif skips to the end
+    for (i = 0; i < numifs; i++) {
+        prog->ops[ifs[i]].args[1] = prog->numops;
+    }
+
+    Q_strlcpy(prog->source, source, sizeof(prog->source));
+    prog->compiled = true;
+}
+
+static void SCR_ExecuteLayoutProgram(const layoutprog_t *prog)
 {
     char    buffer[MAX_QPATH];
+    const layoutop_t *op;
     int     x, y;
     int     value;
-    char* token;
-    int     width;
     int     index;
+    int     color;
+    int     i;
+    color_t rgba;
     ClientInfo* ci;
-
-    if (!s[0])
-        return;
+    const short *stats = cl->frame.playerState.stats;
 
     x = 0;
     y = 0;
 
-    while (s) {
-        token = COM_Parse(&s);
-        if (token[2] == 0) {
-            if (token[0] == 'x') {
-                if (token[1] == 'l') {
-                    token = COM_Parse(&s);
-                    x = atoi(token);
-                    continue;
-                }
-
-                if (token[1] == 'r') {
-                    token = COM_Parse(&s);
-                    x = scr.hud_width + atoi(token);
-                    continue;
-                }
-
-                if (token[1] == 'v') {
-                    token = COM_Parse(&s);
-                    x = scr.hud_width / 2 - 160 + atoi(token);
-                    continue;
-                }
-            }
+    for (i = 0; i < prog->numops; i++) {
+        op = &prog->ops[i];
 
-            if (token[0] == 'y') {
-                if (token[1] == 't') {
-                    token = COM_Parse(&s);
-                    y = atoi(token);
-                    continue;
-                }
-
-                if (token[1] == 'b') {
-                    token = COM_Parse(&s);
-                    y = scr.hud_height + atoi(token);
-                    continue;
-                }
-
-                if (token[1] == 'v') {
-                    token = COM_Parse(&s);
-                    y = scr.hud_height / 2 - 120 + atoi(token);
-                    continue;
-                }
-            }
-        }
+        switch (op->op) {
+        case LOP_X:
+            if (op->args[0] == LAYOUT_RIGHT)
+                x = scr.hud_width + op->args[1];
+            else if (op->args[0] == LAYOUT_VIRTUAL)
+                x = scr.hud_width / 2 - 160 + op->args[1];
+            else
+                x = op->args[1];
+            break;
+
+        case LOP_Y:
+            if (op->args[0] == LAYOUT_RIGHT)
+                y = scr.hud_height + op->args[1];
+            else if (op->args[0] == LAYOUT_VIRTUAL)
+                y = scr.hud_height / 2 - 120 + op->args[1];
+            else
+                y = op->args[1];
+            break;
 
-        if (!strcmp(token, "pic")) {
+        case LOP_PIC:
             // draw a pic from a stat number
-            token = COM_Parse(&s);
-            value = atoi(token);
-            if (value < 0 || value >= MAX_STATS) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            index = cl->frame.playerState.stats[value];
+            index = stats[op->args[0]];
             if (index < 0 || index >= MAX_IMAGES) {
                 Com_Error(ERR_DROP, "%s: invalid pic index", __func__);
             }
-            token = cl->configstrings[ConfigStrings::Images+ index];
-            if (token[0] && cl->precaches.images[index]) {
+            if (cl->configstrings[ConfigStrings::Images + index][0] && cl->precaches.images[index]) {
                 clgi.R_DrawPic(x, y, cl->precaches.images[index]);
             }
 
-            if (value == STAT_SELECTED_ICON && scr_showitemname->integer)
-            {
-                SCR_DrawSelectedItemName(x + 32, y + 8, cl->frame.playerState.stats[STAT_SELECTED_ITEM]);
+            if (op->args[0] == STAT_SELECTED_ICON && scr_showitemname->integer) {
+                SCR_DrawSelectedItemName(x + 32, y + 8, stats[STAT_SELECTED_ITEM]);
             }
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "client")) {
+        case LOP_CLIENT:
             // draw a deathmatch client block
-            int     score, ping, time;
-
-            token = COM_Parse(&s);
-            x = scr.hud_width / 2 - 160 + atoi(token);
-            token = COM_Parse(&s);
-            y = scr.hud_height / 2 - 120 + atoi(token);
-
-            token = COM_Parse(&s);
-            value = atoi(token);
-            if (value < 0 || value >= MAX_CLIENTS) {
-                Com_Error(ERR_DROP, "%s: invalid client index", __func__);
-            }
-            ci = &cl->clientInfo[value];
-
-            token = COM_Parse(&s);
-            score = atoi(token);
-
-            token = COM_Parse(&s);
-            ping = atoi(token);
-
-            token = COM_Parse(&s);
-            time = atoi(token);
+            x = scr.hud_width / 2 - 160 + op->args[0];
+            y = scr.hud_height / 2 - 120 + op->args[1];
+            ci = &cl->clientInfo[op->args[2]];
 
             HUD_DrawAltString(x + 32, y, ci->name);
             HUD_DrawString(x + 32, y + CHAR_HEIGHT, "Score: ");
-            Q_snprintf(buffer, sizeof(buffer), "%i", score);
-            HUD_DrawAltString(x + 32 + 7 * CHAR_WIDTH, y + CHAR_HEIGHT, buffer);
-            Q_snprintf(buffer, sizeof(buffer), "Ping:  %i", ping);
-            HUD_DrawString(x + 32, y + 2 * CHAR_HEIGHT, buffer);
-            Q_snprintf(buffer, sizeof(buffer), "Time:  %i", time);
-            HUD_DrawString(x + 32, y + 3 * CHAR_HEIGHT, buffer);
+            HUD_DrawAltString(x + 32 + 7 * CHAR_WIDTH, y + CHAR_HEIGHT, prog->strings + op->args[3]);
+            HUD_DrawString(x + 32, y + 2 * CHAR_HEIGHT, prog->strings + op->args[4]);
+            HUD_DrawString(x + 32, y + 3 * CHAR_HEIGHT, prog->strings + op->args[5]);
 
             if (!ci->icon) {
                 ci = &cl->baseClientInfo;
             }
             clgi.R_DrawPic(x, y, ci->icon);
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "ctf")) {
+        case LOP_CTF:
             // draw a ctf client block
-            int     score, ping;
-
-            token = COM_Parse(&s);
-            x = scr.hud_width / 2 - 160 + atoi(token);
-            token = COM_Parse(&s);
-            y = scr.hud_height / 2 - 120 + atoi(token);
-
-            token = COM_Parse(&s);
-            value = atoi(token);
-            if (value < 0 || value >= MAX_CLIENTS) {
-                Com_Error(ERR_DROP, "%s: invalid client index", __func__);
-            }
-            ci = &cl->clientInfo[value];
-
-            token = COM_Parse(&s);
-            score = atoi(token);
-
-            token = COM_Parse(&s);
-            ping = atoi(token);
-            if (ping > 999)
-                ping = 999;
+            x = scr.hud_width / 2 - 160 + op->args[0];
+            y = scr.hud_height / 2 - 120 + op->args[1];
+            ci = &cl->clientInfo[op->args[2]];
 
             Q_snprintf(buffer, sizeof(buffer), "%3d %3d %-12.12s",
-                score, ping, ci->name);
-            if (value == cl->frame.clientNumber) {
+                op->args[3], op->args[4], ci->name);
+            if (op->args[2] == cl->frame.clientNumber) {
                 HUD_DrawAltString(x, y, buffer);
             }
             else {
                 HUD_DrawString(x, y, buffer);
             }
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "picn")) {
-            // draw a pic from a name
-            token = COM_Parse(&s);
-            clgi.R_DrawPic(x, y, clgi.R_RegisterPic2(token));
-            continue;
-        }
+        case LOP_PICN:
+            clgi.R_DrawPic(x, y, op->args[0]);
+            break;
 
-        if (!strcmp(token, "num")) {
-            // draw a number
-            token = COM_Parse(&s);
-            width = atoi(token);
-            token = COM_Parse(&s);
-            value = atoi(token);
-            if (value < 0 || value >= MAX_STATS) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            value = cl->frame.playerState.stats[value];
-            HUD_DrawNumber(x, y, 0, width, value);
-            continue;
-        }
+        case LOP_NUM:
+            HUD_DrawNumber(x, y, 0, op->args[0], stats[op->args[1]]);
+            break;
 
-        if (!strcmp(token, "hnum")) {
+        case LOP_HNUM:
             // health number
-            int     color;
-
-            width = 3;
-            value = cl->frame.playerState.stats[STAT_HEALTH];
+            value = stats[STAT_HEALTH];
             if (value > 25)
                 color = 0;  // green
             else if (value > 0)
@@ -1234,116 +1397,83 @@ static void SCR_ExecuteLayoutString(const char* s)
             else
                 color = 1;
 
-            if (cl->frame.playerState.stats[STAT_FLASHES] & 1)
+            if (stats[STAT_FLASHES] & 1)
                 clgi.R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, color, 3, value);
+            break;
 
-        if (!strcmp(token, "anum")) {
+        case LOP_ANUM:
             // ammo number
-            int     color;
-
-            width = 3;
-            value = cl->frame.playerState.stats[STAT_AMMO];
+            value = stats[STAT_AMMO];
             if (value > 5)
                 color = 0;  // green
             else if (value >= 0)
                 color = ((cl->frame.number / CL_FRAMEDIV) >> 2) & 1;     // flash
             else
-                continue;   // negative number = don't show
+                break;      // negative number = don't show
 
-            if (cl->frame.playerState.stats[STAT_FLASHES] & 4)
+            if (stats[STAT_FLASHES] & 4)
                 clgi.R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, color, 3, value);
+            break;
 
-        if (!strcmp(token, "rnum")) {
+        case LOP_RNUM:
             // armor number
-            int     color;
-
-            width = 3;
-            value = cl->frame.playerState.stats[STAT_ARMOR];
+            value = stats[STAT_ARMOR];
             if (value < 1)
-                continue;
-
-            color = 0;  // green
+                break;
 
-            if (cl->frame.playerState.stats[STAT_FLASHES] & 2)
+            if (stats[STAT_FLASHES] & 2)
                 clgi.R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, 0, 3, value);
+            break;
 
-        if (!strcmp(token, "stat_string")) {
-            token = COM_Parse(&s);
-            index = atoi(token);
-            if (index < 0 || index >= MAX_STATS) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            index = cl->frame.playerState.stats[index];
+        case LOP_STAT_STRING:
+            index = stats[op->args[0]];
             if (index < 0 || index >= ConfigStrings::MaxConfigStrings) {
                 Com_Error(ERR_DROP, "%s: invalid string index", __func__);
             }
             HUD_DrawString(x, y, cl->configstrings[index]);
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "cstring")) {
-            token = COM_Parse(&s);
-            HUD_DrawCenterString(x + 320 / 2, y, token);
-            continue;
-        }
+        case LOP_CSTRING:
+            HUD_DrawCenterString(x + 320 / 2, y, prog->strings + op->args[0]);
+            break;
 
-        if (!strcmp(token, "cstring2")) {
-            token = COM_Parse(&s);
-            HUD_DrawAltCenterString(x + 320 / 2, y, token);
-            continue;
-        }
+        case LOP_CSTRING2:
+            HUD_DrawAltCenterString(x + 320 / 2, y, prog->strings + op->args[0]);
+            break;
 
-        if (!strcmp(token, "string")) {
-            token = COM_Parse(&s);
-            HUD_DrawString(x, y, token);
-            continue;
-        }
+        case LOP_STRING:
+            HUD_DrawString(x, y, prog->strings + op->args[0]);
+            break;
 
-        if (!strcmp(token, "string2")) {
-            token = COM_Parse(&s);
-            HUD_DrawAltString(x, y, token);
-            continue;
-        }
+        case LOP_STRING2:
+            HUD_DrawAltString(x, y, prog->strings + op->args[0]);
+            break;
 
-        if (!strcmp(token, "if")) {
-            token = COM_Parse(&s);
-            value = atoi(token);
-            if (value < 0 || value >= MAX_STATS) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            value = cl->frame.playerState.stats[value];
-            if (!value) {   // skip to endif
-                while (strcmp(token, "endif")) {
-                    token = COM_Parse(&s);
-                    if (!s) {
-                        break;
-                    }
-                }
+        case LOP_IF:
+            if (!stats[op->args[0]]) {
+                i = op->args[1] - 1;    // skip to endif
             }
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "color")) {
-            color_t     color;
+        case LOP_COLOR:
+            rgba.u32 = (uint32_t)op->args[0];
+            rgba.u8[3] *= scr_alpha->value;
+            clgi.R_SetColor(rgba.u32);
+            break;
 
-            token = COM_Parse(&s);
-            if (SCR_ParseColor(token, &color)) {
-                color.u8[3] *= scr_alpha->value;
-                clgi.R_SetColor(color.u32);
-            }
-            continue;
+        case LOP_BADSTAT:
+            Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
+            break;
+
+        case LOP_BADCLIENT:
+            Com_Error(ERR_DROP, "%s: invalid client index", __func__);
+            break;
         }
     }
 
@@ -1351,6 +1481,18 @@ static void SCR_ExecuteLayoutString(const char* s)
     clgi.R_SetAlpha(scr_alpha->value);
 }
 
+static void SCR_ExecuteLayoutString(layoutprog_t *prog, const char* s)
+{
+    if (!s[0])
+        return;
+
+    if (!prog->compiled || strcmp(prog->source, s)) {
+        SCR_CompileLayout(prog, s);
+    }
+
+    SCR_ExecuteLayoutProgram(prog);
+}
+
 
 //=============================================================================
 
@@ -1380,7 +1522,7 @@ void SCR_DrawStats(void)
     if (scr_draw2d->integer <= 1)
         return;
 
-    SCR_ExecuteLayoutString(cl->configstrings[ConfigStrings::StatusBar]);
+    SCR_ExecuteLayoutString(&scr_statusbar, cl->configstrings[ConfigStrings::StatusBar]);
 }
 
 void SCR_DrawLayout(void)
@@ -1395,7 +1537,7 @@ void SCR_DrawLayout(void)
         return;
 
 draw:
-    SCR_ExecuteLayoutString(cl->layout);
+    SCR_ExecuteLayoutString(&scr_layout, cl->layout);
 }
 
 //
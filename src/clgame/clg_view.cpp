@@ -357,8 +357,11 @@ static void CLG_AddEntities (void) {
 
     // Add entities here.
     CLG_AddPacketEntities();
+
+    clgi.ProfileBeginZone("CLG_AddEffects");
     CLG_AddTempEntities();
     CLG_AddParticles();
+    clgi.ProfileEndZone("CLG_AddEffects");
 
 #if USE_DLIGHTS
     CLG_AddDLights();
@@ -137,6 +137,7 @@ static const cmdreg_t cmd_cgmodule[] = {
     // Client commands.
     //
     { "skins", CL_Skins_f },
+    { "predictstats", CLG_PredictStats_f },
 
     //
     // Forward to server commands
@@ -187,6 +188,7 @@ void ClientGameCore::Initialize() {
     cl_monsterfootsteps = clgi.Cvar_Get("cl_monsterfootsteps", "1", 0);
     cl_player_model = clgi.Cvar_Get("cl_player_model", va("%d", CL_PLAYER_MODEL_FIRST_PERSON), CVAR_ARCHIVE);
     cl_player_model->changed = cl_player_model_changed;
+    cl_predict_cache = clgi.Cvar_Get("cl_predict_cache", "1", 0);
     cl_thirdperson_angle = clgi.Cvar_Get("cl_thirdperson_angle", "0", 0);
     cl_thirdperson_range = clgi.Cvar_Get("cl_thirdperson_range", "60", 0);
 
@@ -71,73 +71,10 @@ void ClientGamePrediction::PredictAngles() {
 }
 
 //---------------
-// ClientGamePrediction::CheckPredictionError
+// ClientGamePrediction::PredictMovement
 //
 //---------------
 void ClientGamePrediction::PredictMovement(uint32_t acknowledgedCommandIndex, uint32_t currentCommandIndex) {
-    PlayerMove   pm = {};
-
-    if (!acknowledgedCommandIndex || !currentCommandIndex)
-        return;
-
-    // Setup base trace calls.
-    pm.Trace = CLG_Trace;
-    pm.PointContents = CLG_PointContents;
-
-    // Restore ground entity for this frame.
-    pm.groundEntityPtr = cl->predictedState.groundEntityPtr;
-
-    // Copy current state to pmove
-    pm.state = cl->frame.playerState.pmove;
-#if USE_SMOOTH_DELTA_ANGLES
-    pm.state.deltaAngles = cl->deltaAngles;
-#endif
-
-    // Run frames in order.
-    while (++acknowledgedCommandIndex <= currentCommandIndex) {
-        // Fetch the command.
-        ClientMoveCommand* cmd = &cl->clientUserCommands[acknowledgedCommandIndex & CMD_MASK];
-
-        // Execute a pmove with it.
-        if (cmd->input.msec) {
-            // Saved for prediction error checking.
-            cmd->prediction.simulationTime = clgi.GetRealTime();
-
-            pm.moveCommand = *cmd;
-            PMove(&pm);
-
-            // Update player move client side audio effects.
-            CLG_UpdateClientSoundSpecialEffects(&pm);
-        }
-
-        // Save for error detection
-        cmd->prediction.origin = pm.state.origin;
-    }
-
-    // Run pending cmd
-    if (cl->moveCommand.input.msec) {
-        // Saved for prediction error checking.
-        cl->moveCommand.prediction.simulationTime = clgi.GetRealTime();
-
-        pm.moveCommand = cl->moveCommand;
-        pm.moveCommand.input.forwardMove = cl->localmove[0];
-        pm.moveCommand.input.rightMove = cl->localmove[1];
-        pm.moveCommand.input.upMove = cl->localmove[2];
-        PMove(&pm);
-
-        // Update player move client side audio effects.
-        CLG_UpdateClientSoundSpecialEffects(&pm);
-
-        // Save for error detection
-        cl->moveCommand.prediction.origin = pm.state.origin;
-    }
-
-    // Copy results out for rendering
-    cl->predictedState.viewOrigin = pm.state.origin;
-    //cl->predictedState.velocity    = pm.state.velocity;
-    cl->predictedState.viewOffset = pm.state.viewOffset;
-    cl->predictedState.stepOffset = pm.state.stepOffset;
-    cl->predictedState.viewAngles = pm.viewAngles;
-
-    cl->predictedState.groundEntityPtr = pm.groundEntityPtr;
-}
\ No newline at end of file
+    // Runs through the prediction cache, see clg_predict.cpp.
+    CLG_PredictMovement(acknowledgedCommandIndex, currentCommandIndex);
+}
@@ -49,8 +49,11 @@ void ClientGameView::RenderView() {
 
     // Add entities here.
     CLG_AddPacketEntities();
+
+    clgi.ProfileBeginZone("CLG_AddEffects");
     CLG_AddTempEntities();
     CLG_AddParticles();
+    clgi.ProfileEndZone("CLG_AddEffects");
 
 #if USE_DLIGHTS
     CLG_AddDLights();
@@ -67,6 +67,14 @@ int _wrp_GetRFps(void) {
 qboolean _wrp_IsDemoPlayback(void) {
     return cls.demo.playback;
 }
+void _wrp_ProfileBeginZone(const char *name) {
+    Prof_BeginZone(name);
+    CL_DemoBenchZone(name, true);
+}
+void _wrp_ProfileEndZone(const char *name) {
+    CL_DemoBenchZone(name, false);
+    Prof_EndZone(name);
+}
 
 // CBUF_
 void _wrp_Cbuf_AddText(char *text) {
@@ -425,6 +433,9 @@ void CL_InitGameProgs(void)
 
     importAPI.SetClientLoadState = CL_SetLoadState;
     importAPI.GetClienState = CL_GetConnectionState;
+    importAPI.GetLoadProgress = FS_PrefetchProgress;
+    importAPI.ProfileBeginZone = _wrp_ProfileBeginZone;
+    importAPI.ProfileEndZone = _wrp_ProfileEndZone;
 
     importAPI.CheckForIgnore = CL_CheckForIgnore;
     importAPI.CheckForIP = CL_CheckForIP;
@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/msg.h"
 #include "common/net/netchan.h"
 #include "common/net/net.h"
+#include "common/profile.h"
 #include "common/prompt.h"
 #include "common/protocol.h"
 #include "common/sizebuffer.h"
@@ -214,12 +215,17 @@ struct ClientStatic {
         int         file_size;
         int         file_offset;
         int         file_percent;
+        int         index_start;        // end of messages if the demo has an index
         SizeBuffer   buffer;
-        list_t      snapshots;
+        struct demosnap_s   **snapshots;    // sorted by frame number
+        int         numsnapshots;
+        qboolean    indexed;            // snapshots were loaded from an index
+        qboolean    complete;           // EOF marker was reached
         qboolean    paused;
         qboolean    seeking;
         qboolean    eof;
         char		file_name[MAX_OSPATH];
+        char        file_path[MAX_OSPATH];
     } demo;
 
 };
@@ -501,6 +507,21 @@ void CL_FirstDemoFrame(void);
 void CL_Stop_f(void);
 demoInfo_t *CL_GetDemoInfo(const char *path, demoInfo_t *info);
 
+// frame phases timed by benchmark_demo
+typedef enum {
+    DEMOBENCH_PARSE,        // CL_ParseServerMessage, excluding CL_DeltaFrame
+    DEMOBENCH_DELTA,        // CL_DeltaFrame
+    DEMOBENCH_ENTITIES,     // CLG_AddPacketEntities
+    DEMOBENCH_EFFECTS,      // particles and temp entities
+    DEMOBENCH_PREDICT,      // CL_PredictMovement
+
+    DEMOBENCH_NUM_PHASES
+} demobench_t;
+
+void CL_DemoBenchBegin(demobench_t phase);
+void CL_DemoBenchEnd(demobench_t phase);
+void CL_DemoBenchZone(const char *name, qboolean begin);
+
 
 //
 // locs.c
@@ -915,7 +915,14 @@ static void Con_DrawSolidConsole(void)
         }
 
         if (text) {
-            Q_snprintf(buffer, sizeof(buffer), "Loading %s...", text);
+            int finished, total;
+
+            // show how far the background loading got
+            FS_PrefetchProgress(&finished, &total);
+            if (total)
+                Q_snprintf(buffer, sizeof(buffer), "Loading %s... %d%%", text, finished * 100 / total);
+            else
+                Q_snprintf(buffer, sizeof(buffer), "Loading %s...", text);
 
             // draw it
             y = vislines - CON_PRESTEP + CHAR_HEIGHT * 2;
@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // cl_demo.c - demo recording and playback
 //
 
+#include <algorithm>
+
 #include "client.h"
 #include "client/gamemodule.h"
 
@@ -28,11 +30,219 @@ static byte     demo_buffer[MAX_PACKETLEN];
 static cvar_t   *cl_demosnaps;
 static cvar_t   *cl_demomsglen;
 static cvar_t   *cl_demowait;
+static cvar_t   *cl_demoindex;
 cvar_t   *cl_renderdemo;
 cvar_t   *cl_renderdemo_fps;
 
+typedef struct demosnap_s {
+    int frameNumber;
+    off_t filepos;
+    size_t msglen;
+    byte data[1];
+} demosnap_t;
+
+#define SNAP_CHUNK  64
+
+/*
+Demo index. Recording appends it after the EOF marker, so readers that
+don't know about it stop before it. Older demos get it in a separate
+.idx file next to them once they are played through. Little endian.
+
+    snapshot messages, back to back
+    dindexentry_t   entries[count]
+    dindextrailer_t trailer
+*/
+#define DEMO_INDEX_IDENT    (('X'<<24)|('D'<<16)|('I'<<8)|'D')  // "DIDX"
+#define DEMO_INDEX_VERSION  1
+
+typedef struct {
+    uint32_t    frameNumber;
+    uint32_t    filepos;    // first demo message following the snapshot
+    uint32_t    snappos;    // snapshot message, from start of file
+    uint32_t    snaplen;
+} dindexentry_t;
+
+typedef struct {
+    uint32_t    count;
+    uint32_t    entrypos;   // first entry, from start of file
+    uint32_t    demolength; // up to and including the EOF marker
+    uint32_t    ident;
+    uint32_t    version;
+} dindextrailer_t;
+
+// keyframes taken while recording
+static struct {
+    qboolean    enabled;
+    demosnap_t  **snaps;
+    int         numsnaps;
+    char        (*base)[MAX_QPATH];     // configstrings at the first keyframe
+} rec_index;
+
 // =========================================================================
 
+static demosnap_t *alloc_snapshot(int frameNumber, off_t filepos, size_t msglen)
+{
+    // CPP: Cast void* to demosnap_t *
+    demosnap_t *snap = (demosnap_t *)Z_Malloc(sizeof(*snap) + msglen - 1);
+
+    snap->frameNumber = frameNumber;
+    snap->filepos = filepos;
+    snap->msglen = msglen;
+    return snap;
+}
+
+// snapshots are always added in increasing frame order
+static void append_snapshot(demosnap_t ***list, int *count, demosnap_t *snap)
+{
+    if (!(*count & (SNAP_CHUNK - 1))) {
+        *list = (demosnap_t **)Z_Realloc(*list, sizeof(**list) * (*count + SNAP_CHUNK));
+    }
+    (*list)[(*count)++] = snap;
+}
+
+static size_t free_snapshots(demosnap_t ***list, int *count)
+{
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < *count; i++) {
+        total += (*list)[i]->msglen;
+        Z_Free((*list)[i]);
+    }
+
+    Z_Free(*list);
+    *list = NULL;
+    *count = 0;
+
+    return total;
+}
+
+static qerror_t write_index(qhandle_t f, demosnap_t **snaps, int count, size_t demolength)
+{
+    dindexentry_t entry;
+    dindextrailer_t trailer;
+    ssize_t start, ret;
+    size_t pos;
+    int i;
+
+    start = FS_Tell(f);
+    if (start < 0) {
+        return start;
+    }
+
+    for (i = 0; i < count; i++) {
+        ret = FS_Write(snaps[i]->data, snaps[i]->msglen, f);
+        if (ret != snaps[i]->msglen) {
+            return ret < 0 ? ret : Q_ERR_FAILURE;
+        }
+    }
+
+    pos = start;
+    for (i = 0; i < count; i++) {
+        entry.frameNumber = LittleLong(snaps[i]->frameNumber);
+        entry.filepos = LittleLong(snaps[i]->filepos);
+        entry.snappos = LittleLong(pos);
+        entry.snaplen = LittleLong(snaps[i]->msglen);
+        ret = FS_Write(&entry, sizeof(entry), f);
+        if (ret != sizeof(entry)) {
+            return ret < 0 ? ret : Q_ERR_FAILURE;
+        }
+        pos += snaps[i]->msglen;
+    }
+
+    trailer.count = LittleLong(count);
+    trailer.entrypos = LittleLong(pos);
+    trailer.demolength = LittleLong(demolength);
+    trailer.ident = LittleLong(DEMO_INDEX_IDENT);
+    trailer.version = LittleLong(DEMO_INDEX_VERSION);
+    ret = FS_Write(&trailer, sizeof(trailer), f);
+    if (ret != sizeof(trailer)) {
+        return ret < 0 ? ret : Q_ERR_FAILURE;
+    }
+
+    return Q_ERR_SUCCESS;
+}
+
+// loads the index ending at the given length of the file into playback
+// snapshots. returns number of snapshots, 0 if there is no index.
+static int load_index(qhandle_t f, ssize_t length, uint32_t *demolength)
+{
+    dindextrailer_t trailer;
+    dindexentry_t *entries, *e;
+    demosnap_t *snap;
+    uint32_t i, count, entrypos;
+    int prev = INT_MIN;
+    ssize_t ret;
+
+    if (length < (ssize_t)sizeof(trailer)) {
+        return 0;
+    }
+    if (FS_Seek(f, length - sizeof(trailer))) {
+        return 0;
+    }
+    if (FS_Read(&trailer, sizeof(trailer), f) != sizeof(trailer)) {
+        return 0;
+    }
+    if (LittleLong(trailer.ident) != DEMO_INDEX_IDENT ||
+        LittleLong(trailer.version) != DEMO_INDEX_VERSION) {
+        return 0;
+    }
+
+    count = LittleLong(trailer.count);
+    entrypos = LittleLong(trailer.entrypos);
+    if (!count || count > length / sizeof(*entries) ||
+        entrypos + count * sizeof(*entries) != length - sizeof(trailer)) {
+        return Q_ERR_INVALID_FORMAT;
+    }
+
+    entries = (dindexentry_t *)Z_Malloc(count * sizeof(*entries));
+    if (FS_Seek(f, entrypos) ||
+        FS_Read(entries, count * sizeof(*entries), f) != count * sizeof(*entries)) {
+        ret = Q_ERR_UNEXPECTED_EOF;
+        goto fail;
+    }
+
+    *demolength = LittleLong(trailer.demolength);
+
+    for (i = 0, e = entries; i < count; i++, e++) {
+        e->frameNumber = LittleLong(e->frameNumber);
+        e->filepos = LittleLong(e->filepos);
+        e->snappos = LittleLong(e->snappos);
+        e->snaplen = LittleLong(e->snaplen);
+
+        if ((int)e->frameNumber <= prev || e->snaplen > MAX_MSGLEN ||
+            e->snappos > entrypos || e->snaplen > entrypos - e->snappos) {
+            ret = Q_ERR_INVALID_FORMAT;
+            goto fail;
+        }
+        prev = e->frameNumber;
+
+        if (FS_Seek(f, e->snappos)) {
+            ret = Q_ERR_UNEXPECTED_EOF;
+            goto fail;
+        }
+
+        snap = alloc_snapshot(e->frameNumber, e->filepos, e->snaplen);
+        if (FS_Read(snap->data, e->snaplen, f) != e->snaplen) {
+            Z_Free(snap);
+            ret = Q_ERR_UNEXPECTED_EOF;
+            goto fail;
+        }
+
+        append_snapshot(&cls.demo.snapshots, &cls.demo.numsnapshots, snap);
+    }
+
+    Z_Free(entries);
+    return count;
+
+fail:
+    free_snapshots(&cls.demo.snapshots, &cls.demo.numsnapshots);
+    Z_Free(entries);
+    return ret;
+}
+
+static void emit_keyframe(void);
+
 /*
 ====================
 CL_WriteDemoMessage
@@ -66,6 +276,11 @@ qboolean CL_WriteDemoMessage(SizeBuffer *buf)
     Com_DDPrintf("%s: wrote %" PRIz " bytes\n", __func__, buf->currentSize);
 
     SZ_Clear(buf);
+
+    // frames are only ever flushed through the demo buffer
+    if (buf == &cls.demo.buffer)
+        emit_keyframe();
+
     return true;
 
 fail:
@@ -232,6 +447,84 @@ void CL_EmitDemoFrame(void)
     SZ_Clear(&msg_write);
 }
 
+/*
+====================
+emit_keyframe
+
+Saves a full copy of the last written frame every cl_demoindex seconds
+of recording, to be written as demo index when recording stops. The
+configstrings are relative to the first keyframe, just like playback
+snapshots are relative to the first frame.
+====================
+*/
+static void emit_keyframe(void)
+{
+    ServerFrame *frame;
+    demosnap_t *snap;
+    ssize_t pos;
+    char *s;
+    size_t len;
+    int i;
+
+    if (!rec_index.enabled || cls.demo.last_server_frame == -1)
+        return;
+
+    if (rec_index.numsnaps && cls.demo.frames_written <
+        rec_index.snaps[rec_index.numsnaps - 1]->frameNumber + cl_demoindex->integer * 10)
+        return;
+
+    frame = &cl.frames[cls.demo.last_server_frame & UPDATE_MASK];
+    if (frame->number != cls.demo.last_server_frame || !frame->valid ||
+        cl.numEntityStates - frame->firstEntity > MAX_PARSE_ENTITIES)
+        return;
+
+    if (msg_write.currentSize)
+        return;
+
+    pos = FS_Tell(cls.demo.recording);
+    if (pos < 0)
+        return;
+
+    if (!rec_index.base) {
+        rec_index.base = (char (*)[MAX_QPATH])Z_Malloc(sizeof(cl.configstrings)); // CPP: Cast
+        memcpy(rec_index.base, cl.configstrings, sizeof(cl.configstrings));
+    }
+
+    // the next frame in the demo deltas from this one
+    emit_delta_frame(NULL, frame, -1, FRAME_PRE);
+
+    for (i = 0; i < ConfigStrings::MaxConfigStrings; i++) {
+        s = cl.configstrings[i];
+        if (!strcmp(rec_index.base[i], s))
+            continue;
+
+        len = strlen(s);
+        if (len > MAX_QPATH)
+            len = MAX_QPATH;
+
+        MSG_WriteByte(svc_configstring);
+        MSG_WriteShort(i);
+        MSG_WriteData(s, len);
+        MSG_WriteByte(0);
+    }
+
+    MSG_WriteByte(SVG_CMD_LAYOUT);
+    MSG_WriteString(cl.layout);
+
+    snap = alloc_snapshot(cls.demo.frames_written, pos, msg_write.currentSize);
+    memcpy(snap->data, msg_write.data, msg_write.currentSize);
+    append_snapshot(&rec_index.snaps, &rec_index.numsnaps, snap);
+
+    SZ_Clear(&msg_write);
+}
+
+static void free_keyframes(void)
+{
+    free_snapshots(&rec_index.snaps, &rec_index.numsnaps);
+    Z_Free(rec_index.base);
+    memset(&rec_index, 0, sizeof(rec_index));
+}
+
 static size_t format_demo_size(char *buffer, size_t size)
 {
     return Com_FormatSizeLong(buffer, size, FS_Tell(cls.demo.recording));
@@ -274,6 +567,8 @@ void CL_Stop_f(void)
 {
     uint32_t msglen;
     char buffer[MAX_QPATH];
+    qerror_t ret;
+    ssize_t pos;
 
     if (!cls.demo.recording) {
         Com_Printf("Not recording a demo.\n");
@@ -284,6 +579,15 @@ void CL_Stop_f(void)
     msglen = (uint32_t)-1;
     FS_Write(&msglen, 4, cls.demo.recording);
 
+// append index
+    pos = FS_Tell(cls.demo.recording);
+    if (rec_index.numsnaps && pos > 0) {
+        ret = write_index(cls.demo.recording, rec_index.snaps, rec_index.numsnaps, pos);
+        if (ret)
+            Com_EPrintf("Couldn't write demo index: %s\n", Q_ErrorString(ret));
+    }
+    free_keyframes();
+
     format_demo_size(buffer, sizeof(buffer));
 
 // close demofile
@@ -384,6 +688,10 @@ static void CL_Record_f(void)
     // the first frame will be delta uncompressed
     cls.demo.last_server_frame = -1;
 
+    // first keyframe is taken as soon as the first frame is written
+    free_keyframes();
+    rec_index.enabled = cl_demoindex->integer > 0;
+
     SZ_Init(&cls.demo.buffer, demo_buffer, size);
 
     // clear dirty configstrings
@@ -655,6 +963,8 @@ static int parse_next_message(int wait)
     int ret;
 
     ret = read_next_message(cls.demo.playback);
+    if (ret == 0)
+        cls.demo.complete = true;
     if (ret < 0 || (ret == 0 && wait == 0)) {
         finish_demo(ret);
         return -1;
@@ -667,7 +977,9 @@ static int parse_next_message(int wait)
         return -1;
     }
 
+    CL_DemoBenchBegin(DEMOBENCH_PARSE);
     CL_ParseServerMessage();
+    CL_DemoBenchEnd(DEMOBENCH_PARSE);
 
     // if recording demo, write the message out
     if (cls.demo.recording && !cls.demo.paused && CL_FRAMESYNC) {
@@ -680,6 +992,91 @@ static int parse_next_message(int wait)
     return 0;
 }
 
+static void index_path(char *buffer, size_t size, const char *path)
+{
+    Q_concat(buffer, size, path, ".idx", NULL);
+}
+
+/*
+====================
+load_demo_index
+
+Picks up the index appended to the demo by recording, or the one built
+by an earlier playback of an older demo.
+====================
+*/
+static void load_demo_index(const char *path)
+{
+    char buffer[MAX_OSPATH];
+    ssize_t pos, len, ret;
+    uint32_t demolength;
+    qhandle_t f;
+
+    pos = FS_Tell(cls.demo.playback);
+    len = FS_Length(cls.demo.playback);
+    if (pos < 0 || len <= 0)
+        return;
+
+    ret = load_index(cls.demo.playback, len, &demolength);
+    if (FS_Seek(cls.demo.playback, pos))
+        Com_Error(ERR_DROP, "Couldn't seek demo back after reading index");
+
+    if (ret > 0) {
+        cls.demo.index_start = demolength;
+    } else {
+        if (ret < 0)
+            Com_WPrintf("Ignoring demo index in %s: %s\n", path, Q_ErrorString(ret));
+
+        index_path(buffer, sizeof(buffer), path);
+        ret = FS_FOpenFile(buffer, &f, FS_MODE_READ);
+        if (!f)
+            return;
+
+        ret = load_index(f, ret, &demolength);
+        FS_FCloseFile(f);
+
+        if (ret > 0 && demolength != len) {
+            // demo was replaced since
+            free_snapshots(&cls.demo.snapshots, &cls.demo.numsnapshots);
+            ret = Q_ERR_INVALID_FORMAT;
+        }
+        if (ret < 0)
+            Com_WPrintf("Ignoring demo index %s: %s\n", buffer, Q_ErrorString(ret));
+    }
+
+    if (ret > 0) {
+        Com_DPrintf("Loaded demo index with %d snapshots\n", (int)ret);
+        cls.demo.indexed = true;
+    }
+}
+
+// saves snapshots built while playing an older demo through, so the next
+// playback can seek anywhere right away
+static void save_demo_index(void)
+{
+    char buffer[MAX_OSPATH];
+    ssize_t len;
+    qerror_t ret;
+    qhandle_t f;
+
+    len = FS_Length(cls.demo.playback);
+    if (len <= 0)
+        return;
+
+    index_path(buffer, sizeof(buffer), cls.demo.file_path);
+    FS_FOpenFile(buffer, &f, FS_MODE_WRITE);
+    if (!f)
+        return;
+
+    ret = write_index(f, cls.demo.snapshots, cls.demo.numsnapshots, len);
+    FS_FCloseFile(f);
+
+    if (ret)
+        Com_EPrintf("Couldn't write %s: %s\n", buffer, Q_ErrorString(ret));
+    else
+        Com_DPrintf("Wrote %s with %d snapshots\n", buffer, cls.demo.numsnapshots);
+}
+
 /*
 ====================
 CL_PlayDemo_f
@@ -724,6 +1121,9 @@ static void CL_PlayDemo_f(void)
     cls.demo.playback = f;
 
 	Q_strlcpy(cls.demo.file_name, Cmd_Argv(1), sizeof(cls.demo.file_name));
+    Q_strlcpy(cls.demo.file_path, name, sizeof(cls.demo.file_path));
+
+    load_demo_index(name);
 
     cls.connectionState = ClientConnectionState::Connected;
     Q_strlcpy(cls.servername, COM_SkipPath(name), sizeof(cls.servername));
@@ -749,14 +1149,6 @@ static void CL_Demo_c(genctx_t *ctx, int argnum)
     }
 }
 
-typedef struct {
-    list_t entry;
-    int frameNumber;
-    off_t filepos;
-    size_t msglen;
-    byte data[1];
-} demosnap_t;
-
 /*
 ====================
 CL_EmitDemoSnapshot
@@ -777,6 +1169,10 @@ void CL_EmitDemoSnapshot(void)
     if (cl_demosnaps->integer <= 0)
         return;
 
+    // the index already has snapshots for the whole demo
+    if (cls.demo.indexed)
+        return;
+
     if (cls.demo.frames_read < cls.demo.last_snapshot + cl_demosnaps->integer * 10)
         return;
 
@@ -829,13 +1225,9 @@ void CL_EmitDemoSnapshot(void)
     MSG_WriteByte(SVG_CMD_LAYOUT);
     MSG_WriteString(cl.layout);
 
-    // CPP: Cast void* to demosnap_t *
-    snap = (demosnap_t*)Z_Malloc(sizeof(*snap) + msg_write.currentSize - 1);
-    snap->frameNumber = cls.demo.frames_read;
-    snap->filepos = pos;
-    snap->msglen = msg_write.currentSize;
+    snap = alloc_snapshot(cls.demo.frames_read, pos, msg_write.currentSize);
     memcpy(snap->data, msg_write.data, msg_write.currentSize);
-    List_Append(&cls.demo.snapshots, &snap->entry);
+    append_snapshot(&cls.demo.snapshots, &cls.demo.numsnapshots, snap);
 
     Com_DPrintf("[%d] snaplen %" PRIz "\n", cls.demo.frames_read, msg_write.currentSize); // CPP: WARNING: String concat
 
@@ -844,22 +1236,23 @@ void CL_EmitDemoSnapshot(void)
     cls.demo.last_snapshot = cls.demo.frames_read;
 }
 
+// returns the last snapshot at or before the given frame, or the first one
 static demosnap_t *find_snapshot(int frameNumber)
 {
-    demosnap_t *snap, *prev;
+    int lo = 0, hi = cls.demo.numsnapshots - 1, mid;
 
-    if (LIST_EMPTY(&cls.demo.snapshots))
+    if (!cls.demo.numsnapshots)
         return NULL;
 
-    prev = LIST_FIRST(demosnap_t, &cls.demo.snapshots, entry);
-
-    LIST_FOR_EACH(demosnap_t, snap, &cls.demo.snapshots, entry) {
-        if (snap->frameNumber > frameNumber)
-            break;
-        prev = snap;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (cls.demo.snapshots[mid]->frameNumber > frameNumber)
+            hi = mid - 1;
+        else
+            lo = mid;
     }
 
-    return prev;
+    return cls.demo.snapshots[lo];
 }
 
 /*
@@ -881,6 +1274,8 @@ void CL_FirstDemoFrame(void)
     // obtain file length and offset of the second frame
     len = FS_Length(cls.demo.playback);
     ofs = FS_Tell(cls.demo.playback);
+    if (cls.demo.index_start > 0)
+        len = cls.demo.index_start;
     if (len > 0 && ofs > 0) {
         cls.demo.file_offset = ofs;
         cls.demo.file_size = len - ofs;
@@ -893,7 +1288,10 @@ void CL_FirstDemoFrame(void)
     }
 
     // force initial snapshot
-    cls.demo.last_snapshot = INT_MIN;
+    if (cls.demo.indexed)
+        cls.demo.last_snapshot = cls.demo.snapshots[cls.demo.numsnapshots - 1]->frameNumber;
+    else
+        cls.demo.last_snapshot = INT_MIN;
 }
 
 static void CL_Seek_f(void)
@@ -954,9 +1352,12 @@ static void CL_Seek_f(void)
 
     Com_DPrintf("[%d] seeking to %d\n", cls.demo.frames_read, dest);
 
-    // seek to the previous most recent snapshot
+    // seek to the previous most recent snapshot, unless reading forward
+    // from the current position gets there sooner
     if (frames < 0 || cls.demo.last_snapshot > cls.demo.frames_read) {
         snap = find_snapshot(dest);
+        if (snap && frames > 0 && snap->frameNumber <= cls.demo.frames_read)
+            snap = NULL;
 
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->frameNumber);
@@ -1135,11 +1536,270 @@ fail:
 
 }
 
+/*
+===============================================================================
+
+DEMO BENCHMARK
+
+===============================================================================
+*/
+
+enum {
+    BENCH_FRAME = DEMOBENCH_NUM_PHASES, // whole client frame
+    BENCH_COLUMNS
+};
+
+static const char *const bench_names[BENCH_COLUMNS] = {
+    "parse", "delta", "entities", "effects", "predict", "frame"
+};
+
+// zones the client game opens through ProfileBeginZone
+static const struct {
+    const char  *name;
+    demobench_t phase;
+} bench_zones[] = {
+    { "CLG_AddPacketEntities", DEMOBENCH_ENTITIES },
+    { "CLG_AddEffects", DEMOBENCH_EFFECTS }
+};
+
+static struct {
+    qboolean    active;
+    qboolean    json;
+    char        name[MAX_QPATH];
+
+    // settings to restore when done
+    char        vid_null[MAX_QPATH];
+    char        s_enable[MAX_QPATH];
+    char        timedemo[MAX_QPATH];
+
+    uint64_t    begin[DEMOBENCH_NUM_PHASES];
+    uint64_t    frame[BENCH_COLUMNS];   // spent in the current frame
+    uint64_t    frame_start;
+
+    uint64_t    *times[BENCH_COLUMNS];  // nanoseconds, one per frame
+    int         numframes, maxframes;
+} demo_bench;
+
+void CL_DemoBenchBegin(demobench_t phase)
+{
+    if (demo_bench.active) {
+        demo_bench.begin[phase] = Prof_Nanoseconds();
+    }
+}
+
+void CL_DemoBenchEnd(demobench_t phase)
+{
+    if (demo_bench.active && demo_bench.begin[phase]) {
+        demo_bench.frame[phase] += Prof_Nanoseconds() - demo_bench.begin[phase];
+        demo_bench.begin[phase] = 0;
+    }
+}
+
+void CL_DemoBenchZone(const char *name, qboolean begin)
+{
+    int i;
+
+    if (!demo_bench.active) {
+        return;
+    }
+
+    for (i = 0; i < Q_COUNTOF(bench_zones); i++) {
+        if (!strcmp(bench_zones[i].name, name)) {
+            if (begin)
+                CL_DemoBenchBegin(bench_zones[i].phase);
+            else
+                CL_DemoBenchEnd(bench_zones[i].phase);
+            return;
+        }
+    }
+}
+
+// called at the start of every timedemo frame, stores the previous one
+static void bench_frame(void)
+{
+    uint64_t now;
+    int i;
+
+    if (!demo_bench.active) {
+        return;
+    }
+
+    now = Prof_Nanoseconds();
+
+    if (demo_bench.frame_start) {
+        if (demo_bench.numframes == demo_bench.maxframes) {
+            demo_bench.maxframes = max(demo_bench.maxframes * 2, 1024);
+            for (i = 0; i < BENCH_COLUMNS; i++) {
+                demo_bench.times[i] = (uint64_t *)Z_Realloc(demo_bench.times[i],
+                    sizeof(uint64_t) * demo_bench.maxframes);
+            }
+        }
+
+        // delta frames are parsed from within CL_ParseServerMessage
+        demo_bench.frame[DEMOBENCH_PARSE] -= min(demo_bench.frame[DEMOBENCH_PARSE],
+                                                 demo_bench.frame[DEMOBENCH_DELTA]);
+        demo_bench.frame[BENCH_FRAME] = now - demo_bench.frame_start;
+
+        for (i = 0; i < BENCH_COLUMNS; i++) {
+            demo_bench.times[i][demo_bench.numframes] = demo_bench.frame[i];
+        }
+        demo_bench.numframes++;
+    }
+
+    memset(demo_bench.frame, 0, sizeof(demo_bench.frame));
+    demo_bench.frame_start = now;
+}
+
+static void bench_restore(void)
+{
+    Cvar_SetEx("vid_null", demo_bench.vid_null, FROM_CODE);
+    Cvar_SetEx("s_enable", demo_bench.s_enable, FROM_CODE);
+    Cvar_SetEx("timedemo", demo_bench.timedemo, FROM_CODE);
+}
+
+static void bench_write_json(const float stats[BENCH_COLUMNS][5], float seconds)
+{
+    static const char *const stat_names[5] = { "avg", "p50", "p90", "p99", "max" };
+    char path[MAX_OSPATH];
+    qhandle_t f;
+    int i, j;
+
+    f = FS_EasyOpenFile(path, sizeof(path), FS_MODE_WRITE | FS_FLAG_TEXT,
+                        "benchmarks/", COM_SkipPath(demo_bench.name), ".json");
+    if (!f) {
+        return;
+    }
+
+    FS_FPrintf(f, "{\n  \"demo\": \"%s\",\n  \"frames\": %d,\n  \"seconds\": %.3f,\n"
+               "  \"fps\": %.1f,\n  \"units\": \"msec\",\n  \"phases\": {\n",
+               demo_bench.name, demo_bench.numframes, seconds,
+               seconds ? demo_bench.numframes / seconds : 0.0f);
+
+    for (i = 0; i < BENCH_COLUMNS; i++) {
+        FS_FPrintf(f, "    \"%s\": { ", bench_names[i]);
+        for (j = 0; j < 5; j++) {
+            FS_FPrintf(f, "\"%s\": %.4f%s", stat_names[j], stats[i][j], j < 4 ? ", " : " ");
+        }
+        FS_FPrintf(f, "}%s\n", i < BENCH_COLUMNS - 1 ? "," : "");
+    }
+
+    FS_FPrintf(f, "  }\n}\n");
+    FS_FCloseFile(f);
+
+    Com_Printf("Wrote %s\n", path);
+}
+
+// prints the results and restores settings once the demo is closed
+static void bench_finish(void)
+{
+    float stats[BENCH_COLUMNS][5];
+    float seconds;
+    uint64_t total;
+    int i, j, n = demo_bench.numframes;
+
+    if (!demo_bench.active) {
+        return;
+    }
+
+    demo_bench.active = false;
+
+    if (n) {
+        seconds = 0;
+        for (i = 0; i < n; i++)
+            seconds += demo_bench.times[BENCH_FRAME][i] * 1e-9f;
+
+        Com_Printf("%s: %d frames, %.1f seconds, %.1f fps\n", demo_bench.name,
+                   n, seconds, seconds ? n / seconds : 0.0f);
+        Com_Printf("phase          avg      p50      p90      p99      max (msec)\n");
+        for (i = 0; i < BENCH_COLUMNS; i++) {
+            total = 0;
+            for (j = 0; j < n; j++)
+                total += demo_bench.times[i][j];
+            std::sort(demo_bench.times[i], demo_bench.times[i] + n);
+
+            stats[i][0] = total * 1e-6f / n;
+            stats[i][1] = Prof_Percentile(demo_bench.times[i], n, 50);
+            stats[i][2] = Prof_Percentile(demo_bench.times[i], n, 90);
+            stats[i][3] = Prof_Percentile(demo_bench.times[i], n, 99);
+            stats[i][4] = demo_bench.times[i][n - 1] * 1e-6f;
+
+            Com_Printf("%-8s %8.3f %8.3f %8.3f %8.3f %8.3f\n", bench_names[i],
+                       stats[i][0], stats[i][1], stats[i][2], stats[i][3], stats[i][4]);
+        }
+
+        if (demo_bench.json)
+            bench_write_json(stats, seconds);
+    } else {
+        Com_Printf("%s: no frames were played\n", demo_bench.name);
+    }
+
+    bench_restore();
+
+    for (i = 0; i < BENCH_COLUMNS; i++)
+        Z_Free(demo_bench.times[i]);
+    memset(&demo_bench, 0, sizeof(demo_bench));
+}
+
+/*
+====================
+CL_BenchmarkDemo_f
+
+Plays a demo as a timedemo with the null refresh and sound disabled, so
+only the client side of every frame is measured. Phase times are split
+out per frame and summarized as percentiles when the demo ends.
+====================
+*/
+static void CL_BenchmarkDemo_f(void)
+{
+    cvar_t *s_enable = Cvar_FindVar("s_enable");
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <demo> [json]\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (demo_bench.active) {
+        Com_Printf("Already benchmarking %s.\n", demo_bench.name);
+        return;
+    }
+
+    Q_strlcpy(demo_bench.name, Cmd_Argv(1), sizeof(demo_bench.name));
+    demo_bench.json = !Q_stricmp(Cmd_Argv(2), "json");
+
+    Q_strlcpy(demo_bench.vid_null, vid_null->string, sizeof(demo_bench.vid_null));
+    Q_strlcpy(demo_bench.s_enable, s_enable ? s_enable->string : "0", sizeof(demo_bench.s_enable));
+    Q_strlcpy(demo_bench.timedemo, com_timedemo->string, sizeof(demo_bench.timedemo));
+
+    Cvar_SetByVar(com_timedemo, "1", FROM_CODE);
+
+    if (s_enable && s_enable->integer) {
+        Cvar_SetByVar(s_enable, "0", FROM_CODE);
+        S_Shutdown();
+        S_Init();
+    }
+    cvar_modified &= ~CVAR_SOUND;
+
+    if (!vid_null->integer) {
+        Cvar_SetByVar(vid_null, "1", FROM_CODE);
+        CL_RestartRefresh(true);
+    }
+    cvar_modified &= ~CVAR_REFRESH;
+
+    // demo command disconnects first, don't let that finish the benchmark
+    Cmd_ExecuteString(&cmd_buffer, va("demo \"%s\"", demo_bench.name));
+    if (!cls.demo.playback) {
+        bench_restore();
+        memset(&demo_bench, 0, sizeof(demo_bench));
+        return;
+    }
+
+    demo_bench.active = true;
+}
+
 // =========================================================================
 
 void CL_CleanupDemos(void)
 {
-    demosnap_t *snap, *next;
     size_t total;
 
     if (cls.demo.recording) {
@@ -1147,6 +1807,11 @@ void CL_CleanupDemos(void)
     }
 
     if (cls.demo.playback) {
+        if (cls.demo.complete && !cls.demo.indexed &&
+            cls.demo.numsnapshots && cl_demoindex->integer > 0) {
+            save_demo_index();
+        }
+
         FS_FCloseFile(cls.demo.playback);
 
         if (com_timedemo->integer && cls.demo.time_frames) {
@@ -1162,11 +1827,7 @@ void CL_CleanupDemos(void)
         }
     }
 
-    total = 0;
-    LIST_FOR_EACH_SAFE(demosnap_t, snap, next, &cls.demo.snapshots, entry) {
-        total += snap->msglen;
-        Z_Free(snap);
-    }
+    total = free_snapshots(&cls.demo.snapshots, &cls.demo.numsnapshots);
 
     if (total) {
         Com_DPrintf("Freed %" PRIz " bytes of snaps\n", total);
@@ -1174,7 +1835,7 @@ void CL_CleanupDemos(void)
 
     memset(&cls.demo, 0, sizeof(cls.demo));
 
-    List_Init(&cls.demo.snapshots);
+    bench_finish();
 }
 
 /*
@@ -1194,6 +1855,7 @@ void CL_DemoFrame(int msec)
     }
 
     if (com_timedemo->integer) {
+        bench_frame();
         parse_next_message(0);
         cl.time = cl.serverTime;
         cls.demo.time_frames++;
@@ -1223,6 +1885,7 @@ static const cmdreg_t c_demo[] = {
     { "stop", CL_Stop_f },
     { "suspend", CL_Suspend_f },
     { "seek", CL_Seek_f },
+    { "benchmark_demo", CL_BenchmarkDemo_f, CL_Demo_c },
 
     { NULL }
 };
@@ -1237,12 +1900,12 @@ void CL_InitDemos(void)
     cl_demosnaps = Cvar_Get("cl_demosnaps", "10", 0);
     cl_demomsglen = Cvar_Get("cl_demomsglen", va("%d", MAX_PACKETLEN_WRITABLE_DEFAULT), 0);
     cl_demowait = Cvar_Get("cl_demowait", "0", 0);
+    cl_demoindex = Cvar_Get("cl_demoindex", "10", 0);
 
 	cl_renderdemo = Cvar_Get("cl_renderdemo", "0", CVAR_ARCHIVE);
 	cl_renderdemo_fps = Cvar_Get("cl_renderdemo_fps", "60", CVAR_ARCHIVE);
 
     Cmd_Register(c_demo);
-    List_Init(&cls.demo.snapshots);
 }
 
 
@@ -3136,7 +3136,9 @@ unsigned CL_Frame(unsigned msec)
     CL_SendCmd();
 
     // Predict all unacknowledged movements
+    CL_DemoBenchBegin(DEMOBENCH_PREDICT);
     CL_PredictMovement();
+    CL_DemoBenchEnd(DEMOBENCH_PREDICT);
 
     Con_RunConsole();
 
@@ -352,8 +352,11 @@ static void CL_ParseFrame(int extrabits)
 
     cls.demo.frames_read++;
 
-    if (!cls.demo.seeking)
+    if (!cls.demo.seeking) {
+        CL_DemoBenchBegin(DEMOBENCH_DELTA);
         CL_DeltaFrame();
+        CL_DemoBenchEnd(DEMOBENCH_DELTA);
+    }
 }
 
 /*
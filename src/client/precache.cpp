@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "client.h"
 #include "client/gamemodule.h"
+#include "common/jobs.h"
 #include "client/sound/vorbis.h"
 
 /*
@@ -84,6 +85,76 @@ void CL_RegisterBspModels(void)
 }
 
 
+/*
+=================
+CL_PrefetchMedia
+
+Queues the level media to be read and decoded on the job threads, in
+the order registration is going to need it: world textures, models,
+pics and sounds. Returns the map, which must be kept referenced until
+the renderer has loaded it.
+=================
+*/
+static bsp_t *CL_PrefetchMedia(void)
+{
+    char    buffer[MAX_QPATH];
+    bsp_t   *bsp;
+    char    *name;
+    size_t  len;
+    int     i;
+
+    if (!Job_NumThreads())
+        return NULL;
+
+    // the renderer loads the same map first thing, BSP_Load keeps it cached
+    BSP_Load(cl.configstrings[ConfigStrings::Models+ 1], &bsp);
+    if (bsp) {
+        for (i = 0; i < bsp->numtexinfo; i++) {
+            Q_concat(buffer, sizeof(buffer), "/textures/", bsp->texinfo[i].name, ".wal", NULL);
+            R_PrefetchImage(buffer, IT_WALL, IF_NONE, JOB_PRIORITY_HIGH);
+        }
+    }
+
+    for (i = 2; i < MAX_MODELS; i++) {
+        name = cl.configstrings[ConfigStrings::Models+ i];
+        if (!name[0])
+            break;
+        if (name[0] == '*' || name[0] == '#')
+            continue;
+
+        // R_RegisterModel looks for .md3 before .md2
+        len = FS_NormalizePathBuffer(buffer, name, sizeof(buffer));
+        if (len > 4 && len < sizeof(buffer) && !strcmp(buffer + len - 4, ".md2")) {
+            memcpy(buffer + len - 4, ".md3", 4);
+            if (FS_PrefetchFile(buffer, 0, JOB_PRIORITY_NORMAL + 50, NULL, NULL))
+                continue;
+            memcpy(buffer + len - 4, ".md2", 4);
+        }
+        FS_PrefetchFile(buffer, 0, JOB_PRIORITY_NORMAL + 50, NULL, NULL);
+    }
+
+    for (i = 1; i < MAX_IMAGES; i++) {
+        name = cl.configstrings[ConfigStrings::Images+ i];
+        if (!name[0])
+            break;
+        R_PrefetchImage(name, IT_PIC, IF_SRGB, JOB_PRIORITY_NORMAL);
+    }
+
+    for (i = 1; i < MAX_SOUNDS; i++) {
+        name = cl.configstrings[ConfigStrings::Sounds+ i];
+        if (!name[0])
+            break;
+        if (name[0] == '*')
+            continue;   // sexed sounds depend on the player model
+        if (name[0] == '#')
+            FS_PrefetchFile(name + 1, 0, JOB_PRIORITY_LOW, NULL, NULL);
+        else if (Q_concat(buffer, sizeof(buffer), "sound/", name, NULL) < sizeof(buffer))
+            FS_PrefetchFile(buffer, 0, JOB_PRIORITY_LOW, NULL, NULL);
+    }
+
+    return bsp;
+}
+
 /*
 =================
 CL_PrepareMedia
@@ -99,8 +170,11 @@ void CL_PrepareMedia(void)
         return;     // no map loaded
 
 
+    bsp_t *prefetched = CL_PrefetchMedia();
+
     // register models, pics, and skins
     R_BeginRegistration(cl.mapName);
+    BSP_Free(prefetched);
     // register sounds.
     S_BeginRegistration();
 
@@ -117,6 +191,9 @@ void CL_PrepareMedia(void)
     // the renderer can now free unneeded stuff
     R_EndRegistration(cl.mapName);
 
+    // drop whatever registration didn't end up using
+    FS_FlushPrefetch();
+
     // clear any lines of console text
     Con_ClearNotify_f();
 
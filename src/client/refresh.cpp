@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 // Console variables that we need to access from this module
 cvar_t      *vid_rtx;
+cvar_t      *vid_null;
 cvar_t      *vid_geometry;
 cvar_t      *vid_modelist;
 cvar_t      *vid_fullscreen;
@@ -306,9 +307,15 @@ void CL_InitRefresh(void)
     vid_display = Cvar_Get("vid_display", "0", CVAR_ARCHIVE | CVAR_REFRESH);
     vid_displaylist = Cvar_Get("vid_displaylist", "\"<unknown>\" 0", CVAR_ROM);
 
+    vid_null = Cvar_Get("vid_null", "0", CVAR_REFRESH);
+
     Com_SetLastError(NULL);
 
-    modelist = VID_GetDefaultModeList();
+    // null refresh runs headless, don't touch the video subsystem
+    if (vid_null->integer)
+        modelist = Z_CopyString("640x480");
+    else
+        modelist = VID_GetDefaultModeList();
     if (!modelist) {
         Com_Error(ERR_FATAL, "Couldn't initialize refresh: %s", Com_GetLastError());
     }
@@ -338,6 +345,9 @@ void CL_InitRefresh(void)
 
     Com_SetLastError(NULL);
 
+    if (vid_null->integer)
+        R_RegisterFunctionsNull();
+    else
 #if REF_GL && REF_VKPT
 	if (vid_rtx->integer)
 		R_RegisterFunctionsRTX();
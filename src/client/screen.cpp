@@ -50,6 +50,9 @@ static cvar_t   *scr_showpmove;
 #endif
 static cvar_t   *scr_showturtle;
 static cvar_t   *scr_showitemname;
+#if USE_PROFILER
+static cvar_t   *scr_showprofile;
+#endif
 
 static cvar_t   *scr_draw2d;
 static cvar_t   *scr_lag_x;
@@ -780,6 +783,9 @@ void SCR_Init(void)
     scr_showstats = Cvar_Get("scr_showstats", "0", 0);
     scr_showpmove = Cvar_Get("scr_showpmove", "0", 0);
 #endif
+#if USE_PROFILER
+    scr_showprofile = Cvar_Get("scr_showprofile", "0", 0);
+#endif
 
     Cmd_Register(scr_cmds);
 
@@ -846,6 +852,39 @@ static void SCR_TileClear(void)
 
 //=============================================================================
 
+#if USE_PROFILER
+
+#define MAX_PROFILE_LINES   32
+
+static void SCR_DrawProfile(void)
+{
+    profstat_t stats[MAX_PROFILE_LINES];
+    char buffer[MAX_QPATH];
+    int i, count;
+    int x, y;
+
+    if (!scr_showprofile->integer)
+        return;
+
+    count = Prof_GetStats(stats, min(scr_showprofile->integer, MAX_PROFILE_LINES));
+
+    x = scr.hud_width - 48 * CHAR_WIDTH;
+    y = CHAR_HEIGHT * 4;
+
+    Q_snprintf(buffer, sizeof(buffer), "%-24s %5s %7s %7s", "zone", "calls", "avg ms", "max ms");
+    R_DrawString(x, y, UI_ALTCOLOR, MAX_STRING_CHARS, buffer, scr.font_pic);
+    y += CHAR_HEIGHT;
+
+    for (i = 0; i < count; i++) {
+        Q_snprintf(buffer, sizeof(buffer), "%-24.24s %5.0f %7.3f %7.3f",
+                   stats[i].name, stats[i].calls, stats[i].avg_ms, stats[i].max_ms);
+        R_DrawString(x, y, 0, MAX_STRING_CHARS, buffer, scr.font_pic);
+        y += CHAR_HEIGHT;
+    }
+}
+
+#endif
+
 static void SCR_DrawPause(void)
 {/*
     int x, y;*/
@@ -898,6 +937,10 @@ static void SCR_Draw2D(void)
     SCR_DrawDebugPMove();
 #endif
 
+#if USE_PROFILER
+    SCR_DrawProfile();
+#endif
+
     R_SetScale(1.0f);
 	R_SetAlphaScale(1.0f);
 }
@@ -17,19 +17,171 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // snd_dma.c -- main control for any streaming sound output device
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "sound.h"
 
 dma_t       dma;
 
 cvar_t      *s_khz;
 cvar_t      *s_testsound;
+cvar_t      *snd_precache_async;
 #if USE_DSOUND
 static cvar_t       *s_direct;
 #endif
 static cvar_t       *s_mixahead;
+static cvar_t       *s_mixthread;
+static cvar_t       *s_wavout;
 
 static snddmaAPI_t snddma;
 
+static void MIX_Start(void);
+static void MIX_Stop(void);
+static void MIX_Clear(void);
+static void MIX_Update(void);
+
+/*
+===============================================================================
+
+WAV CAPTURE DEVICE
+
+Stands in for the sound card when s_wavout is set. Nothing is played, the
+device position only moves when the main thread advances the capture clock
+and whatever the device consumes is appended to the WAV file. Output is
+always 16 bit stereo at the s_khz rate.
+
+===============================================================================
+*/
+
+// the capture clock runs 1/60th of a second of audio per client frame
+#define CAPTURE_FPS     60
+
+static FILE     *cap_file;
+static unsigned cap_bytes;
+
+static void CAP_Put(byte *p, uint32_t v, int size)
+{
+    while (size--) {
+        *p++ = v & 255;
+        v >>= 8;
+    }
+}
+
+static void CAP_WriteHeader(void)
+{
+    byte    header[44];
+
+    memcpy(header + 0, "RIFF", 4);
+    CAP_Put(header + 4, 36 + cap_bytes, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    CAP_Put(header + 16, 16, 4);                // fmt chunk size
+    CAP_Put(header + 20, 1, 2);                 // PCM
+    CAP_Put(header + 22, dma.channels, 2);
+    CAP_Put(header + 24, dma.speed, 4);
+    CAP_Put(header + 28, dma.speed * dma.channels * 2, 4);
+    CAP_Put(header + 32, dma.channels * 2, 2);  // block align
+    CAP_Put(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    CAP_Put(header + 40, cap_bytes, 4);
+
+    fseek(cap_file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), cap_file);
+    fseek(cap_file, 0, SEEK_END);
+}
+
+// the device consumes count sample pairs painted at time
+static void CAP_Consume(int time, int count)
+{
+    int     fullsamples = dma.samples >> 1;
+    int     lpos, n;
+
+    while (count > 0) {
+        lpos = time & (fullsamples - 1);
+        n = min(count, fullsamples - lpos);
+        cap_bytes += fwrite(dma.buffer + lpos * 4, 1, n * 4, cap_file);
+        time += n;
+        count -= n;
+    }
+
+    dma.samplepos = (time & (fullsamples - 1)) << 1;
+}
+
+static sndinitstat_t CAP_Init(void)
+{
+    char    path[MAX_OSPATH];
+
+    if (Q_snprintf(path, sizeof(path), "%s/%s", fs_gamedir, s_wavout->string) >= sizeof(path) - 4) {
+        Com_EPrintf("Oversize s_wavout path\n");
+        return SIS_FAILURE;
+    }
+    COM_DefaultExtension(path, ".wav", sizeof(path));
+
+    cap_file = fopen(path, "wb");
+    if (!cap_file) {
+        Com_EPrintf("Couldn't open %s: %s\n", path, strerror(errno));
+        return SIS_FAILURE;
+    }
+
+    switch (s_khz->integer) {
+    case 48:
+        dma.speed = 48000;
+        break;
+    case 44:
+        dma.speed = 44100;
+        break;
+    case 22:
+        dma.speed = 22050;
+        break;
+    default:
+        dma.speed = 11025;
+        break;
+    }
+
+    dma.channels = 2;
+    dma.samples = 0x8000 * dma.channels;
+    dma.submission_chunk = 1;
+    dma.samplebits = 16;
+    dma.buffer = (byte *)Z_Mallocz(dma.samples * 2);
+    dma.samplepos = 0;
+
+    cap_bytes = 0;
+    CAP_WriteHeader();
+
+    Com_Printf("Capturing sound to %s\n", path);
+
+    return SIS_SUCCESS;
+}
+
+static void CAP_Shutdown(void)
+{
+    if (cap_file) {
+        CAP_WriteHeader();
+        fclose(cap_file);
+        cap_file = NULL;
+        Com_Printf("Captured %u bytes of sound\n", cap_bytes);
+    }
+
+    if (dma.buffer) {
+        Z_Free(dma.buffer);
+        dma.buffer = NULL;
+    }
+}
+
+static void CAP_Nop(void)
+{
+}
+
+static void CAP_FillAPI(snddmaAPI_t *api)
+{
+    api->Init = CAP_Init;
+    api->Shutdown = CAP_Shutdown;
+    api->BeginPainting = CAP_Nop;
+    api->Submit = CAP_Nop;
+    api->Activate = NULL;
+}
+
 void DMA_SoundInfo(void)
 {
     Com_Printf("%5d channels\n", dma.channels);
@@ -50,10 +202,21 @@ qboolean DMA_Init(void)
     s_khz = Cvar_Get("s_khz", "44", CVAR_ARCHIVE | CVAR_SOUND);
     s_mixahead = Cvar_Get("s_mixahead", "0.1", CVAR_ARCHIVE);
     s_testsound = Cvar_Get("s_testsound", "0", 0);
+    s_mixthread = Cvar_Get("s_mixthread", "0", CVAR_ARCHIVE | CVAR_SOUND);
+    s_wavout = Cvar_Get("s_wavout", "", CVAR_SOUND);
+    snd_precache_async = Cvar_Get("snd_precache_async", "0", 0);
+
+    if (s_wavout->string[0]) {
+        CAP_FillAPI(&snddma);
+        ret = snddma.Init();
+        if (ret != SIS_SUCCESS) {
+            return false;
+        }
+    }
 
 #if USE_DSOUND
     s_direct = Cvar_Get("s_direct", "1", CVAR_SOUND);
-    if (s_direct->integer) {
+    if (ret != SIS_SUCCESS && s_direct->integer) {
         DS_FillAPI(&snddma);
         ret = snddma.Init();
         if (ret != SIS_SUCCESS) {
@@ -75,11 +238,14 @@ qboolean DMA_Init(void)
 
     Com_Printf("sound sampling rate: %i\n", dma.speed);
 
+    MIX_Start();
+
     return true;
 }
 
 void DMA_Shutdown(void)
 {
+    MIX_Stop();
     snddma.Shutdown();
     s_numchannels = 0;
 }
@@ -116,6 +282,11 @@ void DMA_ClearBuffer(void)
 {
     int     clear;
 
+    if (DMA_MixerActive()) {
+        MIX_Clear();
+        return;
+    }
+
     if (dma.samplebits == 8)
         clear = 0x80;
     else
@@ -127,7 +298,16 @@ void DMA_ClearBuffer(void)
     snddma.Submit();
 }
 
-static int DMA_GetTime(void)
+/*
+================
+DMA_GetTime
+
+Returns the device position in sample pairs. When the painted time gets
+close to 32 bit limits it is chopped off, and wrapped is set so that the
+caller can stop all sounds.
+================
+*/
+static int DMA_GetTime(int *painted, qboolean *wrapped)
 {
     static  int     buffers;
     static  int     oldsamplepos;
@@ -135,13 +315,14 @@ static int DMA_GetTime(void)
 
 // it is possible to miscount buffers if it has wrapped twice between
 // calls to S_Update.  Oh well.
+    *wrapped = false;
     if (dma.samplepos < oldsamplepos) {
         buffers++;                  // buffer wrapped
-        if (paintedtime > 0x40000000) {
+        if (*painted > 0x40000000) {
             // time to chop things off to avoid 32 bit limits
             buffers = 0;
-            paintedtime = fullsamples;
-            S_StopAllSounds();
+            *painted = fullsamples;
+            *wrapped = true;
         }
     }
     oldsamplepos = dma.samplepos;
@@ -149,10 +330,30 @@ static int DMA_GetTime(void)
     return buffers * fullsamples + dma.samplepos / dma.channels;
 }
 
+// mix ahead of current position, to an even submission block size
+static int DMA_MixEnd(int soundtime, int mixahead)
+{
+    int endTime, samps;
+
+    endTime = soundtime + mixahead;
+    endTime = (endTime + dma.submission_chunk - 1)
+              & ~(dma.submission_chunk - 1);
+    samps = dma.samples >> (dma.channels - 1);
+    if (endTime - soundtime > samps)
+        endTime = soundtime + samps;
+
+    return endTime;
+}
+
 void DMA_Update(void)
 {
     int soundtime, endTime;
-    int samps;
+    qboolean wrapped;
+
+    if (DMA_MixerActive()) {
+        MIX_Update();
+        return;
+    }
 
     snddma.BeginPainting();
 
@@ -160,7 +361,9 @@ void DMA_Update(void)
         return;
 
 // Updates DMA time
-    soundtime = DMA_GetTime();
+    soundtime = DMA_GetTime(&paintedtime, &wrapped);
+    if (wrapped)
+        S_StopAllSounds();
 
 // check to make sure that we haven't overshot
     if (paintedtime < soundtime) {
@@ -168,20 +371,557 @@ void DMA_Update(void)
         paintedtime = soundtime;
     }
 
-// mix ahead of current position
-    endTime = soundtime + s_mixahead->value * dma.speed;
-//endTime = (soundtime + 4096) & ~4095;
-
-    // mix to an even submission block size
-    endTime = (endTime + dma.submission_chunk - 1)
-              & ~(dma.submission_chunk - 1);
-    samps = dma.samples >> (dma.channels - 1);
-    if (endTime - soundtime > samps)
-        endTime = soundtime + samps;
+    endTime = DMA_MixEnd(soundtime, s_mixahead->value * dma.speed);
 
     S_PaintChannels(endTime);
 
     snddma.Submit();
 }
 
+/*
+===============================================================================
+
+MIXER THREAD
+
+With s_mixthread set, painting moves off the main thread. The main thread
+keeps its channels as the model that picks channels, spatializes entity
+sounds and schedules playsounds, and forwards every change to the mixer as
+a command through a single producer, single consumer ring. The mixer owns
+private copies of the channels and raw samples and paints ahead of the
+device position on its own clock, so a long client frame no longer starves
+the device.
+
+The WAV capture device is fed through the same commands, consumed either by
+the thread or inline at the end of each client frame. The capture clock is
+advanced by a command as well, so the output only depends on the order of
+commands and is reproducible.
+
+===============================================================================
+*/
+
+#define MIX_RING_SIZE   (1 << 18)   // must be a power of two
+
+typedef enum {
+    MIX_START,      // start a sound on a slot once its begin time is reached
+    MIX_UPDATE,     // new volumes for a slot
+    MIX_STOP,       // stop a slot
+    MIX_CLEAR,      // stop everything and silence the buffer
+    MIX_LISTENER,   // listener moved
+    MIX_GAIN,       // master volume changed
+    MIX_RAW,        // streamed samples follow
+    MIX_ADVANCE     // capture clock ticked
+} mixop_t;
+
+typedef struct {
+    mixop_t     op;
+    unsigned    size;       // including payload
+    int         slot;
+    int         time;       // begin time, raw start or capture samples
+    int         count;      // raw samples or capture paint end
+    float       gain;
+    qboolean    active;     // listener is in the game
+    vec3_t      origin;     // listener origin
+    vec3_t      right;      // listener right, negated for s_swapstereo
+    channel_t   ch;         // fixed_origin is only set if the mixer spatializes
+} mixcmd_t;
+
+typedef struct {
+    channel_t       channels[MAX_CHANNELS];
+    channel_t       pending[MAX_CHANNELS];  // started, waiting for begin
+    int             begin[MAX_CHANNELS];
+    samplepair_t    raw[S_MAX_RAW_SAMPLES];
+    int             rawend;
+    int             paintedtime;
+    int             capturetime;
+    qboolean        active;
+    vec3_t          origin;
+    vec3_t          right;
+} mixstate_t;
+
+static byte                     mix_ring[MIX_RING_SIZE];
+static std::atomic<unsigned>    mix_head;       // written by the main thread
+static std::atomic<unsigned>    mix_tail;       // written by the mixer
+static std::atomic<int>         mix_time;       // mixer painted time
+static std::atomic<int>         mix_ahead;      // s_mixahead in samples
+static std::atomic<bool>        mix_wrapped;
+static std::atomic<bool>        mix_quit;
+static std::thread              mix_thread;
+static qboolean                 mix_active;
+
+// main thread: what the mixer was last told about each slot
+static channel_t    mix_sent[MAX_CHANNELS];
+static int          mix_capturetime;
+
+// owned by whoever consumes the commands
+static mixstate_t   mix;
+
+static void MIX_Write(unsigned pos, const void *data, size_t len)
+{
+    size_t ofs = pos & (MIX_RING_SIZE - 1);
+    size_t part = min(len, MIX_RING_SIZE - ofs);
+
+    memcpy(mix_ring + ofs, data, part);
+    memcpy(mix_ring, (const byte *)data + part, len - part);
+}
+
+static void MIX_Read(unsigned pos, void *data, size_t len)
+{
+    size_t ofs = pos & (MIX_RING_SIZE - 1);
+    size_t part = min(len, MIX_RING_SIZE - ofs);
+
+    memcpy(data, mix_ring + ofs, part);
+    memcpy((byte *)data + part, mix_ring, len - part);
+}
+
+// only fixed origin sounds are spatialized by the mixer, the main thread
+// sends volumes for everything else
+static void MIX_Spatialize(channel_t *ch)
+{
+    if (!ch->fixed_origin)
+        return;
+
+    if (!mix.active) {
+        ch->leftvol = ch->rightvol = 255;
+        return;
+    }
+
+    S_SpatializeListener(ch->origin, mix.origin, mix.right, ch->master_vol, ch->dist_mult, &ch->leftvol, &ch->rightvol);
+}
+
+static void MIX_Paint(int endTime)
+{
+    channel_t   *ch;
+    sfxcache_t  *sc;
+    int         i, end;
+
+    while (mix.paintedtime < endTime) {
+        end = endTime;
+
+        // start pending sounds that are due, and stop at the next one
+        for (i = 0; i < MAX_CHANNELS; i++) {
+            if (!mix.pending[i].sfx)
+                continue;
+
+            if (mix.begin[i] > mix.paintedtime) {
+                if (mix.begin[i] < end)
+                    end = mix.begin[i];
+                continue;
+            }
+
+            ch = &mix.channels[i];
+            *ch = mix.pending[i];
+            mix.pending[i].sfx = NULL;
+
+            sc = ch->sfx->cache;
+            if (ch->autosound) {
+                // keep looping sounds in phase, like S_AddLoopSounds does
+                ch->pos = mix.paintedtime % sc->length;
+                ch->end = mix.paintedtime + sc->length - ch->pos;
+            } else {
+                ch->pos = 0;
+                ch->end = mix.paintedtime + sc->length;
+            }
+            MIX_Spatialize(ch);
+        }
+
+        S_PaintChunk(mix.channels, MAX_CHANNELS, mix.paintedtime, end, mix.raw, mix.rawend);
+        mix.paintedtime = end;
+    }
+}
+
+static void MIX_Execute(const mixcmd_t *cmd, unsigned payload)
+{
+    channel_t   *ch;
+    int         i, n, dst;
+
+    switch (cmd->op) {
+    case MIX_START:
+        mix.pending[cmd->slot] = cmd->ch;
+        mix.begin[cmd->slot] = cmd->time;
+        break;
+
+    case MIX_UPDATE:
+        // volumes belong to the most recently started sound
+        ch = &mix.pending[cmd->slot];
+        if (!ch->sfx)
+            ch = &mix.channels[cmd->slot];
+        ch->leftvol = cmd->ch.leftvol;
+        ch->rightvol = cmd->ch.rightvol;
+        break;
+
+    case MIX_STOP:
+        mix.channels[cmd->slot].sfx = NULL;
+        mix.pending[cmd->slot].sfx = NULL;
+        break;
+
+    case MIX_CLEAR:
+        memset(mix.channels, 0, sizeof(mix.channels));
+        memset(mix.pending, 0, sizeof(mix.pending));
+
+        snddma.BeginPainting();
+        if (dma.buffer)
+            memset(dma.buffer, dma.samplebits == 8 ? 0x80 : 0, dma.samples * dma.samplebits / 8);
+        snddma.Submit();
+        break;
+
+    case MIX_LISTENER:
+        mix.active = cmd->active;
+        VectorCopy(cmd->origin, mix.origin);
+        VectorCopy(cmd->right, mix.right);
+
+        for (i = 0; i < MAX_CHANNELS; i++)
+            if (mix.channels[i].sfx)
+                MIX_Spatialize(&mix.channels[i]);
+        break;
+
+    case MIX_GAIN:
+        S_SetPaintGain(cmd->gain);
+        break;
+
+    case MIX_RAW:
+        for (i = 0; i < cmd->count; i += n) {
+            dst = (cmd->time + i) & (S_MAX_RAW_SAMPLES - 1);
+            n = min(cmd->count - i, S_MAX_RAW_SAMPLES - dst);
+            MIX_Read(payload + i * sizeof(samplepair_t), &mix.raw[dst], n * sizeof(samplepair_t));
+        }
+        mix.rawend = cmd->time + cmd->count;
+        break;
+
+    case MIX_ADVANCE:
+        // everything the device consumes must be painted first
+        MIX_Paint(mix.capturetime + cmd->time);
+        CAP_Consume(mix.capturetime, cmd->time);
+        mix.capturetime += cmd->time;
+
+        // then paint ahead of it like a real device
+        MIX_Paint(cmd->count);
+        break;
+    }
+}
+
+static void MIX_RunCommands(void)
+{
+    unsigned    tail = mix_tail.load(std::memory_order_relaxed);
+    mixcmd_t    cmd;
+
+    while (tail != mix_head.load(std::memory_order_acquire)) {
+        MIX_Read(tail, &cmd, sizeof(cmd));
+        MIX_Execute(&cmd, tail + sizeof(cmd));
+        tail += cmd.size;
+        mix_tail.store(tail, std::memory_order_release);
+    }
+}
+
+static void MIX_Thread(void)
+{
+    int         soundtime, msec;
+    qboolean    wrapped;
+
+    while (!mix_quit.load(std::memory_order_acquire)) {
+        MIX_RunCommands();
+
+        // the capture clock only moves with commands
+        if (cap_file) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        snddma.BeginPainting();
+        if (!dma.buffer) {
+            snddma.Submit();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        soundtime = DMA_GetTime(&mix.paintedtime, &wrapped);
+        if (wrapped) {
+            // the main thread stops all of its sounds too
+            memset(mix.channels, 0, sizeof(mix.channels));
+            memset(mix.pending, 0, sizeof(mix.pending));
+            mix.rawend = 0;
+            mix_wrapped.store(true, std::memory_order_release);
+        }
+
+        // catch up after an underrun
+        if (mix.paintedtime < soundtime)
+            mix.paintedtime = soundtime;
+
+        MIX_Paint(DMA_MixEnd(soundtime, mix_ahead.load(std::memory_order_relaxed)));
+        snddma.Submit();
+
+        mix_time.store(mix.paintedtime, std::memory_order_release);
+
+        // come back when half of what is buffered ahead has been played
+        msec = (mix.paintedtime - soundtime) * 500 / dma.speed;
+        std::this_thread::sleep_for(std::chrono::milliseconds(clamp(msec, 1, 10)));
+    }
+}
+
+static void MIX_InitCmd(mixcmd_t *cmd, mixop_t op, int slot)
+{
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->op = op;
+    cmd->slot = slot;
+}
+
+static void MIX_Push(mixcmd_t *cmd, const void *data, size_t len)
+{
+    unsigned head = mix_head.load(std::memory_order_relaxed);
+
+    cmd->size = sizeof(*cmd) + len;
+
+    // wait for the mixer to make room
+    while (MIX_RING_SIZE - (head - mix_tail.load(std::memory_order_acquire)) < cmd->size) {
+        if (mix_thread.joinable())
+            std::this_thread::yield();
+        else
+            MIX_RunCommands();
+    }
+
+    MIX_Write(head, cmd, sizeof(*cmd));
+    if (len)
+        MIX_Write(head + sizeof(*cmd), data, len);
+
+    mix_head.store(head + cmd->size, std::memory_order_release);
+}
+
+// waits until the mixer has executed everything pushed so far
+static void MIX_Flush(void)
+{
+    if (!mix_thread.joinable()) {
+        MIX_RunCommands();
+        return;
+    }
+
+    while (mix_tail.load(std::memory_order_acquire) != mix_head.load(std::memory_order_relaxed))
+        std::this_thread::yield();
+}
+
+static qboolean MIX_FixedOrigin(const channel_t *ch)
+{
+    // sounds from the view entity are full volume, see S_Spatialize
+    return ch->fixed_origin && ch->entnum != -1 && ch->entnum != listener_entnum;
+}
+
+static void MIX_Start(void)
+{
+    mix_active = s_mixthread->integer || cap_file;
+    if (!mix_active)
+        return;
+
+    memset(&mix, 0, sizeof(mix));
+    memset(mix_sent, 0, sizeof(mix_sent));
+    mix_head = 0;
+    mix_tail = 0;
+    mix_time = 0;
+    mix_ahead = s_mixahead->value * dma.speed;
+    mix_wrapped = false;
+    mix_quit = false;
+    mix_capturetime = 0;
+
+    if (s_mixthread->integer) {
+        mix_thread = std::thread(MIX_Thread);
+        Com_Printf("Mixing sound on a separate thread\n");
+    }
+}
+
+static void MIX_Stop(void)
+{
+    if (!mix_active)
+        return;
+
+    // let the capture device see every frame that was sent
+    MIX_Flush();
+
+    if (mix_thread.joinable()) {
+        mix_quit = true;
+        mix_thread.join();
+    }
+
+    mix_active = false;
+}
+
+static void MIX_Clear(void)
+{
+    mixcmd_t    cmd;
+
+    MIX_InitCmd(&cmd, MIX_CLEAR, 0);
+    MIX_Push(&cmd, NULL, 0);
+
+    // sounds may be freed right after this, so wait for the mixer to let go
+    MIX_Flush();
+
+    memset(mix_sent, 0, sizeof(mix_sent));
+}
+
+/*
+================
+MIX_Update
+
+Main thread side of DMA_Update with the mixer active.
+================
+*/
+static void MIX_Update(void)
+{
+    mixcmd_t    cmd;
+    channel_t   *ch, *sent;
+    playsound_t *ps;
+    sfxcache_t  *sc;
+    int         i, count;
+
+    if (cap_file) {
+        // tick the capture clock, the mixer paints ahead of it to the same
+        // time as we predict here
+        count = dma.speed / CAPTURE_FPS;
+        mix_capturetime += count;
+
+        MIX_InitCmd(&cmd, MIX_ADVANCE, 0);
+        cmd.time = count;
+        cmd.count = DMA_MixEnd(mix_capturetime, s_mixahead->value * dma.speed);
+        MIX_Push(&cmd, NULL, 0);
+
+        paintedtime = cmd.count;
+    } else {
+        mix_ahead.store(s_mixahead->value * dma.speed, std::memory_order_relaxed);
+        paintedtime = mix_time.load(std::memory_order_acquire);
+
+        if (mix_wrapped.exchange(false))
+            S_StopAllSounds();
+    }
+
+    MIX_InitCmd(&cmd, MIX_LISTENER, 0);
+    cmd.active = cls.connectionState == ClientConnectionState::Active;
+    VectorCopy(listener_origin, cmd.origin);
+    if (s_swapstereo->integer)
+        VectorNegate(listener_right, cmd.right);
+    else
+        VectorCopy(listener_right, cmd.right);
+    MIX_Push(&cmd, NULL, 0);
+
+    // the mixer stops finished sounds on its own, catch up with it
+    for (i = 0, ch = channels; i < s_numchannels; i++, ch++) {
+        if (!ch->sfx || ch->autosound || ch->end > paintedtime)
+            continue;
+
+        sc = ch->sfx->cache;
+        if (sc && sc->loopstart >= 0) {
+            ch->end = paintedtime + sc->length - sc->loopstart;
+        } else {
+            ch->sfx = NULL;
+            mix_sent[i].sfx = NULL;
+        }
+    }
+
+    // issue playsounds due before the mixer is likely to run again, it
+    // holds them until their exact begin time
+    while (1) {
+        ps = s_pendingplays.next;
+        if (ps == &s_pendingplays)
+            break;
+        if ((int)ps->begin > paintedtime + dma.speed / 50)
+            break;
+        S_IssuePlaysound(ps);
+    }
+
+    // forward whatever else changed since the last frame
+    for (i = 0, ch = channels, sent = mix_sent; i < s_numchannels; i++, ch++, sent++) {
+        if (!ch->sfx) {
+            if (sent->sfx) {
+                MIX_InitCmd(&cmd, MIX_STOP, i);
+                MIX_Push(&cmd, NULL, 0);
+            }
+        } else if (ch->sfx != sent->sfx || ch->autosound != sent->autosound) {
+            // autosounds, everything else went through DMA_StartChannel
+            MIX_InitCmd(&cmd, MIX_START, i);
+            cmd.time = paintedtime;
+            cmd.ch = *ch;
+            cmd.ch.fixed_origin = MIX_FixedOrigin(ch);
+            MIX_Push(&cmd, NULL, 0);
+        } else if (!MIX_FixedOrigin(ch) && (ch->leftvol != sent->leftvol || ch->rightvol != sent->rightvol)) {
+            MIX_InitCmd(&cmd, MIX_UPDATE, i);
+            cmd.ch.leftvol = ch->leftvol;
+            cmd.ch.rightvol = ch->rightvol;
+            MIX_Push(&cmd, NULL, 0);
+        }
+        *sent = *ch;
+    }
+
+    if (!mix_thread.joinable())
+        MIX_RunCommands();
+}
+
+qboolean DMA_MixerActive(void)
+{
+    return mix_active;
+}
 
+/*
+================
+DMA_StartChannel
+
+Called by S_IssuePlaysound. The mixer starts the sound at exactly its begin
+time, which may be a little after it was issued.
+================
+*/
+void DMA_StartChannel(channel_t *ch, int begin)
+{
+    mixcmd_t    cmd;
+    int         slot = ch - channels;
+
+    if (!mix_active)
+        return;
+
+    if (begin < paintedtime)
+        begin = paintedtime;
+    ch->end += begin - paintedtime;
+
+    MIX_InitCmd(&cmd, MIX_START, slot);
+    cmd.time = begin;
+    cmd.ch = *ch;
+    cmd.ch.fixed_origin = MIX_FixedOrigin(ch);
+    MIX_Push(&cmd, NULL, 0);
+
+    mix_sent[slot] = *ch;
+}
+
+// forwards samples S_RawSamples just wrote to s_rawsamples
+void DMA_RawSamples(int start, int count)
+{
+    mixcmd_t    cmd;
+    int         ofs, n;
+
+    if (!mix_active)
+        return;
+
+    if (count > S_MAX_RAW_SAMPLES) {
+        start += count - S_MAX_RAW_SAMPLES;
+        count = S_MAX_RAW_SAMPLES;
+    }
+
+    while (count > 0) {
+        ofs = start & (S_MAX_RAW_SAMPLES - 1);
+        n = min(count, S_MAX_RAW_SAMPLES - ofs);
+
+        MIX_InitCmd(&cmd, MIX_RAW, 0);
+        cmd.time = start;
+        cmd.count = n;
+        MIX_Push(&cmd, &s_rawsamples[ofs], n * sizeof(samplepair_t));
+
+        start += n;
+        count -= n;
+    }
+}
+
+void DMA_SetGain(float gain)
+{
+    mixcmd_t    cmd;
+
+    if (!mix_active) {
+        S_SetPaintGain(gain);
+        return;
+    }
+
+    MIX_InitCmd(&cmd, MIX_GAIN, 0);
+    cmd.gain = gain;
+    MIX_Push(&cmd, NULL, 0);
+}
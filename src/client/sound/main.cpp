@@ -69,6 +69,7 @@ cvar_t		*s_voiceinput;
 cvar_t		*s_voiceinput_volume;
 cvar_t		*s_reverb_set_preset;
 cvar_t      *s_ambient;
+cvar_t      *s_swapstereo;
 
 
 #ifdef _DEBUG
@@ -77,7 +78,6 @@ cvar_t      *s_show;
 
 static cvar_t   *s_enable;
 static cvar_t   *s_auto_focus;
-static cvar_t   *s_swapstereo;
 
 // N&C: Moved to ClientState
 //extern qboolean snd_is_underwater;
@@ -147,6 +147,9 @@ static const cmdreg_t c_sound[] = {
     { "stopsound", S_StopAllSounds },
     { "soundlist", S_SoundList_f },
     { "soundinfo", S_SoundInfo_f },
+#if USE_SNDDMA
+    { "s_mixbench", S_MixBench_f },
+#endif
 
     { NULL }
 };
@@ -318,6 +321,10 @@ static void S_FreeSound(sfx_t *sfx)
 #if USE_OPENAL
     if (s_started == SS_OAL)
         AL_DeleteSfx(sfx);
+#endif
+#if USE_SNDDMA
+    if (sfx->loading)
+        S_CancelResampling(sfx);
 #endif
     if (sfx->cache)
         Z_Free(sfx->cache);
@@ -667,6 +674,12 @@ void S_EndRegistration(void)
         S_LoadSound(sfx);
     }
 
+#if USE_SNDDMA
+    // wait for the resampler, unless sounds may come in late
+    if (s_started == SS_DMA)
+        S_FinishResampling(!snd_precache_async->integer);
+#endif
+
     s_registering = false;
 }
 
@@ -732,25 +745,21 @@ channel_t *S_PickChannel(int entnum, int entchannel)
 
 /*
 =================
-S_SpatializeOrigin
+S_SpatializeListener
 
-Used for spatializing channels and autosounds
+Spatializes an origin against an explicit listener. Doesn't touch any
+client state, so that the mixer thread can use it on its own listener.
 =================
 */
-void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult, int *left_vol, int *right_vol)
+void S_SpatializeListener(const vec3_t &origin, const vec3_t &lorigin, const vec3_t &lright, float master_vol, float dist_mult, int *left_vol, int *right_vol)
 {
     vec_t       dot;
     vec_t       dist;
     vec_t       lscale, rscale, scale;
     vec3_t      source_vec;
 
-    if (cls.connectionState != ClientConnectionState::Active) {
-        *left_vol = *right_vol = 255;
-        return;
-    }
-
 // calculate stereo seperation and distance attenuation
-    VectorSubtract(origin, listener_origin, source_vec);
+    VectorSubtract(origin, lorigin, source_vec);
 
     dist = VectorNormalize(source_vec);
     dist -= SOUND_FULLVOLUME;
@@ -758,9 +767,7 @@ void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult,
         dist = 0;           // close enough to be at full volume
     dist *= dist_mult;      // different attenuation levels
 
-    dot = DotProduct(listener_right, source_vec);
-    if (s_swapstereo->integer)
-        dot = -dot;
+    dot = DotProduct(lright, source_vec);
 
     if (dma.channels == 1 || !dist_mult) {
         // no attenuation = no spatialization
@@ -785,6 +792,30 @@ void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult,
         *left_vol = 0;
 }
 
+/*
+=================
+S_SpatializeOrigin
+
+Used for spatializing channels and autosounds
+=================
+*/
+void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult, int *left_vol, int *right_vol)
+{
+    vec3_t      right;
+
+    if (cls.connectionState != ClientConnectionState::Active) {
+        *left_vol = *right_vol = 255;
+        return;
+    }
+
+    if (s_swapstereo->integer)
+        VectorNegate(listener_right, right);
+    else
+        VectorCopy(listener_right, right);
+
+    S_SpatializeListener(origin, listener_origin, right, master_vol, dist_mult, left_vol, right_vol);
+}
+
 /*
 =================
 S_Spatialize
@@ -908,6 +939,11 @@ void S_IssuePlaysound(playsound_t *ps)
     ch->pos = 0;
     ch->end = paintedtime + sc->length;
 
+#if USE_SNDDMA
+    if (s_started == SS_DMA)
+        DMA_StartChannel(ch, ps->begin);
+#endif
+
     // free the playsound
     S_FreePlaysound(ps);
 }
@@ -1229,6 +1265,9 @@ void S_Update(void)
     if (s_volume->modified)
         S_InitScaletable();
 
+    // pick up sounds converted in the background
+    S_FinishResampling(false);
+
     // update spatialization for dynamic sounds
     ch = channels;
     for (i = 0; i < s_numchannels; i++, ch++) {
@@ -17,45 +17,416 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // snd_mem.c: sound caching
 
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "sound.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+#if USE_AVX2
+#include <immintrin.h>
+#endif
+
 wavinfo_t s_info;
 
 #if USE_SNDDMA
+/*
+===============================================================================
+
+RESAMPLER
+
+Sounds are converted to the device rate with a Blackman windowed sinc
+filter, evaluated as a polyphase filter bank: for rates with a small common
+divisor (all of the usual ones) every output sample falls on one of a few
+phases and the conversion is exact. When downsampling, the cutoff follows
+the output rate so nothing aliases.
+
+Conversions run on a worker thread and the results are cached on disk under
+soundcache/, keyed by a hash of the WAV file and the target rate, so each
+file is only converted once per rate. During registration all conversions
+are queued and waited for at the end; outside of it the frame blocks on the
+conversion, unless snd_precache_async is set, in which case the sound
+doesn't play until it is ready.
+
+The worker only uses malloc and OS paths, never the zone or filesystem.
+
+===============================================================================
+*/
+
+#define RESAMPLE_ZEROS      8       // zero crossings on each side of the kernel
+#define RESAMPLE_CUTOFF     0.95    // fraction of the lower nyquist rate kept
+#define RESAMPLE_PHASES     512     // max phases, finer ones are rounded
+
+#define RSCACHE_MAGIC       MakeRawLong('R', 'S', 'N', 'D')
+#define RSCACHE_VERSION     1
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    hash;       // crc32 of the WAV file
+    uint32_t    filelen;
+    int32_t     rate;
+    int32_t     width;
+    int32_t     length;
+    int32_t     loopstart;
+} rscache_header_t;
+
+typedef struct {
+    list_t      entry;
+    sfx_t       *sfx;       // NULL once cancelled, main thread only
+    char        path[MAX_OSPATH];   // cache file
+    rscache_header_t header;
+    int         inrate;
+    int         samples;
+    byte        *out;
+    byte        data[1];    // source samples
+} resample_job_t;
+
+static struct {
+    std::mutex              lock;
+    std::condition_variable wake;   // jobs queued
+    std::condition_variable done;   // job finished
+    list_t                  queued;
+    list_t                  finished;
+    qboolean                started;
+    qboolean                busy;
+    resample_job_t          *current;   // taken off queued by the worker
+} resampler;
+
+static float S_DotProduct(const float *a, const float *b, int count)
+{
+    float   sum;
+    int     i = 0;
+
+#if USE_AVX2
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+
+    __m128 v = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    sum = _mm_cvtss_f32(v);
+#elif USE_SSE2
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    __m128 v = _mm_add_ps(acc0, acc1);
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    sum = _mm_cvtss_f32(v);
+#else
+    sum = 0;
+#endif
+
+    for (; i < count; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
 /*
 ================
-ResampleSfx
+S_MakeFilterBank
+
+Builds phases * taps coefficients, taps is a multiple of 8. Phase p is for
+output samples that fall p / phases of the way past a source sample.
 ================
 */
-static sfxcache_t *ResampleSfx(sfx_t *sfx)
+static float *S_MakeFilterBank(int inrate, int outrate, int phases, int *taps_p)
+{
+    double  cutoff, t, x, w, s, sum;
+    int     taps, half, p, k;
+    float   *coeffs, *c;
+
+    cutoff = min(1.0, (double)outrate / inrate) * RESAMPLE_CUTOFF;
+    taps = (2 * (int)ceil(RESAMPLE_ZEROS / cutoff) + 7) & ~7;
+    half = taps / 2;
+
+    coeffs = (float *)malloc(sizeof(float) * phases * taps);
+    if (!coeffs)
+        return NULL;
+
+    for (p = 0, c = coeffs; p < phases; p++, c += taps) {
+        sum = 0;
+        for (k = 0; k < taps; k++) {
+            // distance from the output position, in source samples
+            t = k - (half - 1) - (double)p / phases;
+            x = t / half;
+            w = fabs(x) >= 1 ? 0 : 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+            s = t ? sin(M_PI * cutoff * t) / (M_PI * cutoff * t) : 1;
+            c[k] = w * s;
+            sum += c[k];
+        }
+
+        // unity gain at DC for every phase
+        for (k = 0; k < taps; k++)
+            c[k] /= sum;
+    }
+
+    *taps_p = taps;
+    return coeffs;
+}
+
+static int S_Gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// runs on the worker thread
+static qboolean S_Resample(resample_job_t *job)
+{
+    int         inrate = job->inrate, outrate = job->header.rate;
+    int         width = job->header.width, outcount = job->header.length;
+    int         taps, half, phases, i, pad, val;
+    int64_t     num;
+    float       *coeffs, *src, sum;
+
+    phases = min(outrate / S_Gcd(inrate, outrate), RESAMPLE_PHASES);
+
+    coeffs = S_MakeFilterBank(inrate, outrate, phases, &taps);
+    if (!coeffs)
+        return false;
+    half = taps / 2;
+
+    // source as floats, zero padded past both ends
+    pad = taps;
+    src = (float *)calloc(job->samples + pad * 2, sizeof(float));
+    job->out = (byte *)malloc(outcount * width);
+    if (!src || !job->out) {
+        free(coeffs);
+        free(src);
+        return false;
+    }
+
+    if (width == 1) {
+        for (i = 0; i < job->samples; i++)
+            src[pad + i] = (int)job->data[i] - 128;
+    } else {
+        for (i = 0; i < job->samples; i++)
+            src[pad + i] = (int16_t)LittleShort(((uint16_t *)job->data)[i]);
+    }
+
+    for (i = 0; i < outcount; i++) {
+        num = (int64_t)i * inrate;
+        int base = num / outrate;
+        int phase = (num % outrate) * phases / outrate;
+
+        sum = S_DotProduct(coeffs + phase * taps, src + pad + base - (half - 1), taps);
+        val = (int)lrintf(sum);
+
+        if (width == 1)
+            job->out[i] = clamp(val, -128, 127) + 128;
+        else
+            ((int16_t *)job->out)[i] = clamp(val, INT16_MIN, INT16_MAX);
+    }
+
+    free(coeffs);
+    free(src);
+    return true;
+}
+
+// runs on the worker thread, the cache is only a speedup so errors are ignored
+static void S_WriteResampleCache(const resample_job_t *job)
+{
+    char    dir[MAX_OSPATH];
+    FILE    *fp;
+
+    Q_strlcpy(dir, job->path, sizeof(dir));
+    if (FS_CreatePath(dir))
+        return;
+
+    fp = fopen(job->path, "wb");
+    if (!fp)
+        return;
+
+    fwrite(&job->header, 1, sizeof(job->header), fp);
+    fwrite(job->out, job->header.width, job->header.length, fp);
+    fclose(fp);
+}
+
+static void S_ResampleThread(void)
+{
+    resample_job_t  *job;
+
+    while (1) {
+        {
+            std::unique_lock<std::mutex> lock(resampler.lock);
+
+            resampler.busy = false;
+            resampler.done.notify_all();
+
+            resampler.wake.wait(lock, [] { return !LIST_EMPTY(&resampler.queued); });
+
+            job = LIST_FIRST(resample_job_t, &resampler.queued, entry);
+            List_Remove(&job->entry);
+            resampler.busy = true;
+            resampler.current = job;
+        }
+
+        if (S_Resample(job))
+            S_WriteResampleCache(job);
+
+        std::lock_guard<std::mutex> lock(resampler.lock);
+        List_Append(&resampler.finished, &job->entry);
+        resampler.current = NULL;
+    }
+}
+
+static sfxcache_t *S_AllocSfxCache(sfx_t *sfx, int length, int loopstart, int width)
 {
-    int         outcount;
-    int         srcsample;
-    float       stepscale;
-    int         i;
-    int         samplefrac, fracstep;
     sfxcache_t  *sc;
 
-    stepscale = (float)s_info.rate / dma.speed;      // this is usually 0.5, 1, or 2
+    // CPP: WARNING: Cast to sfxcache_t*
+    sc = sfx->cache = (sfxcache_t*)S_Malloc(length * width + sizeof(sfxcache_t) - 1);
+
+    sc->length = length;
+    sc->loopstart = loopstart;
+    sc->width = width;
+
+    return sc;
+}
+
+static sfxcache_t *S_LoadResampleCache(sfx_t *sfx, const char *path, const rscache_header_t *key)
+{
+    rscache_header_t    *header;
+    sfxcache_t          *sc;
+    byte                *data;
+    ssize_t             len;
+
+    len = FS_LoadFile(path, (void **)&data);
+    if (!data)
+        return NULL;
+
+    header = (rscache_header_t *)data;
+    if (len < (ssize_t)sizeof(*header)
+        || header->magic != key->magic
+        || header->version != key->version
+        || header->hash != key->hash
+        || header->filelen != key->filelen
+        || header->rate != key->rate
+        || header->width != key->width
+        || header->length != key->length
+        || header->loopstart != key->loopstart
+        || len - sizeof(*header) != (size_t)key->length * key->width) {
+        FS_FreeFile(data);
+        return NULL;
+    }
+
+    sc = S_AllocSfxCache(sfx, key->length, key->loopstart, key->width);
+    memcpy(sc->data, header + 1, key->length * key->width);
+
+    FS_FreeFile(data);
+    return sc;
+}
+
+/*
+================
+S_FinishResampling
+
+Installs finished conversions. With wait set, blocks until the worker is
+idle first.
+================
+*/
+void S_FinishResampling(qboolean wait)
+{
+    resample_job_t  *job, *next;
+    LIST_DECL(finished);
+
+    if (!resampler.started)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(resampler.lock);
+
+        if (wait)
+            resampler.done.wait(lock, [] { return LIST_EMPTY(&resampler.queued) && !resampler.busy; });
+
+        LIST_FOR_EACH_SAFE(resample_job_t, job, next, &resampler.finished, entry) {
+            List_Remove(&job->entry);
+            List_Append(&finished, &job->entry);
+        }
+    }
+
+    LIST_FOR_EACH_SAFE(resample_job_t, job, next, &finished, entry) {
+        if (job->sfx) {
+            job->sfx->loading = false;
+            if (job->sfx->cache) {
+                // loaded some other way meanwhile, keep that
+            } else if (job->out) {
+                sfxcache_t *sc = S_AllocSfxCache(job->sfx, job->header.length, job->header.loopstart, job->header.width);
+                memcpy(sc->data, job->out, job->header.length * job->header.width);
+            } else {
+                job->sfx->error = Q_ERR(ENOMEM);
+            }
+        }
+        free(job->out);
+        free(job);
+    }
+}
+
+// forgets about the conversion for a sound that is being freed
+void S_CancelResampling(sfx_t *sfx)
+{
+    resample_job_t  *job;
+
+    if (!resampler.started)
+        return;
+
+    std::lock_guard<std::mutex> lock(resampler.lock);
+
+    LIST_FOR_EACH(resample_job_t, job, &resampler.queued, entry)
+        if (job->sfx == sfx)
+            job->sfx = NULL;
+
+    LIST_FOR_EACH(resample_job_t, job, &resampler.finished, entry)
+        if (job->sfx == sfx)
+            job->sfx = NULL;
+
+    if (resampler.current && resampler.current->sfx == sfx)
+        resampler.current->sfx = NULL;
 
-    outcount = s_info.samples / stepscale;
+    sfx->loading = false;
+}
+
+/*
+================
+ResampleSfx
+================
+*/
+static sfxcache_t *ResampleSfx(sfx_t *sfx, const byte *file, size_t filelen)
+{
+    int                 outcount, loopstart;
+    sfxcache_t          *sc;
+    rscache_header_t    key;
+    resample_job_t      *job;
+    char                path[MAX_QPATH];
+
+    outcount = (int64_t)s_info.samples * dma.speed / s_info.rate;
     if (!outcount) {
         Com_DPrintf("%s resampled to zero length\n", s_info.name);
         sfx->error = Q_ERR_TOO_FEW;
         return NULL;
     }
 
-    // CPP: WARNING: Cast to sfxcache_t*
-    sc = sfx->cache = (sfxcache_t*)S_Malloc(outcount * s_info.width + sizeof(sfxcache_t) - 1);
+    loopstart = s_info.loopstart == -1 ? -1 : (int64_t)s_info.loopstart * dma.speed / s_info.rate;
 
-    sc->length = outcount;
-    sc->loopstart = s_info.loopstart == -1 ? -1 : s_info.loopstart / stepscale;
-    sc->width = s_info.width;
-
-// resample / decimate to the current source rate
-//Com_Printf("%s: %f, %d\n",sfx->name,stepscale,sc->width);
-    if (stepscale == 1) {
+    if (s_info.rate == dma.speed) {
 // fast special case
+        sc = S_AllocSfxCache(sfx, outcount, loopstart, s_info.width);
         if (sc->width == 1) {
             memcpy(sc->data, s_info.data, outcount);
         } else {
@@ -67,26 +438,61 @@ static sfxcache_t *ResampleSfx(sfx_t *sfx)
             }
 #endif
         }
-    } else {
-// general case
-        samplefrac = 0;
-        fracstep = stepscale * 256;
-        if (sc->width == 1) {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                sc->data[i] = s_info.data[srcsample];
-            }
-        } else {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[srcsample]);
-            }
+        return sc;
+    }
+
+// general case, see if it was converted before
+    key.magic = RSCACHE_MAGIC;
+    key.version = RSCACHE_VERSION;
+    key.hash = crc32(0, file, filelen);
+    key.filelen = filelen;
+    key.rate = dma.speed;
+    key.width = s_info.width;
+    key.length = outcount;
+    key.loopstart = loopstart;
+
+    Q_snprintf(path, sizeof(path), "soundcache/%08x-%x-%d.bin", key.hash, key.filelen, key.rate);
+
+    sc = S_LoadResampleCache(sfx, path, &key);
+    if (sc)
+        return sc;
+
+// queue it for the worker
+    job = (resample_job_t *)malloc(sizeof(*job) - 1 + s_info.samples * s_info.width);
+    if (!job) {
+        sfx->error = Q_ERR(ENOMEM);
+        return NULL;
+    }
+
+    job->sfx = sfx;
+    job->header = key;
+    job->inrate = s_info.rate;
+    job->samples = s_info.samples;
+    job->out = NULL;
+    memcpy(job->data, s_info.data, s_info.samples * s_info.width);
+    Q_snprintf(job->path, sizeof(job->path), "%s/%s", fs_gamedir, path);
+
+    sfx->loading = true;
+
+    {
+        std::lock_guard<std::mutex> lock(resampler.lock);
+
+        if (!resampler.started) {
+            List_Init(&resampler.queued);
+            List_Init(&resampler.finished);
+            std::thread(S_ResampleThread).detach();
+            resampler.started = true;
         }
+
+        List_Append(&resampler.queued, &job->entry);
+        resampler.wake.notify_one();
     }
 
-    return sc;
+    if (s_registering || snd_precache_async->integer)
+        return NULL;
+
+    S_FinishResampling(true);
+    return sfx->cache;
 }
 #endif
 
@@ -305,6 +711,10 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     if (s->error)
         return NULL;
 
+// still being resampled
+    if (s->loading)
+        return NULL;
+
 // load it in
     if (s->truename)
         name = s->truename;
@@ -334,7 +744,7 @@ sfxcache_t *S_LoadSound(sfx_t *s)
 
 #if USE_SNDDMA
     if (s_started == SS_DMA)
-        sc = ResampleSfx(s);
+        sc = ResampleSfx(s, data, len);
 #endif
 
 fail:
@@ -19,35 +19,60 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "sound.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+#if USE_AVX2
+#include <immintrin.h>
+#endif
+
 #define    PAINTBUFFER_SIZE    2048
 
-static int snd_scaletable[32][256];
-static int snd_vol;
+// channels are mixed in floating point, in the same units as the 16 bit
+// output, and only saturated when transferred to the DMA buffer
+typedef struct {
+    float       left;
+    float       right;
+} paintpair_t;
+
+static float snd_gain;
 
 samplepair_t s_rawsamples[S_MAX_RAW_SAMPLES];
 int          s_rawend = 0;
 
-static void WriteLinearBlast(int16_t *out, samplepair_t *samp, int count)
+static int   s_mixedchannels, s_culledchannels;
+
+static void WriteLinearBlast(int16_t *out, const paintpair_t *samp, int count)
 {
-    int i, val;
+    int i = 0, val;
+
+#if USE_SSE2
+    // cvtps rounds and packs saturates, 4 sample pairs at a time
+    for (; i + 4 <= count; i += 4, samp += 4, out += 8) {
+        __m128i a = _mm_cvtps_epi32(_mm_loadu_ps(&samp[0].left));
+        __m128i b = _mm_cvtps_epi32(_mm_loadu_ps(&samp[2].left));
+        _mm_storeu_si128((__m128i *)out, _mm_packs_epi32(a, b));
+    }
+#endif
 
-    for (i = 0; i < count; i++, samp++, out += 2) {
-        val = samp->left >> 8;
+    // round the same way as cvtps, so results don't depend on the build
+    for (; i < count; i++, samp++, out += 2) {
+        val = (int)lrintf(samp->left);
         out[0] = clamp(val, INT16_MIN, INT16_MAX);
 
-        val = samp->right >> 8;
+        val = (int)lrintf(samp->right);
         out[1] = clamp(val, INT16_MIN, INT16_MAX);
     }
 }
 
-static void TransferStereo16(samplepair_t *samp, int endTime)
+static void TransferStereo16(const paintpair_t *samp, int startTime, int endTime)
 {
     int lpos;
     int ltime;
     int16_t *out;
     int count;
 
-    for (ltime = paintedtime; ltime < endTime;) {
+    for (ltime = startTime; ltime < endTime;) {
         // handle recirculating buffer issues
         lpos = ltime & ((dma.samples >> 1) - 1);
 
@@ -65,57 +90,57 @@ static void TransferStereo16(samplepair_t *samp, int endTime)
     }
 }
 
-static void TransferStereo(samplepair_t *samp, int endTime)
+static void TransferStereo(const paintpair_t *samp, int startTime, int endTime)
 {
     int out_idx, out_mask;
     int count;
-    int *p, val;
+    const float *p;
+    int val;
     int step;
 
-    p = (int *)samp;
-    count = (endTime - paintedtime) * dma.channels;
+    p = &samp->left;
+    count = (endTime - startTime) * dma.channels;
     out_mask = dma.samples - 1;
-    out_idx = paintedtime * dma.channels & out_mask;
+    out_idx = startTime * dma.channels & out_mask;
     step = 3 - dma.channels;
 
     if (dma.samplebits == 16) {
         int16_t *out = (int16_t *)dma.buffer;
         while (count--) {
-            val = *p >> 8;
+            val = (int)lrintf(*p);
             p += step;
-            clamp(val, INT16_MIN, INT16_MAX);
-            out[out_idx] = val;
+            out[out_idx] = clamp(val, INT16_MIN, INT16_MAX);
             out_idx = (out_idx + 1) & out_mask;
         }
     } else if (dma.samplebits == 8) {
         uint8_t *out = (uint8_t *)dma.buffer;
         while (count--) {
-            val = *p >> 8;
+            val = (int)lrintf(*p);
             p += step;
-            clamp(val, INT16_MIN, INT16_MAX);
+            val = clamp(val, INT16_MIN, INT16_MAX);
             out[out_idx] = (val >> 8) + 128;
             out_idx = (out_idx + 1) & out_mask;
         }
     }
 }
 
-static void TransferPaintBuffer(samplepair_t *samp, int endTime)
+static void TransferPaintBuffer(paintpair_t *samp, int startTime, int endTime)
 {
     if (s_testsound->integer) {
         int i;
 
         // write a fixed sine wave
-        for (i = paintedtime; i < endTime; i++) {
-            samp[i].left = samp[i].right = std::sinf(i * 0.1) * 20000 * 256;
+        for (i = startTime; i < endTime; i++) {
+            samp[i - startTime].left = samp[i - startTime].right = std::sinf(i * 0.1f) * 20000;
         }
     }
 
     if (dma.samplebits == 16 && dma.channels == 2) {
         // optimized case
-        TransferStereo16(samp, endTime);
+        TransferStereo16(samp, startTime, endTime);
     } else {
         // general case
-        TransferStereo(samp, endTime);
+        TransferStereo(samp, startTime, endTime);
     }
 }
 
@@ -128,97 +153,149 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-static void Paint8(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+static void Paint8(channel_t *ch, sfxcache_t *sc, int count, paintpair_t *samp)
 {
-    int data;
-    int *lscale, *rscale;
+    float lgain, rgain, data;
     uint8_t *sfx;
     int i;
 
-    if (ch->leftvol > 255)
-        ch->leftvol = 255;
-    if (ch->rightvol > 255)
-        ch->rightvol = 255;
-
-    lscale = snd_scaletable[ch->leftvol >> 3];
-    rscale = snd_scaletable[ch->rightvol >> 3];
+    // 8 bit samples are scaled up to 16 bit range
+    lgain = ch->leftvol * snd_gain * 256;
+    rgain = ch->rightvol * snd_gain * 256;
     sfx = (uint8_t *)sc->data + ch->pos;
 
     for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        samp->left += lscale[data];
-        samp->right += rscale[data];
+        data = (int)*sfx++ - 128;
+        samp->left += data * lgain;
+        samp->right += data * rgain;
     }
 
     ch->pos += count;
 }
 
-static void Paint16(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+static void Paint16(channel_t *ch, sfxcache_t *sc, int count, paintpair_t *samp)
 {
-    int data;
-    int left, right;
-    int leftvol, rightvol;
+    float lgain, rgain, data;
     int16_t *sfx;
-    int i;
+    int i = 0;
 
-    leftvol = ch->leftvol * snd_vol;
-    rightvol = ch->rightvol * snd_vol;
+    lgain = ch->leftvol * snd_gain;
+    rgain = ch->rightvol * snd_gain;
     sfx = (int16_t *)sc->data + ch->pos;
 
-    for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        left = (data * leftvol) >> 8;
-        right = (data * rightvol) >> 8;
-        samp->left += left;
-        samp->right += right;
+#if USE_AVX2
+    {
+        __m256 l = _mm256_set1_ps(lgain);
+        __m256 r = _mm256_set1_ps(rgain);
+
+        for (; i + 8 <= count; i += 8) {
+            __m256 in = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(sfx + i))));
+            __m256 lo = _mm256_mul_ps(in, l);
+            __m256 ro = _mm256_mul_ps(in, r);
+            // unpack interleaves within 128 bit lanes, swap the middle halves back
+            __m256 a = _mm256_unpacklo_ps(lo, ro);
+            __m256 b = _mm256_unpackhi_ps(lo, ro);
+            float *out = &samp[i].left;
+
+            _mm256_storeu_ps(out + 0, _mm256_add_ps(_mm256_loadu_ps(out + 0), _mm256_permute2f128_ps(a, b, 0x20)));
+            _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8), _mm256_permute2f128_ps(a, b, 0x31)));
+        }
+    }
+#elif USE_SSE2
+    {
+        __m128 l = _mm_set1_ps(lgain);
+        __m128 r = _mm_set1_ps(rgain);
+
+        for (; i + 8 <= count; i += 8) {
+            __m128i in = _mm_loadu_si128((const __m128i *)(sfx + i));
+            // sign extend by unpacking into the high halves and shifting down
+            __m128 in0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+            __m128 in1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+            __m128 l0 = _mm_mul_ps(in0, l), r0 = _mm_mul_ps(in0, r);
+            __m128 l1 = _mm_mul_ps(in1, l), r1 = _mm_mul_ps(in1, r);
+            float *out = &samp[i].left;
+
+            _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_unpacklo_ps(l0, r0)));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(l0, r0)));
+            _mm_storeu_ps(out + 8, _mm_add_ps(_mm_loadu_ps(out + 8), _mm_unpacklo_ps(l1, r1)));
+            _mm_storeu_ps(out + 12, _mm_add_ps(_mm_loadu_ps(out + 12), _mm_unpackhi_ps(l1, r1)));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        data = sfx[i];
+        samp[i].left += data * lgain;
+        samp[i].right += data * rgain;
     }
 
     ch->pos += count;
 }
 
-void S_PaintChannels(int endTime)
+/*
+=================
+S_ChannelAudible
+
+Channels whose contribution would round to silence in the output are
+culled. They still advance through their samples so that they stay in
+sync, they just don't get painted.
+=================
+*/
+static inline qboolean S_ChannelAudible(const channel_t *ch)
+{
+    // 0.5 is half of the lowest 16 bit step
+    return (ch->leftvol > ch->rightvol ? ch->leftvol : ch->rightvol) * snd_gain * 32768 >= 0.5f;
+}
+
+/*
+=================
+S_PaintChunk
+
+Paints the given channels and raw samples between two sample times and
+transfers the result to the DMA buffer. Shared by the inline mixer and the
+mixer thread, which owns a private copy of the channels.
+=================
+*/
+void S_PaintChunk(channel_t *chans, int numchans, int startTime, int endTime, const samplepair_t *raw, int rawend)
 {
-    samplepair_t paintbuffer[PAINTBUFFER_SIZE];
+    alignas(32) static paintpair_t paintbuffer[PAINTBUFFER_SIZE];
     int i;
     int end;
     channel_t *ch;
     sfxcache_t *sc;
     int ltime, count;
-    playsound_t *ps;
+    qboolean audible;
 
-    while (paintedtime < endTime) {
+    for (; startTime < endTime; startTime = end) {
         // if paintbuffer is smaller than DMA buffer
         end = endTime;
-        if (end - paintedtime > PAINTBUFFER_SIZE)
-            end = paintedtime + PAINTBUFFER_SIZE;
-
-        // start any playsounds
-        while (1) {
-            ps = s_pendingplays.next;
-            if (ps == &s_pendingplays)
-                break;    // no more pending sounds
-            if (ps->begin <= paintedtime) {
-                S_IssuePlaysound(ps);
-                continue;
-            }
-
-            if (ps->begin < end)
-                end = ps->begin;        // stop here
-            break;
-        }
+        if (end - startTime > PAINTBUFFER_SIZE)
+            end = startTime + PAINTBUFFER_SIZE;
 
         // clear the paint buffer
-        memset(paintbuffer, 0, (end - paintedtime) * sizeof(samplepair_t));
+        memset(paintbuffer, 0, (end - startTime) * sizeof(paintpair_t));
 
         // paint in the channels.
-        ch = channels;
-        for (i = 0; i < s_numchannels; i++, ch++) {
-            ltime = paintedtime;
+        ch = chans;
+        for (i = 0; i < numchans; i++, ch++) {
+            if (!ch->sfx)
+                continue;
 
-            while (ltime < end) {
-                if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
-                    break;
+            // channels are only started on loaded sounds, and the cache
+            // is not freed before all sounds are stopped
+            sc = ch->sfx->cache;
+            if (!sc)
+                continue;
+
+            audible = S_ChannelAudible(ch);
+            if (audible)
+                s_mixedchannels++;
+            else
+                s_culledchannels++;
+
+            ltime = startTime;
 
+            while (ltime < end && ch->sfx) {
                 // max painting is to the end of the buffer
                 count = end - ltime;
 
@@ -226,16 +303,13 @@ void S_PaintChannels(int endTime)
                 if (ch->end - ltime < count)
                     count = ch->end - ltime;
 
-                sc = S_LoadSound(ch->sfx);
-                if (!sc)
-                    break;
-
-                if (count > 0 && ch->sfx) {
-                    samplepair_t *samp = &paintbuffer[ltime - paintedtime];
-                    if (sc->width == 1)
-                        Paint8(ch, sc, count, samp);
+                if (count > 0) {
+                    if (!audible)
+                        ch->pos += count;
+                    else if (sc->width == 1)
+                        Paint8(ch, sc, count, &paintbuffer[ltime - startTime]);
                     else
-                        Paint16(ch, sc, count, samp);
+                        Paint16(ch, sc, count, &paintbuffer[ltime - startTime]);
 
                     ltime += count;
                 }
@@ -255,45 +329,180 @@ void S_PaintChannels(int endTime)
                     }
                 }
             }
-
         }
 
-        if (s_rawend >= paintedtime)
+        if (rawend >= startTime)
         {
           /* add from the streaming sound source */
-          int stop = (end < s_rawend) ? end : s_rawend;
+          int stop = (end < rawend) ? end : rawend;
 
-          for (int i = paintedtime; i < stop; i++)
+          for (int i = startTime; i < stop; i++)
           {
             int s = i & (S_MAX_RAW_SAMPLES - 1);
-            paintbuffer[i - paintedtime].left += s_rawsamples[s].left;
-            paintbuffer[i - paintedtime].right += s_rawsamples[s].right;
+            paintbuffer[i - startTime].left += raw[s].left * (1.0f / 256);
+            paintbuffer[i - startTime].right += raw[s].right * (1.0f / 256);
           }
         }
 
         // transfer out according to DMA format
-        TransferPaintBuffer(paintbuffer, end);
+        TransferPaintBuffer(paintbuffer, startTime, end);
+    }
+}
+
+void S_PaintChannels(int endTime)
+{
+    int end;
+    playsound_t *ps;
+
+    PROF_ZONE("S_PaintChannels");
+
+    while (paintedtime < endTime) {
+        end = endTime;
+
+        // start any playsounds
+        while (1) {
+            ps = s_pendingplays.next;
+            if (ps == &s_pendingplays)
+                break;    // no more pending sounds
+            if (ps->begin <= paintedtime) {
+                S_IssuePlaysound(ps);
+                continue;
+            }
+
+            if (ps->begin < end)
+                end = ps->begin;        // stop here
+            break;
+        }
+
+        S_PaintChunk(channels, s_numchannels, paintedtime, end, s_rawsamples, s_rawend);
         paintedtime = end;
     }
 }
 
+void S_SetPaintGain(float gain)
+{
+    snd_gain = gain;
+}
 
 void S_InitScaletable(void)
 {
-    int        i, j;
-    int        scale;
-
-    snd_vol = S_GetLinearVolume(s_volume->value) * 256;
-    for (i = 0; i < 32; i++) {
-        scale = i * 8 * snd_vol;
-        for (j = 0; j < 256; j++) {
-            snd_scaletable[i][j] = (j - 128) * scale;
-        }
-    }
+    // channel volumes are 0-255, the mixer thread applies the new gain
+    // in order with the rest of its commands
+    DMA_SetGain(S_GetLinearVolume(s_volume->value) / 255);
 
     s_volume->modified = false;
 }
 
+/*
+=================
+S_MixBench_f
+
+Mixes the given number of channels for the given number of seconds of
+audio into a scratch buffer, without touching the sound device. Useful
+with a null audio driver (SDL_AUDIODRIVER=dummy) to compare mixer paths.
+=================
+*/
+void S_MixBench_f(void)
+{
+    channel_t   saved[MAX_CHANNELS];
+    dma_t       saveddma;
+    int         savedtime, savedrawend, savednumchannels;
+    sfx_t       sfx;
+    sfxcache_t  *sc;
+    int         i, numchannels, seconds, length, frame;
+    unsigned    start, msec, seed;
+
+    if (s_started != SS_DMA) {
+        Com_Printf("%s requires the software mixer\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (DMA_MixerActive()) {
+        Com_Printf("%s can't run alongside s_mixthread or s_wavout\n", Cmd_Argv(0));
+        return;
+    }
+
+    numchannels = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : MAX_CHANNELS;
+    numchannels = clamp(numchannels, 1, MAX_CHANNELS);
+    seconds = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 60;
+    seconds = clamp(seconds, 1, 3600);
+
+    S_StopAllSounds();
+
+    memcpy(saved, channels, sizeof(saved));
+    saveddma = dma;
+    savedtime = paintedtime;
+    savedrawend = s_rawend;
+    savednumchannels = s_numchannels;
+
+    // scratch 16 bit stereo buffer at the current rate
+    dma.channels = 2;
+    dma.samplebits = 16;
+    dma.samples = 0x8000;
+    dma.samplepos = 0;
+    dma.submission_chunk = 1;
+    dma.buffer = (byte *)Z_Malloc(dma.samples * 2);
+
+    // one second of looping noise, so nothing ever stops
+    length = dma.speed;
+    sc = (sfxcache_t *)Z_Malloc(sizeof(*sc) - 1 + length * 2);
+    sc->length = length;
+    sc->loopstart = 0;
+    sc->width = 2;
+    for (i = 0, seed = 1; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        ((int16_t *)sc->data)[i] = (int16_t)(seed >> 16);
+    }
+
+    memset(&sfx, 0, sizeof(sfx));
+    Q_strlcpy(sfx.name, "mixbench", sizeof(sfx.name));
+    sfx.cache = sc;
+
+    memset(channels, 0, sizeof(channels));
+    s_numchannels = MAX_CHANNELS;
+    for (i = 0; i < numchannels; i++) {
+        channels[i].sfx = &sfx;
+        channels[i].leftvol = 255 - i * 3;
+        channels[i].rightvol = 64 + i * 2;
+        channels[i].pos = (i * 997) % length;
+        channels[i].end = length - channels[i].pos;
+        channels[i].master_vol = 1;
+
+        // every fourth channel is out of earshot
+        if ((i & 3) == 3)
+            channels[i].leftvol = channels[i].rightvol = 0;
+    }
+
+    paintedtime = 0;
+    s_rawend = 0;
+    s_mixedchannels = s_culledchannels = 0;
+
+    // paint in client frame sized chunks
+    frame = dma.speed / 60;
+
+    start = Sys_Milliseconds();
+    while (paintedtime < seconds * dma.speed)
+        S_PaintChannels(paintedtime + frame);
+    msec = Sys_Milliseconds() - start;
+
+    Com_Printf("%d channels, %d seconds at %d Hz: %u msec (%.1fx realtime, %.3f msec per frame)\n",
+               numchannels, seconds, dma.speed, msec,
+               msec ? seconds * 1000.0f / msec : 0.0f,
+               (float)msec / (seconds * 60));
+    Com_Printf("%d channel chunks mixed, %d culled\n", s_mixedchannels, s_culledchannels);
+
+    Z_Free(dma.buffer);
+    Z_Free(sc);
+
+    memcpy(channels, saved, sizeof(saved));
+    dma = saveddma;
+    paintedtime = savedtime;
+    s_rawend = savedrawend;
+    s_numchannels = savednumchannels;
+
+    S_StopAllSounds();
+}
+
 /*
  * Cinematic streaming and voice over network.
  * This could be used for chat over network, but
@@ -314,6 +523,8 @@ S_RawSamples(int samples, int rate, int width,
   if (s_rawend < paintedtime)
     s_rawend = paintedtime;
 
+  int rawstart = s_rawend;
+
   // mimic the OpenAL behavior: s_volume is master volume
   volume *= s_volume->value;
 
@@ -395,6 +606,9 @@ S_RawSamples(int samples, int rate, int width,
       s_rawsamples[dst].right = (((byte *)data)[src] - 128) * intVolume;
     }
   }
+
+  /* forward to the mixer thread, if any */
+  DMA_RawSamples(rawstart, s_rawend - rawstart);
 }
 
 void S_UnqueueRawSamples()
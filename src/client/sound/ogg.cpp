@@ -36,6 +36,11 @@
 
 #include <errno.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "shared/shared.h"
 #include "sound.h"
 #include "client/sound/vorbis.h"
@@ -50,8 +55,9 @@ static cvar_t* ogg_enable;        /* Music enable flag to toggle from the menu.
 static int ogg_curfile;           /* Index of currently played file. */
 static int ogg_numbufs;           /* Number of buffers for OpenAL */
 static int ogg_numsamples;        /* Number of sambles read from the current file */
+static int ogg_generation;        /* Bumped by every track switch or stop. */
+static int ogg_startsample;       /* Where the next OGG_PlayTrack() starts. */
 static ogg_status_t ogg_status;   /* Status indicator. */
-static stb_vorbis *ogg_file;      /* Ogg Vorbis file. */
 static qboolean ogg_started;      /* Initialization flag. */
 
 enum { MAX_NUM_OGGTRACKS = 32 };
@@ -71,6 +77,68 @@ struct {
 	int numsamples;
 } ogg_saved_state;
 
+/*
+ * Decoding runs on its own thread, which owns the stb_vorbis
+ * handles and never touches anything else. Decoded blocks go
+ * through a single producer, single consumer ring, which
+ * OGG_Stream() drains into S_RawSamples() as the backend needs
+ * more. Blocks are tagged with the generation of the request
+ * that produced them, so track switches and stops just bump the
+ * generation and stale blocks get dropped by the consumer.
+ *
+ * Requests (which track to play, which one comes next) and
+ * errors are exchanged under a mutex, the main thread never
+ * waits for the decoder. A few seconds before the end of a
+ * track the next one is opened and its beginning decoded ahead,
+ * so tracks follow each other without a gap.
+ */
+
+enum {
+	OGG_BLOCK_SAMPLES = 4096,    /* shorts per block */
+	OGG_NUM_BLOCKS = 64,         /* about 3 seconds of 44 kHz stereo */
+	OGG_PREFETCH_BLOCKS = 48,
+	OGG_PREFETCH_SECONDS = 3
+};
+
+typedef struct {
+	int generation;
+	int track;
+	int rate;
+	int channels;
+	int samples;                 /* per channel */
+	qboolean first;              /* decoded from the start of the file */
+	short data[OGG_BLOCK_SAMPLES];
+} ogg_block_t;
+
+static struct {
+	ogg_block_t blocks[OGG_NUM_BLOCKS];
+	std::atomic<unsigned> head;  /* written by the decoder */
+	std::atomic<unsigned> tail;  /* written by the main thread */
+} ogg_ring;
+
+static struct {
+	std::mutex lock;
+	std::condition_variable wake;
+	std::thread thread;
+	qboolean quit;
+
+	/* from the main thread */
+	int generation;
+	int track;                   /* 0 to stop */
+	int seek;
+	char path[MAX_OSPATH];
+	int nexttrack;               /* 0 to repeat the current one */
+	char nextpath[MAX_OSPATH];
+
+	/* from the decoder */
+	int errortrack;
+	qboolean errormissing;       /* the file couldn't be opened */
+	char error[MAX_OSPATH + 64];
+} ogg_decoder;
+
+/* decoder thread only */
+static ogg_block_t ogg_prefetch[OGG_PREFETCH_BLOCKS];
+
 // --------
 
 /*
@@ -229,36 +297,378 @@ OGG_InitTrackList(void)
 // --------
 
 /*
- * Play a portion of the currently opened file.
+ * Open a file for the decoder thread.
  */
-void
-static OGG_Read(void)
+static stb_vorbis *
+OGG_Open(const char *path, int track)
 {
-	short samples[4096] = {0};
+	FILE* f = fopen(path, "rb");
+
+	if (f == NULL)
+	{
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+		ogg_decoder.errortrack = track;
+		ogg_decoder.errormissing = true;
+		Q_snprintf(ogg_decoder.error, sizeof(ogg_decoder.error),
+			"OGG_PlayTrack: could not open file %s for track %d: %s.\n", path, track, strerror(errno));
+
+		return NULL;
+	}
 
-	int read_samples = stb_vorbis_get_samples_short_interleaved(ogg_file, ogg_file->channels, samples,
-		sizeof(samples) / ogg_file->channels);
+	int res = 0;
+	stb_vorbis *file = stb_vorbis_open_file(f, true, &res, NULL);
 
-	if (read_samples > 0)
+	if (res != 0)
 	{
-		ogg_numsamples += read_samples;
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+		ogg_decoder.errortrack = track;
+		ogg_decoder.errormissing = false;
+		Q_snprintf(ogg_decoder.error, sizeof(ogg_decoder.error),
+			"OGG_PlayTrack: '%s' is not a valid Ogg Vorbis file (error %i).\n", path, res);
+		fclose(f);
 
-		S_RawSamples(read_samples, ogg_file->sample_rate, ogg_file->channels, ogg_file->channels,
-			(byte *)samples, S_GetLinearVolume(ogg_volume->value));
+		return NULL;
 	}
-	else
+
+	return file;
+}
+
+/*
+ * Decode a block, returns the number of samples per channel.
+ */
+static int
+OGG_Decode(stb_vorbis *file, ogg_block_t *block, int generation, int track)
+{
+	block->generation = generation;
+	block->track = track;
+	block->rate = file->sample_rate;
+	block->channels = file->channels;
+	block->first = stb_vorbis_get_sample_offset(file) <= 0;
+	block->samples = stb_vorbis_get_samples_short_interleaved(file, file->channels,
+		block->data, OGG_BLOCK_SAMPLES);
+
+	return block->samples;
+}
+
+/*
+ * The decoder thread.
+ */
+static void
+OGG_DecoderThread(void)
+{
+	stb_vorbis *file = NULL;     /* track being decoded */
+	stb_vorbis *next = NULL;     /* prefetched next track */
+	int generation = -1, track = 0, nexttrack = 0;
+	int numprefetch = 0, prefetchpos = 0;
+	char path[MAX_OSPATH] = "", nextpath[MAX_OSPATH] = "", wanted[MAX_OSPATH];
+	int wantedtrack, seek = 0;
+	qboolean request;
+
+	while (1)
 	{
-		// We cannot call OGG_Stop() here. It flushes the OpenAL sample
-		// queue, thus about 12 seconds of music are lost. Instead we
-		// just set the OGG state to stop and open a new file. The new
-		// files content is added to the sample queue after the remaining
-		// samples from the old file.
-		stb_vorbis_close(ogg_file);
-		ogg_status = STOP;
-		ogg_numbufs = 0;
-		ogg_numsamples = 0;
+		{
+			std::unique_lock<std::mutex> lock(ogg_decoder.lock);
+
+			if (ogg_decoder.quit)
+			{
+				break;
+			}
+
+			request = ogg_decoder.generation != generation;
+
+			if (request)
+			{
+				generation = ogg_decoder.generation;
+				track = ogg_decoder.track;
+				seek = ogg_decoder.seek;
+				Q_strlcpy(path, ogg_decoder.path, sizeof(path));
+			}
+			else if (!file && prefetchpos == numprefetch)
+			{
+				/* nothing to do until the next request */
+				ogg_decoder.wake.wait(lock);
+				continue;
+			}
+
+			wantedtrack = ogg_decoder.nexttrack;
+			Q_strlcpy(wanted, ogg_decoder.nextpath, sizeof(wanted));
+		}
+
+		if (request)
+		{
+			if (file)
+			{
+				stb_vorbis_close(file);
+				file = NULL;
+			}
+
+			if (next)
+			{
+				stb_vorbis_close(next);
+				next = NULL;
+			}
+
+			numprefetch = prefetchpos = 0;
 
-		OGG_PlayTrack(ogg_curfile);
+			if (track)
+			{
+				file = OGG_Open(path, track);
+
+				if (file && seek)
+				{
+					stb_vorbis_seek_frame(file, seek);
+				}
+			}
+
+			continue;
+		}
+
+		/* wait for the main thread to make room */
+		unsigned head = ogg_ring.head.load(std::memory_order_relaxed);
+
+		if (head - ogg_ring.tail.load(std::memory_order_acquire) >= OGG_NUM_BLOCKS)
+		{
+			std::unique_lock<std::mutex> lock(ogg_decoder.lock);
+			ogg_decoder.wake.wait_for(lock, std::chrono::milliseconds(10));
+			continue;
+		}
+
+		ogg_block_t *block = &ogg_ring.blocks[head & (OGG_NUM_BLOCKS - 1)];
+
+		/* beginning of the next track, decoded ahead */
+		if (prefetchpos < numprefetch)
+		{
+			*block = ogg_prefetch[prefetchpos++];
+			block->generation = generation;
+			ogg_ring.head.store(head + 1, std::memory_order_release);
+			continue;
+		}
+
+		/* the main thread changed its mind about the next track */
+		if (next && (nexttrack != wantedtrack || strcmp(nextpath, wanted)))
+		{
+			stb_vorbis_close(next);
+			next = NULL;
+		}
+
+		/* open the next track before this one ends */
+		if (!next && wantedtrack && file)
+		{
+			int remaining = stb_vorbis_stream_length_in_samples(file) - stb_vorbis_get_sample_offset(file);
+
+			if (remaining < OGG_PREFETCH_SECONDS * (int)file->sample_rate)
+			{
+				next = OGG_Open(wanted, wantedtrack);
+				nexttrack = wantedtrack;
+				Q_strlcpy(nextpath, wanted, sizeof(nextpath));
+
+				for (numprefetch = 0; next && numprefetch < OGG_PREFETCH_BLOCKS; numprefetch++)
+				{
+					if (OGG_Decode(next, &ogg_prefetch[numprefetch], generation, nexttrack) <= 0)
+					{
+						break;
+					}
+				}
+
+				prefetchpos = numprefetch;
+			}
+		}
+
+		if (file && OGG_Decode(file, block, generation, track) > 0)
+		{
+			ogg_ring.head.store(head + 1, std::memory_order_release);
+			continue;
+		}
+
+		/* end of the track, move on to the next one or start over */
+		if (file)
+		{
+			stb_vorbis_close(file);
+		}
+
+		if (next)
+		{
+			file = next;
+			track = nexttrack;
+			Q_strlcpy(path, nextpath, sizeof(path));
+			prefetchpos = 0;
+			next = NULL;
+		}
+		else
+		{
+			file = OGG_Open(path, track);
+			numprefetch = prefetchpos = 0;
+		}
+
+		/* the main thread picks a new next track when the
+		   first block of this one reaches it */
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+		if (ogg_decoder.nexttrack == track && !strcmp(ogg_decoder.nextpath, path))
+		{
+			ogg_decoder.nexttrack = 0;
+			ogg_decoder.nextpath[0] = 0;
+		}
+	}
+
+	if (file)
+	{
+		stb_vorbis_close(file);
+	}
+
+	if (next)
+	{
+		stb_vorbis_close(next);
+	}
+}
+
+/*
+ * Pick the track played after the given one.
+ */
+static int
+OGG_NextTrack(int trackNo)
+{
+	if (ogg_shuffle->value && ogg_maxfileindex > 0)
+	{
+		int next = rand() % (ogg_maxfileindex+1);
+		int retries = 100;
+
+		while(ogg_tracks[next] == NULL && retries-- > 0)
+		{
+			next = rand() % (ogg_maxfileindex+1);
+		}
+
+		if (ogg_tracks[next])
+		{
+			return next;
+		}
+	}
+
+	return trackNo;
+}
+
+/*
+ * Tell the decoder what to play after the given track.
+ */
+static void
+OGG_QueueNext(int trackNo)
+{
+	int next = OGG_NextTrack(trackNo);
+
+	std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+	ogg_decoder.nexttrack = next;
+	Q_strlcpy(ogg_decoder.nextpath, ogg_tracks[next] ? ogg_tracks[next] : "", sizeof(ogg_decoder.nextpath));
+}
+
+/*
+ * Ask the decoder to play a track, or stop with track 0.
+ * Doesn't wait for anything.
+ */
+static void
+OGG_Request(int trackNo, int seek)
+{
+	ogg_generation++;
+
+	{
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+		ogg_decoder.generation = ogg_generation;
+		ogg_decoder.track = trackNo;
+		ogg_decoder.seek = seek;
+		Q_strlcpy(ogg_decoder.path, trackNo ? ogg_tracks[trackNo] : "", sizeof(ogg_decoder.path));
+		ogg_decoder.nexttrack = 0;
+		ogg_decoder.nextpath[0] = 0;
+		ogg_decoder.wake.notify_one();
+	}
+
+	if (trackNo)
+	{
+		OGG_QueueNext(trackNo);
+	}
+}
+
+/*
+ * Play a block from the decoder. Returns false if
+ * none is ready.
+ */
+static qboolean
+OGG_Read(void)
+{
+	unsigned tail = ogg_ring.tail.load(std::memory_order_relaxed);
+
+	while (tail != ogg_ring.head.load(std::memory_order_acquire))
+	{
+		ogg_block_t *block = &ogg_ring.blocks[tail & (OGG_NUM_BLOCKS - 1)];
+
+		/* left over from before a track switch */
+		if (block->generation != ogg_generation)
+		{
+			ogg_ring.tail.store(++tail, std::memory_order_release);
+			continue;
+		}
+
+		/* the decoder went on with the next track or started over,
+		   queue the one after it so that a repeat is gapless too */
+		if (block->first)
+		{
+			ogg_numsamples = 0;
+		}
+
+		if (block->first || block->track != ogg_curfile)
+		{
+			ogg_curfile = block->track;
+			OGG_QueueNext(ogg_curfile);
+		}
+
+		ogg_numsamples += block->samples;
+
+		S_RawSamples(block->samples, block->rate, 2, block->channels,
+			(byte *)block->data, S_GetLinearVolume(ogg_volume->value));
+
+		ogg_ring.tail.store(tail + 1, std::memory_order_release);
+		ogg_decoder.wake.notify_one();
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Report decoder errors.
+ */
+static void
+OGG_CheckErrors(void)
+{
+	char error[sizeof(ogg_decoder.error)];
+	int track;
+	qboolean missing;
+
+	{
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+
+		if (!ogg_decoder.errortrack)
+		{
+			return;
+		}
+
+		Q_strlcpy(error, ogg_decoder.error, sizeof(error));
+		track = ogg_decoder.errortrack;
+		missing = ogg_decoder.errormissing;
+		ogg_decoder.errortrack = 0;
+	}
+
+	Com_Printf("%s", error);
+
+	/* don't try that file again */
+	if (missing && ogg_tracks[track])
+	{
+		free(ogg_tracks[track]);
+		ogg_tracks[track] = NULL;
+	}
+
+	/* nothing more will come */
+	if (ogg_status != STOP && ogg_ring.head.load(std::memory_order_acquire) == ogg_ring.tail.load(std::memory_order_relaxed))
+	{
+		OGG_Stop();
 	}
 }
 
@@ -273,6 +683,8 @@ OGG_Stream(void)
 		return;
 	}
 
+	OGG_CheckErrors();
+
 	if (ogg_status == PLAY)
 	{
 #ifdef USE_OPENAL
@@ -290,10 +702,10 @@ OGG_Stream(void)
 			}
 
 			/* active_buffers are all active OpenAL buffers,
-			   buffering normal sfx _and_ ogg/vorbis samples. */
-			while (active_buffers <= ogg_numbufs)
+			   buffering normal sfx _and_ ogg/vorbis samples.
+			   Stop early if the decoder hasn't caught up. */
+			while (active_buffers <= ogg_numbufs && OGG_Read())
 			{
-				OGG_Read();
 			}
 		}
 		else /* using SDL */
@@ -305,9 +717,8 @@ OGG_Stream(void)
 				   were played since the last call to this function.
 				   This keeps the buffer at all times at an "optimal"
 				   fill level. */
-				while (paintedtime + S_MAX_RAW_SAMPLES - 2048 > s_rawend)
+				while (paintedtime + S_MAX_RAW_SAMPLES - 2048 > s_rawend && OGG_Read())
 				{
-					OGG_Read();
 				}
 			}
 		}
@@ -398,31 +809,13 @@ OGG_PlayTrack(int trackNo)
 		return;
 	}
 
-	/* Open ogg vorbis file. */
-	FILE* f = fopen(ogg_tracks[trackNo], "rb");
-
-	if (f == NULL)
-	{
-		Com_Printf("OGG_PlayTrack: could not open file %s for track %d: %s.\n", ogg_tracks[trackNo], trackNo, strerror(errno));
-		ogg_tracks[trackNo] = NULL;
-
-		return;
-	}
-
-	int res = 0;
-	ogg_file = stb_vorbis_open_file(f, true, &res, NULL);
-
-	if (res != 0)
-	{
-		Com_Printf("OGG_PlayTrack: '%s' is not a valid Ogg Vorbis file (error %i).\n", ogg_tracks[trackNo], res);
-		fclose(f);
-
-		return;
-	}
+	/* The decoder thread opens the file, errors are reported by OGG_Stream(). */
+	OGG_Request(trackNo, ogg_startsample);
 
 	/* Play file. */
 	ogg_curfile = trackNo;
-	ogg_numsamples = 0;
+	ogg_numsamples = ogg_startsample;
+	ogg_startsample = 0;
 	if (ogg_enable->integer)
 		ogg_status = PLAY;
 	else
@@ -459,12 +852,12 @@ OGG_Info(void)
 	{
 		case PLAY:
 			Com_Printf("State: Playing file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case PAUSE:
 			Com_Printf("State: Paused file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case STOP:
@@ -499,7 +892,7 @@ OGG_Stop(void)
 	}
 #endif
 
-	stb_vorbis_close(ogg_file);
+	OGG_Request(0, 0);
 	ogg_status = STOP;
 	ogg_numbufs = 0;
 }
@@ -627,9 +1020,9 @@ OGG_RecoverState(void)
 	int shuffle_state = ogg_shuffle->value;
 	Cvar_SetValue(ogg_shuffle, 0, FROM_CODE);
 
+	ogg_startsample = ogg_saved_state.numsamples;
 	OGG_PlayTrack(ogg_saved_state.curfile);
-	stb_vorbis_seek_frame(ogg_file, ogg_saved_state.numsamples);
-	ogg_numsamples = ogg_saved_state.numsamples;
+	ogg_startsample = 0;
 
 	Cvar_SetValue(ogg_shuffle, shuffle_state, FROM_CODE);
 }
@@ -666,6 +1059,10 @@ OGG_Init(void)
 	ogg_numsamples = 0;
 	ogg_status = STOP;
 
+	// Decoder
+	ogg_decoder.quit = false;
+	ogg_decoder.thread = std::thread(OGG_DecoderThread);
+
 	ogg_started = true;
 }
 
@@ -683,6 +1080,13 @@ OGG_Shutdown(void)
 	// Music must be stopped.
 	OGG_Stop();
 
+	{
+		std::lock_guard<std::mutex> lock(ogg_decoder.lock);
+		ogg_decoder.quit = true;
+		ogg_decoder.wake.notify_one();
+	}
+	ogg_decoder.thread.join();
+
 	// Free file lsit.
 	for(int i=0; i<MAX_NUM_OGGTRACKS; ++i)
 	{
@@ -47,6 +47,7 @@ typedef struct sfx_s {
     sfxcache_t  *cache;
     char        *truename;
     qerror_t    error;
+    qboolean    loading;        // queued for the resampler
 } sfx_t;
 
 // a playsound_t will be generated by each call to S_StartSound,
@@ -110,6 +111,10 @@ void DMA_Activate(void);
 int DMA_DriftBeginofs(float timeofs);
 void DMA_ClearBuffer(void);
 void DMA_Update(void);
+qboolean DMA_MixerActive(void);
+void DMA_StartChannel(channel_t *ch, int begin);
+void DMA_RawSamples(int start, int count);
+void DMA_SetGain(float gain);
 #endif
 
 #if USE_OPENAL
@@ -158,6 +163,8 @@ extern int          s_rawend;
 
 extern  wavinfo_t   s_info;
 
+extern  qboolean    s_registering;
+
 extern cvar_t   *s_volume;
 extern cvar_t* s_doppler;
 extern cvar_t* s_reverb_preset;
@@ -174,9 +181,11 @@ extern cvar_t* s_occlusion_strength;
 #if USE_SNDDMA
 extern cvar_t   *s_khz;
 extern cvar_t   *s_testsound;
+extern cvar_t   *snd_precache_async;
 #endif
 extern cvar_t   *s_ambient;
 extern cvar_t   *s_show;
+extern cvar_t   *s_swapstereo;
 
 #define S_Malloc(x)     Z_TagMalloc(x, TAG_SOUND)
 #define S_CopyString(x) Z_TagCopyString(x, TAG_SOUND)
@@ -188,6 +197,12 @@ void S_IssuePlaysound(playsound_t *ps);
 void S_BuildSoundList(int *sounds);
 #if USE_SNDDMA
 void S_InitScaletable(void);
+void S_SetPaintGain(float gain);
+void S_PaintChunk(channel_t *chans, int numchans, int startTime, int endTime, const samplepair_t *raw, int rawend);
 void S_PaintChannels(int endTime);
+void S_SpatializeListener(const vec3_t &origin, const vec3_t &lorigin, const vec3_t &lright, float master_vol, float dist_mult, int *left_vol, int *right_vol);
+void S_MixBench_f(void);
+void S_FinishResampling(qboolean wait);
+void S_CancelResampling(sfx_t *sfx);
 #endif
 
@@ -262,6 +262,7 @@ LOAD(Brushes)
 {
     dbrush_t    *in;
     mbrush_t    *out;
+    mbrushplanes_t  *planes;
     int         i;
     uint32_t    firstside, numsides, lastside;
 
@@ -270,6 +271,7 @@ LOAD(Brushes)
 
     in = (dbrush_t*)base; // CPP: Cast
     out = bsp->brushes;
+    bsp->numbrushplanes = 0;
     for (i = 0; i < count; i++, out++, in++) {
         firstside = LittleLong(in->firstside);
         numsides = LittleLong(in->numsides);
@@ -282,6 +284,18 @@ LOAD(Brushes)
         out->numsides = numsides;
         out->contents = LittleLong(in->contents);
         out->checkcount = 0;
+        bsp->numbrushplanes += (numsides + BRUSH_PLANES - 1) / BRUSH_PLANES;
+    }
+
+    // brush sides are loaded already, pack their planes
+    bsp->brushplanes = (mbrushplanes_t*)ALLOC(sizeof(*planes) * bsp->numbrushplanes); // CPP: Cast
+
+    planes = bsp->brushplanes;
+    out = bsp->brushes;
+    for (i = 0; i < count; i++, out++) {
+        out->planes = planes;
+        BSP_PackBrushPlanes(out);
+        planes += (out->numsides + BRUSH_PLANES - 1) / BRUSH_PLANES;
     }
 
     return Q_ERR_SUCCESS;
@@ -1303,6 +1317,197 @@ static qerror_t BSP_ValidateAreaPortals(bsp_t *bsp)
     return Q_ERR_SUCCESS;
 }
 
+/*
+==================
+BSP_PackBrushPlanes
+
+Copies the planes of brush sides into brush->planes. Unused lanes of the
+last block get a zero plane.
+==================
+*/
+void BSP_PackBrushPlanes(mbrush_t *brush)
+{
+    mbrushplanes_t  *out;
+    cplane_t        *plane;
+    int             i, j, k;
+
+    for (i = 0; i < brush->numsides; i += BRUSH_PLANES) {
+        out = &brush->planes[i / BRUSH_PLANES];
+        for (k = 0; k < BRUSH_PLANES; k++) {
+            if (i + k >= brush->numsides) {
+                for (j = 0; j < 3; j++)
+                    out->normal[j][k] = 0;
+                out->dist[k] = 0;
+                continue;
+            }
+            plane = brush->firstbrushside[i + k].plane;
+            for (j = 0; j < 3; j++)
+                out->normal[j][k] = plane->normal[j];
+            out->dist[k] = plane->dist;
+        }
+    }
+}
+
+#define BVH_LEAF_BRUSHES    4
+#define BVH_UNBOUNDED       1e30f
+
+// bounds from the axial sides compiled brushes always have,
+// unbounded along axes without one
+static void BSP_BrushBounds(const mbrush_t *brush, vec3_t &mins, vec3_t &maxs)
+{
+    const cplane_t *plane;
+    int i, j;
+
+    for (j = 0; j < 3; j++) {
+        mins[j] = -BVH_UNBOUNDED;
+        maxs[j] = BVH_UNBOUNDED;
+    }
+
+    for (i = 0; i < brush->numsides; i++) {
+        plane = brush->firstbrushside[i].plane;
+        for (j = 0; j < 3; j++) {
+            if (plane->normal[j] == 1 && plane->dist < maxs[j])
+                maxs[j] = plane->dist;
+            else if (plane->normal[j] == -1 && -plane->dist > mins[j])
+                mins[j] = -plane->dist;
+        }
+    }
+}
+
+static void BSP_WorldBrushes_r(bsp_t *bsp, mnode_t *node, byte *used)
+{
+    mleaf_t *leaf;
+    mbrush_t *brush;
+    int i, num;
+
+    while (node->plane) {
+        BSP_WorldBrushes_r(bsp, node->children[0], used);
+        node = node->children[1];
+    }
+
+    leaf = (mleaf_t *)node;
+    for (i = 0; i < leaf->numleafbrushes; i++) {
+        brush = leaf->firstleafbrush[i];
+        num = brush - bsp->brushes;
+        if (!Q_IsBitSet(used, num)) {
+            Q_SetBit(used, num);
+            bsp->bvhbrushes[bsp->numbvhbrushes++] = brush;
+        }
+    }
+}
+
+static void BSP_BuildBVH_r(bsp_t *bsp, mbvhnode_t *node, vec3_t *bounds, int first, int count)
+{
+    vec3_t cmins, cmaxs, tmp;
+    mbrush_t *brush;
+    float mid, c;
+    int i, j, axis, left;
+
+    ClearBounds(node->mins, node->maxs);
+    ClearBounds(cmins, cmaxs);
+    node->contents = 0;
+    for (i = first; i < first + count; i++) {
+        AddPointToBounds(bounds[i * 2 + 0], node->mins, node->maxs);
+        AddPointToBounds(bounds[i * 2 + 1], node->mins, node->maxs);
+        VectorAdd(bounds[i * 2 + 0], bounds[i * 2 + 1], tmp);
+        VectorScale(tmp, 0.5f, tmp);
+        AddPointToBounds(tmp, cmins, cmaxs);
+        node->contents |= bsp->bvhbrushes[i]->contents;
+    }
+
+    if (count <= BVH_LEAF_BRUSHES) {
+        node->first = first;
+        node->numbrushes = count;
+        return;
+    }
+
+    // split at the middle of the longest axis of brush centers
+    axis = 0;
+    for (j = 1; j < 3; j++) {
+        if (cmaxs[j] - cmins[j] > cmaxs[axis] - cmins[axis])
+            axis = j;
+    }
+    mid = (cmins[axis] + cmaxs[axis]) * 0.5f;
+
+    left = first;
+    for (i = first; i < first + count; i++) {
+        c = (bounds[i * 2 + 0][axis] + bounds[i * 2 + 1][axis]) * 0.5f;
+        if (c >= mid)
+            continue;
+
+        brush = bsp->bvhbrushes[i];
+        bsp->bvhbrushes[i] = bsp->bvhbrushes[left];
+        bsp->bvhbrushes[left] = brush;
+        for (j = 0; j < 2; j++) {
+            VectorCopy(bounds[i * 2 + j], tmp);
+            VectorCopy(bounds[left * 2 + j], bounds[i * 2 + j]);
+            VectorCopy(tmp, bounds[left * 2 + j]);
+        }
+        left++;
+    }
+
+    // all centers coincide, split in halves
+    if (left == first || left == first + count)
+        left = first + count / 2;
+
+    node->first = bsp->numbvhnodes;
+    node->numbrushes = 0;
+    bsp->numbvhnodes += 2;
+
+    BSP_BuildBVH_r(bsp, &bsp->bvhnodes[node->first + 0], bounds, first, left - first);
+    BSP_BuildBVH_r(bsp, &bsp->bvhnodes[node->first + 1], bounds, left, first + count - left);
+}
+
+/*
+==================
+BSP_BuildBrushBVH
+
+Collects brushes of the world model and builds a BVH over their bounds
+for CM_BoxTrace.
+==================
+*/
+static void BSP_BuildBrushBVH(bsp_t *bsp)
+{
+    vec3_t *bounds;
+    byte *used;
+    int i;
+
+    bsp->numbvhnodes = bsp->numbvhbrushes = 0;
+    if (!bsp->numbrushes || !bsp->nummodels)
+        return;
+
+    bsp->bvhbrushes = (mbrush_t**)ALLOC(sizeof(*bsp->bvhbrushes) * bsp->numbrushes); // CPP: Cast
+    used = (byte*)Z_Mallocz((bsp->numbrushes + 7) / 8); // CPP: Cast
+    BSP_WorldBrushes_r(bsp, bsp->models[0].headNode, used);
+    Z_Free(used);
+
+    if (!bsp->numbvhbrushes)
+        return;
+
+    bounds = (vec3_t*)Z_Malloc(sizeof(*bounds) * 2 * bsp->numbvhbrushes); // CPP: Cast
+    for (i = 0; i < bsp->numbvhbrushes; i++)
+        BSP_BrushBounds(bsp->bvhbrushes[i], bounds[i * 2 + 0], bounds[i * 2 + 1]);
+
+    bsp->bvhnodes = (mbvhnode_t*)ALLOC(sizeof(*bsp->bvhnodes) * (2 * bsp->numbvhbrushes - 1)); // CPP: Cast
+    bsp->numbvhnodes = 1;
+    BSP_BuildBVH_r(bsp, &bsp->bvhnodes[0], bounds, 0, bsp->numbvhbrushes);
+
+    Z_Free(bounds);
+}
+
+// returns the map whose world model starts at headNode, if it has a brush BVH
+bsp_t *BSP_ForHeadnode(const mnode_t *headNode)
+{
+    bsp_t *bsp;
+
+    LIST_FOR_EACH(bsp_t, bsp, &bsp_cache, entry) {
+        if (bsp->nodes == headNode)
+            return bsp->numbvhnodes ? bsp : NULL;
+    }
+
+    return NULL;
+}
+
 void BSP_Free(bsp_t *bsp)
 {
     if (!bsp) {
@@ -1619,6 +1824,11 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
         memsize += count * info->memsize;
     }
 
+    // packed brush planes, at most one partial block per brush
+    memsize += (lumpcount[LUMP_BRUSHSIDES] / BRUSH_PLANES + lumpcount[LUMP_BRUSHES] + 1) * sizeof(mbrushplanes_t);
+    // brush BVH
+    memsize += lumpcount[LUMP_BRUSHES] * (sizeof(mbrush_t *) + 2 * sizeof(mbvhnode_t));
+
 #if USE_REF
     // Declaring these Moved up, cuz yeah, this is hated by labels in C++
     // 
@@ -1661,6 +1871,8 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
         goto fail1;
     }
 
+    BSP_BuildBrushBVH(bsp);
+
 	if (!BSP_LoadPatchedPVS(bsp))
 	{
 			BSP_BuildPvsMatrix(bsp);
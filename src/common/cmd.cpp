@@ -37,6 +37,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 static const char *Cmd_ArgsRange(int from, int to); // C++20: added const
 
+// bumped whenever a command or alias is added or removed,
+// invalidates targets resolved by compiled commands
+static unsigned cmd_generation;
+
+// compiled form of the current command, if any
+static struct cmd_compiled_s *cmd_compiled;
+
 /*
 =============================================================================
 
@@ -283,6 +290,8 @@ void Cmd_AliasSet(const char *name, const char *cmd)
 
     hash = Com_HashString(name, ALIAS_HASH_SIZE);
     List_Append(&cmd_aliasHash[hash], &a->hashEntry);
+
+    cmd_generation++;
 }
 
 void Cmd_Alias_g(genctx_t *ctx)
@@ -374,6 +383,7 @@ static void Cmd_UnAlias_f(void)
                 List_Init(&cmd_aliasHash[hash]);
             }
             List_Init(&cmd_alias);
+            cmd_generation++;
             Com_Printf("Removed all alias commands.\n");
             return;
         default:
@@ -400,6 +410,8 @@ static void Cmd_UnAlias_f(void)
 
     Z_Free(a->value);
     Z_Free(a);
+
+    cmd_generation++;
 }
 
 #if USE_CLIENT
@@ -807,15 +819,10 @@ void Cmd_AddMacro(const char *name, xmacro_t function)
 =============================================================================
 */
 
-#define CMD_HASH_SIZE    128
-
-#define FOR_EACH_CMD_HASH(cmd, hash) \
-    LIST_FOR_EACH(cmd_function_t, cmd, &cmd_hash[hash], hashEntry)
 #define FOR_EACH_CMD(cmd) \
     LIST_FOR_EACH(cmd_function_t, cmd, &cmd_functions, listEntry)
 
 typedef struct cmd_function_s {
-    list_t          hashEntry;
     list_t          listEntry;
 
     xcommand_t      function;
@@ -824,7 +831,7 @@ typedef struct cmd_function_s {
 } cmd_function_t;
 
 static  list_t  cmd_functions;        // possible commands to execute
-static  list_t  cmd_hash[CMD_HASH_SIZE];
+static  nametable_t cmd_table = { NULL, 0, 0, TAG_CMD };
 
 static  int     cmd_argc;
 static  char    *cmd_argv[MAX_STRING_TOKENS]; // pointers to cmd_data[]
@@ -1039,6 +1046,9 @@ void Cmd_Shift(void)
         return;
     }
 
+    // first token changes, so does the target
+    cmd_compiled = NULL;
+
     if (cmd_argc == 1) {
         cmd_string[0] = 0;
         return;
@@ -1389,69 +1399,165 @@ char *Cmd_MacroExpandString(const char *text, qboolean aliasHack)
 }
 
 /*
-============
-Cmd_TokenizeString
+=============================================================================
 
-Parses the given string into command line tokens.
-$Cvars will be expanded unless they are in a quoted token
-============
+                        COMPILED COMMANDS
+
+Scripts tend to execute the same lines over and over (bind and alias bodies,
+wait loops, triggers). Tokenized lines are kept in a small direct mapped
+cache keyed by the macro expanded text, along with what the first token
+resolved to. Resolved targets are dropped whenever a command or alias is
+added or removed.
+
+=============================================================================
 */
-void Cmd_TokenizeString(const char *text, qboolean macroExpand)
+
+#define CMD_CACHE_SIZE      256     // must be power of 2
+
+typedef enum {
+    CMD_TARGET_NONE,
+    CMD_TARGET_FUNCTION,
+    CMD_TARGET_ALIAS,
+    CMD_TARGET_CVAR
+} cmdtarget_t;
+
+typedef struct cmd_compiled_s {
+    cmdtarget_t target;
+    unsigned    generation;     // cmd_generation target was resolved at
+    void        *ptr;
+
+    int         argc;
+    size_t      *offsets;       // cmd_offsets[]
+    size_t      *tokens;        // offsets of cmd_argv[] into data
+    char        *data;          // cmd_data[]
+    size_t      data_len;
+    size_t      string_len;     // cmd_string[] is text[0..string_len]
+    size_t      string_tail;
+    char        *text;          // macro expanded line, follows data
+} cmd_compiled_t;
+
+static cmd_compiled_t   *cmd_cache[CMD_CACHE_SIZE];
+
+static struct {
+    unsigned    hits;
+    unsigned    misses;
+    unsigned    resolved;       // targets found without lookup
+} cmd_cache_stats;
+
+static qboolean Cmd_LoadCompiled(const char *text)
+{
+    cmd_compiled_t *c = cmd_cache[Com_HashString(text, CMD_CACHE_SIZE)];
+    int i;
+
+    if (!c || strcmp(c->text, text)) {
+        return false;
+    }
+
+    memcpy(cmd_string, c->text, c->string_len);
+    cmd_string[c->string_len] = 0;
+    cmd_string_len = c->string_len;
+    cmd_string_tail = c->string_tail;
+
+    memcpy(cmd_data, c->data, c->data_len);
+    for (i = 0; i < c->argc; i++) {
+        cmd_offsets[i] = c->offsets[i];
+        cmd_argv[i] = cmd_data + c->tokens[i];
+    }
+    cmd_argc = c->argc;
+
+    cmd_compiled = c;
+    cmd_cache_stats.hits++;
+    return true;
+}
+
+static void Cmd_SaveCompiled(const char *text, size_t data_len)
 {
-    int     i;
-    char    *data, *start, *dest;
+    unsigned hash = Com_HashString(text, CMD_CACHE_SIZE);
+    size_t len = strlen(text);
+    cmd_compiled_t *c;
+    int i;
+
+    Z_Free(cmd_cache[hash]);
+
+    c = (cmd_compiled_t *)Cmd_Malloc(sizeof(*c) + cmd_argc * sizeof(size_t) * 2 +
+                                     data_len + len + 1);
+    c->target = CMD_TARGET_NONE;
+    c->generation = 0;
+    c->ptr = NULL;
+    c->argc = cmd_argc;
+    c->offsets = (size_t *)(c + 1);
+    c->tokens = c->offsets + cmd_argc;
+    c->data = (char *)(c->tokens + cmd_argc);
+    c->data_len = data_len;
+    c->text = c->data + data_len;
+    c->string_len = cmd_string_len;
+    c->string_tail = cmd_string_tail;
 
-// clear the args from the last string
     for (i = 0; i < cmd_argc; i++) {
-        cmd_argv[i] = NULL;
-        cmd_offsets[i] = 0;
+        c->offsets[i] = cmd_offsets[i];
+        c->tokens[i] = cmd_argv[i] - cmd_data;
     }
+    memcpy(c->data, cmd_data, data_len);
+    memcpy(c->text, text, len + 1);
 
-    cmd_argc = 0;
-    cmd_string[0] = 0;
-    cmd_string_len = 0;
-    cmd_string_tail = 0;
-    cmd_optind = 1;
-    cmd_optarg = cmd_optopt = (char*)cmd_null_string; // C++20: Added cast.
+    cmd_cache[hash] = c;
+    cmd_compiled = c;
+    cmd_cache_stats.misses++;
+}
 
-    if (!text[0]) {
-        return;
-    }
+static void Cmd_ClearCompiled(void)
+{
+    int i;
 
-// macro expand the text
-    if (macroExpand) {
-        text = Cmd_MacroExpandString(text, false);
-        if (!text) {
-            return;
-        }
+    for (i = 0; i < CMD_CACHE_SIZE; i++) {
+        Z_Free(cmd_cache[i]);
+        cmd_cache[i] = NULL;
     }
 
-    cmd_string_len = Q_strlcpy(cmd_string, text, sizeof(cmd_string));
-    if (cmd_string_len >= sizeof(cmd_string)) {
-        Com_Printf("Line exceeded %i chars, discarded.\n", MAX_STRING_CHARS);
+    cmd_compiled = NULL;
+}
+
+static void Cmd_CacheStats_f(void)
+{
+    unsigned total = cmd_cache_stats.hits + cmd_cache_stats.misses;
+    int i, count;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "clear")) {
+        Cmd_ClearCompiled();
+        memset(&cmd_cache_stats, 0, sizeof(cmd_cache_stats));
         return;
     }
 
-// strip off any trailing whitespace
-    while (cmd_string_len) {
-        if (cmd_string[cmd_string_len - 1] > ' ') {
-            break;
+    for (i = count = 0; i < CMD_CACHE_SIZE; i++) {
+        if (cmd_cache[i]) {
+            count++;
         }
-        cmd_string[cmd_string_len - 1] = 0;
-        cmd_string_len--;
-        cmd_string_tail++;
     }
 
+    Com_Printf("%d of %d lines cached\n"
+               "%u hits, %u misses (%.1f%% hit rate)\n"
+               "%u targets resolved from cache\n",
+               count, CMD_CACHE_SIZE,
+               cmd_cache_stats.hits, cmd_cache_stats.misses,
+               total ? cmd_cache_stats.hits * 100.0 / total : 0.0,
+               cmd_cache_stats.resolved);
+}
+
+// returns amount of cmd_data[] used
+static size_t Cmd_ParseTokens(void)
+{
+    char    *data, *start, *dest;
+
     dest = cmd_data;
     start = data = cmd_string;
     while (cmd_argc < MAX_STRING_TOKENS) {
 // skip whitespace up to a /n
         while (*data <= ' ') {
             if (*data == 0) {
-                return; // end of text
+                return dest - cmd_data; // end of text
             }
             if (*data == '\n') {
-                return; // a newline seperates commands in the buffer
+                return dest - cmd_data; // a newline seperates commands in the buffer
             }
             data++;
         }
@@ -1473,7 +1579,7 @@ void Cmd_TokenizeString(const char *text, qboolean macroExpand)
             data++;
             while (*data != '\"') {
                 if (*data == 0) {
-                    return; // end of data
+                    return dest - cmd_data; // end of data
                 }
                 *dest++ = *data++;
             }
@@ -1495,35 +1601,95 @@ void Cmd_TokenizeString(const char *text, qboolean macroExpand)
         *dest++ = 0;
 
         if (*data == 0) {
-            return; // end of text
+            return dest - cmd_data; // end of text
         }
     }
+
+    return dest - cmd_data;
 }
 
 /*
 ============
-Cmd_Find
+Cmd_TokenizeString
+
+Parses the given string into command line tokens.
+$Cvars will be expanded unless they are in a quoted token
 ============
 */
-static cmd_function_t *Cmd_Find(const char *name)
+void Cmd_TokenizeString(const char *text, qboolean macroExpand)
 {
-    cmd_function_t *cmd;
-    unsigned hash;
+    int     i;
+    size_t  data_len;
+
+// clear the args from the last string
+    for (i = 0; i < cmd_argc; i++) {
+        cmd_argv[i] = NULL;
+        cmd_offsets[i] = 0;
+    }
+
+    cmd_argc = 0;
+    cmd_string[0] = 0;
+    cmd_string_len = 0;
+    cmd_string_tail = 0;
+    cmd_optind = 1;
+    cmd_optarg = cmd_optopt = (char*)cmd_null_string; // C++20: Added cast.
+    cmd_compiled = NULL;
+
+    if (!text[0]) {
+        return;
+    }
 
-    hash = Com_HashString(name, CMD_HASH_SIZE);
-    FOR_EACH_CMD_HASH(cmd, hash) {
-        if (!strcmp(cmd->name, name)) {
-            return cmd;
+// macro expand the text, expansion can't change lines without any $
+    if (macroExpand) {
+        if (!strchr(text, '$') && Cmd_LoadCompiled(text)) {
+            return;
+        }
+        text = Cmd_MacroExpandString(text, false);
+        if (!text) {
+            return;
+        }
+        if (Cmd_LoadCompiled(text)) {
+            return;
         }
     }
 
-    return NULL;
+    cmd_string_len = Q_strlcpy(cmd_string, text, sizeof(cmd_string));
+    if (cmd_string_len >= sizeof(cmd_string)) {
+        Com_Printf("Line exceeded %i chars, discarded.\n", MAX_STRING_CHARS);
+        return;
+    }
+
+// strip off any trailing whitespace
+    while (cmd_string_len) {
+        if (cmd_string[cmd_string_len - 1] > ' ') {
+            break;
+        }
+        cmd_string[cmd_string_len - 1] = 0;
+        cmd_string_len--;
+        cmd_string_tail++;
+    }
+
+    data_len = Cmd_ParseTokens();
+
+// only lines coming from scripts are worth caching
+    if (macroExpand) {
+        Cmd_SaveCompiled(text, data_len);
+    }
+}
+
+/*
+============
+Cmd_Find
+============
+*/
+static cmd_function_t *Cmd_Find(const char *name)
+{
+    return (cmd_function_t *)NameTable_Find(&cmd_table, name, Com_HashName(name));
 }
 
 static void Cmd_RegCommand(const cmdreg_t *reg)
 {
     cmd_function_t *cmd;
-    unsigned hash;
 
 // fail if the command is a variable name
     if (Cvar_Exists(reg->name, false)) {
@@ -1540,6 +1706,7 @@ static void Cmd_RegCommand(const cmdreg_t *reg)
         }
         cmd->function = reg->function;
         cmd->completer = reg->completer;
+        cmd_generation++;
         return;
     }
 
@@ -1550,8 +1717,9 @@ static void Cmd_RegCommand(const cmdreg_t *reg)
 
     List_Append(&cmd_functions, &cmd->listEntry);
 
-    hash = Com_HashString(reg->name, CMD_HASH_SIZE);
-    List_Append(&cmd_hash[hash], &cmd->hashEntry);
+    NameTable_Insert(&cmd_table, cmd->name, Com_HashName(cmd->name), cmd);
+
+    cmd_generation++;
 }
 
 /*
@@ -1601,8 +1769,10 @@ void Cmd_RemoveCommand(const char *name)
     }
 
     List_Delete(&cmd->listEntry);
-    List_Delete(&cmd->hashEntry);
+    NameTable_Remove(&cmd_table, cmd->name, Com_HashName(cmd->name));
     Z_Free(cmd);
+
+    cmd_generation++;
 }
 
 /*
@@ -1644,13 +1814,50 @@ void Cmd_Command_g(genctx_t *ctx)
 
 void Cmd_ExecuteCommand(cmdbuf_t *buf)
 {
-    cmd_function_t  *cmd;
-    cmdalias_t      *a;
-    cvar_t          *v;
+    cmd_compiled_t  *c = cmd_compiled;
+    cmd_function_t  *cmd = NULL;
+    cmdalias_t      *a = NULL;
+    cvar_t          *v = NULL;
     char            *text;
 
+    if (c && c->target != CMD_TARGET_NONE && c->generation == cmd_generation) {
+        // reuse target resolved last time this line was executed
+        switch (c->target) {
+        case CMD_TARGET_FUNCTION:
+            cmd = (cmd_function_t *)c->ptr;
+            break;
+        case CMD_TARGET_ALIAS:
+            a = (cmdalias_t *)c->ptr;
+            break;
+        default:
+            v = (cvar_t *)c->ptr;
+            break;
+        }
+        cmd_cache_stats.resolved++;
+    } else {
+        cmdtarget_t target = CMD_TARGET_NONE;
+        void *ptr = NULL;
+
+        if ((cmd = Cmd_Find(cmd_argv[0])) != NULL) {
+            target = CMD_TARGET_FUNCTION;
+            ptr = cmd;
+        } else if ((a = Cmd_AliasFind(cmd_argv[0])) != NULL) {
+            target = CMD_TARGET_ALIAS;
+            ptr = a;
+        } else if ((v = Cvar_FindVar(cmd_argv[0])) != NULL) {
+            target = CMD_TARGET_CVAR;
+            ptr = v;
+        }
+
+        // unknown commands are not remembered, cvars can appear any time
+        if (c) {
+            c->target = target;
+            c->generation = cmd_generation;
+            c->ptr = ptr;
+        }
+    }
+
     // check functions
-    cmd = Cmd_Find(cmd_argv[0]);
     if (cmd) {
         if (cmd->function) {
             cmd->function();
@@ -1661,7 +1868,6 @@ void Cmd_ExecuteCommand(cmdbuf_t *buf)
     }
 
     // check aliases
-    a = Cmd_AliasFind(cmd_argv[0]);
     if (a) {
         if (buf->aliasCount >= ALIAS_LOOP_COUNT) {
             Com_WPrintf("Runaway alias loop\n");
@@ -1676,7 +1882,6 @@ void Cmd_ExecuteCommand(cmdbuf_t *buf)
     }
 
     // check variables
-    v = Cvar_FindVar(cmd_argv[0]);
     if (v) {
         Cvar_Command(v);
         return;
@@ -1984,7 +2189,6 @@ static void Cmd_Complete_f(void)
 {
     cmd_function_t *cmd;
     char *name;
-    unsigned hash;
     size_t len;
 
     if (cmd_argc < 2) {
@@ -2016,8 +2220,9 @@ static void Cmd_Complete_f(void)
 
     List_Append(&cmd_functions, &cmd->listEntry);
 
-    hash = Com_HashString(name, CMD_HASH_SIZE);
-    List_Append(&cmd_hash[hash], &cmd->hashEntry);
+    NameTable_Insert(&cmd_table, cmd->name, Com_HashName(cmd->name), cmd);
+
+    cmd_generation++;
 }
 
 static const cmdreg_t c_cmd[] = {
@@ -2035,6 +2240,7 @@ static const cmdreg_t c_cmd[] = {
     { "untrigger", Cmd_UnTrigger_f },
     { "if", Cmd_If_f },
     { "openurl", Cmd_OpenURL_f },
+    { "cmdcache", Cmd_CacheStats_f },
 
     { NULL }
 };
@@ -2049,9 +2255,6 @@ void Cmd_Init(void)
     int i;
 
     List_Init(&cmd_functions);
-    for (i = 0; i < CMD_HASH_SIZE; i++) {
-        List_Init(&cmd_hash[i]);
-    }
 
     List_Init(&cmd_alias);
     for (i = 0; i < ALIAS_HASH_SIZE; i++) {
@@ -26,6 +26,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/zone.h"
 #include "system/hunk.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 mtexinfo_t nulltexinfo;
 
 static mleaf_t      nullleaf;
@@ -35,6 +39,8 @@ static int          checkcount;
 
 static cvar_t       *map_noareas;
 static cvar_t       *map_allsolid_bug;
+static cvar_t       *map_brushbvh;
+static int          brushbvh_mode = -1;     // overrides map_brushbvh if set
 
 static void    FloodAreaConnections(cm_t *cm);
 
@@ -114,6 +120,7 @@ static mnode_t  *box_headnode;
 static mbrush_t box_brush;
 static mbrush_t *box_leafbrush;
 static mbrushside_t box_brushsides[6];
+alignas(16) static mbrushplanes_t box_brushplanes[2];
 static mleaf_t  box_leaf;
 static mleaf_t  box_emptyleaf;
 
@@ -137,6 +144,7 @@ static void CM_InitBoxHull(void)
 
     box_brush.numsides = 6;
     box_brush.firstbrushside = &box_brushsides[0];
+    box_brush.planes = &box_brushplanes[0];
     box_brush.contents = CONTENTS_MONSTER;
 
     box_leaf.contents = CONTENTS_MONSTER;
@@ -175,6 +183,8 @@ static void CM_InitBoxHull(void)
         VectorClear(p->normal);
         p->normal[i >> 1] = -1;
     }
+
+    BSP_PackBrushPlanes(&box_brush);
 }
 
 
@@ -188,6 +198,8 @@ BSP trees instead of being compared directly.
 */
 mnode_t *CM_HeadnodeForBox(const vec3_t &mins, const vec3_t &maxs)
 {
+    int i;
+
     box_planes[0].dist = maxs[0];
     box_planes[1].dist = -maxs[0];
     box_planes[2].dist = mins[0];
@@ -201,6 +213,9 @@ mnode_t *CM_HeadnodeForBox(const vec3_t &mins, const vec3_t &maxs)
     box_planes[10].dist = mins[2];
     box_planes[11].dist = -mins[2];
 
+    for (i = 0; i < 6; i++)
+        box_brushplanes[i / BRUSH_PLANES].dist[i % BRUSH_PLANES] = box_brushsides[i].plane->dist;
+
     return box_headnode;
 }
 
@@ -358,6 +373,91 @@ static trace_t  *trace_trace;
 static int      trace_contents;
 static qboolean trace_ispoint;      // optimized case
 
+static vec3_t   trace_invdelta;     // for the brush BVH
+static const bsp_t  *trace_bvh;     // map whose brush BVH is walked, if any
+static mbrush_t *trace_brush;       // brush the fraction was taken from
+
+// The BSP walk keeps the first brush hit at a given fraction. The BVH clips
+// brushes in another order, so there equal fractions go to the lowest
+// numbered brush instead, which doesn't depend on the order.
+static inline qboolean CM_NearerHit(const trace_t *trace, float frac, const mbrush_t *brush)
+{
+    if (!trace_bvh)
+        return frac < trace->fraction;
+
+    frac = max(frac, 0.0f);     // as stored
+    if (frac != trace->fraction)
+        return frac < trace->fraction;
+    return trace_brush && brush - trace_bvh->brushes < trace_brush - trace_bvh->brushes;
+}
+
+/*
+================
+CM_PlaneDistances
+
+Distances of p1 and p2 from a block of packed brush planes, with the
+planes pushed out apropriately for mins/maxs unless tracing a point.
+Distances from p2 are skipped if d2 is NULL.
+================
+*/
+static inline void CM_PlaneDistances(const mbrushplanes_t *planes, const vec3_t &mins, const vec3_t &maxs,
+                                     qboolean point, const vec3_t &p1, const vec3_t &p2, float *d1, float *d2)
+{
+#if USE_SSE2
+    __m128  nx = _mm_load_ps(planes->normal[0]);
+    __m128  ny = _mm_load_ps(planes->normal[1]);
+    __m128  nz = _mm_load_ps(planes->normal[2]);
+    __m128  dist = _mm_load_ps(planes->dist);
+    __m128  zero = _mm_setzero_ps();
+    __m128  neg, ox, oy, oz, d;
+
+    if (!point) {
+        // corner of the box furthest behind each plane
+        neg = _mm_cmplt_ps(nx, zero);
+        ox = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(maxs[0])), _mm_andnot_ps(neg, _mm_set1_ps(mins[0])));
+        neg = _mm_cmplt_ps(ny, zero);
+        oy = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(maxs[1])), _mm_andnot_ps(neg, _mm_set1_ps(mins[1])));
+        neg = _mm_cmplt_ps(nz, zero);
+        oz = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(maxs[2])), _mm_andnot_ps(neg, _mm_set1_ps(mins[2])));
+
+        d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, nx), _mm_mul_ps(oy, ny)), _mm_mul_ps(oz, nz));
+        dist = _mm_sub_ps(dist, d);
+    }
+
+    d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p1[0]), nx),
+                              _mm_mul_ps(_mm_set1_ps(p1[1]), ny)),
+                   _mm_mul_ps(_mm_set1_ps(p1[2]), nz));
+    _mm_storeu_ps(d1, _mm_sub_ps(d, dist));
+
+    if (d2) {
+        d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p2[0]), nx),
+                                  _mm_mul_ps(_mm_set1_ps(p2[1]), ny)),
+                       _mm_mul_ps(_mm_set1_ps(p2[2]), nz));
+        _mm_storeu_ps(d2, _mm_sub_ps(d, dist));
+    }
+#else
+    vec3_t  normal, ofs;
+    float   dist;
+    int     i, j;
+
+    for (i = 0; i < BRUSH_PLANES; i++) {
+        for (j = 0; j < 3; j++)
+            normal[j] = planes->normal[j][i];
+
+        dist = planes->dist[i];
+        if (!point) {
+            for (j = 0; j < 3; j++)
+                ofs[j] = normal[j] < 0 ? maxs[j] : mins[j];
+            dist -= DotProduct(ofs, normal);
+        }
+
+        d1[i] = DotProduct(p1, normal) - dist;
+        if (d2)
+            d2[i] = DotProduct(p2, normal) - dist;
+    }
+#endif
+}
+
 /*
 ================
 CM_ClipBoxToBrush
@@ -366,19 +466,16 @@ CM_ClipBoxToBrush
 static void CM_ClipBoxToBrush(const vec3_t &mins, const vec3_t &maxs, const vec3_t &p1, const vec3_t &p2,
                               trace_t *trace, mbrush_t *brush)
 {
-    int         i, j;
-    cplane_t    *plane, *clipplane;
-    float       dist;
+    int         i, j, count;
     float       enterfrac, leavefrac;
-    vec3_t      ofs;
-    float       d1, d2;
+    float       d1[BRUSH_PLANES], d2[BRUSH_PLANES];
     qboolean    getout, startout;
     float       f;
     mbrushside_t    *side, *leadside;
+    mbrushplanes_t  *planes;
 
     enterfrac = -1;
     leavefrac = 1;
-    clipplane = NULL;
 
     if (!brush->numsides)
         return;
@@ -388,59 +485,41 @@ static void CM_ClipBoxToBrush(const vec3_t &mins, const vec3_t &maxs, const vec3
     leadside = NULL;
 
     side = brush->firstbrushside;
-    for (i = 0; i < brush->numsides; i++, side++) {
-        plane = side->plane;
-
-        // FIXME: special case for axial
-
-        if (!trace_ispoint) {
-            // general box case
-
-            // push the plane out apropriately for mins/maxs
-
-            // FIXME: use signbits into 8 way lookup for each mins/maxs
-            for (j = 0; j < 3; j++) {
-                if (plane->normal[j] < 0)
-                    ofs[j] = maxs[j];
-                else
-                    ofs[j] = mins[j];
-            }
-            dist = DotProduct(ofs, plane->normal);
-            dist = plane->dist - dist;
-        } else {
-            // special point case
-            dist = plane->dist;
-        }
-
-        d1 = DotProduct(p1, plane->normal) - dist;
-        d2 = DotProduct(p2, plane->normal) - dist;
-
-        if (d2 > 0)
-            getout = true; // endpoint is not in solid
-        if (d1 > 0)
-            startout = true;
-
-        // if completely in front of face, no intersection
-        if (d1 > 0 && d2 >= d1)
-            return;
-
-        if (d1 <= 0 && d2 <= 0)
-            continue;
-
-        // crosses face
-        if (d1 > d2) {
-            // enter
-            f = (d1 - DIST_EPSILON) / (d1 - d2);
-            if (f > enterfrac) {
-                enterfrac = f;
-                clipplane = plane;
-                leadside = side;
+    planes = brush->planes;
+    for (i = 0; i < brush->numsides; i += BRUSH_PLANES, planes++) {
+        CM_PlaneDistances(planes, mins, maxs, trace_ispoint, p1, p2, d1, d2);
+
+        count = brush->numsides - i;
+        if (count > BRUSH_PLANES)
+            count = BRUSH_PLANES;
+
+        for (j = 0; j < count; j++, side++) {
+            if (d2[j] > 0)
+                getout = true; // endpoint is not in solid
+            if (d1[j] > 0)
+                startout = true;
+
+            // if completely in front of face, no intersection
+            if (d1[j] > 0 && d2[j] >= d1[j])
+                return;
+
+            if (d1[j] <= 0 && d2[j] <= 0)
+                continue;
+
+            // crosses face
+            if (d1[j] > d2[j]) {
+                // enter
+                f = (d1[j] - DIST_EPSILON) / (d1[j] - d2[j]);
+                if (f > enterfrac) {
+                    enterfrac = f;
+                    leadside = side;
+                }
+            } else {
+                // leave
+                f = (d1[j] + DIST_EPSILON) / (d1[j] - d2[j]);
+                if (f < leavefrac)
+                    leavefrac = f;
             }
-        } else {
-            // leave
-            f = (d1 + DIST_EPSILON) / (d1 - d2);
-            if (f < leavefrac)
-                leavefrac = f;
         }
     }
 
@@ -449,22 +528,29 @@ static void CM_ClipBoxToBrush(const vec3_t &mins, const vec3_t &maxs, const vec3
         trace->startSolid = true;
         if (!getout) {
             trace->allSolid = true;
-            if (!map_allsolid_bug->integer) {
+            if (!map_allsolid_bug->integer && (!trace_bvh || CM_NearerHit(trace, 0, brush))) {
                 // original Q2 didn't set these
                 trace->fraction = 0;
                 trace->contents = brush->contents;
+                if (trace_bvh) {
+                    // don't keep the plane of a tied brush
+                    memset(&trace->plane, 0, sizeof(trace->plane));
+                    trace->surface = &(nulltexinfo.c);
+                    trace_brush = brush;
+                }
             }
         }
         return;
     }
     if (enterfrac < leavefrac) {
-        if (enterfrac > -1 && enterfrac < trace->fraction) {
+        if (enterfrac > -1 && CM_NearerHit(trace, enterfrac, brush)) {
             if (enterfrac < 0)
                 enterfrac = 0;
             trace->fraction = enterfrac;
-            trace->plane = *clipplane;
+            trace->plane = *leadside->plane;
             trace->surface = &(leadside->texinfo->c);
             trace->contents = brush->contents;
+            trace_brush = brush;
         }
     }
 }
@@ -477,12 +563,9 @@ CM_TestBoxInBrush
 static void CM_TestBoxInBrush(const vec3_t &mins, const vec3_t &maxs, const vec3_t &p1,
                               trace_t *trace, mbrush_t *brush)
 {
-    int         i, j;
-    cplane_t    *plane;
-    float       dist;
-    vec3_t      ofs;
-    float       d1;
-    mbrushside_t    *side;
+    int         i, j, count;
+    float       d1[BRUSH_PLANES];
+    mbrushplanes_t  *planes;
 
     if (!brush->numsides)
         return;
@@ -515,33 +598,20 @@ static void CM_TestBoxInBrush(const vec3_t &mins, const vec3_t &maxs, const vec3
     //    }
     //}
 
-    // N&C: FF Precision. This was the old code.
-    side = brush->firstbrushside;
-    for (i = 0; i < brush->numsides; i++, side++) {
-        plane = side->plane;
-
-        // FIXME: special case for axial
+    // N&C: FF Precision. This was the old code, now on packed planes.
+    planes = brush->planes;
+    for (i = 0; i < brush->numsides; i += BRUSH_PLANES, planes++) {
+        CM_PlaneDistances(planes, mins, maxs, false, p1, p1, d1, NULL);
 
-        // general box case
-
-        // push the plane out apropriately for mins/maxs
-
-        // FIXME: use signbits into 8 way lookup for each mins/maxs
-        for (j = 0; j < 3; j++) {
-            if (plane->normal[j] < 0)
-                ofs[j] = maxs[j];
-            else
-                ofs[j] = mins[j];
-        }
-        dist = DotProduct(ofs, plane->normal);
-        dist = plane->dist - dist;
-
-        d1 = DotProduct(p1, plane->normal) - dist;
+        count = brush->numsides - i;
+        if (count > BRUSH_PLANES)
+            count = BRUSH_PLANES;
 
         // if completely in front of face, no intersection
-        if (d1 > 0)
-            return;
-
+        for (j = 0; j < count; j++) {
+            if (d1[j] > 0)
+                return;
+        }
     }
 
     // inside this brush
@@ -611,6 +681,132 @@ static void CM_TestInLeaf(mleaf_t *leaf)
 }
 
 
+/*
+===============================================================================
+
+BRUSH BVH
+
+Long traces and big boxes split on many BSP nodes and visit lots of leafs,
+testing the same brushes over and over. Such traces walk a BVH over world
+brush bounds instead, nearest child first, and only clip the brushes whose
+bounds the swept box touches before the current fraction.
+
+===============================================================================
+*/
+
+#define BVH_MIN_LENGTH  1024    // traces this long use the BVH
+#define BVH_MIN_EXTENT  64      // as do boxes this large
+#define BVH_EPSILON     1       // bounds slack, must exceed DIST_EPSILON
+
+// returns false if the swept box misses the bounds before the current
+// fraction, otherwise the fraction it enters them at
+static qboolean CM_SweepBounds(const mbvhnode_t *node, float *enter)
+{
+    float   t0, t1, a, b, lo, hi;
+    int     i;
+
+    t0 = 0;
+    t1 = trace_trace->fraction;
+    for (i = 0; i < 3; i++) {
+        lo = node->mins[i] - trace_maxs[i] - BVH_EPSILON;
+        hi = node->maxs[i] - trace_mins[i] + BVH_EPSILON;
+        if (trace_start[i] == trace_end[i]) {
+            if (trace_start[i] < lo || trace_start[i] > hi)
+                return false;
+            continue;
+        }
+
+        a = (lo - trace_start[i]) * trace_invdelta[i];
+        b = (hi - trace_start[i]) * trace_invdelta[i];
+        if (a > b) {
+            t0 = max(t0, b);
+            t1 = min(t1, a);
+        } else {
+            t0 = max(t0, a);
+            t1 = min(t1, b);
+        }
+        if (t0 > t1)
+            return false;
+    }
+
+    *enter = t0;
+    return true;
+}
+
+static void CM_TraceBVH_r(const bsp_t *bsp, const mbvhnode_t *node)
+{
+    const mbvhnode_t *front, *back;
+    mbrush_t    *b;
+    float       f0, f1;
+    qboolean    hit0, hit1;
+    int         i;
+
+    if (!(node->contents & trace_contents))
+        return;
+
+    if (node->numbrushes) {
+        for (i = 0; i < node->numbrushes; i++) {
+            b = bsp->bvhbrushes[node->first + i];
+            if (!(b->contents & trace_contents))
+                continue;
+            CM_ClipBoxToBrush(trace_mins, trace_maxs, trace_start, trace_end, trace_trace, b);
+        }
+        return;
+    }
+
+    front = &bsp->bvhnodes[node->first];
+    back = front + 1;
+    hit0 = CM_SweepBounds(front, &f0);
+    hit1 = CM_SweepBounds(back, &f1);
+    if (hit0 && hit1 && f1 < f0) {
+        front = back;
+        back = front - 1;
+    } else if (!hit0) {
+        front = back;
+        hit0 = hit1;
+        hit1 = false;
+    }
+
+    if (hit0) {
+        CM_TraceBVH_r(bsp, front);
+        // see if anything nearer was hit meanwhile
+        if (hit1 && CM_SweepBounds(back, &f1))
+            CM_TraceBVH_r(bsp, back);
+    }
+}
+
+// returns the map to trace through its brush BVH, or NULL to walk the BSP tree
+static const bsp_t *CM_BrushBVH(mnode_t *headNode)
+{
+    int mode = brushbvh_mode >= 0 ? brushbvh_mode : map_brushbvh->integer;
+    vec3_t delta;
+
+    if (!mode)
+        return NULL;
+
+    if (mode == 1) {
+        VectorSubtract(trace_end, trace_start, delta);
+        if (DotProduct(delta, delta) < BVH_MIN_LENGTH * BVH_MIN_LENGTH &&
+            max(max(trace_extents[0], trace_extents[1]), trace_extents[2]) < BVH_MIN_EXTENT)
+            return NULL;
+    }
+
+    return BSP_ForHeadnode(headNode);
+}
+
+/*
+==================
+CM_SetBrushBVH
+
+Makes traces use the BSP tree (0), the brush BVH (2) or pick by size (1)
+regardless of map_brushbvh, for comparing them. -1 goes back to the cvar.
+==================
+*/
+void CM_SetBrushBVH(int mode)
+{
+    brushbvh_mode = mode;
+}
+
 /*
 ==================
 CM_RecursiveHullCheck
@@ -715,6 +911,10 @@ void CM_BoxTrace(trace_t *trace, const vec3_t &start, const vec3_t &end,
                  const vec3_t &mins, const vec3_t &maxs,
                  mnode_t *headNode, int brushmask)
 {
+    const bsp_t *bsp;
+    float       frac;
+    int         i;
+
     checkcount++;       // for multi-check avoidance
 
     // fill in a default trace
@@ -722,6 +922,8 @@ void CM_BoxTrace(trace_t *trace, const vec3_t &start, const vec3_t &end,
     memset(trace_trace, 0, sizeof(*trace_trace));
     trace_trace->fraction = 1;
     trace_trace->surface = &(nulltexinfo.c);
+    trace_bvh = NULL;
+    trace_brush = NULL;
 
     if (!headNode) {
         return;
@@ -738,7 +940,7 @@ void CM_BoxTrace(trace_t *trace, const vec3_t &start, const vec3_t &end,
     //
     if (start[0] == end[0] && start[1] == end[1] && start[2] == end[2]) {
         mleaf_t     *leafs[1024];
-        int     i, numleafs;
+        int     numleafs;
         vec3_t  c1, c2;
 
         VectorAdd(start, mins, c1);
@@ -805,7 +1007,17 @@ void CM_BoxTrace(trace_t *trace, const vec3_t &start, const vec3_t &end,
     //
     // general sweeping through world
     //
-    CM_RecursiveHullCheck(headNode, 0, 1, start, end);
+    bsp = CM_BrushBVH(headNode);
+    if (bsp) {
+        for (i = 0; i < 3; i++)
+            trace_invdelta[i] = start[i] != end[i] ? 1.0f / (end[i] - start[i]) : 0;
+        trace_bvh = bsp;
+        if (CM_SweepBounds(&bsp->bvhnodes[0], &frac))
+            CM_TraceBVH_r(bsp, &bsp->bvhnodes[0]);
+        trace_bvh = NULL;
+    } else {
+        CM_RecursiveHullCheck(headNode, 0, 1, start, end);
+    }
 
     if (trace_trace->fraction == 1)
         VectorCopy(end, trace_trace->endPosition);
@@ -1168,5 +1380,6 @@ void CM_Init(void)
 
     map_noareas = Cvar_Get("map_noareas", "0", 0);
     map_allsolid_bug = Cvar_Get("map_allsolid_bug", "1", 0);
+    map_brushbvh = Cvar_Get("map_brushbvh", "1", 0);
 }
 
@@ -32,11 +32,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/field.h"
 #include "common/fifo.h"
 #include "common/files.h"
+#include "common/jobs.h"
 #include "common/mdfour.h"
 #include "common/msg.h"
 #include "common/net/net.h"
 #include "common/net/netchan.h"
 //#include "common/pmove.h"
+#include "common/profile.h"
 #include "common/prompt.h"
 #include "common/protocol.h"
 #include "common/tests.h"
@@ -99,6 +101,7 @@ cvar_t  *com_time_format;
 cvar_t  *com_debug_break;
 #endif
 cvar_t  *com_fatal_error;
+cvar_t  *com_debug_lookups;
 
 cvar_t  *allow_download;
 cvar_t  *allow_download_players;
@@ -627,6 +630,7 @@ void Com_Quit(const char *reason, ErrorType type)
     NET_Shutdown();
     logfile_close();
     FS_Shutdown();
+    Job_Shutdown();
 
     Sys_Quit();
     // doesn't get there
@@ -953,6 +957,7 @@ void Qcommon_Init(int argc, char **argv)
     com_debug_break = Cvar_Get("com_debug_break", "0", 0);
 #endif
     com_fatal_error = Cvar_Get("com_fatal_error", "0", 0);
+    com_debug_lookups = Cvar_Get("com_debug_lookups", "0", 0);
     com_version = Cvar_Get("version", com_version_string, CVAR_SERVERINFO | CVAR_USERINFO | CVAR_ROM);
 
     allow_download = Cvar_Get("allow_download", COM_DEDICATED ? "0" : "1", CVAR_ARCHIVE);
@@ -1024,6 +1029,8 @@ void Qcommon_Init(int argc, char **argv)
     // The log file is opened during the execution of one of the config files above.
     Com_LPrintf(PRINT_NOTICE, "\nEngine version: " APPLICATION " " LONG_VERSION_STRING ", built on " __DATE__ "\n\n");
 
+    Prof_Init();
+    Job_Init();
     Netchan_Init();
     NET_Init();
     BSP_Init();
@@ -1181,5 +1188,8 @@ void Qcommon_Frame(void)
                    all, ev, sv, gm, cl, rf);
     }
 #endif
+
+    Cvar_CheckLookups();
+    Prof_EndFrame();
 }
 
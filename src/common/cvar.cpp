@@ -33,9 +33,11 @@ int     cvar_modified;
 
 #define Cvar_Malloc(size)   Z_TagMalloc(size, TAG_CVAR)
 
-#define CVARHASH_SIZE    256
+static nametable_t  cvar_table = { NULL, 0, 0, TAG_CVAR };
 
-static cvar_t *cvarHash[CVARHASH_SIZE];
+// lookups by name since the last Cvar_CheckLookups
+static unsigned     cvar_lookups;
+static char         cvar_last_lookup[MAX_QPATH];
 
 /*
 ============
@@ -44,18 +46,30 @@ Cvar_FindVar
 */
 cvar_t *Cvar_FindVar(const char *var_name)
 {
-    cvar_t *var;
-    unsigned hash;
+    cvar_lookups++;
+    if (com_debug_lookups && com_debug_lookups->integer) {
+        Q_strlcpy(cvar_last_lookup, var_name, sizeof(cvar_last_lookup));
+    }
 
-    hash = Com_HashString(var_name, CVARHASH_SIZE);
+    return (cvar_t *)NameTable_Find(&cvar_table, var_name, Com_HashName(var_name));
+}
 
-    for (var = cvarHash[hash]; var; var = var->hashNext) {
-        if (!strcmp(var_name, var->name)) {
-            return var;
-        }
+/*
+============
+Cvar_CheckLookups
+
+Called once per frame. Cvars should be looked up once and kept by pointer,
+reports code that keeps finding them by name on every frame.
+============
+*/
+void Cvar_CheckLookups(void)
+{
+    if (cvar_lookups && com_debug_lookups->integer) {
+        Com_Printf("%u cvar lookups by name this frame, last was \"%s\"\n",
+                   cvar_lookups, cvar_last_lookup);
     }
 
-    return NULL;
+    cvar_lookups = 0;
 }
 
 xgenerator_t Cvar_FindGenerator(const char *var_name)
@@ -271,7 +285,6 @@ The flags will be or'ed in if the variable exists.
 cvar_t *Cvar_Get(const char *var_name, const char *var_value, int flags)
 {
     cvar_t *var, *c, **p;
-    unsigned hash;
     size_t length;
 
     if (!var_name) {
@@ -323,9 +336,8 @@ cvar_t *Cvar_Get(const char *var_name, const char *var_value, int flags)
     *p = var;
 
     // link the variable in
-    hash = Com_HashString(var_name, CVARHASH_SIZE);
-    var->hashNext = cvarHash[hash];
-    cvarHash[hash] = var;
+    var->hashNext = NULL;
+    NameTable_Insert(&cvar_table, var->name, Com_HashName(var->name), var);
 
     return var;
 }
@@ -17,12 +17,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <condition_variable>
+#include <mutex>
+
 #include "shared/shared.h"
 #include "shared/list.h"
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/error.h"
 #include "common/files.h"
+#include "common/jobs.h"
 #include "common/prompt.h"
 #include "system/system.h"
 #include "client/client.h"
@@ -203,6 +207,8 @@ cvar_t              *fs_game;
 
 cvar_t              *fs_shareware;
 
+static cvar_t       *fs_prefetch;
+
 #if USE_ZLIB
 // local stream used for all file loads
 static zipstream_t  fs_zipstream;
@@ -1588,21 +1594,13 @@ static ssize_t read_phys_file(file_t *file, void *buf, size_t len)
     return result;
 }
 
-/*
-=================
-FS_Read
-=================
-*/
-ssize_t FS_Read(void *buf, size_t len, qhandle_t f)
+// also used by prefetch jobs, must not touch anything but the file itself
+static ssize_t read_file(file_t *file, void *buf, size_t len)
 {
-    file_t *file = file_for_handle(f);
 #if USE_ZLIB
     int ret;
 #endif
 
-    if (!file)
-        return Q_ERR_BADF;
-
     if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
         return Q_ERR_INVAL;
 
@@ -1636,6 +1634,21 @@ ssize_t FS_Read(void *buf, size_t len, qhandle_t f)
     }
 }
 
+/*
+=================
+FS_Read
+=================
+*/
+ssize_t FS_Read(void *buf, size_t len, qhandle_t f)
+{
+    file_t *file = file_for_handle(f);
+
+    if (!file)
+        return Q_ERR_BADF;
+
+    return read_file(file, buf, len);
+}
+
 ssize_t FS_ReadLine(qhandle_t f, char *buffer, size_t size)
 {
     file_t *file = file_for_handle(f);
@@ -1902,6 +1915,419 @@ qhandle_t FS_EasyOpenFile(char *buf, size_t size, unsigned mode,
     return easy_open_write(buf, size, mode, dir, name, ext);
 }
 
+/*
+=============================================================================
+
+PREFETCHING
+
+Files that are going to be loaded soon (level media) can be read ahead
+on the job threads. Lookup happens on the main thread when the file is
+queued, with a unique handle, so the jobs only read from their own FILE.
+FS_LoadFile then picks up the contents instead of reading the file again.
+An optional decode callback runs on the job thread too, its result is
+returned by FS_LoadPrefetched.
+
+=============================================================================
+*/
+
+#define PREFETCH_HASH_SIZE  256
+
+// stop handing out reads while this much hasn't been picked up yet
+#define PREFETCH_MAX_BYTES  (256 << 20)
+
+// jobs handed out at once, the rest when something is picked up
+#define PREFETCH_MAX_JOBS   32
+
+typedef enum {
+    PF_QUEUED,
+    PF_RUNNING,
+    PF_DONE
+} pfstate_t;
+
+typedef struct {
+    list_t          hash;
+    list_t          queue;      // while PF_QUEUED
+    pfstate_t       state;
+    qboolean        dispatched; // a job was added for it
+    unsigned        mode;
+    int             priority;
+    file_t          file;       // unique handle owned by the prefetch
+    fs_decode_t     decode;
+    fs_decodefree_t decodefree;
+    byte            *data;
+    ssize_t         len;        // or error
+    void            *decoded;
+    size_t          size;       // data and decoded bytes, counted in fs_prefetch_bytes
+    char            path[1];
+} prefetch_t;
+
+static list_t                   fs_prefetch_hash[PREFETCH_HASH_SIZE];
+static LIST_DECL(fs_prefetch_queue);
+static std::mutex               fs_prefetch_lock;
+static std::condition_variable  fs_prefetch_done;
+static int                      fs_prefetch_total;
+static int                      fs_prefetch_finished;
+static size_t                   fs_prefetch_bytes;   // dispatched and not picked up
+
+static prefetch_t *find_prefetch(const char *normalized, unsigned mode)
+{
+    prefetch_t *pf;
+    list_t *list = &fs_prefetch_hash[FS_HashPath(normalized, PREFETCH_HASH_SIZE)];
+
+    LIST_FOR_EACH(prefetch_t, pf, list, hash) {
+        if (pf->mode == mode && !FS_pathcmp(pf->path, normalized)) {
+            return pf;
+        }
+    }
+
+    return NULL;
+}
+
+// only called for unique handles, leaves the pack reference to the main thread
+static void close_prefetch_file(file_t *file)
+{
+    switch (file->type) {
+    case FS_REAL:
+    case FS_PAK:
+        fclose(file->fp);
+        break;
+#if USE_ZLIB
+    case FS_ZIP:
+        close_zip_file(file);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+// reads and decodes the file, may run on any thread. returns the number of
+// bytes held, the caller accounts for them with the lock held.
+static size_t read_prefetch(prefetch_t *pf)
+{
+    ssize_t len = pf->file.length;
+    ssize_t read;
+    byte *data;
+    size_t size = 0;
+
+    data = (byte *)FS_Malloc(len + 1);
+    read = read_file(&pf->file, data, len);
+    close_prefetch_file(&pf->file);
+
+    if (read != len) {
+        Z_Free(data);
+        pf->len = read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+        return 0;
+    }
+
+    data[len] = 0;
+    if (pf->decode) {
+        pf->decoded = pf->decode(data, len, &size);
+    }
+
+    pf->data = data;
+    pf->len = len;
+    return len + 1 + size;
+}
+
+// replaces the estimate counted when the read was dispatched
+static void done_prefetch(prefetch_t *pf, size_t size)
+{
+    fs_prefetch_bytes += size - pf->size;
+    pf->size = size;
+    pf->state = PF_DONE;
+    fs_prefetch_finished++;
+    fs_prefetch_done.notify_all();
+}
+
+// never waits, reads are only handed out while under budget
+static void prefetch_job(void *arg)
+{
+    std::unique_lock<std::mutex> lock(fs_prefetch_lock);
+    prefetch_t *pf;
+    size_t size;
+
+    // the main thread may have taken it already
+    LIST_FOR_EACH(prefetch_t, pf, &fs_prefetch_queue, queue) {
+        if (pf->dispatched) {
+            break;
+        }
+    }
+    if (LIST_TERM(pf, &fs_prefetch_queue, queue)) {
+        return;
+    }
+
+    List_Remove(&pf->queue);
+    pf->state = PF_RUNNING;
+    lock.unlock();
+
+    size = read_prefetch(pf);
+
+    lock.lock();
+    done_prefetch(pf, size);
+}
+
+// hands the highest priority reads to the job threads, as long as not too
+// much is waiting to be picked up. main thread only.
+static void dispatch_prefetch(void)
+{
+    int priorities[PREFETCH_MAX_JOBS];
+    int i, numjobs = 0;
+    prefetch_t *pf;
+
+    {
+        std::lock_guard<std::mutex> lock(fs_prefetch_lock);
+
+        LIST_FOR_EACH(prefetch_t, pf, &fs_prefetch_queue, queue) {
+            if (numjobs == PREFETCH_MAX_JOBS || fs_prefetch_bytes >= PREFETCH_MAX_BYTES) {
+                break;
+            }
+            if (pf->dispatched) {
+                continue;
+            }
+            pf->dispatched = true;
+            pf->size = pf->file.length + 1;
+            fs_prefetch_bytes += pf->size;
+            priorities[numjobs++] = pf->priority;
+        }
+    }
+
+    for (i = 0; i < numjobs; i++) {
+        Job_Add(prefetch_job, NULL, priorities[i]);
+    }
+}
+
+// waits for the prefetch to finish, or reads it right away if no job got to it yet
+static void finish_prefetch(prefetch_t *pf, std::unique_lock<std::mutex> &lock)
+{
+    size_t size;
+
+    if (pf->state == PF_QUEUED) {
+        List_Remove(&pf->queue);
+        pf->state = PF_RUNNING;
+        lock.unlock();
+
+        size = read_prefetch(pf);
+
+        lock.lock();
+        done_prefetch(pf, size);
+        return;
+    }
+
+    fs_prefetch_done.wait(lock, [pf] { return pf->state == PF_DONE; });
+}
+
+static void free_prefetch(prefetch_t *pf)
+{
+    if (pf->file.unique && pf->file.pack) {
+        pack_put(pf->file.pack);
+    }
+    if (pf->decoded) {
+        pf->decodefree(pf->decoded);
+    }
+    Z_Free(pf->data);
+    Z_Free(pf);
+}
+
+static qboolean take_prefetch(const char *path, unsigned flags, memtag_t tag,
+                              void **buffer, void **decoded, ssize_t *len_p)
+{
+    char normalized[MAX_OSPATH];
+    unsigned mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+    prefetch_t *pf;
+
+    if (!fs_prefetch_total) {
+        return false;
+    }
+
+    if (FS_NormalizePathBuffer(normalized, path, MAX_OSPATH) >= MAX_OSPATH) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(fs_prefetch_lock);
+
+    pf = find_prefetch(normalized, mode);
+    if (!pf) {
+        return false;
+    }
+
+    finish_prefetch(pf, lock);
+
+    List_Remove(&pf->hash);
+    fs_prefetch_bytes -= pf->size;
+    lock.unlock();
+
+    dispatch_prefetch();
+
+    *len_p = pf->len;
+    if (pf->data && tag != TAG_FILESYSTEM) {
+        *buffer = memcpy(Z_TagMalloc(pf->len + 1, tag), pf->data, pf->len + 1);
+    } else {
+        *buffer = pf->data;
+        pf->data = NULL;
+    }
+
+    if (decoded) {
+        *decoded = pf->decoded;
+        pf->decoded = NULL;
+    }
+
+    free_prefetch(pf);
+    return true;
+}
+
+/*
+============
+FS_PrefetchFile
+
+Queues the file to be read by a job thread, higher priority first.
+Returns false if the file doesn't exist.
+============
+*/
+qboolean FS_PrefetchFile(const char *path, unsigned flags, int priority,
+                         fs_decode_t decode, fs_decodefree_t decodefree)
+{
+    char normalized[MAX_OSPATH];
+    unsigned mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+    file_t file;
+    prefetch_t *pf;
+    ssize_t len;
+    size_t namelen;
+
+    if (!fs_searchpaths) {
+        return false;
+    }
+
+    namelen = FS_NormalizePathBuffer(normalized, path, MAX_OSPATH);
+    if (namelen >= MAX_OSPATH) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fs_prefetch_lock);
+        if (find_prefetch(normalized, mode)) {
+            return true;
+        }
+    }
+
+    memset(&file, 0, sizeof(file));
+    file.mode = mode;
+
+    len = expand_open_file_read(&file, path, true);
+    if (len < 0) {
+        return len != Q_ERR_NOENT;
+    }
+
+    // let FS_LoadFile handle these the usual way
+    if (!fs_prefetch->integer || !Job_NumThreads() || len > MAX_LOADFILE ||
+        (file.type != FS_REAL && file.type != FS_PAK && file.type != FS_ZIP)) {
+        close_prefetch_file(&file);
+        if (file.pack) {
+            pack_put(file.pack);
+        }
+        return true;
+    }
+
+    pf = (prefetch_t *)FS_Mallocz(sizeof(*pf) + namelen);
+    memcpy(pf->path, normalized, namelen + 1);
+    pf->state = PF_QUEUED;
+    pf->mode = mode;
+    pf->priority = priority;
+    pf->file = file;
+    pf->decode = decode;
+    pf->decodefree = decodefree;
+
+    {
+        std::lock_guard<std::mutex> lock(fs_prefetch_lock);
+        list_t *cursor;
+
+        List_Append(&fs_prefetch_hash[FS_HashPath(normalized, PREFETCH_HASH_SIZE)], &pf->hash);
+
+        for (cursor = fs_prefetch_queue.prev; cursor != &fs_prefetch_queue; cursor = cursor->prev) {
+            if (LIST_ENTRY(prefetch_t, cursor, queue)->priority >= priority) {
+                break;
+            }
+        }
+        List_Insert(cursor, &pf->queue);
+
+        fs_prefetch_total++;
+    }
+
+    dispatch_prefetch();
+    return true;
+}
+
+/*
+============
+FS_LoadPrefetched
+
+Same as FS_LoadFileFlags, also returns the result of the decode callback
+if the file was prefetched with one.
+============
+*/
+ssize_t FS_LoadPrefetched(const char *path, void **buffer, unsigned flags, void **decoded)
+{
+    ssize_t len;
+
+    *decoded = NULL;
+
+    if (fs_searchpaths && take_prefetch(path, flags, TAG_FILESYSTEM, buffer, decoded, &len)) {
+        return len;
+    }
+
+    return FS_LoadFileEx(path, buffer, flags, TAG_FILESYSTEM);
+}
+
+/*
+============
+FS_FlushPrefetch
+
+Drops everything that wasn't picked up.
+============
+*/
+void FS_FlushPrefetch(void)
+{
+    prefetch_t *pf, *next;
+    int i;
+
+    if (!fs_prefetch_total) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(fs_prefetch_lock);
+
+    LIST_FOR_EACH_SAFE(prefetch_t, pf, next, &fs_prefetch_queue, queue) {
+        close_prefetch_file(&pf->file);
+        pf->state = PF_DONE;
+    }
+    List_Init(&fs_prefetch_queue);
+
+    for (i = 0; i < PREFETCH_HASH_SIZE; i++) {
+        LIST_FOR_EACH_SAFE(prefetch_t, pf, next, &fs_prefetch_hash[i], hash) {
+            fs_prefetch_done.wait(lock, [pf] { return pf->state == PF_DONE; });
+            free_prefetch(pf);
+        }
+        List_Init(&fs_prefetch_hash[i]);
+    }
+
+    fs_prefetch_total = fs_prefetch_finished = 0;
+    fs_prefetch_bytes = 0;
+    fs_prefetch_done.notify_all();
+}
+
+/*
+============
+FS_PrefetchProgress
+============
+*/
+void FS_PrefetchProgress(int *finished, int *total)
+{
+    std::lock_guard<std::mutex> lock(fs_prefetch_lock);
+
+    *finished = fs_prefetch_finished;
+    *total = fs_prefetch_total;
+}
+
 /*
 ============
 FS_LoadFile
@@ -1929,6 +2355,11 @@ ssize_t FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t
         return Q_ERR_AGAIN; // not yet initialized
     }
 
+    // see if it was read in the background
+    if (buffer && take_prefetch(path, flags, tag, buffer, NULL, &len)) {
+        return len;
+    }
+
     // allocate new file handle
     file = alloc_handle(&f);
     if (!file) {
@@ -3606,6 +4037,8 @@ void FS_Restart(qboolean total)
 {
     Com_Printf("----- FS_Restart -----\n");
 
+    FS_FlushPrefetch();
+
     if (total) {
         // perform full reset
         free_all_paths();
@@ -3669,6 +4102,8 @@ void FS_Shutdown(void)
         return;
     }
 
+    FS_FlushPrefetch();
+
     // close file handles
     for (i = 0, file = fs_files; i < MAX_FILE_HANDLES; i++, file++) {
         if (file->type != FS_FREE) {
@@ -3776,6 +4211,11 @@ void FS_Init(void)
 #endif
 
 	fs_shareware = Cvar_Get("fs_shareware", "0", CVAR_ROM);
+    fs_prefetch = Cvar_Get("fs_prefetch", "1", 0);
+
+    for (int i = 0; i < PREFETCH_HASH_SIZE; i++) {
+        List_Init(&fs_prefetch_hash[i]);
+    }
 
     // get the game cvar and start the filesystem
     fs_game = Cvar_Get("game", DEFGAME, CVAR_LATCH | CVAR_SERVERINFO);
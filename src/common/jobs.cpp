@@ -0,0 +1,268 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// jobs.cpp -- worker threads for background jobs
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "shared/shared.h"
+#include "shared/list.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/jobs.h"
+#include "common/profile.h"
+#include "common/zone.h"
+
+#define MAX_JOB_THREADS     8
+
+typedef struct {
+    list_t      entry;
+    jobfunc_t   func;
+    void        *arg;
+    int         priority;
+} job_t;
+
+static cvar_t   *com_jobthreads;
+
+static std::thread              job_threads[MAX_JOB_THREADS];
+static int                      job_numthreads;
+static std::mutex               job_lock;
+static std::condition_variable  job_wake;
+static LIST_DECL(job_queue);
+static qboolean                 job_quit;
+
+static void Job_Thread(void)
+{
+    std::unique_lock<std::mutex> lock(job_lock);
+
+    while (1) {
+        while (!job_quit && LIST_EMPTY(&job_queue)) {
+            job_wake.wait(lock);
+        }
+
+        if (job_quit) {
+            break;
+        }
+
+        job_t *job = LIST_FIRST(job_t, &job_queue, entry);
+        List_Remove(&job->entry);
+        lock.unlock();
+
+        {
+            PROF_ZONE("Job");
+            job->func(job->arg);
+        }
+        Z_Free(job);
+
+        lock.lock();
+    }
+}
+
+/*
+============
+Job_Add
+
+Queues a job for the worker threads, keeping the queue sorted by priority.
+============
+*/
+void Job_Add(jobfunc_t func, void *arg, int priority)
+{
+    if (!job_numthreads) {
+        func(arg);
+        return;
+    }
+
+    job_t *job = (job_t *)Z_Malloc(sizeof(*job));
+    job->func = func;
+    job->arg = arg;
+    job->priority = priority;
+
+    std::lock_guard<std::mutex> lock(job_lock);
+    list_t *cursor;
+
+    // insert after the last job with the same or higher priority
+    for (cursor = job_queue.prev; cursor != &job_queue; cursor = cursor->prev) {
+        if (LIST_ENTRY(job_t, cursor, entry)->priority >= priority) {
+            break;
+        }
+    }
+
+    List_Insert(cursor, &job->entry);
+    job_wake.notify_one();
+}
+
+/*
+============
+Job_ParallelFor
+
+Helper jobs and the caller take indices from a shared counter. The caller
+only waits for the indices to finish, helpers that start late find
+nothing left to do and drop their reference to the context.
+============
+*/
+typedef struct {
+    jobrangefunc_t          func;
+    void                    *arg;
+    int                     count;
+    std::atomic<int>        next;
+    std::atomic<int>        refcount;
+    int                     finished;
+    std::mutex              lock;
+    std::condition_variable done;
+} jobrange_t;
+
+static void run_range(jobrange_t *range)
+{
+    int index, ran = 0;
+
+    while ((index = range->next.fetch_add(1)) < range->count) {
+        range->func(range->arg, index);
+        ran++;
+    }
+
+    if (ran) {
+        std::lock_guard<std::mutex> lock(range->lock);
+        range->finished += ran;
+        if (range->finished == range->count) {
+            range->done.notify_all();
+        }
+    }
+}
+
+static void release_range(jobrange_t *range)
+{
+    if (range->refcount.fetch_sub(1) == 1) {
+        range->~jobrange_t();
+        Z_Free(range);
+    }
+}
+
+static void range_job(void *arg)
+{
+    jobrange_t *range = (jobrange_t *)arg;
+
+    run_range(range);
+    release_range(range);
+}
+
+void Job_ParallelFor(jobrangefunc_t func, void *arg, int count, int priority)
+{
+    int i, helpers;
+
+    if (count <= 0) {
+        return;
+    }
+
+    helpers = min(job_numthreads, count - 1);
+    if (!helpers) {
+        for (i = 0; i < count; i++) {
+            func(arg, i);
+        }
+        return;
+    }
+
+    jobrange_t *range = new (Z_Malloc(sizeof(*range))) jobrange_t;
+    range->func = func;
+    range->arg = arg;
+    range->count = count;
+    range->next = 0;
+    range->refcount = helpers + 1;
+    range->finished = 0;
+
+    for (i = 0; i < helpers; i++) {
+        Job_Add(range_job, range, priority);
+    }
+
+    run_range(range);
+
+    {
+        std::unique_lock<std::mutex> lock(range->lock);
+        range->done.wait(lock, [range] { return range->finished == range->count; });
+    }
+
+    release_range(range);
+}
+
+int Job_NumThreads(void)
+{
+    return job_numthreads;
+}
+
+/*
+============
+Job_Init
+============
+*/
+void Job_Init(void)
+{
+    int count;
+
+    com_jobthreads = Cvar_Get("com_jobthreads", "-1", CVAR_NOSET);
+
+    count = com_jobthreads->integer;
+    if (count < 0) {
+        // leave a core for the main thread
+        count = (int)std::thread::hardware_concurrency() - 1;
+    }
+    clamp(count, 0, MAX_JOB_THREADS);
+
+    job_quit = false;
+    for (job_numthreads = 0; job_numthreads < count; job_numthreads++) {
+        job_threads[job_numthreads] = std::thread(Job_Thread);
+    }
+
+    Com_DPrintf("%s: %d worker threads\n", __func__, job_numthreads);
+}
+
+/*
+============
+Job_Shutdown
+
+Jobs that haven't started yet are dropped.
+============
+*/
+void Job_Shutdown(void)
+{
+    job_t *job, *next;
+
+    if (!job_numthreads) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job_lock);
+        job_quit = true;
+        job_wake.notify_all();
+    }
+
+    for (int i = 0; i < job_numthreads; i++) {
+        job_threads[i].join();
+    }
+    job_numthreads = 0;
+
+    LIST_FOR_EACH_SAFE(job_t, job, next, &job_queue, entry) {
+        Z_Free(job);
+    }
+    List_Init(&job_queue);
+}
@@ -39,7 +39,7 @@ Handles byte ordering and avoids alignment errors
 SizeBuffer   msg_write;
 byte        msg_write_buffer[MAX_MSGLEN];
 
-SizeBuffer   msg_read;
+thread_local SizeBuffer  msg_read;
 byte        msg_read_buffer[MAX_MSGLEN];
 
 const PackedEntity   nullEntityState = {};
@@ -213,8 +213,6 @@ void MSG_WriteVector3(const vec3_t& pos)
     MSG_WriteFloat(pos[2]);
 }
 
-#if USE_CLIENT
-
 //
 //===============
 // MSG_WriteDeltaClientMoveCommand
@@ -280,8 +278,6 @@ int MSG_WriteDeltaClientMoveCommand(const ClientMoveCommand* from, const ClientM
     return bits;
 }
 
-#endif // USE_CLIENT
-
 void MSG_PackEntity(PackedEntity* out, const EntityState* in)
 {
     // allow 0 to accomodate empty entityBaselines
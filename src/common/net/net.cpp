@@ -44,6 +44,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <sys/param.h>
@@ -544,6 +545,20 @@ static size_t NET_DnRate_m(char *buffer, size_t size)
 
 //=============================================================================
 
+// copies the slices one after another, returns total length
+static size_t NET_GatherPacket(byte *out, const netbuf_t *bufs, int count)
+{
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        memcpy(out + len, bufs[i].data, bufs[i].len);
+        len += bufs[i].len;
+    }
+
+    return len;
+}
+
 #if USE_CLIENT
 
 static void NET_GetLoopPackets(NetSource sock, void (*packet_cb)(void))
@@ -579,8 +594,8 @@ static void NET_GetLoopPackets(NetSource sock, void (*packet_cb)(void))
     }
 }
 
-static qboolean NET_SendLoopPacket(NetSource sock, const void *data,
-                                   size_t len, const netadr_t *to)
+static qboolean NET_SendLoopPacket(NetSource sock, const netbuf_t *bufs,
+                                   int count, size_t len, const netadr_t *to)
 {
     loopback_t *loop;
     loopmsg_t *msg;
@@ -594,12 +609,12 @@ static qboolean NET_SendLoopPacket(NetSource sock, const void *data,
     msg = &loop->msgs[loop->send & (MAX_LOOPBACK - 1)];
     loop->send++;
 
-    memcpy(msg->data, data, len);
+    NET_GatherPacket(msg->data, bufs, count);
     msg->datalen = len;
 
 #ifdef _DEBUG
     if (net_log_enable->integer > 1) {
-        NET_LogPacket(to, "LP send", (const byte*)data, len); // CPP: Cast
+        NET_LogPacket(to, "LP send", msg->data, len);
     }
 #endif
     if (sock == NS_CLIENT) {
@@ -842,15 +857,24 @@ void NET_GetPackets(NetSource sock, void (*packet_cb)(void))
 
 /*
 =============
-NET_SendPacket
+NET_SendPacketv
 
+Sends a datagram made of several slices without assembling it first.
 =============
 */
-qboolean NET_SendPacket(NetSource sock, const void *data,
-                        size_t len, const netadr_t *to)
+qboolean NET_SendPacketv(NetSource sock, const netbuf_t *bufs,
+                         int count, const netadr_t *to)
 {
     ssize_t ret;
     qsocket_t s;
+    size_t len;
+    int i;
+
+    if (count > NET_MAX_BUFS)
+        Com_Error(ERR_FATAL, "%s: too many buffers", __func__);
+
+    for (i = 0, len = 0; i < count; i++)
+        len += bufs[i].len;
 
     if (len == 0)
         return false;
@@ -866,7 +890,7 @@ qboolean NET_SendPacket(NetSource sock, const void *data,
         return false;
 #if USE_CLIENT
     case NA_LOOPBACK:
-        return NET_SendLoopPacket(sock, data, len, to);
+        return NET_SendLoopPacket(sock, bufs, count, len, to);
 #endif
     case NA_IP:
     case NA_BROADCAST:
@@ -882,7 +906,7 @@ qboolean NET_SendPacket(NetSource sock, const void *data,
     if (s == -1)
         return false;
 
-    ret = os_udp_send(s, data, len, to);
+    ret = os_udp_sendv(s, bufs, count, to);
     if (ret == NET_AGAIN)
         return false;
 
@@ -898,8 +922,12 @@ qboolean NET_SendPacket(NetSource sock, const void *data,
                     NET_AdrToString(to));
 
 #ifdef _DEBUG
-    if (net_log_enable->integer)
-        NET_LogPacket(to, "UDP send", (const byte*)data, ret); // CPP: Cast
+    if (net_log_enable->integer) {
+        byte buf[MAX_PACKETLEN];
+
+        NET_GatherPacket(buf, bufs, count);
+        NET_LogPacket(to, "UDP send", buf, ret);
+    }
 #endif
 
     net_rate_sent += ret;
@@ -909,6 +937,23 @@ qboolean NET_SendPacket(NetSource sock, const void *data,
     return true;
 }
 
+/*
+=============
+NET_SendPacket
+
+=============
+*/
+qboolean NET_SendPacket(NetSource sock, const void *data,
+                        size_t len, const netadr_t *to)
+{
+    netbuf_t buf;
+
+    buf.data = data;
+    buf.len = len;
+
+    return NET_SendPacketv(sock, &buf, 1, to);
+}
+
 //=============================================================================
 
 static qsocket_t UDP_OpenSocket(const char *iface, int port, int family)
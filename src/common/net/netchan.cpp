@@ -17,11 +17,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "shared/shared.h"
+#include "common/cmd.h"
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/msg.h"
 #include "common/net/netchan.h"
 #include "common/net/net.h"
+#include "common/profile.h"
 #include "common/protocol.h"
 #include "common/sizebuffer.h"
 #include "common/zone.h"
@@ -106,6 +108,138 @@ static void net_maxmsglen_changed(cvar_t *self)
     }
 }
 
+#if USE_CLIENT
+
+#define BENCH_RELIABLE  64
+
+static NetChannel   *bench_chan;
+static size_t       bench_bytes;
+static const byte   *bench_check;   // compare delivered messages against this
+static qboolean     bench_damaged;
+
+static void Netchan_BenchPacket(void)
+{
+    const byte *data;
+    size_t length;
+
+    if (net_from.type != NA_LOOPBACK || !Netchan_Process(bench_chan)) {
+        return;
+    }
+
+    data = msg_read.data + msg_read.readCount;
+    length = msg_read.currentSize - msg_read.readCount;
+    bench_bytes += length;
+
+    if (bench_check && bench_chan->netSource == NS_SERVER) {
+        if (length < BENCH_RELIABLE || memcmp(data, bench_check, BENCH_RELIABLE) ||
+            memcmp(data + BENCH_RELIABLE, bench_check, length - BENCH_RELIABLE)) {
+            bench_damaged = true;
+        }
+    }
+}
+
+static void Netchan_BenchDrain(NetSource sock, NetChannel *chan)
+{
+    bench_chan = chan;
+    NET_GetPackets(sock, Netchan_BenchPacket);
+}
+
+// one message carrying reliable and unreliable data, acknowledged right away
+static void Netchan_BenchMessage(NetChannel *send, NetChannel *recv,
+                                 const byte *payload, size_t size)
+{
+    SZ_Write(&send->message, payload, BENCH_RELIABLE);
+
+    Netchan_Transmit(send, size, payload, 1);
+    Netchan_BenchDrain(NS_SERVER, recv);
+
+    while (send->fragmentPending) {
+        Netchan_TransmitNextFragment(send);
+        Netchan_BenchDrain(NS_SERVER, recv);
+    }
+
+    Netchan_Transmit(recv, 0, NULL, 1);
+    Netchan_BenchDrain(NS_CLIENT, send);
+}
+
+/*
+===============
+Netchan_Bench_f
+
+Pushes messages through a client and server channel pair over the
+loopback and reports the time spent per delivered byte.
+================
+*/
+static void Netchan_Bench_f(void)
+{
+    NetChannel  *send, *recv;
+    netadr_t    adr;
+    byte        *payload;
+    size_t      i, size, expected;
+    int         count;
+    uint64_t    start;
+    double      ns;
+
+    if (sv_running->integer) {
+        Com_Printf("Can't benchmark the netchan while a server is running.\n");
+        return;
+    }
+
+    size = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 1024;
+    count = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 10000;
+    clamp(size, 1, MAX_MSGLEN - BENCH_RELIABLE);
+    clamp(count, 1, 10000000);
+
+    payload = (byte*)Z_Malloc(size); // CPP: Cast
+    for (i = 0; i < size; i++) {
+        payload[i] = rand();
+    }
+
+    memset(&adr, 0, sizeof(adr));
+    adr.type = NA_LOOPBACK;
+
+    send = Netchan_Setup(NS_CLIENT, &adr, 1, MAX_PACKETLEN_WRITABLE_DEFAULT, PROTOCOL_VERSION_DEFAULT);
+    recv = Netchan_Setup(NS_SERVER, &adr, 1, MAX_PACKETLEN_WRITABLE_DEFAULT, PROTOCOL_VERSION_DEFAULT);
+
+    // check the message survives the trip before timing anything
+    bench_bytes = 0;
+    bench_check = payload;
+    bench_damaged = false;
+    Netchan_BenchMessage(send, recv, payload, size);
+    bench_check = NULL;
+
+    expected = BENCH_RELIABLE + size;
+    if (bench_bytes != expected || bench_damaged) {
+        Com_EPrintf("Message of %" PRIz " bytes arrived damaged\n", expected);
+        goto finish;
+    }
+
+    bench_bytes = 0;
+    start = Prof_Nanoseconds();
+
+    for (i = 0; i < count; i++) {
+        Netchan_BenchMessage(send, recv, payload, size);
+    }
+
+    ns = Prof_Nanoseconds() - start;
+
+    if (bench_bytes != expected * count) {
+        Com_WPrintf("Delivered %" PRIz " of %" PRIz " bytes\n", bench_bytes, expected * count);
+    }
+
+    Com_Printf("%d messages of %" PRIz " bytes in %.3f ms\n",
+               count, expected, ns * 1e-6);
+    Com_Printf("%.3f ns per byte, %.1f MB/s\n",
+               ns / max(bench_bytes, (size_t)1), bench_bytes * 1e3 / max(ns, 1.0));
+
+finish:
+    Netchan_Close(send);
+    Netchan_Close(recv);
+    Z_Free(payload);
+}
+
+#endif // USE_CLIENT
+
 /*
 ===============
 Netchan_Init
@@ -127,6 +261,10 @@ void Netchan_Init(void)
     net_maxmsglen = Cvar_Get("net_maxmsglen", va("%d", MAX_PACKETLEN_WRITABLE_DEFAULT), 0);
     net_maxmsglen->changed = net_maxmsglen_changed;
     net_chantype = Cvar_Get("net_chantype", "1", 0);
+
+#if USE_CLIENT
+    Cmd_AddCommand("netchan_bench", Netchan_Bench_f);
+#endif
 }
 
 /*
@@ -164,19 +302,28 @@ void Netchan_OutOfBand(NetSource sock, const netadr_t *address,
 
 // ============================================================================
 
+// sequence, acknowledge, qport and fragment offset
+#define NETCHAN_HEADER_SIZE 11
+
 /*
 ===============
 Netchan_TransmitNextFragment
+
+The fragment is gathered straight from the reliable and unreliable parts
+of the message, only the packet header is written here.
 ================
 */
 size_t Netchan_TransmitNextFragment(NetChannel *netchan)
 {
     SizeBuffer   send;
-    byte        send_buf[MAX_PACKETLEN];
+    byte        send_buf[NETCHAN_HEADER_SIZE];
+    netbuf_t    bufs[3];
+    int         count;
     qboolean    send_reliable;
     uint32_t    w1, w2;
     uint16_t    offset;
-    size_t      fragment_length;
+    size_t      fragment_start, fragment_end, fragment_length;
+    size_t      total_length, reliable_length, length;
     qboolean    more_fragments;
 
     // Should we send a reliable message, or not?
@@ -200,58 +347,77 @@ size_t Netchan_TransmitNextFragment(NetChannel *netchan)
     }
 #endif
 
-    // Calculate Fragment length based on how much has been read so far.
+    // Calculate Fragment length based on how much has been sent so far.
     // Ensure we do not exceed the max packet length.
-    fragment_length = netchan->outFragment.currentSize - netchan->outFragment.readCount;
+    reliable_length = netchan->fragmentReliableLength;
+    total_length = reliable_length + netchan->outFragment.currentSize;
+    fragment_start = netchan->fragmentOffset;
+    fragment_length = total_length - fragment_start;
     if (fragment_length > netchan->maximumPacketLength) {
         fragment_length = netchan->maximumPacketLength;
     }
+    fragment_end = fragment_start + fragment_length;
 
     // More 
-    more_fragments = true;
-    if (netchan->outFragment.readCount + fragment_length ==
-        netchan->outFragment.currentSize) {
-        more_fragments = false;
-    }
+    more_fragments = fragment_end < total_length ? true : false;
 
     // Write fragment offset
-    offset = (netchan->outFragment.readCount & 0x7FFF) |
-             (more_fragments << 15);
+    offset = (fragment_start & 0x7FFF) | (more_fragments << 15);
     SZ_WriteShort(&send, offset);
 
-    // Write fragment contents
-    SZ_Write(&send, netchan->outFragment.data + netchan->outFragment.readCount,
-             fragment_length);
+    // Gather fragment contents, it may straddle both parts
+    bufs[0].data = send.data;
+    bufs[0].len = send.currentSize;
+    count = 1;
+
+    if (fragment_start < reliable_length) {
+        length = min(fragment_end, reliable_length) - fragment_start;
+        bufs[count].data = netchan->reliableData + fragment_start;
+        bufs[count].len = length;
+        count++;
+    }
+
+    if (fragment_end > reliable_length) {
+        length = max(fragment_start, reliable_length) - reliable_length;
+        bufs[count].data = netchan->outFragment.data + length;
+        bufs[count].len = fragment_end - reliable_length - length;
+        count++;
+    }
 
     SHOWPACKET("send %4" PRIz " : s=%d ack=%d rack=%d "
                "fragment_offset=%" PRIz " more_fragments=%d",
-               send.currentSize,
+               send.currentSize + fragment_length,
                netchan->outgoingSequence,
                netchan->incomingSequence,
                netchan->incomingReliableSequence,
-               netchan->outFragment.readCount,
+               fragment_start,
                more_fragments);
     if (send_reliable) {
         SHOWPACKET(" reliable=%i ", netchan->reliableSequence);
     }
     SHOWPACKET("\n");
 
-    // Increment read count with fragment length and store whether one more is pending or not.
-    netchan->outFragment.readCount += fragment_length;
+    // Send the datagram before the fragment buffer may be cleared
+    NET_SendPacketv(netchan->netSource, bufs, count,
+                    &netchan->remoteNetAddress);
+
+    // Advance offset with fragment length and store whether one more is pending or not.
+    netchan->fragmentOffset = fragment_end;
     netchan->fragmentPending = more_fragments;
 
     // If the message has been sent completely, clear the fragment buffer
     if (!netchan->fragmentPending) {
         netchan->outgoingSequence++;
         netchan->lastSentTime = com_localTime;
+        netchan->fragmentReliableLength = 0;
+        netchan->fragmentOffset = 0;
         SZ_Clear(&netchan->outFragment);
     }
 
-    // Send the datagram
-    NET_SendPacket(netchan->netSource, send.data, send.currentSize,
-                   &netchan->remoteNetAddress);
+    length = send.currentSize + fragment_length;
+    netchan->totalBytesSent += length;
 
-    return send.currentSize;
+    return length;
 }
 
 /*
@@ -262,9 +428,13 @@ Netchan_Transmit
 size_t Netchan_Transmit(NetChannel *netchan, size_t length, const void *data, int numpackets)
 {
     SizeBuffer   send;
-    byte        send_buf[MAX_PACKETLEN];
+    byte        send_buf[NETCHAN_HEADER_SIZE];
+    netbuf_t    bufs[3];
+    int         count;
+    byte        *swap;
     qboolean    send_reliable;
     uint32_t    w1, w2;
+    size_t      total;
     int         i;
 
 // check for message overflow
@@ -287,25 +457,29 @@ size_t Netchan_Transmit(NetChannel *netchan, size_t length, const void *data, in
         send_reliable = true;
     }
 
-// if the reliable transmit buffer is empty, copy the current message out
+// if the reliable transmit buffer is empty, swap the current message in,
+// further writes go to the buffer that held the previous reliable
     if (!netchan->reliableLength && netchan->message.currentSize) {
         send_reliable = true;
-        memcpy(netchan->reliableBuffer, netchan->messageBuffer,
-               netchan->message.currentSize);
+        swap = netchan->reliableData;
+        netchan->reliableData = netchan->message.data;
         netchan->reliableLength = netchan->message.currentSize;
+        netchan->message.data = swap;
         netchan->message.currentSize = 0;
         netchan->reliableSequence ^= 1;
     }
 
     if (length > netchan->maximumPacketLength || (send_reliable &&
                                            (netchan->reliableLength + length > netchan->maximumPacketLength))) {
+        netchan->fragmentReliableLength = 0;
+        netchan->fragmentOffset = 0;
         if (send_reliable) {
             netchan->lastReliableSequence = netchan->outgoingSequence;
-            SZ_Write(&netchan->outFragment, netchan->reliableBuffer,
-                     netchan->reliableLength);
+            netchan->fragmentReliableLength = netchan->reliableLength;
         }
-        // add the unreliable part if space is available
-        if (netchan->outFragment.maximumSize - netchan->outFragment.currentSize >= length)
+        // add the unreliable part if space is available, it is the only
+        // part that needs a copy since the caller's buffer is transient
+        if (netchan->outFragment.maximumSize - netchan->fragmentReliableLength >= length)
             SZ_Write(&netchan->outFragment, data, length);
         else
             Com_WPrintf("%s: dumped unreliable\n",
@@ -330,17 +504,31 @@ size_t Netchan_Transmit(NetChannel *netchan, size_t length, const void *data, in
     }
 #endif
 
-    // copy the reliable message to the packet first
+    bufs[0].data = send.data;
+    bufs[0].len = send.currentSize;
+    count = 1;
+
+    // the reliable message goes first
     if (send_reliable) {
         netchan->lastReliableSequence = netchan->outgoingSequence;
-        SZ_Write(&send, netchan->reliableBuffer, netchan->reliableLength);
+        bufs[count].data = netchan->reliableData;
+        bufs[count].len = netchan->reliableLength;
+        count++;
     }
 
     // add the unreliable part
-    SZ_Write(&send, data, length);
+    if (length) {
+        bufs[count].data = data;
+        bufs[count].len = length;
+        count++;
+    }
+
+    for (i = 0, total = 0; i < count; i++) {
+        total += bufs[i].len;
+    }
 
     SHOWPACKET("send %4" PRIz " : s=%d ack=%d rack=%d",
-               send.currentSize,
+               total,
                netchan->outgoingSequence,
                netchan->incomingSequence,
         netchan->incomingReliableSequence);
@@ -351,15 +539,16 @@ size_t Netchan_Transmit(NetChannel *netchan, size_t length, const void *data, in
 
     // send the datagram
     for (i = 0; i < numpackets; i++) {
-        NET_SendPacket(netchan->netSource, send.data, send.currentSize,
-                       &netchan->remoteNetAddress);
+        NET_SendPacketv(netchan->netSource, bufs, count,
+                        &netchan->remoteNetAddress);
     }
 
     netchan->outgoingSequence++;
     netchan->reliableAckPending = false;
     netchan->lastSentTime = com_localTime;
+    netchan->totalBytesSent += total * numpackets;
 
-    return send.currentSize * numpackets;
+    return total * numpackets;
 }
 
 /*
@@ -478,10 +667,11 @@ qboolean Netchan_Process(NetChannel *netchan)
             return false;
         }
 
-        // message has been sucessfully assembled
-        SZ_Clear(&msg_read);
-        SZ_Write(&msg_read, netchan->inFragment.data,
-            netchan->inFragment.currentSize);
+        // message has been sucessfully assembled, read it in place. the
+        // buffer is not touched again until the next packet is processed.
+        SZ_Init(&msg_read, netchan->inFragment.data,
+                netchan->inFragment.maximumSize);
+        msg_read.currentSize = netchan->inFragment.currentSize;
         SZ_Clear(&netchan->inFragment);
     }
 
@@ -514,11 +704,9 @@ Netchan_ShouldUpdate
 */
 qboolean Netchan_ShouldUpdate(NetChannel *netchan)
 {
-    NetChannel *chan = (NetChannel *)netchan;
-
     if (netchan->message.currentSize ||
         netchan->reliableAckPending ||
-        chan->outFragment.currentSize ||
+        netchan->fragmentPending ||
         com_localTime - netchan->lastSentTime > 1000) {
         return true;
     }
@@ -550,6 +738,7 @@ NetChannel *Netchan_Setup(NetSource sock, const netadr_t *adr, int qport, size_t
 
     SZ_Init(&netchan->message, netchan->messageBuffer,
         sizeof(netchan->messageBuffer));
+    netchan->reliableData = netchan->reliableBuffer;
     SZ_TagInit(&netchan->inFragment, netchan->inFragmentBuffer,
         sizeof(netchan->inFragmentBuffer), SZ_NC_FRG_IN);
     SZ_TagInit(&netchan->outFragment, netchan->outFragmentBuffer,
@@ -134,19 +134,28 @@ static ssize_t os_udp_recv(qsocket_t sock, void *data,
     return NET_ERROR;
 }
 
-static ssize_t os_udp_send(qsocket_t sock, const void *data,
-                           size_t len, const netadr_t *to)
+static ssize_t os_udp_sendv(qsocket_t sock, const netbuf_t *bufs,
+                            int count, const netadr_t *to)
 {
     struct sockaddr_storage addr;
-    socklen_t addrlen;
+    struct iovec iov[NET_MAX_BUFS];
+    struct msghdr msg;
     ssize_t ret;
-    int tries;
+    int i, tries;
 
-    addrlen = NET_NetadrToSockadr(to, &addr);
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = (void *)bufs[i].data;
+        iov[i].iov_len = bufs[i].len;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = NET_NetadrToSockadr(to, &addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
 
     for (tries = 0; tries < MAX_ERROR_RETRIES; tries++) {
-        ret = sendto(sock, data, len, 0,
-                     (struct sockaddr *)&addr, addrlen);
+        ret = sendmsg(sock, &msg, 0);
         if (ret >= 0)
             return ret;
 
@@ -142,20 +142,27 @@ static ssize_t os_udp_recv(qsocket_t sock, void *data,
     return NET_ERROR;
 }
 
-static ssize_t os_udp_send(qsocket_t sock, const void *data,
-                           size_t len, const netadr_t *to)
+static ssize_t os_udp_sendv(qsocket_t sock, const netbuf_t *bufs,
+                            int count, const netadr_t *to)
 {
     struct sockaddr_storage addr;
+    WSABUF wsabufs[NET_MAX_BUFS];
+    DWORD sent;
     int addrlen;
-    int ret;
+    int i, ret;
+
+    for (i = 0; i < count; i++) {
+        wsabufs[i].buf = (CHAR *)bufs[i].data; // CPP: Cast
+        wsabufs[i].len = bufs[i].len;
+    }
 
     addrlen = NET_NetadrToSockadr(to, &addr);
 
-    ret = sendto(sock, (const char*)data, len, 0, // CPP: Cast
-                 (struct sockaddr *)&addr, addrlen);
+    ret = WSASendTo(sock, wsabufs, count, &sent, 0,
+                    (struct sockaddr *)&addr, addrlen, NULL, NULL);
 
     if (ret != SOCKET_ERROR)
-        return ret;
+        return sent;
 
     net_error = WSAGetLastError();
 
@@ -0,0 +1,355 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// profile.cpp -- scoped zone profiler
+//
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+
+#include "shared/shared.h"
+#include "common/cmd.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/files.h"
+#include "common/profile.h"
+#include "common/zone.h"
+
+uint64_t Prof_Nanoseconds(void)
+{
+    auto d = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+float Prof_Percentile(const uint64_t *times, int count, int p)
+{
+    return times[min(count * p / 100, count - 1)] * 1e-6f;
+}
+
+#if USE_PROFILER
+
+#define PROF_RING_SIZE      65536   // events per thread, must be power of 2
+#define PROF_MAX_DEPTH      64
+#define PROF_MAX_THREADS    32
+#define PROF_MAX_ZONES      128
+
+typedef struct {
+    const char  *name;
+    uint64_t    start;      // nanoseconds
+    uint64_t    end;
+} profevent_t;
+
+// written by the owning thread only, read by the main thread. readers may
+// see an event being overwritten if they fall behind a whole ring, which
+// is tolerable for statistics.
+typedef struct {
+    int                     id;
+    std::atomic<uint32_t>   head;   // number of events written
+    uint32_t                tail;   // number of events aggregated
+    profevent_t             events[PROF_RING_SIZE];
+} profthread_t;
+
+typedef struct {
+    const char  *name;
+    uint64_t    time;       // this window
+    uint64_t    calls;
+    uint64_t    frame_time; // this frame
+    uint64_t    max_time;   // worst frame of this window
+    profstat_t  stat;       // last window
+} profzone_t;
+
+static cvar_t   *com_profile;
+
+static std::atomic<bool>        prof_enabled;
+static std::mutex               prof_lock;
+static profthread_t             *prof_threads[PROF_MAX_THREADS];
+static std::atomic<int>         prof_numthreads;
+
+static profzone_t   prof_zones[PROF_MAX_ZONES];
+static int          prof_numzones;
+static unsigned     prof_window_start;
+static unsigned     prof_window_frames;
+static uint64_t     prof_base;
+
+// open zones of the current thread, start 0 means not recorded
+static thread_local uint64_t        prof_starts[PROF_MAX_DEPTH];
+static thread_local int             prof_depth;
+static thread_local profthread_t    *prof_thread;
+
+static inline uint64_t Prof_Now(void)
+{
+    // never returns 0
+    return Prof_Nanoseconds() - prof_base + 1;
+}
+
+static profthread_t *Prof_RegisterThread(void)
+{
+    std::lock_guard<std::mutex> lock(prof_lock);
+    int id = prof_numthreads.load();
+    profthread_t *t;
+
+    if (id == PROF_MAX_THREADS) {
+        return NULL;
+    }
+
+    t = new (Z_TagMallocz(sizeof(*t), TAG_GENERAL)) profthread_t;
+    t->id = id;
+    prof_threads[id] = t;
+    prof_numthreads.store(id + 1);
+
+    return t;
+}
+
+void Prof_BeginZone(const char *name)
+{
+    if (prof_depth < PROF_MAX_DEPTH) {
+        prof_starts[prof_depth] = prof_enabled.load(std::memory_order_relaxed) ? Prof_Now() : 0;
+    }
+    prof_depth++;
+}
+
+void Prof_EndZone(const char *name)
+{
+    profthread_t *t;
+    profevent_t *e;
+    uint64_t start;
+    uint32_t head;
+
+    if (prof_depth <= 0) {
+        return;
+    }
+
+    prof_depth--;
+    if (prof_depth >= PROF_MAX_DEPTH) {
+        return;
+    }
+
+    start = prof_starts[prof_depth];
+    if (!start) {
+        return;
+    }
+
+    t = prof_thread;
+    if (!t) {
+        t = prof_thread = Prof_RegisterThread();
+        if (!t) {
+            return;
+        }
+    }
+
+    head = t->head.load(std::memory_order_relaxed);
+    e = &t->events[head & (PROF_RING_SIZE - 1)];
+    e->name = name;
+    e->start = start;
+    e->end = Prof_Now();
+    t->head.store(head + 1, std::memory_order_release);
+}
+
+static profzone_t *Prof_FindZone(const char *name)
+{
+    profzone_t *z;
+    int i;
+
+    // same literal may have different addresses in different files
+    for (i = 0, z = prof_zones; i < prof_numzones; i++, z++) {
+        if (z->name == name || !strcmp(z->name, name)) {
+            return z;
+        }
+    }
+
+    if (prof_numzones == PROF_MAX_ZONES) {
+        return NULL;
+    }
+
+    z = &prof_zones[prof_numzones++];
+    z->name = name;
+    z->stat.name = name;
+    return z;
+}
+
+static void Prof_Aggregate(profthread_t *t)
+{
+    uint32_t head = t->head.load(std::memory_order_acquire);
+    profevent_t *e;
+    profzone_t *z;
+
+    if (head - t->tail > PROF_RING_SIZE) {
+        t->tail = head - PROF_RING_SIZE;
+    }
+
+    for (; t->tail != head; t->tail++) {
+        e = &t->events[t->tail & (PROF_RING_SIZE - 1)];
+        z = Prof_FindZone(e->name);
+        if (z) {
+            z->frame_time += e->end - e->start;
+            z->calls++;
+        }
+    }
+}
+
+/*
+============
+Prof_EndFrame
+
+Called on the main thread once per frame.
+============
+*/
+void Prof_EndFrame(void)
+{
+    int i, numthreads = prof_numthreads.load();
+    profzone_t *z;
+    float frames;
+
+    prof_enabled.store(com_profile->integer != 0, std::memory_order_relaxed);
+
+    // no zones are open between frames, unless Com_Error longjmp'd out
+    prof_depth = 0;
+
+    for (i = 0; i < numthreads; i++) {
+        Prof_Aggregate(prof_threads[i]);
+    }
+
+    for (i = 0, z = prof_zones; i < prof_numzones; i++, z++) {
+        z->time += z->frame_time;
+        z->max_time = max(z->max_time, z->frame_time);
+        z->frame_time = 0;
+    }
+
+    prof_window_frames++;
+    if (com_localTime - prof_window_start < 1000) {
+        return;
+    }
+
+    // publish averages over the last second
+    frames = prof_window_frames;
+    for (i = 0, z = prof_zones; i < prof_numzones; i++, z++) {
+        z->stat.calls = z->calls / frames;
+        z->stat.avg_ms = z->time * 1e-6f / frames;
+        z->stat.max_ms = z->max_time * 1e-6f;
+        z->time = z->calls = z->max_time = 0;
+    }
+
+    prof_window_start = com_localTime;
+    prof_window_frames = 0;
+}
+
+int Prof_GetStats(profstat_t *stats, int max)
+{
+    const profstat_t *s;
+    int i, j, count = 0;
+
+    // insert every zone into the sorted list, dropping the cheapest one
+    // once it's full. there are few zones.
+    for (i = 0; i < prof_numzones; i++) {
+        s = &prof_zones[i].stat;
+        if (s->calls <= 0) {
+            continue;
+        }
+
+        if (count < max) {
+            j = count++;
+        } else if (max > 0 && stats[max - 1].avg_ms < s->avg_ms) {
+            j = max - 1;
+        } else {
+            continue;
+        }
+
+        for (; j > 0 && stats[j - 1].avg_ms < s->avg_ms; j--) {
+            stats[j] = stats[j - 1];
+        }
+        stats[j] = *s;
+    }
+
+    return count;
+}
+
+/*
+============
+Prof_Dump_f
+
+Writes events still in the ring buffers in Chrome trace event format,
+viewable in chrome://tracing or Perfetto.
+============
+*/
+static void Prof_Dump_f(void)
+{
+    char path[MAX_OSPATH];
+    int i, numthreads = prof_numthreads.load();
+    uint32_t head, n;
+    profthread_t *t;
+    profevent_t *e;
+    qboolean first = true;
+    qhandle_t f;
+    int count = 0;
+
+    f = FS_EasyOpenFile(path, sizeof(path), FS_MODE_WRITE | FS_FLAG_TEXT,
+                        "profiles/", Cmd_Argc() > 1 ? Cmd_Argv(1) : "profile", ".json");
+    if (!f) {
+        return;
+    }
+
+    FS_FPrintf(f, "{\"traceEvents\":[\n");
+
+    for (i = 0; i < numthreads; i++) {
+        t = prof_threads[i];
+        head = t->head.load(std::memory_order_acquire);
+        n = min(head, (uint32_t)PROF_RING_SIZE);
+
+        FS_FPrintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                   "\"args\":{\"name\":\"%s %d\"}}", first ? "" : ",\n", t->id,
+                   t->id ? "worker" : "main", t->id);
+        first = false;
+
+        for (; n; n--) {
+            e = &t->events[(head - n) & (PROF_RING_SIZE - 1)];
+            FS_FPrintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f}", e->name, t->id,
+                       e->start * 1e-3, (e->end - e->start) * 1e-3);
+            count++;
+        }
+    }
+
+    FS_FPrintf(f, "\n]}\n");
+    FS_FCloseFile(f);
+
+    Com_Printf("Wrote %d events to %s\n", count, path);
+}
+
+/*
+============
+Prof_Init
+============
+*/
+void Prof_Init(void)
+{
+    prof_base = Prof_Nanoseconds();
+
+    com_profile = Cvar_Get("com_profile", "0", 0);
+    prof_enabled.store(com_profile->integer != 0);
+
+    // main thread always comes first
+    prof_thread = Prof_RegisterThread();
+
+    Cmd_AddCommand("profile_dump", Prof_Dump_f);
+}
+
+#endif // USE_PROFILER
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "shared/shared.h"
 #include "common/bsp.h"
 #include "common/cmd.h"
+#include "common/cmodel.h"
 #include "common/common.h"
 #include "common/files.h"
 #include "common/tests.h"
@@ -155,6 +156,230 @@ static void BSP_Test_f(void)
     FS_FreeList(list);
 }
 
+static float trace_random(unsigned *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return ((*seed >> 16) & 32767) * (1.0f / 32767);
+}
+
+static void trace_point(const mmodel_t *world, unsigned *seed, vec3_t &point)
+{
+    for (int i = 0; i < 3; i++)
+        point[i] = world->mins[i] + (world->maxs[i] - world->mins[i]) * trace_random(seed);
+}
+
+// random traces inside the world bounds, same sequence on every run
+static unsigned trace_bench(cm_t *cm, int count, const vec3_t &mins, const vec3_t &maxs, int *hits)
+{
+    mmodel_t *world = &cm->cache->models[0];
+    vec3_t start, end;
+    trace_t tr;
+    unsigned seed = 1, begin;
+    int i;
+
+    *hits = 0;
+    begin = Sys_Milliseconds();
+    for (i = 0; i < count; i++) {
+        trace_point(world, &seed, start);
+        trace_point(world, &seed, end);
+        CM_BoxTrace(&tr, start, end, mins, maxs, world->headNode, CONTENTS_MASK_PLAYERSOLID);
+        if (tr.fraction < 1)
+            (*hits)++;
+    }
+
+    return Sys_Milliseconds() - begin;
+}
+
+static void CM_TraceBench_f(void)
+{
+    static const vec3_t box_mins = { -16, -16, -24 };
+    static const vec3_t box_maxs = { 16, 16, 32 };
+    char name[MAX_QPATH];
+    cm_t cm;
+    qerror_t ret;
+    unsigned msec;
+    int count, hits;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <map> [traces]\n", Cmd_Argv(0));
+        return;
+    }
+
+    count = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 1000000;
+    clamp(count, 1, 100000000);
+
+    Q_concat(name, sizeof(name), "maps/", Cmd_Argv(1), ".bsp", NULL);
+    memset(&cm, 0, sizeof(cm));
+    ret = CM_LoadMap(&cm, name);
+    if (ret) {
+        Com_EPrintf("Couldn't load %s: %s\n", name, Q_ErrorString(ret));
+        return;
+    }
+
+    msec = trace_bench(&cm, count, vec3_zero(), vec3_zero(), &hits);
+    Com_Printf("point: %d traces in %u msec, %.0f traces/sec, %d hits\n",
+               count, msec, count * 1000.0 / max(msec, 1u), hits);
+
+    msec = trace_bench(&cm, count, box_mins, box_maxs, &hits);
+    Com_Printf("box:   %d traces in %u msec, %.0f traces/sec, %d hits\n",
+               count, msec, count * 1000.0 / max(msec, 1u), hits);
+
+    CM_FreeMap(&cm);
+}
+
+static qboolean same_trace(const trace_t *a, const trace_t *b)
+{
+    if (a->fraction != b->fraction || a->startSolid != b->startSolid || a->allSolid != b->allSolid)
+        return false;
+    if (!VectorCompare(a->endPosition, b->endPosition))
+        return false;
+    return true;
+}
+
+static qboolean same_brush(const trace_t *a, const trace_t *b)
+{
+    if (a->fraction < 1 && (!VectorCompare(a->plane.normal, b->plane.normal) || a->plane.dist != b->plane.dist))
+        return false;
+    return a->contents == b->contents && a->surface == b->surface;
+}
+
+// traces random short and long rays and boxes through the BSP tree and the
+// brush BVH of the map and compares results. The BSP tree reports the first
+// of several brushes hit at the same fraction and the BVH the lowest
+// numbered one, so those are counted apart from failures.
+static void CM_TestBVH_f(void)
+{
+    char name[MAX_QPATH];
+    mmodel_t *world;
+    vec3_t start, end, mins, maxs;
+    trace_t bsp, bvh;
+    unsigned seed = 1;
+    cm_t cm;
+    qerror_t ret;
+    int i, j, count, errors, ties;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <map> [traces]\n", Cmd_Argv(0));
+        return;
+    }
+
+    count = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 100000;
+    clamp(count, 1, 100000000);
+
+    Q_concat(name, sizeof(name), "maps/", Cmd_Argv(1), ".bsp", NULL);
+    memset(&cm, 0, sizeof(cm));
+    ret = CM_LoadMap(&cm, name);
+    if (ret) {
+        Com_EPrintf("Couldn't load %s: %s\n", name, Q_ErrorString(ret));
+        return;
+    }
+
+    if (!BSP_ForHeadnode(cm.cache->nodes)) {
+        Com_Printf("%s has no brush BVH\n", name);
+        CM_FreeMap(&cm);
+        return;
+    }
+
+    world = &cm.cache->models[0];
+
+    errors = ties = 0;
+    for (i = 0; i < count; i++) {
+        trace_point(world, &seed, start);
+        if (i & 1) {
+            for (j = 0; j < 3; j++)
+                end[j] = start[j] + 256 * trace_random(&seed) - 128;
+        } else {
+            trace_point(world, &seed, end);
+        }
+
+        if (i & 2) {
+            for (j = 0; j < 3; j++) {
+                mins[j] = -48 * trace_random(&seed);
+                maxs[j] = 64 * trace_random(&seed);
+            }
+        } else {
+            VectorClear(mins);
+            VectorClear(maxs);
+        }
+
+        CM_SetBrushBVH(0);
+        CM_BoxTrace(&bsp, start, end, mins, maxs, world->headNode, CONTENTS_MASK_SHOT);
+        CM_SetBrushBVH(2);
+        CM_BoxTrace(&bvh, start, end, mins, maxs, world->headNode, CONTENTS_MASK_SHOT);
+
+        if (!same_trace(&bsp, &bvh)) {
+            if (errors < 10) {
+                Com_EPrintf("trace %d: fraction %f %f, solid %d%d %d%d\n", i,
+                            bsp.fraction, bvh.fraction, bsp.startSolid, bsp.allSolid,
+                            bvh.startSolid, bvh.allSolid);
+            }
+            errors++;
+        } else if (!same_brush(&bsp, &bvh)) {
+            ties++;
+        }
+    }
+
+    CM_SetBrushBVH(-1);
+
+    Com_Printf("%d failures, %d ties reported from other brushes, %d traces tested\n",
+               errors, ties, count);
+
+    CM_FreeMap(&cm);
+}
+
+#define CACHETEST_TOKENS    48
+
+// tokenizes a long line twice, the second time it comes from the command cache
+static void Cmd_TestCache_f(void)
+{
+    char line[MAX_STRING_CHARS];
+    char tokens[CACHETEST_TOKENS][16];
+    int i, pass, errors;
+
+    Q_strlcpy(line, "cachetest", sizeof(line));
+    for (i = 0; i < CACHETEST_TOKENS; i++) {
+        // every other token is quoted and has a space in it
+        Q_snprintf(tokens[i], sizeof(tokens[i]), (i & 1) ? "arg %d" : "arg%d", i);
+        Q_strlcat(line, (i & 1) ? " \"" : " ", sizeof(line));
+        Q_strlcat(line, tokens[i], sizeof(line));
+        if (i & 1) {
+            Q_strlcat(line, "\"", sizeof(line));
+        }
+    }
+
+    errors = 0;
+    for (pass = 0; pass < 2; pass++) {
+        Cmd_TokenizeString(line, true);
+
+        if (Cmd_Argc() != CACHETEST_TOKENS + 1) {
+            Com_EPrintf("pass %d: argc == %d, expected %d\n",
+                        pass, Cmd_Argc(), CACHETEST_TOKENS + 1);
+            errors++;
+            continue;
+        }
+
+        if (strcmp(Cmd_Argv(0), "cachetest")) {
+            Com_EPrintf("pass %d: argv[0] == \"%s\"\n", pass, Cmd_Argv(0));
+            errors++;
+        }
+
+        for (i = 0; i < CACHETEST_TOKENS; i++) {
+            if (strcmp(Cmd_Argv(i + 1), tokens[i])) {
+                Com_EPrintf("pass %d: argv[%d] == \"%s\", expected \"%s\"\n",
+                            pass, i + 1, Cmd_Argv(i + 1), tokens[i]);
+                errors++;
+            }
+        }
+
+        if (strcmp(Cmd_RawString(), line)) {
+            Com_EPrintf("pass %d: line doesn't match\n", pass);
+            errors++;
+        }
+    }
+
+    Com_Printf("%d failures, %d passes tested\n", errors, pass);
+}
+
 typedef struct {
     const char *filter;
     const char *string;
@@ -532,6 +757,9 @@ void TST_Init(void)
     Cmd_AddCommand("crash", Com_Crash_f);
     Cmd_AddCommand("printjunk", Com_PrintJunk_f);
     Cmd_AddCommand("bsptest", BSP_Test_f);
+    Cmd_AddCommand("tracebench", CM_TraceBench_f);
+    Cmd_AddCommand("bvhtest", CM_TestBVH_f);
+    Cmd_AddCommand("cachetest", Cmd_TestCache_f);
     Cmd_AddCommand("wildtest", Com_TestWild_f);
     Cmd_AddCommand("normtest", Com_TestNorm_f);
     Cmd_AddCommand("infotest", Com_TestInfo_f);
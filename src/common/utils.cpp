@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "shared/shared.h"
 #include "common/utils.h"
+#include "common/zone.h"
 
 /*
 ==============================================================================
@@ -335,10 +336,12 @@ qboolean Com_ParseTimespec(const char *s, int *frames)
 
 /*
 ================
-Com_HashString
+Com_HashName
+
+Full 32-bit version of Com_HashString, for tables that keep hashes around.
 ================
 */
-unsigned Com_HashString(const char *s, unsigned size)
+unsigned Com_HashName(const char *s)
 {
     unsigned hash, c;
 
@@ -348,8 +351,17 @@ unsigned Com_HashString(const char *s, unsigned size)
         hash = 127 * hash + c;
     }
 
-    hash = (hash >> 20) ^(hash >> 10) ^ hash;
-    return hash & (size - 1);
+    return (hash >> 20) ^(hash >> 10) ^ hash;
+}
+
+/*
+================
+Com_HashString
+================
+*/
+unsigned Com_HashString(const char *s, unsigned size)
+{
+    return Com_HashName(s) & (size - 1);
 }
 
 /*
@@ -374,6 +386,108 @@ unsigned Com_HashStringLen(const char *s, size_t len, unsigned size)
     return hash & (size - 1);
 }
 
+/*
+==============================================================================
+
+NAME TABLES
+
+Open addressing with linear probing, kept at most half full. Slots cache the
+full hash so that mismatches rarely need a string compare.
+
+==============================================================================
+*/
+
+#define NAMETABLE_MIN_SIZE  64
+
+static nameslot_t *NameTable_Slot(const nametable_t *t, const char *name, unsigned hash)
+{
+    unsigned i, mask;
+    nameslot_t *slot;
+
+    if (!t->size) {
+        return NULL;
+    }
+
+    mask = t->size - 1;
+    for (i = hash & mask; (slot = &t->slots[i])->name; i = (i + 1) & mask) {
+        if (slot->hash == hash && !strcmp(slot->name, name)) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+void *NameTable_Find(const nametable_t *t, const char *name, unsigned hash)
+{
+    nameslot_t *slot = NameTable_Slot(t, name, hash);
+
+    return slot ? slot->value : NULL;
+}
+
+static void NameTable_Link(nametable_t *t, const char *name, unsigned hash, void *value)
+{
+    unsigned i, mask = t->size - 1;
+
+    for (i = hash & mask; t->slots[i].name; i = (i + 1) & mask)
+        ;
+
+    t->slots[i].hash = hash;
+    t->slots[i].name = name;
+    t->slots[i].value = value;
+    t->count++;
+}
+
+void NameTable_Insert(nametable_t *t, const char *name, unsigned hash, void *value)
+{
+    nameslot_t *old = t->slots;
+    unsigned i, oldsize = t->size;
+
+    if ((t->count + 1) * 2 > t->size) {
+        t->size = oldsize ? oldsize * 2 : NAMETABLE_MIN_SIZE;
+        t->slots = (nameslot_t *)Z_TagMallocz(t->size * sizeof(t->slots[0]), t->tag);
+        t->count = 0;
+        for (i = 0; i < oldsize; i++) {
+            if (old[i].name) {
+                NameTable_Link(t, old[i].name, old[i].hash, old[i].value);
+            }
+        }
+        Z_Free(old);
+    }
+
+    NameTable_Link(t, name, hash, value);
+}
+
+void NameTable_Remove(nametable_t *t, const char *name, unsigned hash)
+{
+    nameslot_t *slot = NameTable_Slot(t, name, hash);
+    unsigned i, j, k, mask;
+
+    if (!slot) {
+        return;
+    }
+
+    // shift following entries back so that probing never stops early
+    mask = t->size - 1;
+    i = j = slot - t->slots;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!t->slots[j].name) {
+            break;
+        }
+        // leave entries whose home slot is cyclically in (i, j]
+        k = t->slots[j].hash & mask;
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        t->slots[i] = t->slots[j];
+        i = j;
+    }
+
+    memset(&t->slots[i], 0, sizeof(t->slots[i]));
+    t->count--;
+}
+
 /*
 ===============
 Com_PageInMemory
@@ -19,6 +19,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // CPP: Required include for _ReturnAddress();
 #include <intrin.h>
 
+#include <mutex>
+
 #include "shared/shared.h"
 #include "common/common.h"
 #include "common/zone.h"
@@ -51,6 +53,11 @@ typedef struct zhead_s {
 
 static zhead_t      z_chain;
 
+// Zone memory may be allocated and freed from worker threads (media
+// prefetching, sound resampling), this guards the chain and stats.
+// Recursive since Com_Error may free memory while shutting down.
+static std::recursive_mutex z_lock;
+
 typedef struct {
     zhead_t     z;
     char        data[2];
@@ -113,6 +120,7 @@ static inline void Z_Validate(zhead_t *z, const char *func)
 
 void Z_Check(void)
 {
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
     zhead_t *z;
 
     Z_FOR_EACH(z) {
@@ -125,6 +133,7 @@ void Z_LeakTest(memtag_t tag)
     zhead_t *z;
     size_t numLeaks = 0, numBytes = 0;
 
+    std::unique_lock<std::recursive_mutex> lock(z_lock);
     Z_FOR_EACH(z) {
         Z_Validate(z, __func__);
         if (z->tag == tag) {
@@ -132,6 +141,7 @@ void Z_LeakTest(memtag_t tag)
             numBytes += z->size;
         }
     }
+    lock.unlock();
 
     if (numLeaks) {
         Com_WPrintf("************* Z_LeakTest *************\n"
@@ -158,6 +168,8 @@ void Z_Free(void *ptr)
 
     z = (zhead_t *)ptr - 1;
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     Z_Validate(z, __func__);
 
     s = &z_stats[z->tag < TAG_MAX ? z->tag : TAG_FREE];
@@ -194,6 +206,8 @@ void *Z_Realloc(void *ptr, size_t size)
 
     z = (zhead_t *)ptr - 1;
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     Z_Validate(z, __func__);
 
     if (z->tag == TAG_STATIC) {
@@ -235,6 +249,8 @@ void Z_Stats_f(void)
     zstats_t *s;
     int i;
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     Com_Printf("    bytes blocks name\n"
                "--------- ------ -------\n");
 
@@ -259,6 +275,7 @@ Z_FreeTags
 */
 void Z_FreeTags(memtag_t tag)
 {
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
     zhead_t *z, *n;
 
     Z_FOR_EACH_SAFE(z, n) {
@@ -312,17 +329,19 @@ void *Z_TagMalloc(size_t size, memtag_t tag)
     z->time = time(NULL);
 #endif
 
-    z->next = z_chain.next;
-    z->prev = &z_chain;
-    z_chain.next->prev = z;
-    z_chain.next = z;
-
     if (z_perturb && z_perturb->integer) {
         memset(z + 1, z_perturb->integer, size - Z_EXTRA);
     }
 
     Z_TAIL_F(z) = Z_TAIL;
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
+    z->next = z_chain.next;
+    z->prev = &z_chain;
+    z_chain.next->prev = z;
+    z_chain.next = z;
+
     s = &z_stats[tag < TAG_MAX ? tag : TAG_FREE];
     s->count++;
     s->bytes += size;
@@ -440,6 +459,7 @@ char *Z_CvarCopyString(const char *in)
     }
 
     // return static storage
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
     z = (zstatic_t *)&z_static[i];
     s = &z_stats[TAG_STATIC];
     s->count++;
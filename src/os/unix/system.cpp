@@ -197,6 +197,49 @@ Sys_IsFile(const char *path)
 	return false;
 }
 
+/*
+================
+Sys_MapFile
+
+Maps the entire file read-only into memory. Returns NULL if the file
+could not be opened or is empty.
+================
+*/
+void *Sys_MapFile(const char *path, size_t *len)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+    *len = 0;
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    *len = st.st_size;
+    return p;
+}
+
+void Sys_UnmapFile(void *data, size_t len)
+{
+    if (data) {
+        munmap(data, len);
+    }
+}
+
 /*
 =================
 Sys_Init
@@ -688,6 +688,64 @@ Sys_IsFile(const char *path)
 	return (fileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)) == 0;
 }
 
+/*
+================
+Sys_MapFile
+
+Maps the entire file read-only into memory. Returns NULL if the file
+could not be opened or is empty.
+================
+*/
+void *Sys_MapFile(const char *path, size_t *len)
+{
+	WCHAR wpath[MAX_OSPATH] = { 0 };
+	LARGE_INTEGER size;
+	HANDLE file, mapping;
+	void *p;
+
+	*len = 0;
+
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, MAX_OSPATH);
+
+	file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return NULL;
+	}
+
+	// the view keeps the mapping object alive
+	p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!p)
+	{
+		return NULL;
+	}
+
+	*len = (size_t)size.QuadPart;
+	return p;
+}
+
+void Sys_UnmapFile(void *data, size_t len)
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+}
+
 /*
 ================
 Sys_Init
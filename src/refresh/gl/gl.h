@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/files.h"
+#include "common/profile.h"
 #include "client/video.h"
 #include "client/client.h"
 #include "refresh/refresh.h"
@@ -508,7 +509,10 @@ void R_SetSky_GL(const char *name, float rotate, vec3_t &axis);
  * gl_mesh.c
  *
  */
+void GL_PrepareAliasModel(model_t *model);
+void GL_TessellateAliasModels(void);
 void GL_DrawAliasModel(model_t *model);
+void GL_ShutdownMeshes(void);
 
 /*
  * hq2x.c
@@ -413,6 +413,54 @@ static void GL_DrawNullModel(void)
     qglDrawArrays(GL_LINES, 0, 6);
 }
 
+static void GL_SetupEntity(r_entity_t *ent)
+{
+    glr.ent = ent;
+
+    // convert angles to axis
+    if (VectorEmpty(ent->angles)) {
+        glr.entrotated = false;
+        VectorSet(glr.entaxis[0], 1, 0, 0);
+        VectorSet(glr.entaxis[1], 0, 1, 0);
+        VectorSet(glr.entaxis[2], 0, 0, 1);
+    } else {
+        glr.entrotated = true;
+        AnglesToAxis(ent->angles, glr.entaxis);
+    }
+}
+
+// culls and lights alias models, then tessellates all of them at once
+// on the job threads before anything is drawn
+static void GL_PrepareEntities(void)
+{
+    r_entity_t *ent, *last;
+    model_t *model;
+
+    if (!gl_drawentities->integer) {
+        return;
+    }
+
+    last = glr.fd.entities + glr.fd.num_entities;
+    for (ent = glr.fd.entities; ent != last; ent++) {
+        if (ent->flags & RenderEffects::Beam) {
+            continue;
+        }
+        if (ent->model & 0x80000000) {
+            continue;
+        }
+
+        model = MOD_ForHandle(ent->model);
+        if (!model || model->type != model_s::MOD_ALIAS) { // CPP: Enum
+            continue;
+        }
+
+        GL_SetupEntity(ent);
+        GL_PrepareAliasModel(model);
+    }
+
+    GL_TessellateAliasModels();
+}
+
 static void GL_DrawEntities(int mask)
 {
     r_entity_t *ent, *last;
@@ -433,18 +481,7 @@ static void GL_DrawEntities(int mask)
             continue;
         }
 
-        glr.ent = ent;
-
-        // convert angles to axis
-        if (VectorEmpty(ent->angles)) {
-            glr.entrotated = false;
-            VectorSet(glr.entaxis[0], 1, 0, 0);
-            VectorSet(glr.entaxis[1], 0, 1, 0);
-            VectorSet(glr.entaxis[2], 0, 0, 1);
-        } else {
-            glr.entrotated = true;
-            AnglesToAxis(ent->angles, glr.entaxis);
-        }
+        GL_SetupEntity(ent);
 
         // inline BSP model
         if (ent->model & 0x80000000) {
@@ -585,6 +622,8 @@ void R_RenderFrame_GL(refdef_t *fd)
         GL_DrawWorld();
     }
 
+    GL_PrepareEntities();
+
     GL_DrawEntities(0);
 
     GL_DrawBeams();
@@ -1071,6 +1110,7 @@ void R_Shutdown_GL(qboolean total)
     GL_FreeWorld();
     GL_ShutdownImages();
     MOD_Shutdown();
+    GL_ShutdownMeshes();
 
     if (gl_vertex_buffer_object->modified) {
         // disable buffer objects after map is freed
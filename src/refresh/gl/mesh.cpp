@@ -17,34 +17,52 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "gl.h"
-
-typedef void (*tessfunc_t)(const maliasmesh_t *);
-
-static int      oldframenum;
-static int      newframenum;
-static float    frontlerp;
-static float    backlerp;
-static vec3_t   origin;
-static vec3_t   oldscale;
-static vec3_t   newscale;
-static vec3_t   translate;
-static vec_t    shellscale;
-static tessfunc_t tessfunc;
-static vec4_t   color;
-
-static const vec_t  *shadelight;
-static vec3_t       shadedir;
-
-static float    celscale;
-
-static GLfloat  shadowmatrix[16];
-
-static void setup_dotshading(void)
+#include "common/jobs.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
+typedef struct aliasent_s aliasent_t;
+
+// tessellates vertices [first, first + count) of the mesh into dst_vert,
+// which points to the first vertex of the mesh. may run on a job thread.
+typedef void (*tessfunc_t)(const aliasent_t *, const maliasmesh_t *,
+                           int first, int count, vec_t *dst_vert);
+
+// everything needed to tessellate and draw an alias model entity
+struct aliasent_s {
+    int         oldframenum;
+    int         newframenum;
+    float       frontlerp;
+    float       backlerp;
+    vec3_t      origin;
+    vec3_t      oldscale;
+    vec3_t      newscale;
+    vec3_t      translate;
+    vec_t       shellscale;
+    tessfunc_t  tessfunc;
+    int         stride;         // floats per tessellated vertex
+    vec4_t      color;
+    const vec_t *shadelight;
+    vec3_t      shadedir;
+    float       celscale;
+    GLfloat     shadowmatrix[16];
+
+    // set by GL_PrepareAliasModels
+    int         drawframe;
+    qboolean    culled;
+    vec_t       *vertices;
+};
+
+static aliasent_t   alias_ents[MAX_ENTITIES];
+
+static void setup_dotshading(aliasent_t *ae)
 {
     float cp, cy, sp, sy;
     vec_t yaw;
 
-    shadelight = NULL;
+    ae->shadelight = NULL;
 
     if (!gl_dotshading->integer)
         return;
@@ -52,7 +70,7 @@ static void setup_dotshading(void)
     if (glr.ent->flags & RF_SHELL_MASK)
         return;
 
-    shadelight = color;
+    ae->shadelight = ae->color;
 
     // matches the anormtab.h precalculations
     yaw = -Radians(glr.ent->angles[vec3_t::Yaw]);
@@ -60,14 +78,14 @@ static void setup_dotshading(void)
     sy = std::sinf(yaw);
     cp = std::cosf(-M_PI / 4);
     sp = std::sinf(-M_PI / 4);
-    shadedir[0] = cp * cy;
-    shadedir[1] = cp * sy;
-    shadedir[2] = -sp;
+    ae->shadedir[0] = cp * cy;
+    ae->shadedir[1] = cp * sy;
+    ae->shadedir[2] = -sp;
 }
 
-static inline vec_t shadedot(const vec_t *normal)
+static inline vec_t shadedot(const aliasent_t *ae, const vec_t *normal)
 {
-    vec_t d = DotProduct(normal, shadedir);
+    vec_t d = DotProduct(normal, ae->shadedir);
 
     // matches the anormtab.h precalculations
     if (d < 0) {
@@ -89,42 +107,45 @@ static inline vec_t *get_static_normal(vec_t *normal, const maliasvert_t *vert)
     return normal;
 }
 
-static void tess_static_shell(const maliasmesh_t *mesh)
+static void tess_static_shell(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_vert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_vert = &mesh->verts[ae->newframenum * mesh->numverts + first];
     vec3_t normal;
 
+    dst_vert += first * 4;
+
     while (count--) {
         get_static_normal(normal, src_vert);
 
-        dst_vert[0] = normal[0] * shellscale +
-                      src_vert->pos[0] * newscale[0] + translate[0];
-        dst_vert[1] = normal[1] * shellscale +
-                      src_vert->pos[1] * newscale[1] + translate[1];
-        dst_vert[2] = normal[2] * shellscale +
-                      src_vert->pos[2] * newscale[2] + translate[2];
+        dst_vert[0] = normal[0] * ae->shellscale +
+                      src_vert->pos[0] * ae->newscale[0] + ae->translate[0];
+        dst_vert[1] = normal[1] * ae->shellscale +
+                      src_vert->pos[1] * ae->newscale[1] + ae->translate[1];
+        dst_vert[2] = normal[2] * ae->shellscale +
+                      src_vert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert += 4;
 
         src_vert++;
     }
 }
 
-static void tess_static_shade(const maliasmesh_t *mesh)
+static void tess_static_shade(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_vert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_vert = &mesh->verts[ae->newframenum * mesh->numverts + first];
+    const vec_t *shadelight = ae->shadelight;
     vec3_t normal;
     vec_t d;
 
+    dst_vert += first * VERTEX_SIZE;
+
     while (count--) {
-        d = shadedot(get_static_normal(normal, src_vert));
+        d = shadedot(ae, get_static_normal(normal, src_vert));
 
-        dst_vert[0] = src_vert->pos[0] * newscale[0] + translate[0];
-        dst_vert[1] = src_vert->pos[1] * newscale[1] + translate[1];
-        dst_vert[2] = src_vert->pos[2] * newscale[2] + translate[2];
+        dst_vert[0] = src_vert->pos[0] * ae->newscale[0] + ae->translate[0];
+        dst_vert[1] = src_vert->pos[1] * ae->newscale[1] + ae->translate[1];
+        dst_vert[2] = src_vert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert[4] = shadelight[0] * d;
         dst_vert[5] = shadelight[1] * d;
         dst_vert[6] = shadelight[2] * d;
@@ -135,23 +156,164 @@ static void tess_static_shade(const maliasmesh_t *mesh)
     }
 }
 
-static void tess_static_plain(const maliasmesh_t *mesh)
+static void tess_static_plain(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_vert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_vert = &mesh->verts[ae->newframenum * mesh->numverts + first];
+
+    dst_vert += first * 4;
 
     while (count--) {
-        dst_vert[0] = src_vert->pos[0] * newscale[0] + translate[0];
-        dst_vert[1] = src_vert->pos[1] * newscale[1] + translate[1];
-        dst_vert[2] = src_vert->pos[2] * newscale[2] + translate[2];
+        dst_vert[0] = src_vert->pos[0] * ae->newscale[0] + ae->translate[0];
+        dst_vert[1] = src_vert->pos[1] * ae->newscale[1] + ae->translate[1];
+        dst_vert[2] = src_vert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert += 4;
 
         src_vert++;
     }
 }
 
-static inline vec_t *get_lerped_normal(vec_t *normal,
+#if USE_SSE2
+
+typedef enum {
+    LERP_PLAIN,
+    LERP_SHELL,
+    LERP_SHADE
+} lerpmode_t;
+
+/*
+=============
+tess_lerped_sse
+
+Same math as the scalar tess_lerped_* functions, 4 vertices at a time
+with one component per register.
+=============
+*/
+static void tess_lerped_sse(const aliasent_t *ae, const maliasmesh_t *mesh,
+                            int first, int count, vec_t *dst_vert, lerpmode_t mode)
+{
+    const maliasvert_t *src_oldvert = &mesh->verts[ae->oldframenum * mesh->numverts + first];
+    const maliasvert_t *src_newvert = &mesh->verts[ae->newframenum * mesh->numverts + first];
+    const int stride = mode == LERP_SHADE ? VERTEX_SIZE : 4;
+    const __m128 backlerp = _mm_set1_ps(ae->backlerp);
+    const __m128 frontlerp = _mm_set1_ps(ae->frontlerp);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 shadelight = zero;
+    int i, lane, n;
+
+    dst_vert += first * stride;
+
+    if (mode == LERP_SHADE)
+        shadelight = _mm_loadu_ps(ae->shadelight);
+
+    for (i = 0; i < count; i += 4, src_oldvert += 4, src_newvert += 4, dst_vert += 4 * stride) {
+        alignas(16) float oldpos[3][4], newpos[3][4];
+        alignas(16) float oldnorm[3][4], newnorm[3][4];
+        alignas(16) float dots[4];
+        __m128 pos[3], norm[3], d = zero;
+
+        n = min(count - i, 4);
+
+        // missing lanes repeat the last vertex
+        for (lane = 0; lane < 4; lane++) {
+            const maliasvert_t *oldvert = &src_oldvert[lane < n ? lane : n - 1];
+            const maliasvert_t *newvert = &src_newvert[lane < n ? lane : n - 1];
+
+            oldpos[0][lane] = oldvert->pos[0];
+            oldpos[1][lane] = oldvert->pos[1];
+            oldpos[2][lane] = oldvert->pos[2];
+            newpos[0][lane] = newvert->pos[0];
+            newpos[1][lane] = newvert->pos[1];
+            newpos[2][lane] = newvert->pos[2];
+
+            if (mode != LERP_PLAIN) {
+                vec3_t v;
+                get_static_normal(v, oldvert);
+                oldnorm[0][lane] = v[0];
+                oldnorm[1][lane] = v[1];
+                oldnorm[2][lane] = v[2];
+                get_static_normal(v, newvert);
+                newnorm[0][lane] = v[0];
+                newnorm[1][lane] = v[1];
+                newnorm[2][lane] = v[2];
+            }
+        }
+
+        if (mode != LERP_PLAIN) {
+            // lerp and normalize
+            for (int j = 0; j < 3; j++) {
+                norm[j] = _mm_add_ps(_mm_mul_ps(_mm_load_ps(oldnorm[j]), backlerp),
+                                     _mm_mul_ps(_mm_load_ps(newnorm[j]), frontlerp));
+            }
+
+            __m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(norm[0], norm[0]),
+                                               _mm_mul_ps(norm[1], norm[1])),
+                                    _mm_mul_ps(norm[2], norm[2]));
+            len = _mm_div_ps(one, _mm_sqrt_ps(len));
+            for (int j = 0; j < 3; j++)
+                norm[j] = _mm_mul_ps(norm[j], len);
+        }
+
+        for (int j = 0; j < 3; j++) {
+            pos[j] = _mm_mul_ps(_mm_load_ps(oldpos[j]), _mm_set1_ps(ae->oldscale[j]));
+            if (mode == LERP_SHELL)
+                pos[j] = _mm_add_ps(_mm_mul_ps(norm[j], _mm_set1_ps(ae->shellscale)), pos[j]);
+            pos[j] = _mm_add_ps(pos[j], _mm_mul_ps(_mm_load_ps(newpos[j]), _mm_set1_ps(ae->newscale[j])));
+            pos[j] = _mm_add_ps(pos[j], _mm_set1_ps(ae->translate[j]));
+        }
+
+        if (mode == LERP_SHADE) {
+            d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(norm[0], _mm_set1_ps(ae->shadedir[0])),
+                                      _mm_mul_ps(norm[1], _mm_set1_ps(ae->shadedir[1]))),
+                           _mm_mul_ps(norm[2], _mm_set1_ps(ae->shadedir[2])));
+
+            // matches the anormtab.h precalculations
+            const __m128 negative = _mm_cmplt_ps(d, zero);
+            d = _mm_or_ps(_mm_and_ps(negative, _mm_mul_ps(d, _mm_set1_ps(0.3f))),
+                          _mm_andnot_ps(negative, d));
+            d = _mm_add_ps(d, one);
+        }
+
+        // back to one vertex per register, the 4th float is unused
+        __m128 v0 = pos[0], v1 = pos[1], v2 = pos[2], v3 = d;
+        _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+        _mm_storeu_ps(dst_vert + 0 * stride, v0);
+        if (n > 1) _mm_storeu_ps(dst_vert + 1 * stride, v1);
+        if (n > 2) _mm_storeu_ps(dst_vert + 2 * stride, v2);
+        if (n > 3) _mm_storeu_ps(dst_vert + 3 * stride, v3);
+
+        if (mode == LERP_SHADE) {
+            _mm_store_ps(dots, d);
+            for (lane = 0; lane < n; lane++) {
+                __m128 c = _mm_mul_ps(shadelight, _mm_setr_ps(dots[lane], dots[lane], dots[lane], 1.0f));
+                _mm_storeu_ps(dst_vert + lane * stride + 4, c);
+            }
+        }
+    }
+}
+
+static void tess_lerped_shell(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
+{
+    tess_lerped_sse(ae, mesh, first, count, dst_vert, LERP_SHELL);
+}
+
+static void tess_lerped_shade(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
+{
+    tess_lerped_sse(ae, mesh, first, count, dst_vert, LERP_SHADE);
+}
+
+static void tess_lerped_plain(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
+{
+    tess_lerped_sse(ae, mesh, first, count, dst_vert, LERP_PLAIN);
+}
+
+#else // USE_SSE2
+
+static inline vec_t *get_lerped_normal(const aliasent_t *ae, vec_t *normal,
                                        const maliasvert_t *oldvert,
                                        const maliasvert_t *newvert)
 {
@@ -161,7 +323,7 @@ static inline vec_t *get_lerped_normal(vec_t *normal,
     get_static_normal(oldnorm, oldvert);
     get_static_normal(newnorm, newvert);
 
-    LerpVector2(oldnorm, newnorm, backlerp, frontlerp, tmp);
+    LerpVector2(oldnorm, newnorm, ae->backlerp, ae->frontlerp, tmp);
 
     // normalize result
     len = 1 / VectorLength(tmp);
@@ -170,26 +332,27 @@ static inline vec_t *get_lerped_normal(vec_t *normal,
     return normal;
 }
 
-static void tess_lerped_shell(const maliasmesh_t *mesh)
+static void tess_lerped_shell(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_oldvert = &mesh->verts[oldframenum * mesh->numverts];
-    maliasvert_t *src_newvert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_oldvert = &mesh->verts[ae->oldframenum * mesh->numverts + first];
+    const maliasvert_t *src_newvert = &mesh->verts[ae->newframenum * mesh->numverts + first];
     vec3_t normal;
 
+    dst_vert += first * 4;
+
     while (count--) {
-        get_lerped_normal(normal, src_oldvert, src_newvert);
-
-        dst_vert[0] = normal[0] * shellscale +
-                      src_oldvert->pos[0] * oldscale[0] +
-                      src_newvert->pos[0] * newscale[0] + translate[0];
-        dst_vert[1] = normal[1] * shellscale +
-                      src_oldvert->pos[1] * oldscale[1] +
-                      src_newvert->pos[1] * newscale[1] + translate[1];
-        dst_vert[2] = normal[2] * shellscale +
-                      src_oldvert->pos[2] * oldscale[2] +
-                      src_newvert->pos[2] * newscale[2] + translate[2];
+        get_lerped_normal(ae, normal, src_oldvert, src_newvert);
+
+        dst_vert[0] = normal[0] * ae->shellscale +
+                      src_oldvert->pos[0] * ae->oldscale[0] +
+                      src_newvert->pos[0] * ae->newscale[0] + ae->translate[0];
+        dst_vert[1] = normal[1] * ae->shellscale +
+                      src_oldvert->pos[1] * ae->oldscale[1] +
+                      src_newvert->pos[1] * ae->newscale[1] + ae->translate[1];
+        dst_vert[2] = normal[2] * ae->shellscale +
+                      src_oldvert->pos[2] * ae->oldscale[2] +
+                      src_newvert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert += 4;
 
         src_oldvert++;
@@ -197,27 +360,29 @@ static void tess_lerped_shell(const maliasmesh_t *mesh)
     }
 }
 
-static void tess_lerped_shade(const maliasmesh_t *mesh)
+static void tess_lerped_shade(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_oldvert = &mesh->verts[oldframenum * mesh->numverts];
-    maliasvert_t *src_newvert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_oldvert = &mesh->verts[ae->oldframenum * mesh->numverts + first];
+    const maliasvert_t *src_newvert = &mesh->verts[ae->newframenum * mesh->numverts + first];
+    const vec_t *shadelight = ae->shadelight;
     vec3_t normal;
     vec_t d;
 
+    dst_vert += first * VERTEX_SIZE;
+
     while (count--) {
-        d = shadedot(get_lerped_normal(normal, src_oldvert, src_newvert));
+        d = shadedot(ae, get_lerped_normal(ae, normal, src_oldvert, src_newvert));
 
         dst_vert[0] =
-            src_oldvert->pos[0] * oldscale[0] +
-            src_newvert->pos[0] * newscale[0] + translate[0];
+            src_oldvert->pos[0] * ae->oldscale[0] +
+            src_newvert->pos[0] * ae->newscale[0] + ae->translate[0];
         dst_vert[1] =
-            src_oldvert->pos[1] * oldscale[1] +
-            src_newvert->pos[1] * newscale[1] + translate[1];
+            src_oldvert->pos[1] * ae->oldscale[1] +
+            src_newvert->pos[1] * ae->newscale[1] + ae->translate[1];
         dst_vert[2] =
-            src_oldvert->pos[2] * oldscale[2] +
-            src_newvert->pos[2] * newscale[2] + translate[2];
+            src_oldvert->pos[2] * ae->oldscale[2] +
+            src_newvert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert[4] = shadelight[0] * d;
         dst_vert[5] = shadelight[1] * d;
         dst_vert[6] = shadelight[2] * d;
@@ -229,23 +394,24 @@ static void tess_lerped_shade(const maliasmesh_t *mesh)
     }
 }
 
-static void tess_lerped_plain(const maliasmesh_t *mesh)
+static void tess_lerped_plain(const aliasent_t *ae, const maliasmesh_t *mesh,
+                              int first, int count, vec_t *dst_vert)
 {
-    maliasvert_t *src_oldvert = &mesh->verts[oldframenum * mesh->numverts];
-    maliasvert_t *src_newvert = &mesh->verts[newframenum * mesh->numverts];
-    vec_t *dst_vert = tess.vertices;
-    int count = mesh->numverts;
+    const maliasvert_t *src_oldvert = &mesh->verts[ae->oldframenum * mesh->numverts + first];
+    const maliasvert_t *src_newvert = &mesh->verts[ae->newframenum * mesh->numverts + first];
+
+    dst_vert += first * 4;
 
     while (count--) {
         dst_vert[0] =
-            src_oldvert->pos[0] * oldscale[0] +
-            src_newvert->pos[0] * newscale[0] + translate[0];
+            src_oldvert->pos[0] * ae->oldscale[0] +
+            src_newvert->pos[0] * ae->newscale[0] + ae->translate[0];
         dst_vert[1] =
-            src_oldvert->pos[1] * oldscale[1] +
-            src_newvert->pos[1] * newscale[1] + translate[1];
+            src_oldvert->pos[1] * ae->oldscale[1] +
+            src_newvert->pos[1] * ae->newscale[1] + ae->translate[1];
         dst_vert[2] =
-            src_oldvert->pos[2] * oldscale[2] +
-            src_newvert->pos[2] * newscale[2] + translate[2];
+            src_oldvert->pos[2] * ae->oldscale[2] +
+            src_newvert->pos[2] * ae->newscale[2] + ae->translate[2];
         dst_vert += 4;
 
         src_oldvert++;
@@ -253,28 +419,30 @@ static void tess_lerped_plain(const maliasmesh_t *mesh)
     }
 }
 
-static glCullResult_t cull_static_model(model_t *model)
+#endif // !USE_SSE2
+
+static glCullResult_t cull_static_model(aliasent_t *ae, model_t *model)
 {
-    maliasframe_t *newframe = &model->frames[newframenum];
+    maliasframe_t *newframe = &model->frames[ae->newframenum];
     vec3_t bounds[2];
     glCullResult_t cull;
 
     if (glr.entrotated) {
-        cull = GL_CullSphere(origin, newframe->radius);
+        cull = GL_CullSphere(ae->origin, newframe->radius);
         if (cull == CULL_OUT) {
             c.spheresCulled++;
             return cull;
         }
         if (cull == CULL_CLIP) {
-            cull = GL_CullLocalBox(origin, newframe->bounds);
+            cull = GL_CullLocalBox(ae->origin, newframe->bounds);
             if (cull == CULL_OUT) {
                 c.rotatedBoxesCulled++;
                 return cull;
             }
         }
     } else {
-        VectorAdd(newframe->bounds[0], origin, bounds[0]);
-        VectorAdd(newframe->bounds[1], origin, bounds[1]);
+        VectorAdd(newframe->bounds[0], ae->origin, bounds[0]);
+        VectorAdd(newframe->bounds[1], ae->origin, bounds[1]);
         cull = GL_CullBox(bounds);
         if (cull == CULL_OUT) {
             c.boxesCulled++;
@@ -282,16 +450,16 @@ static glCullResult_t cull_static_model(model_t *model)
         }
     }
 
-    VectorCopy(newframe->scale, newscale);
-    VectorCopy(newframe->translate, translate);
+    VectorCopy(newframe->scale, ae->newscale);
+    VectorCopy(newframe->translate, ae->translate);
 
     return cull;
 }
 
-static glCullResult_t cull_lerped_model(model_t *model)
+static glCullResult_t cull_lerped_model(aliasent_t *ae, model_t *model)
 {
-    maliasframe_t *newframe = &model->frames[newframenum];
-    maliasframe_t *oldframe = &model->frames[oldframenum];
+    maliasframe_t *newframe = &model->frames[ae->newframenum];
+    maliasframe_t *oldframe = &model->frames[ae->oldframenum];
     vec3_t bounds[2];
     vec_t radius;
     glCullResult_t cull;
@@ -299,14 +467,14 @@ static glCullResult_t cull_lerped_model(model_t *model)
     if (glr.entrotated) {
         radius = newframe->radius > oldframe->radius ?
                  newframe->radius : oldframe->radius;
-        cull = GL_CullSphere(origin, radius);
+        cull = GL_CullSphere(ae->origin, radius);
         if (cull == CULL_OUT) {
             c.spheresCulled++;
             return cull;
         }
         UnionBounds(newframe->bounds, oldframe->bounds, bounds);
         if (cull == CULL_CLIP) {
-            cull = GL_CullLocalBox(origin, bounds);
+            cull = GL_CullLocalBox(ae->origin, bounds);
             if (cull == CULL_OUT) {
                 c.rotatedBoxesCulled++;
                 return cull;
@@ -314,8 +482,8 @@ static glCullResult_t cull_lerped_model(model_t *model)
         }
     } else {
         UnionBounds(newframe->bounds, oldframe->bounds, bounds);
-        VectorAdd(bounds[0], origin, bounds[0]);
-        VectorAdd(bounds[1], origin, bounds[1]);
+        VectorAdd(bounds[0], ae->origin, bounds[0]);
+        VectorAdd(bounds[1], ae->origin, bounds[1]);
         cull = GL_CullBox(bounds);
         if (cull == CULL_OUT) {
             c.boxesCulled++;
@@ -323,18 +491,19 @@ static glCullResult_t cull_lerped_model(model_t *model)
         }
     }
 
-    VectorScale(oldframe->scale, backlerp, oldscale);
-    VectorScale(newframe->scale, frontlerp, newscale);
+    VectorScale(oldframe->scale, ae->backlerp, ae->oldscale);
+    VectorScale(newframe->scale, ae->frontlerp, ae->newscale);
 
     LerpVector2(oldframe->translate, newframe->translate,
-                backlerp, frontlerp, translate);
+                ae->backlerp, ae->frontlerp, ae->translate);
 
     return cull;
 }
 
-static void setup_color(void)
+static void setup_color(aliasent_t *ae)
 {
     int flags = glr.ent->flags;
+    vec_t *color = ae->color;
     float f, m;
     int i;
 
@@ -367,7 +536,7 @@ static void setup_color(void)
     } else {
         // MATHLIB: Quick workaround.
         vec3_t tempColor = { color[0], color[1], color[2] };
-        GL_LightPoint(origin, tempColor);
+        GL_LightPoint(ae->origin, tempColor);
         color[0] = tempColor[0];
         color[1] = tempColor[1];
         color[2] = tempColor[2];
@@ -405,12 +574,12 @@ static void setup_color(void)
     }
 }
 
-static void setup_celshading(void)
+static void setup_celshading(aliasent_t *ae)
 {
     float value = Cvar_ClampValue(gl_celshading, 0, 10);
     vec3_t dir;
 
-    celscale = 0;
+    ae->celscale = 0;
 
     if (value == 0)
         return;
@@ -418,23 +587,23 @@ static void setup_celshading(void)
     if (glr.ent->flags & (RenderEffects::Translucent | RF_SHELL_MASK))
         return;
 
-    VectorSubtract(origin, glr.fd.vieworg, dir);
-    celscale = 1.0f - VectorLength(dir) / 700.0f;
+    VectorSubtract(ae->origin, glr.fd.vieworg, dir);
+    ae->celscale = 1.0f - VectorLength(dir) / 700.0f;
 }
 
-static void draw_celshading(maliasmesh_t *mesh)
+static void draw_celshading(const aliasent_t *ae, maliasmesh_t *mesh)
 {
-    if (celscale < 0.01f || celscale > 1)
+    if (ae->celscale < 0.01f || ae->celscale > 1)
         return;
 
     GL_BindTexture(0, TEXNUM_BLACK);
     GL_StateBits(GLS_BLEND_BLEND);
     GL_ArrayBits(GLA_VERTEX);
 
-    qglLineWidth(gl_celshading->value * celscale);
+    qglLineWidth(gl_celshading->value * ae->celscale);
     qglPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     qglCullFace(GL_FRONT);
-    qglColor4f(0, 0, 0, color[3] * celscale);
+    qglColor4f(0, 0, 0, ae->color[3] * ae->celscale);
     qglDrawElements(GL_TRIANGLES, mesh->numindices, QGL_INDEX_ENUM,
                     mesh->indices);
     qglCullFace(GL_BACK);
@@ -442,13 +611,13 @@ static void draw_celshading(maliasmesh_t *mesh)
     qglLineWidth(1);
 }
 
-static void setup_shadow(void)
+static void setup_shadow(aliasent_t *ae)
 {
     GLfloat matrix[16], tmp[16];
     cplane_t *plane;
     vec3_t dir;
 
-    shadowmatrix[15] = 0;
+    ae->shadowmatrix[15] = 0;
 
     if (!gl_shadows->integer)
         return;
@@ -494,33 +663,33 @@ static void setup_shadow(void)
     matrix[0] = glr.entaxis[0][0];
     matrix[4] = glr.entaxis[1][0];
     matrix[8] = glr.entaxis[2][0];
-    matrix[12] = origin[0];
+    matrix[12] = ae->origin[0];
 
     matrix[1] = glr.entaxis[0][1];
     matrix[5] = glr.entaxis[1][1];
     matrix[9] = glr.entaxis[2][1];
-    matrix[13] = origin[1];
+    matrix[13] = ae->origin[1];
 
     matrix[2] = glr.entaxis[0][2];
     matrix[6] = glr.entaxis[1][2];
     matrix[10] = glr.entaxis[2][2];
-    matrix[14] = origin[2];
+    matrix[14] = ae->origin[2];
 
     matrix[3] = 0;
     matrix[7] = 0;
     matrix[11] = 0;
     matrix[15] = 1;
 
-    GL_MultMatrix(shadowmatrix, tmp, matrix);
+    GL_MultMatrix(ae->shadowmatrix, tmp, matrix);
 }
 
-static void draw_shadow(maliasmesh_t *mesh)
+static void draw_shadow(const aliasent_t *ae, maliasmesh_t *mesh)
 {
-    if (shadowmatrix[15] < 0.5f)
+    if (ae->shadowmatrix[15] < 0.5f)
         return;
 
     // load shadow projection matrix
-    GL_LoadMatrix(shadowmatrix);
+    GL_LoadMatrix(ae->shadowmatrix);
 
     // eliminate z-fighting by utilizing stencil buffer, if available
     if (gl_config.stencilbits) {
@@ -535,7 +704,7 @@ static void draw_shadow(maliasmesh_t *mesh)
 
     qglEnable(GL_POLYGON_OFFSET_FILL);
     qglPolygonOffset(-1.0f, -2.0f);
-    qglColor4f(0, 0, 0, color[3] * 0.5f);
+    qglColor4f(0, 0, 0, ae->color[3] * 0.5f);
     qglDrawElements(GL_TRIANGLES, mesh->numindices, QGL_INDEX_ENUM,
                     mesh->indices);
     qglDisable(GL_POLYGON_OFFSET_FILL);
@@ -573,14 +742,15 @@ static int texnum_for_mesh(maliasmesh_t *mesh)
     return mesh->skins[ent->skinNumber]->texnum;
 }
 
-static void draw_alias_mesh(maliasmesh_t *mesh)
+// vertices are already tessellated if the entity was prepared
+static void draw_alias_mesh(const aliasent_t *ae, maliasmesh_t *mesh, vec_t *vertices)
 {
     glStateBits_t state = GLS_DEFAULT;
 
     // fall back to entity matrix
     GL_LoadMatrix(glr.entmatrix);
 
-    if (shadelight)
+    if (ae->shadelight)
         state = (glStateBits_t)(state | GLS_SHADE_SMOOTH); // CPP: Bitflag cast
 
     if (glr.ent->flags & RenderEffects::Translucent)
@@ -590,17 +760,20 @@ static void draw_alias_mesh(maliasmesh_t *mesh)
 
     GL_BindTexture(0, texnum_for_mesh(mesh));
 
-    (*tessfunc)(mesh);
+    if (!vertices) {
+        vertices = tess.vertices;
+        (*ae->tessfunc)(ae, mesh, 0, mesh->numverts, vertices);
+    }
     c.trisDrawn += mesh->numtris;
 
-    if (shadelight) {
+    if (ae->shadelight) {
         GL_ArrayBits((glArrayBits_t)(GLA_VERTEX | GLA_TC | GLA_COLOR)); // CPP: Cast
-        GL_VertexPointer(3, VERTEX_SIZE, tess.vertices);
-        GL_ColorFloatPointer(4, VERTEX_SIZE, tess.vertices + 4);
+        GL_VertexPointer(3, VERTEX_SIZE, vertices);
+        GL_ColorFloatPointer(4, VERTEX_SIZE, vertices + 4);
     } else {
         GL_ArrayBits((glArrayBits_t)(GLA_VERTEX | GLA_TC)); // CPP: Cast
-        GL_VertexPointer(3, 4, tess.vertices);
-        qglColor4fv(color);
+        GL_VertexPointer(3, 4, vertices);
+        qglColor4fv(ae->color);
     }
 
     GL_TexCoordPointer(2, 0, (GLfloat *)mesh->tcoords);
@@ -610,7 +783,7 @@ static void draw_alias_mesh(maliasmesh_t *mesh)
     qglDrawElements(GL_TRIANGLES, mesh->numindices, QGL_INDEX_ENUM,
                     mesh->indices);
 
-    draw_celshading(mesh);
+    draw_celshading(ae, mesh);
 
     if (gl_showtris->integer) {
         GL_EnableOutlines();
@@ -620,76 +793,242 @@ static void draw_alias_mesh(maliasmesh_t *mesh)
     }
 
     // FIXME: unlock arrays before changing matrix?
-    draw_shadow(mesh);
+    draw_shadow(ae, mesh);
 
     GL_UnlockArrays();
 }
 
-void GL_DrawAliasModel(model_t *model)
+// culls the entity and sets up everything for tessellation and drawing,
+// returns false if it is not visible
+static qboolean setup_alias_model(aliasent_t *ae, model_t *model)
 {
     r_entity_t *ent = glr.ent;
     glCullResult_t cull;
-    int i;
 
-    newframenum = ent->frame;
-    if (newframenum < 0 || newframenum >= model->numframes) {
-        Com_DPrintf("%s: no such frame %d\n", __func__, newframenum);
-        newframenum = 0;
+    ae->newframenum = ent->frame;
+    if (ae->newframenum < 0 || ae->newframenum >= model->numframes) {
+        Com_DPrintf("%s: no such frame %d\n", "GL_DrawAliasModel", ae->newframenum);
+        ae->newframenum = 0;
     }
 
-    oldframenum = ent->oldframe;
-    if (oldframenum < 0 || oldframenum >= model->numframes) {
-        Com_DPrintf("%s: no such oldframe %d\n", __func__, oldframenum);
-        oldframenum = 0;
+    ae->oldframenum = ent->oldframe;
+    if (ae->oldframenum < 0 || ae->oldframenum >= model->numframes) {
+        Com_DPrintf("%s: no such oldframe %d\n", "GL_DrawAliasModel", ae->oldframenum);
+        ae->oldframenum = 0;
     }
 
-    backlerp = ent->backlerp;
-    frontlerp = 1.0f - backlerp;
+    ae->backlerp = ent->backlerp;
+    ae->frontlerp = 1.0f - ae->backlerp;
 
     // optimized case
-    if (backlerp == 0)
-        oldframenum = newframenum;
+    if (ae->backlerp == 0)
+        ae->oldframenum = ae->newframenum;
 
     // interpolate origin, if necessarry
     if (ent->flags & RenderEffects::FrameLerp)
         LerpVector2(ent->oldorigin, ent->origin,
-                    backlerp, frontlerp, origin);
+                    ae->backlerp, ae->frontlerp, ae->origin);
     else
-        VectorCopy(ent->origin, origin);
+        VectorCopy(ent->origin, ae->origin);
 
     // cull the model, setup scale and translate vectors
-    if (newframenum == oldframenum)
-        cull = cull_static_model(model);
+    if (ae->newframenum == ae->oldframenum)
+        cull = cull_static_model(ae, model);
     else
-        cull = cull_lerped_model(model);
+        cull = cull_lerped_model(ae, model);
     if (cull == CULL_OUT)
-        return;
+        return false;
 
     // setup parameters common for all meshes
-    setup_color();
-    setup_celshading();
-    setup_dotshading();
-    setup_shadow();
+    setup_color(ae);
+    setup_celshading(ae);
+    setup_dotshading(ae);
+    setup_shadow(ae);
 
     // select proper tessfunc
     if (ent->flags & RF_SHELL_MASK) {
-        shellscale = (ent->flags & RenderEffects::WeaponModel) ?
+        ae->shellscale = (ent->flags & RenderEffects::WeaponModel) ?
             WEAPONSHELL_SCALE : POWERSUIT_SCALE;
-        tessfunc = newframenum == oldframenum ?
+        ae->tessfunc = ae->newframenum == ae->oldframenum ?
             tess_static_shell : tess_lerped_shell;
-    } else if (shadelight) {
-        tessfunc = newframenum == oldframenum ?
+        ae->stride = 4;
+    } else if (ae->shadelight) {
+        ae->tessfunc = ae->newframenum == ae->oldframenum ?
             tess_static_shade : tess_lerped_shade;
+        ae->stride = VERTEX_SIZE;
     } else {
-        tessfunc = newframenum == oldframenum ?
+        ae->tessfunc = ae->newframenum == ae->oldframenum ?
             tess_static_plain : tess_lerped_plain;
+        ae->stride = 4;
+    }
+
+    return true;
+}
+
+/*
+=============================================================
+
+ALIAS MODEL PREPARATION
+
+Vertices of all visible alias models are tessellated up front, in chunks
+spread across the job threads. Drawing stays on the main thread and only
+submits the prepared vertices.
+
+=============================================================
+*/
+
+// vertices per job
+#define TESS_CHUNK_VERTS    1024
+
+typedef struct {
+    const aliasent_t    *ae;
+    const maliasmesh_t  *mesh;
+    int                 first;
+    int                 count;
+    size_t              offset;     // of the mesh in alias_verts
+} tessjob_t;
+
+static vec_t        *alias_verts;
+static size_t       alias_maxverts;     // in floats
+static tessjob_t    *alias_jobs;
+static int          alias_maxjobs;
+
+static void tess_job(void *arg, int index)
+{
+    const tessjob_t *job = &((const tessjob_t *)arg)[index];
+
+    (*job->ae->tessfunc)(job->ae, job->mesh, job->first, job->count,
+                         alias_verts + job->offset);
+}
+
+/*
+=============
+GL_PrepareAliasModel
+
+Called on the main thread with glr.ent and entity axis set up.
+=============
+*/
+void GL_PrepareAliasModel(model_t *model)
+{
+    aliasent_t *ae = &alias_ents[glr.ent - glr.fd.entities];
+
+    ae->drawframe = glr.drawframe;
+    ae->vertices = NULL;
+    ae->culled = !setup_alias_model(ae, model);
+}
+
+/*
+=============
+GL_TessellateAliasModels
+
+Runs the tessellation jobs for every entity prepared this frame and
+waits for them to finish.
+=============
+*/
+void GL_TessellateAliasModels(void)
+{
+    size_t size = 0, offset;
+    int i, j, first, numjobs = 0;
+
+    // count vertices and jobs
+    for (i = 0; i < glr.fd.num_entities; i++) {
+        const aliasent_t *ae = &alias_ents[i];
+        const model_t *model;
+
+        if (ae->drawframe != glr.drawframe || ae->culled)
+            continue;
+
+        model = MOD_ForHandle(glr.fd.entities[i].model);
+        for (j = 0; j < model->nummeshes; j++) {
+            size += model->meshes[j].numverts * ae->stride;
+            numjobs += (model->meshes[j].numverts + TESS_CHUNK_VERTS - 1) / TESS_CHUNK_VERTS;
+        }
+    }
+
+    if (!numjobs)
+        return;
+
+    // the 4th float of the last vertex may be written too
+    size += 4;
+    if (size > alias_maxverts) {
+        alias_maxverts = size + size / 2;
+        Z_Free(alias_verts);
+        alias_verts = (vec_t *)Z_TagMalloc(alias_maxverts * sizeof(vec_t), TAG_RENDERER);
+    }
+    if (numjobs > alias_maxjobs) {
+        alias_maxjobs = numjobs + numjobs / 2;
+        Z_Free(alias_jobs);
+        alias_jobs = (tessjob_t *)Z_TagMalloc(alias_maxjobs * sizeof(tessjob_t), TAG_RENDERER);
+    }
+
+    // split meshes into jobs
+    offset = 0;
+    numjobs = 0;
+    for (i = 0; i < glr.fd.num_entities; i++) {
+        aliasent_t *ae = &alias_ents[i];
+        const model_t *model;
+
+        if (ae->drawframe != glr.drawframe || ae->culled)
+            continue;
+
+        ae->vertices = alias_verts + offset;
+
+        model = MOD_ForHandle(glr.fd.entities[i].model);
+        for (j = 0; j < model->nummeshes; j++) {
+            const maliasmesh_t *mesh = &model->meshes[j];
+
+            for (first = 0; first < mesh->numverts; first += TESS_CHUNK_VERTS) {
+                tessjob_t *job = &alias_jobs[numjobs++];
+                job->ae = ae;
+                job->mesh = mesh;
+                job->first = first;
+                job->count = min(mesh->numverts - first, TESS_CHUNK_VERTS);
+                job->offset = offset;
+            }
+
+            offset += mesh->numverts * ae->stride;
+        }
+    }
+
+    Job_ParallelFor(tess_job, alias_jobs, numjobs, JOB_PRIORITY_HIGH);
+}
+
+void GL_ShutdownMeshes(void)
+{
+    Z_Free(alias_verts);
+    alias_verts = NULL;
+    alias_maxverts = 0;
+
+    Z_Free(alias_jobs);
+    alias_jobs = NULL;
+    alias_maxjobs = 0;
+
+    // glr.drawframe may start over
+    memset(alias_ents, 0, sizeof(alias_ents));
+}
+
+void GL_DrawAliasModel(model_t *model)
+{
+    r_entity_t *ent = glr.ent;
+    aliasent_t *ae = &alias_ents[ent - glr.fd.entities];
+    vec_t *vertices;
+    int i;
+
+    if (ae->drawframe == glr.drawframe) {
+        if (ae->culled)
+            return;
+        vertices = ae->vertices;
+    } else {
+        if (!setup_alias_model(ae, model))
+            return;
+        vertices = NULL;
     }
 
 	float scale = 1.f;
 	if (ent->scale > 0.f)
 		scale = ent->scale;
 
-    GL_RotateForEntity(origin, scale);
+    GL_RotateForEntity(ae->origin, scale);
 
     if ((ent->flags & (RenderEffects::WeaponModel | RF_LEFTHAND)) ==
         (RenderEffects::WeaponModel | RF_LEFTHAND)) {
@@ -703,8 +1042,11 @@ void GL_DrawAliasModel(model_t *model)
         qglDepthRange(0, 0.25f);
 
     // draw all the meshes
-    for (i = 0; i < model->nummeshes; i++)
-        draw_alias_mesh(&model->meshes[i]);
+    for (i = 0; i < model->nummeshes; i++) {
+        draw_alias_mesh(ae, &model->meshes[i], vertices);
+        if (vertices)
+            vertices += model->meshes[i].numverts * ae->stride;
+    }
 
     if (ent->flags & RenderEffects::DepthHack)
         qglDepthRange(0, 1);
@@ -717,4 +1059,3 @@ void GL_DrawAliasModel(model_t *model)
         qglFrontFace(GL_CW);
     }
 }
-
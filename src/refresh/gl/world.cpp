@@ -552,6 +552,8 @@ static void GL_WorldNode_r(mnode_t *node, int clipflags)
 
 void GL_DrawWorld(void)
 {
+    PROF_ZONE("GL_DrawWorld");
+
     // auto cycle the world frame for texture animation
     gl_world.frame = (int)(glr.fd.time * 2);
 
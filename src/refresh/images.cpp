@@ -340,11 +340,15 @@ STB_IMAGE LOADING
 =================================================================
 */
 
-IMG_LOAD(STB)
-{
-	int w, h, channels;
-	byte* data = stbi_load_from_memory(rawdata, rawlen, &w, &h, &channels, 4);
+// result of decoding on a job thread, see R_PrefetchImage
+typedef struct {
+    byte    *pic;
+    int     width, height, channels;
+} stbdecoded_t;
 
+static qerror_t IMG_SetSTB(byte *data, int w, int h, int channels,
+                           image_t *image, byte **pic)
+{
 	if (!data)
 		return Q_ERR_LIBRARY_ERROR;
 
@@ -359,6 +363,50 @@ IMG_LOAD(STB)
     return Q_ERR_SUCCESS;
 }
 
+IMG_LOAD(STB)
+{
+	int w, h, channels;
+	byte* data = stbi_load_from_memory(rawdata, rawlen, &w, &h, &channels, 4);
+
+	return IMG_SetSTB(data, w, h, channels, image, pic);
+}
+
+// runs on a job thread
+static void *IMG_DecodeSTB(const void *rawdata, size_t rawlen, size_t *size)
+{
+    stbdecoded_t *dec = (stbdecoded_t *)Z_Mallocz(sizeof(*dec));
+
+    dec->pic = stbi_load_from_memory((const stbi_uc *)rawdata, rawlen,
+                                     &dec->width, &dec->height, &dec->channels, 4);
+    if (dec->pic) {
+        *size = sizeof(*dec) + (size_t)dec->width * dec->height * 4;
+    } else {
+        *size = sizeof(*dec);
+    }
+
+    return dec;
+}
+
+static void IMG_FreeDecoded(void *decoded)
+{
+    stbdecoded_t *dec = (stbdecoded_t *)decoded;
+
+    if (dec->pic)
+        stbi_image_free(dec->pic);
+    Z_Free(dec);
+}
+
+static qerror_t IMG_LoadDecoded(void *decoded, image_t *image, byte **pic)
+{
+    stbdecoded_t *dec = (stbdecoded_t *)decoded;
+    qerror_t ret;
+
+    ret = IMG_SetSTB(dec->pic, dec->width, dec->height, dec->channels, image, pic);
+    Z_Free(dec);
+
+    return ret;
+}
+
 
 /*
 =================================================================
@@ -793,14 +841,15 @@ static image_t *lookup_image(const char *name,
 static int _try_image_format(imageformat_t fmt, image_t* image, int try_src, byte** pic)
 {
     byte* data;
+    void*       decoded;
     ssize_t     len;
     qerror_t    ret;
 
-    // load the file
+    // load the file, it may already have been read and decoded by R_PrefetchImage
     int fs_flags = 0;
     if (try_src > 0)
         fs_flags = try_src == TRY_IMAGE_SRC_GAME ? FS_PATH_GAME : FS_PATH_BASE;
-    len = FS_LoadFileFlags(image->name, (void**)&data, fs_flags);
+    len = FS_LoadPrefetched(image->name, (void**)&data, fs_flags, &decoded);
     if (!data) {
         return len;
     }
@@ -816,6 +865,8 @@ static int _try_image_format(imageformat_t fmt, image_t* image, int try_src, byt
         len_base = FS_LoadFileFlags(image->name, (void**)&data_base, FS_PATH_BASE);
         if ((len == len_base) && (memcmp(data, data_base, len) == 0)) {
             // Identical data in game, pretend file doesn't exist
+            if (decoded)
+                IMG_FreeDecoded(decoded);
             FS_FreeFile(data);
             FS_FreeFile(data_base);
             return Q_ERR_NOENT;
@@ -824,7 +875,10 @@ static int _try_image_format(imageformat_t fmt, image_t* image, int try_src, byt
     }
 
     // decompress the image
-    ret = img_loaders[fmt].load(data, len, image, pic);
+    if (decoded)
+        ret = IMG_LoadDecoded(decoded, image, pic);
+    else
+        ret = img_loaders[fmt].load(data, len, image, pic);
 
     FS_FreeFile(data);
 
@@ -1378,6 +1432,135 @@ fail:
     return 0;
 }
 
+// queues a single candidate file, returns false if it doesn't exist
+static qboolean prefetch_image_format(char *name, size_t baselen, imageformat_t fmt,
+                                      int try_src, int priority)
+{
+    unsigned fs_flags = 0;
+    if (try_src > 0)
+        fs_flags = try_src == TRY_IMAGE_SRC_GAME ? FS_PATH_GAME : FS_PATH_BASE;
+
+    memcpy(name + baselen + 1, img_loaders[fmt].ext, 4);
+
+    // 32-bit formats are decoded on the job thread as well
+    if (img_loaders[fmt].load == IMG_LoadSTB)
+        return FS_PrefetchFile(name, fs_flags, priority, IMG_DecodeSTB, IMG_FreeDecoded);
+
+    return FS_PrefetchFile(name, fs_flags, priority, NULL, NULL);
+}
+
+// same search order as try_load_image_candidate
+static qboolean prefetch_image_candidate(char *name, size_t baselen, imagetype_t type,
+                                         imageflags_t flags, qboolean ignore_extension,
+                                         int try_src, int priority)
+{
+    int32_t fmt, orig;
+    int     i;
+
+    for (orig = 0; orig < IM_MAX; orig++) {
+        if (!Q_stricmp(name + baselen + 1, img_loaders[orig].ext)) {
+            break;
+        }
+    }
+
+    if (orig == IM_MAX || ignore_extension) {
+        orig = IM_MAX;
+    } else {
+        if (prefetch_image_format(name, baselen, (imageformat_t)orig, try_src, priority))
+            return true;
+        if (flags & IF_EXACT)
+            return false;
+    }
+
+    for (i = 0; i < img_total; i++) {
+        fmt = img_search[i];
+        if (fmt == orig)
+            continue;
+        if (prefetch_image_format(name, baselen, (imageformat_t)fmt, try_src, priority))
+            return true;
+    }
+
+    fmt = (type == IT_WALL) ? IM_WAL : IM_PCX;
+    if (fmt == orig)
+        return false;
+
+    return prefetch_image_format(name, baselen, (imageformat_t)fmt, try_src, priority);
+}
+
+/*
+===============
+R_PrefetchImage
+
+Takes the same arguments as R_RegisterImage and queues the files that
+find_or_load_image is going to try, up to the first one that exists,
+to be read and decoded ahead on the job threads.
+===============
+*/
+void R_PrefetchImage(const char *name, imagetype_t type, imageflags_t flags, int priority)
+{
+    char        fullname[MAX_QPATH];
+    char        buffer[MAX_QPATH];
+    size_t      len;
+
+    if (!*name || !r_numImages) {
+        return;
+    }
+
+    if (type == IT_SKIN) {
+        len = FS_NormalizePathBuffer(fullname, name, sizeof(fullname));
+    } else if (*name == '/' || *name == '\\') {
+        len = FS_NormalizePathBuffer(fullname, name + 1, sizeof(fullname));
+    } else {
+        len = Q_concat(fullname, sizeof(fullname), "pics/", name, NULL);
+        if (len >= sizeof(fullname)) {
+            return;
+        }
+        FS_NormalizePath(fullname, fullname);
+        len = COM_DefaultExtension(fullname, ".pcx", sizeof(fullname));
+    }
+
+    if (len >= sizeof(fullname) || len <= 4 || fullname[len - 4] != '.') {
+        return;
+    }
+
+    // already registered
+    if (lookup_image(fullname, type, FS_HashPathLen(fullname, len - 4, RIMAGES_HASH), len - 4)) {
+        return;
+    }
+
+    int override_textures = !!r_override_textures->integer;
+    if (!vid_rtx->integer && (type != IT_PIC))
+        override_textures = 0;
+    if (flags & IF_EXACT)
+        override_textures = 0;
+
+    if (override_textures) {
+        const char *last_slash = strrchr(fullname, '/');
+        if (!last_slash)
+            last_slash = fullname;
+        else
+            last_slash += 1;
+
+        if (Q_concat(buffer, sizeof(buffer), "overrides/", last_slash, NULL) < sizeof(buffer) &&
+            prefetch_image_candidate(buffer, strlen(buffer) - 4, type, flags, true, -1, priority))
+            return;
+    }
+
+    qboolean is_not_baseq2 = fs_game->string[0] && strcmp(fs_game->string, BASEGAME) != 0;
+
+    for (int try_location = is_not_baseq2 ? TRY_IMAGE_SRC_GAME : TRY_IMAGE_SRC_BASE;
+        try_location >= TRY_IMAGE_SRC_BASE;
+        try_location--) {
+        int location_flag = try_location == TRY_IMAGE_SRC_GAME ? IF_SRC_GAME : IF_SRC_BASE;
+        if (((flags & IF_SRC_MASK) != 0) && ((flags & IF_SRC_MASK) != location_flag))
+            continue;
+
+        memcpy(buffer, fullname, len + 1);
+        if (prefetch_image_candidate(buffer, len - 4, type, flags, !!override_textures, try_location, priority))
+            return;
+    }
+}
+
 qhandle_t R_RegisterRawImage(const char *name, int width, int height, byte* pic, imagetype_t type, imageflags_t flags)
 {
     image_t         *image;
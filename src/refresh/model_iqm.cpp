@@ -26,6 +26,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <format/iqm.h>
 #include <refresh/models.h>
 #include <refresh/refresh.h>
+#include <common/cmd.h>
+#include <common/common.h>
+#include <common/zone.h>
+#include <system/system.h>
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
 
 static qboolean IQM_CheckRange(const iqmHeader_t* header, uint32_t offset, uint32_t count, size_t size) {
 	// return true if the range specified by offset, count and size
@@ -668,20 +676,16 @@ qerror_t MOD_LoadIQM_Base(model_t* model, const void* rawdata, size_t length, co
 
 /*
 =================
-R_ComputeIQMTransforms
+IQM_ComputePoseScalar
 
-Compute matrices for this model, returns [model->num_poses] 3x4 matrices in the (pose_matrices) array
+Reference implementation, also used when SSE2 isn't available.
 =================
 */
-qboolean R_ComputeIQMTransforms(const iqm_model_t* model, const r_entity_t* entity, float* pose_matrices) {
+static void IQM_ComputePoseScalar(const iqm_model_t* model, int frame, int oldframe, float backlerp, float* pose_matrices) {
 	iqm_transform_t relativeJoints[IQM_MAX_JOINTS];
 
 	iqm_transform_t* relativeJoint = relativeJoints;
 
-	const int frame = model->num_frames ? entity->frame % (int)model->num_frames : 0;
-	const int oldframe = model->num_frames ? entity->oldframe % (int)model->num_frames : 0;
-	const float backlerp = entity->backlerp;
-
 	// copy or lerp animation frame pose
 	if (oldframe == frame) {
 		const iqm_transform_t* pose = &model->poses[frame * model->num_poses];
@@ -725,6 +729,387 @@ qboolean R_ComputeIQMTransforms(const iqm_model_t* model, const r_entity_t* enti
 			Matrix34Multiply(mat1, invBindMat, poseMat);
 		}
 	}
+}
+
+#if USE_SSE2
+
+// same as Matrix34Multiply, one row of the result per register
+static inline void Matrix34MultiplySSE(const float* a, const float* b, float* out) {
+	const __m128 b0 = _mm_loadu_ps(b + 0);
+	const __m128 b1 = _mm_loadu_ps(b + 4);
+	const __m128 b2 = _mm_loadu_ps(b + 8);
+	const __m128 b3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (int row = 0; row < 3; row++, a += 4, out += 4) {
+		__m128 r = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[1]), b1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[2]), b2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[3]), b3));
+		_mm_storeu_ps(out, r);
+	}
+}
+
+// loads one component of up to 4 consecutive transforms into the lanes of a register,
+// missing lanes repeat the last transform
+static inline __m128 IQM_GatherJoints(const iqm_transform_t* t, int count, int component) {
+	alignas(16) float v[4];
+	for (int lane = 0; lane < 4; lane++) {
+		const float* f = (const float*)&t[lane < count ? lane : count - 1];
+		v[lane] = f[component];
+	}
+	return _mm_load_ps(v);
+}
+
+/*
+=================
+IQM_JointsToMatrices
+
+Lerps 4 joints at a time, a component per register (translate 0-2,
+rotate 3-6, scale 7-9), and turns them into 3x4 matrices.
+=================
+*/
+static void IQM_JointsToMatrices(const iqm_transform_t* oldpose, const iqm_transform_t* pose, int count,
+	float backlerp, float* mats) {
+	__m128 t[10];
+
+	for (int c = 0; c < 10; c++)
+		t[c] = IQM_GatherJoints(pose, count, c);
+
+	if (oldpose) {
+		const float lerp = 1.0f - backlerp;
+		const __m128 vbacklerp = _mm_set1_ps(backlerp);
+		const __m128 vlerp = _mm_set1_ps(lerp);
+		__m128 f[10];
+
+		for (int c = 0; c < 10; c++)
+			f[c] = IQM_GatherJoints(oldpose, count, c);
+
+		// translate and scale
+		for (int c = 0; c < 3; c++) {
+			t[c] = _mm_add_ps(_mm_mul_ps(f[c], vbacklerp), _mm_mul_ps(t[c], vlerp));
+			t[7 + c] = _mm_add_ps(_mm_mul_ps(f[7 + c], vbacklerp), _mm_mul_ps(t[7 + c], vlerp));
+		}
+
+		// rotate, flipping the sign of 'to' to take the shortest path
+		__m128 cosAngle = _mm_mul_ps(f[3], t[3]);
+		cosAngle = _mm_add_ps(cosAngle, _mm_mul_ps(f[4], t[4]));
+		cosAngle = _mm_add_ps(cosAngle, _mm_mul_ps(f[5], t[5]));
+		cosAngle = _mm_add_ps(cosAngle, _mm_mul_ps(f[6], t[6]));
+
+		const __m128 sign = _mm_and_ps(cosAngle, _mm_set1_ps(-0.0f));
+		cosAngle = _mm_xor_ps(cosAngle, sign);
+		for (int c = 3; c < 7; c++)
+			t[c] = _mm_xor_ps(t[c], sign);
+
+		// the trig only depends on the angle, do it per lane
+		alignas(16) float cosines[4], fromWeights[4], toWeights[4];
+		_mm_store_ps(cosines, cosAngle);
+		for (int lane = 0; lane < 4; lane++) {
+			if (cosines[lane] < 0.999999f) {
+				const float angle = acosf(cosines[lane]);
+				const float sinAngle = sinf(angle);
+				fromWeights[lane] = sinf((1.0f - lerp) * angle) / sinAngle;
+				toWeights[lane] = sinf(lerp * angle) / sinAngle;
+			} else {
+				fromWeights[lane] = 1.0f - lerp;
+				toWeights[lane] = lerp;
+			}
+		}
+
+		const __m128 vfrom = _mm_load_ps(fromWeights);
+		const __m128 vto = _mm_load_ps(toWeights);
+		for (int c = 3; c < 7; c++)
+			t[c] = _mm_add_ps(_mm_mul_ps(f[c], vfrom), _mm_mul_ps(t[c], vto));
+	}
+
+	// JointToMatrix
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 x2 = _mm_mul_ps(two, t[3]);
+	const __m128 y2 = _mm_mul_ps(two, t[4]);
+	const __m128 z2 = _mm_mul_ps(two, t[5]);
+	const __m128 w2 = _mm_mul_ps(two, t[6]);
+	const __m128 xx = _mm_mul_ps(x2, t[3]);
+	const __m128 yy = _mm_mul_ps(y2, t[4]);
+	const __m128 zz = _mm_mul_ps(z2, t[5]);
+	const __m128 xy = _mm_mul_ps(x2, t[4]);
+	const __m128 xz = _mm_mul_ps(x2, t[5]);
+	const __m128 yz = _mm_mul_ps(y2, t[5]);
+	const __m128 wx = _mm_mul_ps(w2, t[3]);
+	const __m128 wy = _mm_mul_ps(w2, t[4]);
+	const __m128 wz = _mm_mul_ps(w2, t[5]);
+
+	__m128 m[12];
+	m[0] = _mm_mul_ps(t[7], _mm_sub_ps(one, _mm_add_ps(yy, zz)));
+	m[1] = _mm_mul_ps(t[7], _mm_sub_ps(xy, wz));
+	m[2] = _mm_mul_ps(t[7], _mm_add_ps(xz, wy));
+	m[3] = t[0];
+	m[4] = _mm_mul_ps(t[8], _mm_add_ps(xy, wz));
+	m[5] = _mm_mul_ps(t[8], _mm_sub_ps(one, _mm_add_ps(xx, zz)));
+	m[6] = _mm_mul_ps(t[8], _mm_sub_ps(yz, wx));
+	m[7] = t[1];
+	m[8] = _mm_mul_ps(t[9], _mm_sub_ps(xz, wy));
+	m[9] = _mm_mul_ps(t[9], _mm_add_ps(yz, wx));
+	m[10] = _mm_mul_ps(t[9], _mm_sub_ps(one, _mm_add_ps(xx, yy)));
+	m[11] = t[2];
+
+	// back to one matrix per joint
+	for (int row = 0; row < 3; row++) {
+		__m128 r0 = m[row * 4 + 0], r1 = m[row * 4 + 1], r2 = m[row * 4 + 2], r3 = m[row * 4 + 3];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(mats + 0 * 12 + row * 4, r0);
+		if (count > 1) _mm_storeu_ps(mats + 1 * 12 + row * 4, r1);
+		if (count > 2) _mm_storeu_ps(mats + 2 * 12 + row * 4, r2);
+		if (count > 3) _mm_storeu_ps(mats + 3 * 12 + row * 4, r3);
+	}
+}
+
+/*
+=================
+IQM_ComputePoseSSE
+
+Same as IQM_ComputePoseScalar. Joint lerps and local matrices don't depend
+on each other and are done in batches, only the final multiply by the parent
+pose has to walk the hierarchy in order.
+=================
+*/
+static void IQM_ComputePoseSSE(const iqm_model_t* model, int frame, int oldframe, float backlerp, float* pose_matrices) {
+	alignas(16) float localMats[IQM_MAX_JOINTS * 12];
+	const iqm_transform_t* pose = &model->poses[frame * model->num_poses];
+	const iqm_transform_t* oldpose = oldframe == frame ? NULL : &model->poses[oldframe * model->num_poses];
+	const uint32_t num_poses = model->num_poses;
+
+	for (uint32_t pose_idx = 0; pose_idx < num_poses; pose_idx += 4) {
+		const int count = (int)min(num_poses - pose_idx, 4u);
+		IQM_JointsToMatrices(oldpose ? oldpose + pose_idx : NULL, pose + pose_idx, count, backlerp, localMats + pose_idx * 12);
+	}
+
+	// multiply by inverse of bind pose and parent bind pose
+	for (uint32_t pose_idx = 0; pose_idx < num_poses; pose_idx++) {
+		const int parent = model->jointParents[pose_idx];
+		float* localMat = localMats + pose_idx * 12;
+		const float* invBindMat = model->invBindJoints + pose_idx * 12;
+		float mat[12];
+
+		if (parent >= 0) {
+			Matrix34MultiplySSE(&model->bindJoints[parent * 12], localMat, mat);
+			Matrix34MultiplySSE(mat, invBindMat, localMat);
+		} else {
+			Matrix34MultiplySSE(localMat, invBindMat, pose_matrices + pose_idx * 12);
+		}
+	}
+
+	// walk the hierarchy, parents always come before their children
+	for (uint32_t pose_idx = 0; pose_idx < num_poses; pose_idx++) {
+		const int parent = model->jointParents[pose_idx];
+		if (parent >= 0) {
+			Matrix34MultiplySSE(&pose_matrices[parent * 12], localMats + pose_idx * 12, pose_matrices + pose_idx * 12);
+		}
+	}
+}
+
+#define IQM_ComputePose IQM_ComputePoseSSE
+
+#else
+
+#define IQM_ComputePose IQM_ComputePoseScalar
+
+#endif // USE_SSE2
+
+/*
+=================
+IQM POSE CACHE
+
+Crowds of the same model tend to play the same animation, so the matrices
+of each (model, frame, oldframe, backlerp) are kept for the rest of the
+frame. backlerp is quantized so that nearly identical poses are shared.
+=================
+*/
+
+#define IQM_BACKLERP_STEPS          256
+#define IQM_POSE_CACHE_SIZE         256     // power of two
+#define IQM_POSE_CACHE_MATRICES     4096
+
+typedef struct {
+	const iqm_model_t* model;
+	int frame;
+	int oldframe;
+	int backlerp;   // quantized
+	unsigned framenum;
+	float* matrices;
+} iqm_pose_cache_t;
+
+static iqm_pose_cache_t iqm_pose_cache[IQM_POSE_CACHE_SIZE];
+static float iqm_pose_pool[IQM_POSE_CACHE_MATRICES * 12];
+static uint32_t iqm_pose_pool_used;
+static unsigned iqm_pose_framenum = 1;
+
+/*
+=================
+R_ResetIQMPoseCache
+
+Called by the renderer before it evaluates the entities of a frame.
+=================
+*/
+void R_ResetIQMPoseCache(void) {
+	iqm_pose_framenum++;
+	iqm_pose_pool_used = 0;
+}
+
+// returns the quantized backlerp, frame == oldframe when not lerping
+static int IQM_PoseKey(const iqm_model_t* model, const r_entity_t* entity, int* frame_p, int* oldframe_p) {
+	int frame = model->num_frames ? entity->frame % (int)model->num_frames : 0;
+	int oldframe = model->num_frames ? entity->oldframe % (int)model->num_frames : 0;
+	int backlerp = (int)(Clampf(entity->backlerp, 0.0f, 1.0f) * IQM_BACKLERP_STEPS + 0.5f);
+
+	if (backlerp == IQM_BACKLERP_STEPS)
+		frame = oldframe;
+	if (backlerp == 0 || backlerp == IQM_BACKLERP_STEPS || frame == oldframe) {
+		oldframe = frame;
+		backlerp = 0;
+	}
+
+	*frame_p = frame;
+	*oldframe_p = oldframe;
+	return backlerp;
+}
+
+static iqm_pose_cache_t* IQM_FindPose(const iqm_model_t* model, int frame, int oldframe, int backlerp) {
+	unsigned hash = (unsigned)(((uintptr_t)model >> 4) * 31 + frame * 131 + oldframe * 17 + backlerp * 7);
+
+	for (int i = 0; i < IQM_POSE_CACHE_SIZE; i++, hash++) {
+		iqm_pose_cache_t* entry = &iqm_pose_cache[hash & (IQM_POSE_CACHE_SIZE - 1)];
+		if (entry->framenum != iqm_pose_framenum)
+			return entry;   // free slot
+		if (entry->model == model && entry->frame == frame && entry->oldframe == oldframe && entry->backlerp == backlerp)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+=================
+R_ComputeIQMTransforms
+
+Compute matrices for this model, returns [model->num_poses] 3x4 matrices in the (pose_matrices) array
+=================
+*/
+qboolean R_ComputeIQMTransforms(const iqm_model_t* model, const r_entity_t* entity, float* pose_matrices) {
+	int frame, oldframe;
+	const int backlerp = IQM_PoseKey(model, entity, &frame, &oldframe);
+	const size_t size = model->num_poses * 12 * sizeof(float);
+
+	iqm_pose_cache_t* entry = IQM_FindPose(model, frame, oldframe, backlerp);
+	if (entry && entry->framenum == iqm_pose_framenum) {
+		memcpy(pose_matrices, entry->matrices, size);
+		return true;
+	}
+
+	IQM_ComputePose(model, frame, oldframe, (float)backlerp / IQM_BACKLERP_STEPS, pose_matrices);
+
+	// keep it for the other entities, unless the pool is full
+	if (entry && iqm_pose_pool_used + model->num_poses <= IQM_POSE_CACHE_MATRICES) {
+		entry->model = model;
+		entry->frame = frame;
+		entry->oldframe = oldframe;
+		entry->backlerp = backlerp;
+		entry->framenum = iqm_pose_framenum;
+		entry->matrices = iqm_pose_pool + iqm_pose_pool_used * 12;
+		memcpy(entry->matrices, pose_matrices, size);
+		iqm_pose_pool_used += model->num_poses;
+	}
 
 	return true;
 }
+
+/*
+=================
+IQM_Bench_f
+
+Evaluates poses of many instances of an IQM model, groups of 8 instances
+share the same animation state.
+=================
+*/
+void IQM_Bench_f(void) {
+	if (Cmd_Argc() < 2) {
+		Com_Printf("Usage: %s <model> [instances] [iterations]\n", Cmd_Argv(0));
+		return;
+	}
+
+	const model_t* mod = MOD_ForHandle(R_RegisterModel(Cmd_Argv(1)));
+	if (!mod || !mod->iqmData || !mod->iqmData->num_poses) {
+		Com_Printf("%s is not an animated IQM model\n", Cmd_Argv(1));
+		return;
+	}
+
+	const iqm_model_t* model = mod->iqmData;
+	int instances = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 256;
+	int iterations = Cmd_Argc() > 3 ? atoi(Cmd_Argv(3)) : 100;
+	clamp(instances, 1, 65536);
+	clamp(iterations, 1, 100000);
+	const size_t count = model->num_poses * 12;
+
+	r_entity_t* entities = (r_entity_t*)Z_Mallocz(instances * sizeof(*entities));
+	float* reference = (float*)Z_Malloc(instances * count * sizeof(float));
+	float* matrices = (float*)Z_Malloc(instances * count * sizeof(float));
+
+	for (int i = 0; i < instances; i++) {
+		entities[i].frame = i / 8 + 1;
+		entities[i].oldframe = i / 8;
+		entities[i].backlerp = (float)((i / 8) % 5) * 0.2f + 0.1f;
+	}
+
+	unsigned start, scalar_msec, simd_msec, cached_msec;
+	int frame, oldframe, backlerp;
+
+	start = Sys_Milliseconds();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < instances; i++) {
+			backlerp = IQM_PoseKey(model, &entities[i], &frame, &oldframe);
+			IQM_ComputePoseScalar(model, frame, oldframe, (float)backlerp / IQM_BACKLERP_STEPS, reference + i * count);
+		}
+	}
+	scalar_msec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for (int n = 0; n < iterations; n++) {
+		for (int i = 0; i < instances; i++) {
+			backlerp = IQM_PoseKey(model, &entities[i], &frame, &oldframe);
+			IQM_ComputePose(model, frame, oldframe, (float)backlerp / IQM_BACKLERP_STEPS, matrices + i * count);
+		}
+	}
+	simd_msec = Sys_Milliseconds() - start;
+
+	float error = 0;
+	for (size_t i = 0; i < instances * count; i++) {
+		error = max(error, fabsf(matrices[i] - reference[i]));
+	}
+
+	start = Sys_Milliseconds();
+	for (int n = 0; n < iterations; n++) {
+		R_ResetIQMPoseCache();
+		for (int i = 0; i < instances; i++) {
+			R_ComputeIQMTransforms(model, &entities[i], matrices + i * count);
+		}
+	}
+	cached_msec = Sys_Milliseconds() - start;
+	R_ResetIQMPoseCache();
+
+	for (size_t i = 0; i < instances * count; i++) {
+		error = max(error, fabsf(matrices[i] - reference[i]));
+	}
+
+	Com_Printf("%s: %u joints, %d instances x %d iterations\n", mod->name, model->num_poses, instances, iterations);
+	Com_Printf("scalar: %u msec, %s: %u msec, cached: %u msec, max error %g\n", scalar_msec,
+#if USE_SSE2
+		"sse2",
+#else
+		"scalar",
+#endif
+		simd_msec, cached_msec, error);
+
+	Z_Free(entities);
+	Z_Free(reference);
+	Z_Free(matrices);
+}
@@ -485,11 +485,13 @@ void MOD_Init(void)
 	}
 
 	Cmd_AddCommand("modellist", MOD_List_f);
+	Cmd_AddCommand("iqmbench", IQM_Bench_f);
 }
 
 void MOD_Shutdown(void)
 {
 	MOD_FreeAll();
 	Cmd_RemoveCommand("modellist");
+	Cmd_RemoveCommand("iqmbench");
 }
 
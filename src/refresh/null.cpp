@@ -0,0 +1,191 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// null.cpp -- refresh backend that draws nothing
+//
+// Creates no window and touches no graphics API. Images are still looked
+// up and decoded by the common code, but nothing is uploaded. Model files
+// are read and registered as empty models without being decoded. Selected
+// with vid_null, used by benchmark_demo to measure the client without
+// rendering costs.
+//
+
+#include "shared/shared.h"
+#include "shared/list.h"
+#include "common/common.h"
+#include "common/files.h"
+#include "common/zone.h"
+#include "refresh/images.h"
+#include "refresh/models.h"
+#include "refresh/refresh.h"
+
+#define NULL_WIDTH      640
+#define NULL_HEIGHT     480
+
+static qboolean R_Init_Null(qboolean total)
+{
+    if (total) {
+        Com_Printf("------- R_Init -------\n");
+        Com_Printf("Using null refresh, nothing will be drawn\n");
+
+        r_config.width = NULL_WIDTH;
+        r_config.height = NULL_HEIGHT;
+        r_config.flags = (vidFlags_t)0; // CPP: Cast
+    }
+
+    IMG_Init();
+    IMG_GetPalette();
+    MOD_Init();
+
+    if (total) {
+        Com_Printf("----------------------\n");
+    }
+
+    return true;
+}
+
+static void R_Shutdown_Null(qboolean total)
+{
+    IMG_FreeAll();
+    IMG_Shutdown();
+    MOD_Shutdown();
+
+    if (total) {
+        memset(&r_config, 0, sizeof(r_config));
+    }
+}
+
+static void R_BeginRegistration_Null(const char *name)
+{
+    registration_sequence++;
+}
+
+static void R_EndRegistration_Null(const char *name)
+{
+    IMG_FreeUnused();
+    MOD_FreeUnused();
+}
+
+static void R_SetSky_Null(const char *name, float rotate, vec3_t &axis) {}
+static void R_RenderFrame_Null(refdef_t *fd) {}
+
+static void R_LightPoint_Null(const vec3_t &origin, vec3_t &light)
+{
+    light = vec3_t{ 1, 1, 1 };
+}
+
+static void R_ClearColor_Null(void) {}
+static void R_SetAlpha_Null(float alpha) {}
+static void R_SetAlphaScale_Null(float alpha) {}
+static void R_SetColor_Null(uint32_t color) {}
+static void R_SetClipRect_Null(const clipRect_t *clip) {}
+static void R_SetScale_Null(float scale) {}
+static void R_DrawChar_Null(int x, int y, int flags, int ch, qhandle_t font) {}
+
+static int R_DrawString_Null(int x, int y, int flags, size_t maxlen, const char *s, qhandle_t font)
+{
+    // callers use the returned position for layout
+    while (maxlen-- && *s++) {
+        x += CHAR_WIDTH;
+    }
+
+    return x;
+}
+
+static void R_DrawPic_Null(int x, int y, qhandle_t pic) {}
+static void R_DrawStretchPic_Null(int x, int y, int w, int h, qhandle_t pic) {}
+static void R_TileClear_Null(int x, int y, int w, int h, qhandle_t pic) {}
+static void R_DrawFill8_Null(int x, int y, int w, int h, int c) {}
+static void R_DrawFill32_Null(int x, int y, int w, int h, uint32_t color) {}
+static void R_BeginFrame_Null(void) {}
+static void R_EndFrame_Null(void) {}
+
+// there is no window, so ignore whatever the video layer reports
+static void R_ModeChanged_Null(int width, int height, int flags, int rowbytes, void *pixels) {}
+
+static void R_AddDecal_Null(decal_t *d) {}
+static qboolean R_InterceptKey_Null(unsigned key, qboolean down) { return false; }
+
+static void IMG_Load_Null(image_t *image, byte *pic)
+{
+    Z_Free(pic);
+}
+
+static void IMG_Unload_Null(image_t *image) {}
+
+// screenshots come out black
+static byte *IMG_ReadPixels_Null(int *width, int *height, int *rowbytes)
+{
+    size_t size = r_config.width * r_config.height * 3;
+    byte *pixels = (byte*)FS_AllocTempMem(size); // CPP: Cast
+
+    memset(pixels, 0, size);
+
+    *width = r_config.width;
+    *height = r_config.height;
+    *rowbytes = r_config.width * 3;
+
+    return pixels;
+}
+
+static qerror_t MOD_Load_Null(model_t *model, const void *rawdata, size_t length, const char *mod_name)
+{
+    model->type = model_s::MOD_EMPTY; // CPP: Enum
+    return Q_ERR_SUCCESS;
+}
+
+static void MOD_Reference_Null(model_t *model) {}
+
+void R_RegisterFunctionsNull()
+{
+    R_Init = R_Init_Null;
+    R_Shutdown = R_Shutdown_Null;
+    R_BeginRegistration = R_BeginRegistration_Null;
+    R_EndRegistration = R_EndRegistration_Null;
+    R_SetSky = R_SetSky_Null;
+    R_RenderFrame = R_RenderFrame_Null;
+    R_LightPoint = R_LightPoint_Null;
+    R_ClearColor = R_ClearColor_Null;
+    R_SetAlpha = R_SetAlpha_Null;
+    R_SetAlphaScale = R_SetAlphaScale_Null;
+    R_SetColor = R_SetColor_Null;
+    R_SetClipRect = R_SetClipRect_Null;
+    R_SetScale = R_SetScale_Null;
+    R_DrawChar = R_DrawChar_Null;
+    R_DrawString = R_DrawString_Null;
+    R_DrawPic = R_DrawPic_Null;
+    R_DrawStretchPic = R_DrawStretchPic_Null;
+    R_TileClear = R_TileClear_Null;
+    R_DrawFill8 = R_DrawFill8_Null;
+    R_DrawFill32 = R_DrawFill32_Null;
+    R_BeginFrame = R_BeginFrame_Null;
+    R_EndFrame = R_EndFrame_Null;
+    R_ModeChanged = R_ModeChanged_Null;
+    R_AddDecal = R_AddDecal_Null;
+    R_InterceptKey = R_InterceptKey_Null;
+    IMG_Load = IMG_Load_Null;
+    IMG_Unload = IMG_Unload_Null;
+    IMG_ReadPixels = IMG_ReadPixels_Null;
+    MOD_LoadMD2 = MOD_Load_Null;
+#if USE_MD3
+    MOD_LoadMD3 = MOD_Load_Null;
+#endif
+    MOD_LoadIQM = MOD_Load_Null;
+    MOD_Reference = MOD_Reference_Null;
+}
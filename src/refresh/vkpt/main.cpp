@@ -1885,6 +1885,9 @@ prepare_entities(EntityUploadInfo* upload_info) {
 	int instance_idx = 0;
 	int iqm_matrix_offset = 0;
 
+	// poses shared by entities are only valid for this frame
+	R_ResetIQMPoseCache();
+
 	const qboolean first_person_model = (cl_player_model->integer == CL_PLAYER_MODEL_FIRST_PERSON) && cl.baseClientInfo.model;
 
 	for (int i = 0; i < vkpt_refdef.fd->num_entities; i++) 	{
@@ -0,0 +1,1065 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// bench.cpp -- headless server benchmark with synthetic clients
+//
+
+#include <algorithm>
+
+#include "server.h"
+#include "common/jobs.h"
+
+#define MOVES_MAGIC     (('V'<<24)|('M'<<16)|('V'<<8)|'S')  // "SVMV"
+#define MOVES_VERSION   1
+
+#define MAX_RECORD_MOVES    (1 << 20)
+
+#define BENCH_MOVES         600     // length of the generated stream
+#define BENCH_MAX_PACKETS   8       // per client and tick
+
+enum {
+    PHASE_INPUT,    // netchan and clc_move parsing
+    PHASE_GAME,     // game frame
+    PHASE_SEND,     // building and writing client frames
+    PHASE_OTHER,    // timeouts, pings, async packets, world prep
+    PHASE_TOTAL,
+    NUM_PHASES
+};
+
+static const char *const phase_names[NUM_PHASES] = {
+    "input", "game", "send", "other", "total"
+};
+
+typedef struct {
+    client_t            *client;
+    int                 sequence;       // last packet sent by the client
+    int                 reliableAck;    // last reliable sequence received
+    int                 move;           // next move of the stream
+    int                 msec;           // command time owed this tick
+    ClientMoveCommand   cmds[3];        // oldest, old and new
+    size_t              bytes;          // sent when the timed run started
+} benchclient_t;
+
+// summed over the timed ticks, sampled before the world frame resets them
+typedef struct {
+    unsigned    traces;
+    unsigned    multicasts;
+    unsigned    recipients;
+    size_t      copiedBytes;
+} benchtotals_t;
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    count;
+} movesheader_t;
+
+typedef struct {
+    uint8_t     msec;
+    uint8_t     buttons;
+    uint8_t     impulse;
+    uint8_t     lightLevel;
+    float       viewAngles[3];
+    int16_t     forwardMove;
+    int16_t     rightMove;
+    int16_t     upMove;
+    int16_t     pad;
+} movesrecord_t;
+
+static struct {
+    client_t        *client;
+    PlayerMoveInput *moves;
+    int             nummoves;
+    char            path[MAX_OSPATH];
+} rec;
+
+/*
+===============================================================================
+
+MOVE STREAMS
+
+Move files hold the raw PlayerMoveInput of every clc_move a player sent,
+in little endian. Recorded with `recordmoves', replayed by `sv_bench'.
+
+===============================================================================
+*/
+
+static void write_move(movesrecord_t *out, const PlayerMoveInput *in)
+{
+    out->msec = in->msec;
+    out->buttons = in->buttons;
+    out->impulse = in->impulse;
+    out->lightLevel = in->lightLevel;
+    out->viewAngles[0] = LittleFloat(in->viewAngles[0]);
+    out->viewAngles[1] = LittleFloat(in->viewAngles[1]);
+    out->viewAngles[2] = LittleFloat(in->viewAngles[2]);
+    out->forwardMove = LittleShort(in->forwardMove);
+    out->rightMove = LittleShort(in->rightMove);
+    out->upMove = LittleShort(in->upMove);
+    out->pad = 0;
+}
+
+static void read_move(PlayerMoveInput *out, const movesrecord_t *in)
+{
+    memset(out, 0, sizeof(*out));
+    out->msec = in->msec;
+    out->buttons = in->buttons;
+    out->impulse = in->impulse;
+    out->lightLevel = in->lightLevel;
+    out->viewAngles[0] = LittleFloat(in->viewAngles[0]);
+    out->viewAngles[1] = LittleFloat(in->viewAngles[1]);
+    out->viewAngles[2] = LittleFloat(in->viewAngles[2]);
+    out->forwardMove = (int16_t)LittleShort(in->forwardMove);
+    out->rightMove = (int16_t)LittleShort(in->rightMove);
+    out->upMove = (int16_t)LittleShort(in->upMove);
+}
+
+static void moves_path(char *buffer, size_t size, const char *name)
+{
+    Q_snprintf(buffer, size, "bench/%s", name);
+    COM_DefaultExtension(buffer, ".mov", size);
+}
+
+static PlayerMoveInput *load_moves(const char *name, int *count)
+{
+    char path[MAX_OSPATH];
+    PlayerMoveInput *moves;
+    movesheader_t header;
+    movesrecord_t record;
+    byte *data;
+    ssize_t len;
+    uint32_t i, n;
+
+    moves_path(path, sizeof(path), name);
+    len = FS_LoadFile(path, (void **)&data);
+    if (!data) {
+        Com_Printf("Couldn't load %s: %s\n", path, Q_ErrorString(len));
+        return NULL;
+    }
+
+    memset(&header, 0, sizeof(header));
+    if (len >= sizeof(header))
+        memcpy(&header, data, sizeof(header));
+
+    n = LittleLong(header.count);
+    if ((uint32_t)LittleLong(header.magic) != MOVES_MAGIC
+        || LittleLong(header.version) != MOVES_VERSION
+        || n < 1 || n > (len - sizeof(header)) / sizeof(record)) {
+        Com_Printf("%s is not a valid move file\n", path);
+        FS_FreeFile(data);
+        return NULL;
+    }
+
+    moves = (PlayerMoveInput *)Z_Malloc(sizeof(*moves) * n);
+    for (i = 0; i < n; i++) {
+        memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+        read_move(&moves[i], &record);
+    }
+
+    FS_FreeFile(data);
+    *count = n;
+    return moves;
+}
+
+// run, strafe, turn, jump and fire in a fixed pattern
+static PlayerMoveInput *generate_moves(int *count)
+{
+    PlayerMoveInput *moves, *in;
+    unsigned seed = 1;
+    float yaw = 0;
+    int i;
+
+    moves = (PlayerMoveInput *)Z_Mallocz(sizeof(*moves) * BENCH_MOVES);
+    for (i = 0, in = moves; i < BENCH_MOVES; i++, in++) {
+        seed = seed * 1103515245 + 12345;
+        yaw += (int)((seed >> 16) % 9) - 4;
+
+        in->msec = 16;
+        in->viewAngles[0] = 15 * sinf(i * 0.05f);
+        in->viewAngles[1] = AngleMod(yaw);
+        in->forwardMove = (i / 120) & 1 ? 200 : 400;
+        in->rightMove = ((i / 45) % 3 - 1) * 300;
+        in->upMove = i % 90 < 3 ? 200 : 0;
+        // button bits belong to the game, 1 is attack in the default one
+        in->buttons = (i / 30) % 4 == 0 ? 1 : 0;
+        in->lightLevel = 128;
+    }
+
+    *count = BENCH_MOVES;
+    return moves;
+}
+
+/*
+==================
+SV_RecordMove
+
+Called for every clc_move after it was executed.
+==================
+*/
+void SV_RecordMove(client_t *client, const ClientMoveCommand *cmd)
+{
+    if (client != rec.client)
+        return;
+
+    if (rec.nummoves == MAX_RECORD_MOVES)
+        return;
+
+    if (!(rec.nummoves & 1023)) {
+        rec.moves = (PlayerMoveInput *)Z_Realloc(rec.moves,
+                                                 sizeof(rec.moves[0]) * (rec.nummoves + 1024));
+    }
+
+    rec.moves[rec.nummoves++] = cmd->input;
+}
+
+static void stop_recording(void)
+{
+    movesheader_t *header;
+    movesrecord_t *records;
+    size_t len;
+    qerror_t ret;
+    int i;
+
+    len = sizeof(*header) + sizeof(*records) * rec.nummoves;
+    header = (movesheader_t *)Z_Malloc(len);
+    header->magic = LittleLong(MOVES_MAGIC);
+    header->version = LittleLong(MOVES_VERSION);
+    header->count = LittleLong(rec.nummoves);
+
+    records = (movesrecord_t *)(header + 1);
+    for (i = 0; i < rec.nummoves; i++)
+        write_move(&records[i], &rec.moves[i]);
+
+    ret = FS_WriteFile(rec.path, header, len);
+    if (ret < 0)
+        Com_EPrintf("Couldn't write %s: %s\n", rec.path, Q_ErrorString(ret));
+    else
+        Com_Printf("Wrote %d moves to %s\n", rec.nummoves, rec.path);
+
+    Z_Free(header);
+    Z_Free(rec.moves);
+    rec.moves = NULL;
+    rec.nummoves = 0;
+    rec.client = NULL;
+}
+
+static void SV_RecordMoves_f(void)
+{
+    client_t *cl;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <userid> [name]\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (rec.client) {
+        Com_Printf("Already recording moves of %s.\n", rec.client->name);
+        return;
+    }
+
+    cl = SV_GetPlayer(Cmd_Argv(1), !!sv_enhanced_setplayer->integer);
+    if (!cl)
+        return;
+
+    moves_path(rec.path, sizeof(rec.path), Cmd_Argc() > 2 ? Cmd_Argv(2) : cl->name);
+    rec.client = cl;
+
+    Com_Printf("Recording moves of %s to %s.\n", cl->name, rec.path);
+}
+
+static void SV_StopMoves_f(void)
+{
+    if (!rec.client) {
+        Com_Printf("Not recording moves.\n");
+        return;
+    }
+
+    stop_recording();
+}
+
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+// delivers msg_write to the server as if it arrived from the client,
+// acknowledging everything the server has sent so far
+static void bench_send(benchclient_t *bc, qboolean reliable)
+{
+    client_t *cl = bc->client;
+    NetChannel *nc = cl->netchan;
+    uint32_t w1, w2;
+
+    if (!nc->fragmentPending)
+        bc->reliableAck = nc->reliableSequence;
+
+    w1 = (++bc->sequence & 0x3FFFFFFF) | ((uint32_t)reliable << 31);
+    w2 = ((nc->outgoingSequence - 1) & 0x3FFFFFFF) | ((uint32_t)bc->reliableAck << 31);
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    SZ_WriteLong(&msg_read, w1);
+    SZ_WriteLong(&msg_read, w2);
+    SZ_Write(&msg_read, msg_write.data, msg_write.currentSize);
+    SZ_Clear(&msg_write);
+
+    if (!Netchan_Process(nc))
+        return;
+
+    cl->lastMessage = svs.realtime;
+    SV_QueueClientPacket(cl);
+}
+
+static void bench_move(benchclient_t *bc, const PlayerMoveInput *in)
+{
+    client_t *cl = bc->client;
+
+    bc->cmds[0] = bc->cmds[1];
+    bc->cmds[1] = bc->cmds[2];
+    bc->cmds[2].input = *in;
+    bc->cmds[2].commandNumber++;
+
+    MSG_WriteByte(clc_move);
+    MSG_WriteLong(cl->connectionState == ConnectionState::Spawned ? cl->frameNumber - 1 : -1);
+    MSG_WriteDeltaClientMoveCommand(NULL, &bc->cmds[0]);
+    MSG_WriteDeltaClientMoveCommand(&bc->cmds[0], &bc->cmds[1]);
+    MSG_WriteDeltaClientMoveCommand(&bc->cmds[1], &bc->cmds[2]);
+
+    bench_send(bc, false);
+}
+
+// accepts a client the way SVC_DirectConnect does, minus the handshake
+static client_t *bench_connect(void)
+{
+    char userinfo[MAX_INFO_STRING * 2];
+    client_t *cl;
+    netadr_t adr;
+    int number;
+
+    for (number = 0; number < sv_maxclients->integer; number++) {
+        if (svs.client_pool[number].connectionState == ConnectionState::Free)
+            break;
+    }
+    if (number == sv_maxclients->integer) {
+        Com_Printf("No free client slots.\n");
+        return NULL;
+    }
+
+    cl = &svs.client_pool[number];
+    memset(cl, 0, sizeof(*cl));
+    cl->number = cl->slot = number;
+    cl->protocolVersion = PROTOCOL_VERSION_POLYHEDRON;
+    cl->protocolMinorVersion = PROTOCOL_VERSION_POLYHEDRON_CURRENT;
+    cl->edict = EDICT_NUM(number + 1);
+    cl->gamedir = fs_game->string;
+    cl->mapName = sv.name;
+    cl->configstrings = (char *)sv.configstrings;
+    cl->pool = (EntityPool *)&ge->entities;
+    cl->cm = &sv.cm;
+    cl->spawncount = sv.spawncount;
+    cl->maximumClients = sv_maxclients->integer;
+    cl->lastValidCluster = -1;
+    cl->esFlags = MSG_ES_BEAMORIGIN;
+    cl->reconnected = true;
+    strcpy(cl->reconnectKey, "bench");
+    cl->versionString = SV_CopyString("bench");
+
+    Q_snprintf(userinfo, sizeof(userinfo),
+               "\\name\\bench%02d\\skin\\male/grunt\\hand\\2", number);
+    memset(userinfo + strlen(userinfo), 0, MAX_INFO_STRING);
+
+    sv_client = cl;
+    sv_player = cl->edict;
+    if (!ge->ClientConnect(cl->edict, userinfo)) {
+        Com_Printf("Game refused synthetic client %d.\n", number);
+        sv_client = NULL;
+        sv_player = NULL;
+        SV_CleanClient(cl);
+        return NULL;
+    }
+    sv_client = NULL;
+    sv_player = NULL;
+
+    // packets to an unspecified address are counted, but never sent
+    memset(&adr, 0, sizeof(adr));
+    cl->netchan = Netchan_Setup(NS_SERVER, &adr, 0, MAX_PACKETLEN_WRITABLE_DEFAULT, cl->protocolVersion);
+    cl->numpackets = 1;
+
+    Q_strlcpy(cl->userinfo, userinfo, sizeof(cl->userinfo));
+    SV_UserinfoChanged(cl);
+    cl->rate = 0;
+
+    SV_InitClientSend(cl);
+    cl->WriteFrame = SV_WriteFrameToClient;
+
+    List_SeqAdd(&sv_clientlist, &cl->entry);
+
+    cl->connectionState = ConnectionState::Assigned;
+    cl->frameNumber = 1;
+    cl->lastFrame = -1;
+    cl->lastMessage = svs.realtime;
+    cl->lastActivity = svs.realtime;
+    cl->pingMinimum = 9999;
+
+    return cl;
+}
+
+static void bench_tick(benchclient_t *clients, int numclients,
+                       const PlayerMoveInput *moves, int nummoves,
+                       uint64_t *t, benchtotals_t *totals)
+{
+    benchclient_t *bc;
+    int i, n;
+
+    svs.realtime += SV_FRAMETIME;
+
+    t[0] = Prof_Nanoseconds();
+
+    for (i = 0, bc = clients; i < numclients; i++, bc++) {
+        if (bc->client->connectionState != ConnectionState::Spawned)
+            continue;
+
+        // clients send their commands at their own rate,
+        // several packets may arrive during one server frame
+        bc->msec += SV_FRAMETIME;
+        for (n = 0; bc->msec > 0 && n < BENCH_MAX_PACKETS; n++) {
+            const PlayerMoveInput *in = &moves[bc->move++ % nummoves];
+            bc->msec -= max(in->msec, 1);
+            bench_move(bc, in);
+        }
+        bc->msec = min(bc->msec, 0);
+    }
+
+    SV_RunClientPackets();
+
+    t[1] = Prof_Nanoseconds();
+
+    SV_SendAsyncPackets();
+    SV_CheckTimeouts();
+    SV_CalcPings();
+    SV_GiveMsec();
+
+    t[2] = Prof_Nanoseconds();
+
+    SV_RunGameFrame();
+
+    t[3] = Prof_Nanoseconds();
+
+    SV_SendClientMessages();
+
+    t[4] = Prof_Nanoseconds();
+
+    totals->traces += sv.tracecount;
+    totals->multicasts += sv.multicast.messages;
+    totals->recipients += sv.multicast.recipients;
+    totals->copiedBytes += sv.multicast.copiedBytes;
+
+    SV_PrepWorldFrame();
+    sv.frameNumber++;
+
+    t[5] = Prof_Nanoseconds();
+}
+
+/*
+==================
+SV_Bench_f
+
+Starts the given map and runs the server for a number of ticks back to back
+with synthetic clients, each replaying the same move stream at a different
+offset. Nothing is sent on the network. Ticks always advance by exactly one
+server frame, like with `fixedtime', so runs are comparable.
+==================
+*/
+static void SV_Bench_f(void)
+{
+    char            mapname[MAX_QPATH], movesname[MAX_QPATH];
+    benchclient_t   *clients, *bc;
+    PlayerMoveInput *moves;
+    uint64_t        *times[NUM_PHASES], t[6];
+    int             i, j, numclients, numticks, nummoves, warmup;
+    size_t          bytes, minbytes, maxbytes, totalbytes;
+    benchtotals_t   totals;
+    float           seconds;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <map> [clients] [ticks] [moves]\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (!COM_DEDICATED) {
+        Com_Printf("%s is only available on dedicated servers.\n", Cmd_Argv(0));
+        return;
+    }
+
+    // map command below retokenizes
+    Q_strlcpy(mapname, Cmd_Argv(1), sizeof(mapname));
+    numclients = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 16;
+    numticks = Cmd_Argc() > 3 ? atoi(Cmd_Argv(3)) : 1000;
+    Q_strlcpy(movesname, Cmd_Argv(4), sizeof(movesname));
+    clamp(numclients, 1, CLIENTNUM_RESERVED);
+    clamp(numticks, 1, 1000000);
+
+    if (movesname[0])
+        moves = load_moves(movesname, &nummoves);
+    else
+        moves = generate_moves(&nummoves);
+    if (!moves)
+        return;
+
+    if (sv_maxclients->integer < numclients)
+        Cvar_SetInteger(sv_maxclients, numclients, FROM_CODE);
+
+    Cmd_ExecuteString(&cmd_buffer, va("map \"%s\" force", mapname));
+    if (sv.serverState != ServerState::Game) {
+        Com_Printf("Couldn't start %s.\n", mapname);
+        Z_Free(moves);
+        return;
+    }
+
+    numclients = min(numclients, sv_maxclients->integer);
+    clients = (benchclient_t *)Z_Mallocz(sizeof(*clients) * numclients);
+
+    for (i = 0; i < numclients; i++) {
+        bc = &clients[i];
+        bc->client = bench_connect();
+        if (!bc->client) {
+            numclients = i;
+            break;
+        }
+        bc->move = i * 37;
+
+        MSG_WriteByte(clc_stringcmd);
+        MSG_WriteString("new");
+        MSG_WriteByte(clc_stringcmd);
+        MSG_WriteString("begin");
+        bench_send(bc, true);
+    }
+
+    SV_RunClientPackets();
+
+    if (!numclients) {
+        Z_Free(clients);
+        Z_Free(moves);
+        return;
+    }
+
+    for (i = 0; i < NUM_PHASES; i++)
+        times[i] = (uint64_t *)Z_Malloc(sizeof(uint64_t) * numticks);
+
+    // let the gamestate go out and the clients settle
+    warmup = SV_FRAMERATE;
+    memset(&totals, 0, sizeof(totals));
+    for (i = 0; i < warmup; i++)
+        bench_tick(clients, numclients, moves, nummoves, t, &totals);
+
+    for (i = 0; i < numclients; i++) {
+        if (clients[i].client->netchan)
+            clients[i].bytes = clients[i].client->netchan->totalBytesSent;
+    }
+
+    memset(&totals, 0, sizeof(totals));
+    for (i = 0; i < numticks; i++) {
+        bench_tick(clients, numclients, moves, nummoves, t, &totals);
+        times[PHASE_INPUT][i] = t[1] - t[0];
+        times[PHASE_OTHER][i] = t[2] - t[1] + t[5] - t[4];
+        times[PHASE_GAME][i] = t[3] - t[2];
+        times[PHASE_SEND][i] = t[4] - t[3];
+        times[PHASE_TOTAL][i] = t[5] - t[0];
+    }
+
+    minbytes = SIZE_MAX;
+    maxbytes = totalbytes = 0;
+    for (i = 0, j = 0; i < numclients; i++) {
+        bc = &clients[i];
+        if (!bc->client->netchan)
+            continue;   // timed out and removed
+        if (bc->client->connectionState == ConnectionState::Spawned)
+            j++;
+        bytes = bc->client->netchan->totalBytesSent - bc->bytes;
+        minbytes = min(minbytes, bytes);
+        maxbytes = max(maxbytes, bytes);
+        totalbytes += bytes;
+    }
+    if (minbytes == SIZE_MAX)
+        minbytes = 0;
+
+    seconds = 0;
+    for (i = 0; i < numticks; i++)
+        seconds += times[PHASE_TOTAL][i] * 1e-9f;
+
+    Com_Printf("%s: %d clients (%d spawned at end), %d ticks, %d moves, %.1f ticks/sec\n",
+               mapname, numclients, j, numticks, nummoves, seconds ? numticks / seconds : 0.0f);
+    Com_Printf("phase      p50      p90      p99      max (msec)\n");
+    for (i = 0; i < NUM_PHASES; i++) {
+        std::sort(times[i], times[i] + numticks);
+        Com_Printf("%-6s %8.3f %8.3f %8.3f %8.3f\n", phase_names[i],
+                   Prof_Percentile(times[i], numticks, 50), Prof_Percentile(times[i], numticks, 90),
+                   Prof_Percentile(times[i], numticks, 99), times[i][numticks - 1] * 1e-6f);
+    }
+    Com_Printf("%.0f bytes per client and tick (min %.0f, max %.0f), %.1f traces per tick\n",
+               (float)totalbytes / (numclients * numticks), (float)minbytes / numticks,
+               (float)maxbytes / numticks, (float)totals.traces / numticks);
+    Com_Printf("%.1f unreliable multicasts to %.1f clients per tick, %.0f bytes copied\n",
+               (float)totals.multicasts / numticks, (float)totals.recipients / numticks,
+               (float)totals.copiedBytes / numticks);
+
+    for (i = 0; i < numclients; i++) {
+        if (clients[i].client->connectionState == ConnectionState::Free)
+            continue;
+        SV_DropClient(clients[i].client, NULL);
+        SV_RemoveClient(clients[i].client);
+    }
+
+    for (i = 0; i < NUM_PHASES; i++)
+        Z_Free(times[i]);
+    Z_Free(clients);
+    Z_Free(moves);
+}
+
+static qboolean same_input(const PlayerMoveInput *a, const PlayerMoveInput *b)
+{
+    return a->msec == b->msec &&
+           a->viewAngles[0] == b->viewAngles[0] &&
+           a->viewAngles[1] == b->viewAngles[1] &&
+           a->viewAngles[2] == b->viewAngles[2] &&
+           a->forwardMove == b->forwardMove &&
+           a->rightMove == b->rightMove &&
+           a->upMove == b->upMove &&
+           a->buttons == b->buttons &&
+           a->impulse == b->impulse &&
+           a->lightLevel == b->lightLevel;
+}
+
+// random mix of string commands, userinfo and at most one move
+static void decodetest_packet(clientpacket_t *expect, const PlayerMoveInput *moves,
+                              int nummoves, unsigned *seed)
+{
+    ClientMoveCommand cmds[3];
+    int i, n, r;
+
+    memset(expect, 0, sizeof(*expect));
+    memset(cmds, 0, sizeof(cmds));
+
+    n = 1 + (*seed >> 16) % 6;
+    for (i = 0; i < n; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        r = (*seed >> 16) % 5;
+
+        if (r == 0 && !expect->moveStart) {
+            MSG_WriteByte(clc_move);
+            expect->moveStart = msg_write.currentSize;
+            expect->lastFrame = *seed & 0xffff;
+            cmds[0].input = moves[(*seed >> 8) % nummoves];
+            cmds[1].input = moves[(*seed >> 12) % nummoves];
+            cmds[2].input = moves[(*seed >> 20) % nummoves];
+            MSG_WriteLong(expect->lastFrame);
+            MSG_WriteDeltaClientMoveCommand(NULL, &cmds[0]);
+            MSG_WriteDeltaClientMoveCommand(&cmds[0], &cmds[1]);
+            MSG_WriteDeltaClientMoveCommand(&cmds[1], &cmds[2]);
+            expect->moveEnd = msg_write.currentSize;
+            memcpy(expect->cmds, cmds, sizeof(cmds));
+        } else if (r == 1) {
+            MSG_WriteByte(clc_stringcmd);
+            MSG_WriteString(va("say %u", *seed));
+        } else if (r == 2) {
+            MSG_WriteByte(clc_userinfo);
+            MSG_WriteString(va("\\name\\test%u", *seed));
+        } else if (r == 3) {
+            MSG_WriteByte(clc_userinfo_delta);
+            MSG_WriteString("skin");
+            MSG_WriteString(va("male/%u", *seed));
+        } else {
+            MSG_WriteByte(clc_nop);
+        }
+    }
+}
+
+static int decodetest_compare(const clientpacket_t *expect, client_t *fake, int count)
+{
+    const clientpacket_t *p, *e;
+    size_t offset = 0;
+    int i, j, n, errors = 0;
+
+    p = SV_GetClientPackets(&n);
+    if (n != count) {
+        Com_EPrintf("%d packets queued, expected %d\n", n, count);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++, p++) {
+        e = &expect[i];
+        // queue keeps arrival order
+        if (p->client != &fake[i % 2] || p->offset != offset || p->drops != i % 3) {
+            Com_EPrintf("Packet %d out of order\n", i);
+            errors++;
+        }
+        offset += p->length;
+
+        if (p->moveStart != e->moveStart) {
+            Com_EPrintf("Packet %d move at %" PRIz ", expected %" PRIz "\n",
+                        i, p->moveStart, e->moveStart);
+            errors++;
+            continue;
+        }
+        if (!e->moveStart)
+            continue;
+
+        if (p->moveEnd != e->moveEnd || p->lastFrame != e->lastFrame) {
+            Com_EPrintf("Packet %d move header mismatch\n", i);
+            errors++;
+        }
+        for (j = 0; j < 3; j++) {
+            if (!same_input(&p->cmds[j].input, &e->cmds[j].input)) {
+                Com_EPrintf("Packet %d command %d mismatch\n", i, j);
+                errors++;
+            }
+        }
+    }
+
+    return errors;
+}
+
+// queues msg_write as left by Netchan_Process, past some header
+static void decodetest_queue(client_t *client)
+{
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    SZ_WriteLong(&msg_read, 0);
+    SZ_Write(&msg_read, msg_write.data, msg_write.currentSize);
+    SZ_Clear(&msg_write);
+    msg_read.readCount = 4;
+
+    SV_QueueClientPacket(client);
+}
+
+#define EXECTEST_CLIENTS    3
+#define EXECTEST_PACKETS    24
+
+static int  exectest_log[EXECTEST_PACKETS];
+static int  exectest_logged;
+
+// "sinfo <packet>" output is the only trace an executed packet leaves
+static void exectest_addmessage(client_t *client, byte *data, size_t len, qboolean reliable)
+{
+    int id;
+
+    if (strcmp(Cmd_Argv(0), "sinfo"))
+        return;     // disconnect notice
+
+    // long output is flushed in several messages
+    id = atoi(Cmd_Argv(1));
+    if (exectest_logged && exectest_log[exectest_logged - 1] == id)
+        return;
+
+    if (exectest_logged < EXECTEST_PACKETS)
+        exectest_log[exectest_logged++] = id;
+}
+
+static void exectest_queue(client_t *client, int id)
+{
+    MSG_WriteByte(clc_stringcmd);
+    MSG_WriteString(id < 0 ? "disconnect" : va("sinfo %d", id));
+    decodetest_queue(client);
+}
+
+static int exectest_check(const int *expect, int count, const char *what)
+{
+    int i, queued, errors = 0;
+
+    SV_GetClientPackets(&queued);
+    if (queued) {
+        Com_EPrintf("%s: %d packets left in queue\n", what, queued);
+        errors++;
+    }
+
+    if (exectest_logged != count) {
+        Com_EPrintf("%s: %d packets executed, expected %d\n", what, exectest_logged, count);
+        errors++;
+    }
+
+    for (i = 0; i < count && i < exectest_logged; i++) {
+        if (exectest_log[i] != expect[i]) {
+            Com_EPrintf("%s: packet %d executed as number %d, expected %d\n",
+                        what, exectest_log[i], i, expect[i]);
+            errors++;
+        }
+    }
+
+    exectest_logged = 0;
+    return errors;
+}
+
+// runs string commands for fake clients through SV_RunClientPackets
+static int decodetest_execute(void)
+{
+    client_t    *fake;
+    client_t    *last;
+    netadr_t    adr;
+    int         expect[EXECTEST_PACKETS];
+    unsigned    seed = 1;
+    int         i, c, count, errors = 0;
+
+    fake = (client_t *)Z_Mallocz(sizeof(*fake) * EXECTEST_CLIENTS);
+    last = &fake[EXECTEST_CLIENTS - 1];
+
+    memset(&adr, 0, sizeof(adr));
+    for (i = 0; i < EXECTEST_CLIENTS; i++) {
+        List_Init(&fake[i].entry);  // for SV_RemoveClient
+        Q_snprintf(fake[i].name, sizeof(fake[i].name), "fake%d", i);
+        fake[i].connectionState = ConnectionState::Connected;
+        fake[i].messageLevel = PRINT_LOW;
+        fake[i].AddMessage = exectest_addmessage;
+        fake[i].netchan = Netchan_Setup(NS_SERVER, &adr, 0, MAX_PACKETLEN_WRITABLE_DEFAULT, PROTOCOL_VERSION_DEFAULT);
+    }
+
+    // interleaved clients run in arrival order, the last one disconnects
+    // halfway through and its later packets are skipped
+    exectest_logged = 0;
+    for (i = count = 0; i < EXECTEST_PACKETS; i++) {
+        seed = seed * 1103515245 + 12345;
+        c = (seed >> 16) % EXECTEST_CLIENTS;
+
+        if (i == EXECTEST_PACKETS / 2) {
+            exectest_queue(last, -1);
+        } else {
+            exectest_queue(&fake[c], i);
+            if (&fake[c] != last || i < EXECTEST_PACKETS / 2)
+                expect[count++] = i;
+        }
+    }
+
+    SV_RunClientPackets();
+    errors += exectest_check(expect, count, "batch");
+    if (last->connectionState != ConnectionState::Free) {
+        Com_EPrintf("batch: client not removed by disconnect\n");
+        errors++;
+    }
+
+    // connectionless packets may reuse a slot, the queue runs first
+    for (i = 0; i < 4; i++) {
+        exectest_queue(&fake[i & 1], i);
+        expect[i] = i;
+    }
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    SZ_WriteLong(&msg_read, -1);
+    SZ_Write(&msg_read, "exectest\n", 9);
+    net_from = adr;
+    SV_PacketEvent();
+    errors += exectest_check(expect, 4, "connectionless");
+
+#if USE_ICMP
+    // so may errors, this address matches no client
+    for (i = 0; i < 4; i++) {
+        exectest_queue(&fake[i & 1], i);
+    }
+
+    SV_ErrorEvent(&adr, 0, 0);
+    errors += exectest_check(expect, 4, "error");
+#endif
+
+    for (i = 0; i < EXECTEST_CLIENTS; i++)
+        if (fake[i].netchan)
+            Netchan_Close(fake[i].netchan);
+    Z_Free(fake);
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    return errors;
+}
+
+/*
+==================
+SV_DecodeTest_f
+
+Queues random client packets for two fake clients, decodes them on job
+threads and then inline, and checks both against what was written. Then
+executes string commands of three more fake clients through the queue,
+checking their order, that packets of a client dropped earlier in the
+batch are skipped, and that connectionless packets and errors run the
+queue first.
+==================
+*/
+static void SV_DecodeTest_f(void)
+{
+    clientpacket_t  *expect;
+    client_t        *fake;
+    PlayerMoveInput *moves;
+    netadr_t        adr;
+    unsigned        seed = 1;
+    int             i, count, nummoves, queued, errors;
+
+    SV_GetClientPackets(&queued);
+    if (queued) {
+        Com_Printf("Client packets are pending.\n");
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : MAX_PACKET_QUEUE;
+    clamp(count, 1, MAX_PACKET_QUEUE);
+
+    moves = generate_moves(&nummoves);
+    expect = (clientpacket_t *)Z_Malloc(sizeof(*expect) * count);
+    fake = (client_t *)Z_Mallocz(sizeof(*fake) * 2);
+
+    SZ_Clear(&msg_write);
+    memset(&adr, 0, sizeof(adr));
+    for (i = 0; i < 2; i++)
+        fake[i].netchan = Netchan_Setup(NS_SERVER, &adr, 0, MAX_PACKETLEN_WRITABLE_DEFAULT, PROTOCOL_VERSION_DEFAULT);
+
+    for (i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        decodetest_packet(&expect[i], moves, nummoves, &seed);
+
+        fake[i % 2].netchan->deltaFramePacketDrops = i % 3;
+        decodetest_queue(&fake[i % 2]);
+    }
+
+    SV_DecodeClientPackets(true);
+    errors = decodetest_compare(expect, fake, count);
+
+    SV_DecodeClientPackets(false);
+    errors += decodetest_compare(expect, fake, count);
+
+    SV_ClearClientPackets();
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+
+    errors += decodetest_execute();
+
+    Com_Printf("%d failures, %d packets tested on %d job threads\n",
+               errors, count, Job_NumThreads());
+
+    for (i = 0; i < 2; i++)
+        Netchan_Close(fake[i].netchan);
+    Z_Free(fake);
+    Z_Free(expect);
+    Z_Free(moves);
+}
+
+#define REWIND_MSEC     100
+
+/*
+==================
+SV_RewindBench_f
+
+Traces the same random rays between linked entities with SV_Trace and
+SV_TraceRewound, and prints the cost of each per trace. Needs a running
+map with some clients or monsters that moved for a while.
+==================
+*/
+static void SV_RewindBench_f(void)
+{
+    vec3_t      *points;
+    Entity      *ent;
+    unsigned    seed = 1, tracecount;
+    uint64_t    start, normal, rewound;
+    int         i, a, b, count, numpoints;
+    int         hits[2] = { 0, 0 };
+    trace_t     tr;
+
+    if (!sv.cm.cache) {
+        Com_Printf("No map loaded.\n");
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 100000;
+    clamp(count, 1, 10000000);
+
+    points = (vec3_t *)Z_Malloc(sizeof(*points) * ge->numberOfEntities);
+    for (i = 1, numpoints = 0; i < ge->numberOfEntities; i++) {
+        ent = EDICT_NUM(i);
+        if (ent->inUse && ent->area.prev && ent->solid == Solid::BoundingBox)
+            points[numpoints++] = ent->state.origin;
+    }
+
+    if (numpoints < 2) {
+        Com_Printf("Need at least two solid entities to trace between.\n");
+        Z_Free(points);
+        return;
+    }
+
+    // keep the runaway trace check from firing, it counts traces per frame
+    tracecount = sv.tracecount;
+
+    // time both with the same sequence of rays
+    start = Prof_Nanoseconds();
+    for (i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        a = (seed >> 16) % numpoints;
+        b = (a + 1 + (seed >> 8) % (numpoints - 1)) % numpoints;
+        sv.tracecount = 0;
+        tr = SV_Trace(points[a], vec3_zero(), vec3_zero(), points[b], NULL, CONTENTS_MASK_SHOT);
+        hits[0] += tr.fraction < 1;
+    }
+    normal = Prof_Nanoseconds() - start;
+
+    seed = 1;
+    start = Prof_Nanoseconds();
+    for (i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        a = (seed >> 16) % numpoints;
+        b = (a + 1 + (seed >> 8) % (numpoints - 1)) % numpoints;
+        sv.tracecount = 0;
+        tr = SV_TraceRewound(REWIND_MSEC, points[a], vec3_zero(), vec3_zero(), points[b], NULL, CONTENTS_MASK_SHOT);
+        hits[1] += tr.fraction < 1;
+    }
+    rewound = Prof_Nanoseconds() - start;
+
+    sv.tracecount = tracecount;
+
+    Com_Printf("%d traces between %d entities\n", count, numpoints);
+    Com_Printf("normal:  %.1f ns/trace, %d hits\n", (double)normal / count, hits[0]);
+    Com_Printf("rewound: %.1f ns/trace, %d hits (%d ms back)\n", (double)rewound / count, hits[1], REWIND_MSEC);
+
+    Z_Free(points);
+}
+
+static void SV_Bench_c(genctx_t *ctx, int argnum)
+{
+    if (argnum == 1) {
+        FS_File_g("maps", ".bsp", FS_SEARCH_STRIPEXT, ctx);
+    }
+}
+
+static const cmdreg_t c_bench[] = {
+    { "sv_bench", SV_Bench_f, SV_Bench_c },
+    { "sv_decodetest", SV_DecodeTest_f },
+    { "sv_rewindbench", SV_RewindBench_f },
+    { "recordmoves", SV_RecordMoves_f },
+    { "stopmoves", SV_StopMoves_f },
+    { NULL }
+};
+
+void SV_RegisterBenchmark(void)
+{
+    Cmd_Register(c_bench);
+}
+
+/*
+==================
+SV_ShutdownBenchmark
+
+Writes out any move recording still in progress.
+==================
+*/
+void SV_ShutdownBenchmark(void)
+{
+    if (rec.client)
+        stop_recording();
+}
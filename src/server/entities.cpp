@@ -269,10 +269,12 @@ void SV_BuildClientFrame(client_t *client)
 	int         l;
     int         clientarea, clientcluster;
     mleaf_t     *leaf;
-    static byte        clientphs[VIS_MAX_BYTES];
+    const byte  *clientphs;
     static byte        clientpvs[VIS_MAX_BYTES];
     qboolean    ent_visible;
-    int cull_nonvisible_entities = Cvar_Get("sv_cull_nonvisible_entities", "1", CVAR_CHEAT)->integer;
+    int cull_nonvisible_entities = sv_cull_nonvisible_entities->integer;
+
+    PROF_ZONE("SV_BuildClientFrame");
 
     clent = client->edict;
     if (!clent->client)
@@ -318,10 +320,12 @@ void SV_BuildClientFrame(client_t *client)
 	}
 	else
 	{
-		BSP_ClusterVis(client->cm->cache, clientpvs, client->lastValidCluster, DVIS_PVS2);
+		memcpy(clientpvs, SV_ClusterVis(client->lastValidCluster, DVIS_PVS2), VIS_MAX_BYTES);
 	}
 
-    BSP_ClusterVis(client->cm->cache, clientphs, clientcluster, DVIS_PHS);
+    // shared by clients in the same cluster, don't ask for other rows below
+    clientphs = SV_ClusterVis(clientcluster, DVIS_PHS);
+    SV_HoldClusterVis();
 
     // build up the list of visible entities
     frame->num_entities = 0;
@@ -432,5 +436,7 @@ void SV_BuildClientFrame(client_t *client)
             break;
         }
     }
+
+    SV_CheckClusterVis();
 }
 
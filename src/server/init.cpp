@@ -146,7 +146,12 @@ void SV_SpawnServer(MapCommand *cmd)
     SV_SendClientMessages();
     SV_SendAsyncPackets();
 
+    // files may change between maps
+    SV_FlushDownloadCache();
+    SV_ClearClientPackets();
+
     // free current level
+    SV_FreeGamestate();
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entityString);
 
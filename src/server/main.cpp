@@ -39,6 +39,7 @@ cvar_t  *sv_timeout;            // seconds without any message
 cvar_t  *sv_zombietime;         // seconds to sink messages after disconnect
 cvar_t  *sv_ghostime;
 cvar_t  *sv_idlekick;
+cvar_t  *sv_maxrewind;
 
 cvar_t  *sv_password;
 cvar_t  *sv_reserved_password;
@@ -49,6 +50,8 @@ cvar_t  *sv_show_name_changes;
 cvar_t  *sv_airaccelerate;
 cvar_t  *sv_qwmod;              // atu QW Physics modificator
 cvar_t  *sv_novis;
+cvar_t  *sv_cull_nonvisible_entities;
+cvar_t  *sv_coop;
 
 cvar_t* sv_in_bspmenu;
 
@@ -1247,7 +1250,7 @@ SV_CalcPings
 Updates the cl->ping and cl->fps variables
 ===================
 */
-static void SV_CalcPings(void)
+void SV_CalcPings(void)
 {
     client_t    *cl;
     int         (*calc)(client_t *);
@@ -1300,7 +1303,7 @@ Every few frames, gives all clients an allotment of milliseconds
 for their command moves.  If they exceed it, assume cheating.
 ===================
 */
-static void SV_GiveMsec(void)
+void SV_GiveMsec(void)
 {
     client_t    *cl;
 
@@ -1318,7 +1321,7 @@ static void SV_GiveMsec(void)
 SV_PacketEvent
 =================
 */
-static void SV_PacketEvent(void)
+void SV_PacketEvent(void)
 {
     client_t    *client;
     NetChannel   *netchan;
@@ -1327,6 +1330,8 @@ static void SV_PacketEvent(void)
     // check for connectionless packet (0xffffffff) first
     // connectionless packets are processed even if the server is down
     if (*(int *)msg_read.data == -1) {
+        // it may add or reuse a client slot, catch up with earlier packets
+        SV_RunClientPackets();
         SV_ConnectionlessPacket();
         return;
     }
@@ -1382,7 +1387,8 @@ static void SV_PacketEvent(void)
         if (netchan->deltaFramePacketDrops > 0)
             client->frameFlags |= FF_CLIENTDROP;
 
-        SV_ExecuteClientMessage(client);
+        // executed after the batch, in arrival order
+        SV_QueueClientPacket(client);
         break;
     }
 }
@@ -1431,6 +1437,9 @@ void SV_ErrorEvent(netadr_t *from, int ee_errno, int ee_info)
     client_t    *client;
     NetChannel   *netchan;
 
+    // may drop a client, catch up with earlier packets
+    SV_RunClientPackets();
+
     if (!svs.initialized) {
         return;
     }
@@ -1472,7 +1481,7 @@ for a few seconds to make sure any final reliable message gets resent
 if necessary
 ==================
 */
-static void SV_CheckTimeouts(void)
+void SV_CheckTimeouts(void)
 {
     client_t    *client;
     unsigned    zombie_time = 1000 * sv_zombietime->value;
@@ -1534,12 +1543,13 @@ This has to be done before the world logic, because
 player processing happens outside RunWorldFrame
 ================
 */
-static void SV_PrepWorldFrame(void)
+void SV_PrepWorldFrame(void)
 {
     Entity    *ent;
     int        i;
 
     sv.tracecount = 0;
+    memset(&sv.multicast, 0, sizeof(sv.multicast));
 
     if (!SV_FRAMESYNC)
         return;
@@ -1565,7 +1575,7 @@ static inline qboolean check_paused(void)
     if (com_timedemo->integer)
         goto resume;
 
-	if (!LIST_SINGLE(&sv_clientlist) && !Cvar_VariableInteger("coop"))
+	if (!LIST_SINGLE(&sv_clientlist) && !sv_coop->integer)
         goto resume;
 
     if (!sv_paused->integer) {
@@ -1590,14 +1600,20 @@ resume:
 SV_RunGameFrame
 =================
 */
-static void SV_RunGameFrame(void)
+void SV_RunGameFrame(void)
 {
 #if USE_CLIENT
     if (host_speeds->integer)
         time_before_game = Sys_Milliseconds();
 #endif
 
-    ge->RunFrame();
+    {
+        PROF_ZONE("SVG_RunFrame");
+        ge->RunFrame();
+    }
+
+    // remember where everyone was for rewound traces
+    SV_RecordLagFrame();
 
 #if USE_CLIENT
     if (host_speeds->integer)
@@ -1712,6 +1728,7 @@ unsigned SV_Frame(unsigned msec)
 
     // read packets from UDP clients
     NET_GetPackets(NS_SERVER, SV_PacketEvent);
+    SV_RunClientPackets();
 
     if (svs.initialized) {
         // deliver fragments and reliable messages for connecting clients
@@ -1920,11 +1937,12 @@ void SV_Init(void)
     SV_InitOperatorCommands();
 
     SV_RegisterSavegames();
+    SV_RegisterBenchmark();
 
     Cvar_Get("protocol", STRINGIFY(PROTOCOL_VERSION_DEFAULT), CVAR_SERVERINFO | CVAR_ROM);
     Cvar_Get("skill", "1", CVAR_LATCH);
     Cvar_Get("deathmatch", "1", CVAR_SERVERINFO | CVAR_LATCH);
-    Cvar_Get("coop", "0", /*CVAR_SERVERINFO|*/CVAR_LATCH);
+    sv_coop = Cvar_Get("coop", "0", /*CVAR_SERVERINFO|*/CVAR_LATCH);
     Cvar_Get("cheats", "0", CVAR_SERVERINFO | CVAR_LATCH);
     Cvar_Get("gamemodeflags", "16", CVAR_SERVERINFO); // 16 = DF_INSTANT_ITEMS
     Cvar_Get("fraglimit", "0", CVAR_SERVERINFO);
@@ -1941,6 +1959,7 @@ void SV_Init(void)
     sv_zombietime = Cvar_Get("zombietime", "2", 0);
     sv_ghostime = Cvar_Get("sv_ghostime", "6", 0);
     sv_idlekick = Cvar_Get("sv_idlekick", "0", 0);
+    sv_maxrewind = Cvar_Get("sv_maxrewind", "250", 0);
     sv_showclamp = Cvar_Get("showclamp", "0", 0);
     sv_enforcetime = Cvar_Get("sv_enforcetime", "1", 0);
     sv_allow_nodelta = Cvar_Get("sv_allow_nodelta", "1", 0);
@@ -1955,6 +1974,7 @@ void SV_Init(void)
     sv_reserved_password = Cvar_Get("sv_reserved_password", "", CVAR_PRIVATE);
     sv_locked = Cvar_Get("sv_locked", "0", 0);
     sv_novis = Cvar_Get("sv_novis", "0", 0);
+    sv_cull_nonvisible_entities = Cvar_Get("sv_cull_nonvisible_entities", "1", CVAR_CHEAT);
     sv_downloadserver = Cvar_Get("sv_downloadserver", "", 0);
     sv_redirect_address = Cvar_Get("sv_redirect_address", "", 0);
 
@@ -2087,6 +2107,11 @@ void SV_Shutdown(const char *finalmsg, ErrorType type)
     SV_FinalMessage(finalmsg, type);
     SV_MasterShutdown();
     SV_ShutdownGameProgs();
+    SV_ShutdownSavegames();
+    SV_ShutdownBenchmark();
+    SV_FlushDownloadCache();
+    SV_FreeGamestate();
+    SV_ClearClientPackets();
 
     // free current level
     CM_FreeMap(&sv.cm);
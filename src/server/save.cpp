@@ -16,16 +16,491 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
 #include "server.h"
 
 #define SAVE_MAGIC1     (('2'<<24)|('V'<<16)|('S'<<8)|'S')  // "SSV2"
 #define SAVE_MAGIC2     (('2'<<24)|('V'<<16)|('A'<<8)|'S')  // "SAV2"
 #define SAVE_VERSION    1
 
+// snapshot container every savegame file is wrapped in
+#define SAVE_ZMAGIC     (('Z'<<24)|('V'<<16)|('S'<<8)|'P')  // "PSVZ"
+#define SAVE_ZVERSION   1
+
 #define SAVE_CURRENT    ".current"
 #define SAVE_AUTO       "save0"
 
+#define MAX_SAVE_LOADS  4
+
 cvar_t *sv_savedir = NULL;
+static cvar_t *sv_savecompress;
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    rawlen;     // size of the snapshot
+    uint32_t    zlen;       // size of the deflated snapshot, 0 if stored
+} save_header_t;
+
+/*
+==============================================================================
+
+SAVE THREAD
+
+Writing a savegame used to stall the frame in a pile of small fwrite calls,
+followed by a file-by-file directory copy for autosaves. Now the game hands
+over complete in-memory snapshots, and everything that touches the disk is
+queued here and done in order on a background thread: compression, writing
+through a temporary file, and removing or copying files between save slots.
+
+The save thread never touches the zone allocator, filesystem handles or the
+console, so jobs are allocated with malloc and only carry OS paths. Anything
+that reads back a file still being written calls flush_saves first.
+
+==============================================================================
+*/
+
+typedef enum {
+    SAVE_JOB_WRITE,
+    SAVE_JOB_COPY,
+    SAVE_JOB_REMOVE
+} save_job_type_t;
+
+typedef struct {
+    list_t          entry;
+    save_job_type_t type;
+    char            path[MAX_OSPATH];   // destination, or file to remove
+    char            src[MAX_OSPATH];    // source for copies
+    size_t          len;
+    int             level;              // compression level for writes
+    byte            data[1];            // snapshot for writes
+} save_job_t;
+
+static struct {
+    std::mutex              lock;
+    std::condition_variable wake;   // jobs queued
+    std::condition_variable idle;   // queue drained
+    list_t                  jobs;
+    qboolean                started;
+    qboolean                busy;
+    char                    current[MAX_OSPATH];    // path of the busy job
+    save_job_type_t         currenttype;
+    int                     errors;
+    char                    failed[MAX_OSPATH];
+} save_thread;
+
+typedef struct {
+    void    *data;      // what the caller sees
+    void    *map;       // file mapping, if still held
+    size_t  maplen;
+    void    *buffer;    // inflated snapshot, if any
+} save_load_t;
+
+static save_load_t save_loads[MAX_SAVE_LOADS];
+
+static qboolean write_snapshot(const char *path, const byte *data, size_t len, int level)
+{
+    char            tmp[MAX_OSPATH], dir[MAX_OSPATH];
+    save_header_t   header;
+    byte            *zdata = NULL;
+    uLongf          zlen = 0;
+    FILE            *fp;
+    qboolean        ok;
+
+    if (Q_concat(tmp, sizeof(tmp), path, ".tmp", NULL) >= sizeof(tmp))
+        return false;
+
+    Q_strlcpy(dir, path, sizeof(dir));
+    if (FS_CreatePath(dir))
+        return false;
+
+    if (level > 0) {
+        zlen = compressBound(len);
+        zdata = (byte *)malloc(zlen);
+        if (zdata && compress2(zdata, &zlen, data, len, level) != Z_OK) {
+            free(zdata);
+            zdata = NULL;
+        }
+        // incompressible snapshots are stored
+        if (zdata && zlen >= len) {
+            free(zdata);
+            zdata = NULL;
+        }
+    }
+
+    header.magic = LittleLong(SAVE_ZMAGIC);
+    header.version = LittleLong(SAVE_ZVERSION);
+    header.rawlen = LittleLong(len);
+    header.zlen = LittleLong(zdata ? zlen : 0);
+
+    fp = fopen(tmp, "wb");
+    if (!fp) {
+        free(zdata);
+        return false;
+    }
+
+    ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header);
+    if (zdata)
+        ok &= fwrite(zdata, 1, zlen, fp) == zlen;
+    else
+        ok &= fwrite(data, 1, len, fp) == len;
+    ok &= fclose(fp) == 0;
+    free(zdata);
+
+    if (!ok) {
+        remove(tmp);
+        return false;
+    }
+
+    // only replace the old file once the new one is complete
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmp, path)) {
+        remove(tmp);
+        return false;
+    }
+
+    return true;
+}
+
+static qboolean copy_snapshot(const char *src, const char *dst)
+{
+    char    dir[MAX_OSPATH];
+    byte    buf[0x10000];
+    FILE    *ifp, *ofp;
+    size_t  len, res;
+    qboolean ok;
+
+    ifp = fopen(src, "rb");
+    if (!ifp)
+        return false;
+
+    Q_strlcpy(dir, dst, sizeof(dir));
+    if (FS_CreatePath(dir)) {
+        fclose(ifp);
+        return false;
+    }
+
+    ofp = fopen(dst, "wb");
+    if (!ofp) {
+        fclose(ifp);
+        return false;
+    }
+
+    do {
+        len = fread(buf, 1, sizeof(buf), ifp);
+        res = fwrite(buf, 1, len, ofp);
+    } while (len == sizeof(buf) && res == len);
+
+    ok = !ferror(ifp) && !ferror(ofp);
+    ok &= fclose(ofp) == 0;
+    fclose(ifp);
+
+    return ok;
+}
+
+static void save_thread_func(void)
+{
+    save_job_t  *job;
+    qboolean    ok;
+
+    while (1) {
+        {
+            std::unique_lock<std::mutex> lock(save_thread.lock);
+
+            save_thread.busy = false;
+            save_thread.current[0] = 0;
+            if (LIST_EMPTY(&save_thread.jobs))
+                save_thread.idle.notify_all();
+
+            save_thread.wake.wait(lock, [] { return !LIST_EMPTY(&save_thread.jobs); });
+
+            job = LIST_FIRST(save_job_t, &save_thread.jobs, entry);
+            List_Remove(&job->entry);
+            save_thread.busy = true;
+            Q_strlcpy(save_thread.current, job->path, sizeof(save_thread.current));
+            save_thread.currenttype = job->type;
+        }
+
+        switch (job->type) {
+        case SAVE_JOB_WRITE:
+            ok = write_snapshot(job->path, job->data, job->len, job->level);
+            break;
+        case SAVE_JOB_COPY:
+            ok = copy_snapshot(job->src, job->path);
+            break;
+        case SAVE_JOB_REMOVE:
+            ok = !remove(job->path);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+
+        if (!ok) {
+            std::lock_guard<std::mutex> lock(save_thread.lock);
+            save_thread.errors++;
+            Q_strlcpy(save_thread.failed, job->path, sizeof(save_thread.failed));
+        }
+
+        free(job);
+    }
+}
+
+// reports failures from the save thread, must be called from the main thread
+static int check_save_errors(void)
+{
+    std::lock_guard<std::mutex> lock(save_thread.lock);
+    int errors = save_thread.errors;
+
+    if (errors) {
+        Com_EPrintf("Couldn't write savegame file %s", save_thread.failed);
+        if (errors > 1)
+            Com_EPrintf(" (and %d more)", errors - 1);
+        Com_EPrintf("\n");
+        save_thread.errors = 0;
+    }
+
+    return errors;
+}
+
+static void queue_save_job(save_job_t *job)
+{
+    std::lock_guard<std::mutex> lock(save_thread.lock);
+
+    if (!save_thread.started) {
+        List_Init(&save_thread.jobs);
+        // the thread simply blocks when idle, it is never joined
+        std::thread(save_thread_func).detach();
+        save_thread.started = true;
+    }
+
+    List_Append(&save_thread.jobs, &job->entry);
+    save_thread.wake.notify_one();
+}
+
+// blocks until everything queued so far is on disk
+static int flush_saves(void)
+{
+    {
+        std::unique_lock<std::mutex> lock(save_thread.lock);
+
+        if (save_thread.started) {
+            save_thread.idle.wait(lock, [] {
+                return LIST_EMPTY(&save_thread.jobs) && !save_thread.busy;
+            });
+        }
+    }
+
+    return check_save_errors();
+}
+
+// returns true if a queued or running job is going to change the file
+static qboolean save_pending(const char *path)
+{
+    std::lock_guard<std::mutex> lock(save_thread.lock);
+    save_job_t *job;
+
+    if (!save_thread.started)
+        return false;
+
+    if (save_thread.busy && !strcmp(save_thread.current, path))
+        return true;
+
+    LIST_FOR_EACH(save_job_t, job, &save_thread.jobs, entry) {
+        if (!strcmp(job->path, path))
+            return true;
+    }
+
+    return false;
+}
+
+static int queue_write(const char *path, const void *data, size_t len)
+{
+    save_job_t *job;
+
+    if (len > UINT32_MAX)
+        return -1;
+
+    job = (save_job_t *)malloc(sizeof(*job) + len);
+    if (!job)
+        return -1;
+
+    job->type = SAVE_JOB_WRITE;
+    if (Q_strlcpy(job->path, path, sizeof(job->path)) >= sizeof(job->path)) {
+        free(job);
+        return -1;
+    }
+    job->src[0] = 0;
+    job->len = len;
+    job->level = Cvar_ClampInteger(sv_savecompress, 0, 9);
+    memcpy(job->data, data, len);
+
+    check_save_errors();
+    queue_save_job(job);
+    return 0;
+}
+
+static int queue_file_job(save_job_type_t type, const char *path, const char *src)
+{
+    save_job_t *job;
+
+    job = (save_job_t *)malloc(sizeof(*job));
+    if (!job)
+        return -1;
+
+    job->type = type;
+    Q_strlcpy(job->path, path, sizeof(job->path));
+    Q_strlcpy(job->src, src ? src : "", sizeof(job->src));
+    job->len = 0;
+    job->level = 0;
+
+    queue_save_job(job);
+    return 0;
+}
+
+/*
+=================
+load_snapshot
+
+Maps a savegame file and returns the snapshot inside. Stored snapshots are
+handed out straight from the mapping, deflated ones are inflated into a
+zone buffer. Files without the container header predate it and are raw.
+=================
+*/
+static void *load_snapshot(const char *path, size_t *len)
+{
+    save_load_t     *load;
+    save_header_t   header;
+    uLongf          rawlen;
+    byte            *map;
+    size_t          maplen;
+    int             i;
+
+    *len = 0;
+
+    for (i = 0, load = save_loads; i < MAX_SAVE_LOADS; i++, load++) {
+        if (!load->data)
+            break;
+    }
+    if (i == MAX_SAVE_LOADS) {
+        Com_WPrintf("%s: too many open savegame files\n", __func__);
+        return NULL;
+    }
+
+    map = (byte *)Sys_MapFile(path, &maplen);
+    if (!map)
+        return NULL;
+
+    load->map = map;
+    load->maplen = maplen;
+    load->buffer = NULL;
+
+    if (maplen < sizeof(header)) {
+        load->data = map;
+        *len = maplen;
+        return load->data;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    if ((uint32_t)LittleLong(header.magic) != SAVE_ZMAGIC) {
+        load->data = map;
+        *len = maplen;
+        return load->data;
+    }
+
+    header.version = LittleLong(header.version);
+    header.rawlen = LittleLong(header.rawlen);
+    header.zlen = LittleLong(header.zlen);
+
+    if (header.version != SAVE_ZVERSION)
+        goto fail;
+
+    if (!header.zlen) {
+        if (header.rawlen > maplen - sizeof(header))
+            goto fail;
+        load->data = map + sizeof(header);
+        *len = header.rawlen;
+        return load->data;
+    }
+
+    if (header.zlen > maplen - sizeof(header))
+        goto fail;
+
+    // the compressed image is no longer needed once inflated
+    load->buffer = Z_Malloc(header.rawlen ? header.rawlen : 1);
+    rawlen = header.rawlen;
+    if (uncompress((byte *)load->buffer, &rawlen, map + sizeof(header), header.zlen) != Z_OK ||
+        rawlen != header.rawlen) {
+        Z_Free(load->buffer);
+        goto fail;
+    }
+
+    Sys_UnmapFile(map, maplen);
+    load->map = NULL;
+    load->data = load->buffer;
+    *len = rawlen;
+    return load->data;
+
+fail:
+    Com_WPrintf("%s: %s is not a valid savegame file\n", __func__, path);
+    Sys_UnmapFile(map, maplen);
+    memset(load, 0, sizeof(*load));
+    return NULL;
+}
+
+static void free_snapshot(void *data)
+{
+    save_load_t *load;
+    int         i;
+
+    if (!data)
+        return;
+
+    for (i = 0, load = save_loads; i < MAX_SAVE_LOADS; i++, load++) {
+        if (load->data == data) {
+            Sys_UnmapFile(load->map, load->maplen);
+            Z_Free(load->buffer);
+            memset(load, 0, sizeof(*load));
+            return;
+        }
+    }
+
+    Com_WPrintf("%s: unknown savegame buffer\n", __func__);
+}
+
+qboolean PF_WriteSaveFile(const char *filename, const void *data, size_t len)
+{
+    return !queue_write(filename, data, len);
+}
+
+void *PF_LoadSaveFile(const char *filename, size_t *len)
+{
+    flush_saves();
+    return load_snapshot(filename, len);
+}
+
+void PF_FreeSaveFile(void *data)
+{
+    free_snapshot(data);
+}
+
+/*
+==============================================================================
+
+SAVEGAME FILES
+
+==============================================================================
+*/
+
+static size_t save_path(char *buf, const char *dir, const char *name)
+{
+    return Q_snprintf(buf, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dir, name);
+}
 
 
 static int write_server_file(qboolean autosave)
@@ -64,8 +539,10 @@ static int write_server_file(qboolean autosave)
     MSG_WriteString(NULL);
 
     // write server state
-	Q_snprintf(name, MAX_OSPATH, "%s/%s/server.ssv", sv_savedir->string, SAVE_CURRENT);
-    ret = FS_WriteFile(name, msg_write.data, msg_write.currentSize);
+    if (save_path(name, SAVE_CURRENT, "server.ssv") >= MAX_OSPATH)
+        ret = -1;
+    else
+        ret = queue_write(name, msg_write.data, msg_write.currentSize);
 
     SZ_Clear(&msg_write);
 
@@ -115,11 +592,11 @@ static int write_level_file(void)
     MSG_WriteByte(len);
     MSG_WriteData(portalbits, len);
 
-    len = Q_snprintf(name, MAX_QPATH, "%s/%s/%s.sv2", sv_savedir->string, SAVE_CURRENT, sv.name);
-    if (len >= MAX_QPATH)
+    len = Q_snprintf(name, MAX_OSPATH, "%s/%s/%s/%s.sv2", fs_gamedir, sv_savedir->string, SAVE_CURRENT, sv.name);
+    if (len >= MAX_OSPATH)
         ret = -1;
     else
-        ret = FS_WriteFile(name, msg_write.data, msg_write.currentSize);
+        ret = queue_write(name, msg_write.data, msg_write.currentSize);
 
     SZ_Clear(&msg_write);
 
@@ -138,123 +615,179 @@ static int write_level_file(void)
 
 static int copy_file(const char *src, const char *dst, const char *name)
 {
-    char    path[MAX_OSPATH];
-    byte    buf[0x10000];
-    FILE    *ifp, *ofp;
-    size_t  len, res;
-    int     ret = -1;
+    char    srcpath[MAX_OSPATH], dstpath[MAX_OSPATH];
 
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, src, name);
-    if (len >= MAX_OSPATH)
-        goto fail0;
+    if (save_path(srcpath, src, name) >= MAX_OSPATH)
+        return -1;
 
-    ifp = fopen(path, "rb");
-    if (!ifp)
-        goto fail0;
+    if (save_path(dstpath, dst, name) >= MAX_OSPATH)
+        return -1;
 
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dst, name);
-    if (len >= MAX_OSPATH)
-        goto fail1;
+    return queue_file_job(SAVE_JOB_COPY, dstpath, srcpath);
+}
 
-    if (FS_CreatePath(path))
-        goto fail1;
+static int remove_file(const char *dir, const char *name)
+{
+    char path[MAX_OSPATH];
 
-    ofp = fopen(path, "wb");
-    if (!ofp)
-        goto fail1;
+    if (save_path(path, dir, name) >= MAX_OSPATH)
+        return -1;
 
-    do {
-        len = fread(buf, 1, sizeof(buf), ifp);
-        res = fwrite(buf, 1, len, ofp);
-    } while (len == sizeof(buf) && res == len);
+    return queue_file_job(SAVE_JOB_REMOVE, path, NULL);
+}
 
-    if (ferror(ifp))
-        goto fail2;
+static void **list_save_dir(const char *dir, int *count)
+{
+    return FS_ListFiles(va("%s/%s", sv_savedir->string, dir), ".ssv;.sav;.sv2",
+        FS_TYPE_REAL | FS_PATH_GAME, count);
+}
 
-    if (ferror(ofp))
-        goto fail2;
+#define MAX_PENDING_FILES   64
 
-    ret = 0;
-fail2:
-    fclose(ofp);
-fail1:
-    fclose(ifp);
-fail0:
-    return ret;
+/*
+=================
+list_pending_files
+
+Files that are still waiting in the save queue or being written don't show
+up in the directory listing yet, but anything queued after them must see
+them. Returns the names of pending files in the given slot. Call before
+listing the directory, so a file finishing in between shows up in the
+listing instead of nowhere.
+=================
+*/
+static int add_pending_file(const char *path, const char *prefix, size_t len,
+                            char (*names)[MAX_QPATH], int numnames)
+{
+    const char  *name;
+    int         i;
+
+    if (strncmp(path, prefix, len))
+        return numnames;
+
+    name = path + len;
+    for (i = 0; i < numnames; i++) {
+        if (!strcmp(names[i], name))
+            return numnames;
+    }
+
+    if (numnames < MAX_PENDING_FILES)
+        Q_strlcpy(names[numnames++], name, MAX_QPATH);
+    return numnames;
 }
 
-static int remove_file(const char *dir, const char *name)
+static int list_pending_files(const char *dir, char (*names)[MAX_QPATH])
 {
-    char path[MAX_OSPATH];
-    size_t len;
+    char        prefix[MAX_OSPATH];
+    save_job_t  *job;
+    size_t      len;
+    int         numnames = 0;
 
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dir, name);
+    len = save_path(prefix, dir, "");
     if (len >= MAX_OSPATH)
-        return -1;
+        return 0;
+
+    std::lock_guard<std::mutex> lock(save_thread.lock);
 
-    return remove(path);
+    if (!save_thread.started)
+        return 0;
+
+    if (save_thread.busy && save_thread.currenttype != SAVE_JOB_REMOVE)
+        numnames = add_pending_file(save_thread.current, prefix, len, names, numnames);
+
+    LIST_FOR_EACH(save_job_t, job, &save_thread.jobs, entry) {
+        if (job->type == SAVE_JOB_REMOVE)
+            continue;
+        numnames = add_pending_file(job->path, prefix, len, names, numnames);
+    }
+
+    return numnames;
 }
 
-static void **list_save_dir(const char *dir, int *count)
+static qboolean listed_file(void **list, int count, const char *name)
 {
-    return FS_ListFiles(va("%s/%s", sv_savedir->string, dir), ".ssv;.sav;.sv2",
-        FS_TYPE_REAL | FS_PATH_GAME, count);
+    int i;
+
+    for (i = 0; list && i < count; i++) {
+        if (!strcmp((const char *)list[i], name)) // CPP: Cast
+            return true;
+    }
+
+    return false;
 }
 
 static int wipe_save_dir(const char *dir)
 {
+    static char pending[MAX_PENDING_FILES][MAX_QPATH];
     void **list;
-    int i, count, ret = 0;
+    int i, count, numpending, ret = 0;
 
-    if ((list = list_save_dir(dir, &count)) == NULL)
-        return 0;
+    numpending = list_pending_files(dir, pending);
+    list = list_save_dir(dir, &count);
 
-    for (i = 0; i < count; i++)
+    for (i = 0; list && i < count; i++)
         ret |= remove_file(dir, (const char*)list[i]); // CPP: Cast
 
+    for (i = 0; i < numpending; i++) {
+        if (!listed_file(list, count, pending[i]))
+            ret |= remove_file(dir, pending[i]);
+    }
+
     FS_FreeList(list);
     return ret;
 }
 
 static int copy_save_dir(const char *src, const char *dst)
 {
+    static char pending[MAX_PENDING_FILES][MAX_QPATH];
     void **list;
-    int i, count, ret = 0;
+    int i, count, numpending, ret = 0;
+
+    numpending = list_pending_files(src, pending);
+    list = list_save_dir(src, &count);
 
-    if ((list = list_save_dir(src, &count)) == NULL)
+    if (!list && !numpending)
         return -1;
 
-    for (i = 0; i < count; i++)
+    for (i = 0; list && i < count; i++)
         ret |= copy_file(src, dst, (const char*)list[i]); // CPP: Cast
 
+    for (i = 0; i < numpending; i++) {
+        if (!listed_file(list, count, pending[i]))
+            ret |= copy_file(src, dst, pending[i]);
+    }
+
     FS_FreeList(list);
     return ret;
 }
 
 static int read_binary_file(const char *name)
 {
-    qhandle_t f;
+    char path[MAX_OSPATH];
+    void *data;
     size_t len;
 
-    len = FS_FOpenFile(name, &f, FS_MODE_READ | FS_TYPE_REAL | FS_PATH_GAME);
-    if (!f)
+    if (Q_snprintf(path, MAX_OSPATH, "%s/%s", fs_gamedir, name) >= MAX_OSPATH)
         return -1;
 
-    if (len > MAX_MSGLEN)
-        goto fail;
+    // listing save slots shouldn't wait for unrelated saves
+    if (save_pending(path))
+        flush_saves();
 
-    if (FS_Read(msg_read_buffer, len, f) != len)
-        goto fail;
+    data = load_snapshot(path, &len);
+    if (!data)
+        return -1;
+
+    if (len > MAX_MSGLEN) {
+        free_snapshot(data);
+        return -1;
+    }
+
+    memcpy(msg_read_buffer, data, len);
+    free_snapshot(data);
 
     SZ_Init(&msg_read, msg_read_buffer, len);
     msg_read.currentSize = len;
-
-    FS_FCloseFile(f);
     return 0;
-
-fail:
-    FS_FCloseFile(f);
-    return -1;
 }
 
 char *SV_GetSaveInfo(const char *dir)
@@ -594,6 +1127,9 @@ static void SV_Loadgame_f(void)
         return;
     }
 
+    // let any save still in flight land first
+    flush_saves();
+
     // make sure the server files exist
     if (!FS_FileExistsEx(va("%s/%s/server.ssv", sv_savedir->string, dir), FS_TYPE_REAL | FS_PATH_GAME) ||
         !FS_FileExistsEx(va("%s/%s/game.ssv", sv_savedir->string, dir), FS_TYPE_REAL | FS_PATH_GAME)) {
@@ -694,4 +1230,26 @@ void SV_RegisterSavegames(void)
 {
     Cmd_Register(c_savegames);
 	sv_savedir = Cvar_Get("sv_savedir", "save", 0);
+    sv_savecompress = Cvar_Get("sv_savecompress", "1", 0);
+}
+
+/*
+==================
+SV_ShutdownSavegames
+
+Waits for pending savegame writes and releases any snapshots the game
+didn't get to free because of an error.
+==================
+*/
+void SV_ShutdownSavegames(void)
+{
+    save_load_t *load;
+    int         i;
+
+    flush_saves();
+
+    for (i = 0, load = save_loads; i < MAX_SAVE_LOADS; i++, load++) {
+        if (load->data)
+            free_snapshot(load->data);
+    }
 }
@@ -251,11 +251,10 @@ MultiCast::PHS    send to clients potentially hearable from org
 void SV_Multicast(const vec3_t &origin, int32_t to)
 {
     client_t    *client;
-    static byte mask[VIS_MAX_BYTES];
+    const byte  *mask;
     mleaf_t     *leaf1, *leaf2;
     int         leafnum q_unused;
     int         flags;
-    vec3_t      org;
 
     if (!sv.cm.cache) {
         Com_Error(ERR_DROP, "%s: no map loaded", __func__);
@@ -270,6 +269,7 @@ void SV_Multicast(const vec3_t &origin, int32_t to)
     case MultiCast::All:
         leaf1 = NULL;
         leafnum = 0;
+        mask = NULL;
         break;
     case MultiCast::PHS_R:
         flags |= MSG_RELIABLE;
@@ -277,7 +277,7 @@ void SV_Multicast(const vec3_t &origin, int32_t to)
     case MultiCast::PHS:
         leaf1 = CM_PointLeaf(&sv.cm, origin); // MATHLIB: !! Or do *origin??
         leafnum = leaf1 - sv.cm.cache->leafs;
-        BSP_ClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        mask = SV_ClusterVis(leaf1->cluster, DVIS_PHS);
         break;
     case MultiCast::PVS_R:
         flags |= MSG_RELIABLE;
@@ -285,12 +285,19 @@ void SV_Multicast(const vec3_t &origin, int32_t to)
     case MultiCast::PVS:
         leaf1 = CM_PointLeaf(&sv.cm, origin); // MATHLIB: !! Or do *origin??
         leafnum = leaf1 - sv.cm.cache->leafs;
-        BSP_ClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PVS2);
+        mask = SV_ClusterVis(leaf1->cluster, DVIS_PVS2);
         break;
     default:
         Com_Error(ERR_DROP, "SV_Multicast: bad to: %i", to);
     }
 
+    // mask is held across the loop below
+    SV_HoldClusterVis();
+
+    if (!(flags & MSG_RELIABLE) && msg_write.currentSize) {
+        sv.multicast.messages++;
+    }
+
     // send the data to all relevent clients
     FOR_EACH_CLIENT(client) {
         if (client->connectionState < ConnectionState::Primed) {
@@ -304,17 +311,9 @@ void SV_Multicast(const vec3_t &origin, int32_t to)
 
         if (leaf1) {
             // find the client's PVS
-#if 0
-            PlayerState *ps = &client->edict->client->playerState;
-            // N&C: FF Precision.
-            VectorAdd(ps->viewOffset, ps->pmove.origin, orig);
-            //VectorMA(ps->viewOffset, 0.125f, ps->pmove.origin, org);
-#else
             // FIXME: for some strange reason, game code assumes the server
             // uses entity origin for PVS/PHS culling, not the view origin
-            org = client->edict->state.origin; // VectorCopy(client->edict->state.origin, org);
-#endif
-            leaf2 = CM_PointLeaf(&sv.cm, org);
+            leaf2 = SV_ClientLeaf(client);
             if (!CM_AreasConnected(&sv.cm, leaf1->area, leaf2->area))
                 continue;
             if (leaf2->cluster == -1)
@@ -323,9 +322,18 @@ void SV_Multicast(const vec3_t &origin, int32_t to)
                 continue;
         }
 
+        // unreliable ones too go into the netchan message, like any other
+        // message they must not be lost when a datagram is dropped
+        if (!(flags & MSG_RELIABLE)) {
+            sv.multicast.recipients++;
+            sv.multicast.copiedBytes += msg_write.currentSize;
+        }
+
         SV_ClientAddMessage(client, flags);
     }
 
+    SV_CheckClusterVis();
+
     // clear the buffer
     SZ_Clear(&msg_write);
 }
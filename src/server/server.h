@@ -31,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/msg.h"
 #include "common/net/net.h"
 #include "common/net/netchan.h"
+#include "common/profile.h"
 #include "common/prompt.h"
 #include "common/protocol.h"
 #include "common/zone.h"
@@ -143,6 +144,13 @@ typedef struct {
     server_entity_t entities[MAX_EDICTS];
 
     unsigned    tracecount;
+
+    // per frame multicast statistics
+    struct {
+        unsigned    messages;       // unreliable multicasts sent
+        unsigned    recipients;     // clients they were written to
+        size_t      copiedBytes;    // copied into netchan messages
+    } multicast;
 } server_t;
 
 
@@ -283,7 +291,8 @@ typedef struct client_s {
         int32_t fileSize;   // total bytes (can't use EOF because of paks)
         char *fileName;  // name of the file
 
-        byte *bytes;     // file being downloaded
+        const byte *bytes;  // file being downloaded, owned by cache
+        struct downloadcache_s *cache;
         int32_t bytesSent;  // bytes sent
 
         int32_t command;    // svc_(z)download
@@ -331,6 +340,10 @@ typedef struct client_s {
     time_t timeOfInitialConnect; // time of initial connect
 	int32_t lastValidCluster;
 
+    // leaf of the entity origin for multicast, see SV_ClientLeaf
+    vec3_t leafOrigin;
+    mleaf_t *leaf;
+    int32_t leafSpawncount;
 
 } client_t;
 
@@ -464,6 +477,8 @@ extern cvar_t       *sv_debug;
 extern cvar_t       *sv_pad_packets;
 #endif
 extern cvar_t       *sv_novis;
+extern cvar_t       *sv_cull_nonvisible_entities;
+extern cvar_t       *sv_coop;
 extern cvar_t       *sv_lan_force_rate;
 extern cvar_t       *sv_calcpings_method;
 extern cvar_t       *sv_changemapcmd;
@@ -490,6 +505,7 @@ extern cvar_t       *map_override_path;
 extern cvar_t       *sv_timeout;
 extern cvar_t       *sv_zombietime;
 extern cvar_t       *sv_ghostime;
+extern cvar_t       *sv_maxrewind;
 
 extern client_t     *sv_client;
 extern Entity       *sv_player;
@@ -517,6 +533,14 @@ void SV_RateInit(RateLimit *r, const char *s);
 AddressMatch *SV_MatchAddress(list_t *list, netadr_t *address);
 
 int SV_CountClients(void);
+void SV_PacketEvent(void);
+
+// server frame phases, in the order SV_Frame runs them
+void SV_CheckTimeouts(void);
+void SV_CalcPings(void);
+void SV_GiveMsec(void);
+void SV_RunGameFrame(void);
+void SV_PrepWorldFrame(void);
 
 #if USE_ZLIB
 voidpf SV_zalloc(voidpf opaque, uInt items, uInt size);
@@ -562,10 +586,35 @@ void SV_InitClientSend(client_t *newcl);
 //
 // sv_user.c
 //
+#define MAX_PACKET_QUEUE        512
+#define PACKET_QUEUE_BYTES      0x40000
+
+// sequenced packet waiting to be executed, decoded ahead of time
+typedef struct {
+    client_t            *client;
+    int                 drops;          // netchan drops before this packet
+    size_t              offset;         // into the queue data
+    size_t              length;
+
+    // filled in by the decode stage, moveStart is 0 if there is no move
+    size_t              moveStart;      // just past clc_move
+    size_t              moveEnd;
+    int                 lastFrame;
+    ClientMoveCommand   cmds[3];        // oldest, old and new
+} clientpacket_t;
+
 void SV_New_f(void);
 void SV_Begin_f(void);
 void SV_ExecuteClientMessage(client_t *cl);
+void SV_QueueClientPacket(client_t *client);
+void SV_DecodeClientPackets(qboolean jobs);
+void SV_RunClientPackets(void);
+void SV_ClearClientPackets(void);
+const clientpacket_t *SV_GetClientPackets(int *count);
 void SV_CloseDownload(client_t *client);
+void SV_InvalidateGamestate(void);
+void SV_FreeGamestate(void);
+void SV_FlushDownloadCache(void);
 
 //
 // sv_ccmds.c
@@ -606,8 +655,20 @@ void SV_AutoSaveBegin(MapCommand *cmd);
 void SV_AutoSaveEnd(void);
 void SV_CheckForSavegame(MapCommand *cmd);
 void SV_RegisterSavegames(void);
+void SV_ShutdownSavegames(void);
 int SV_NoSaveGames(void);
 
+//
+// sv_bench.c
+//
+void SV_RegisterBenchmark(void);
+void SV_ShutdownBenchmark(void);
+void SV_RecordMove(client_t *client, const ClientMoveCommand *cmd);
+
+qboolean PF_WriteSaveFile(const char *filename, const void *data, size_t len);
+void *PF_LoadSaveFile(const char *filename, size_t *len);
+void PF_FreeSaveFile(void *data);
+
 //============================================================
 
 //
@@ -639,6 +700,31 @@ int SV_AreaEntities(const vec3_t &mins, const vec3_t &maxs, Entity **list, int m
 
 qboolean SV_EntityIsVisible(cm_t *cm, Entity *ent, byte *mask);
 
+const byte *SV_ClusterVis(int cluster, int vis);
+// returns a decompressed vis row of the current map from a small cache,
+// valid only until the next SV_ClusterVis call, which may reuse the slot;
+// copy the row or bracket its use with SV_HoldClusterVis/SV_CheckClusterVis
+
+#ifdef _DEBUG
+extern unsigned sv_visgeneration;   // bumped by every SV_ClusterVis call
+#define SV_HoldClusterVis() \
+    unsigned visgeneration = sv_visgeneration
+#define SV_CheckClusterVis() \
+    if (sv_visgeneration != visgeneration) \
+        Com_Error(ERR_FATAL, "%s: vis row used across SV_ClusterVis calls", __func__)
+#else
+#define SV_HoldClusterVis()
+#define SV_CheckClusterVis()
+#endif
+
+mleaf_t *SV_ClientLeaf(client_t *client);
+// returns the leaf of the client entity origin, only descends the tree
+// again when the entity has moved
+
+void SV_ClearLagFrames(void);
+void SV_RecordLagFrame(void);
+// keeps past bounding boxes of clients and monsters for SV_TraceRewound
+
 //===================================================================
 
 //
@@ -652,6 +738,10 @@ trace_t q_gameabi SV_Trace(const vec3_t &start, const vec3_t &mins, const vec3_t
                            Entity *passedict, int contentmask);
 // mins and maxs are relative
 
+trace_t q_gameabi SV_TraceRewound(int msec, const vec3_t &start, const vec3_t &mins, const vec3_t &maxs,
+                                  const vec3_t &end, Entity *passedict, int contentmask);
+// same as SV_Trace with clients and monsters moved back msec milliseconds
+
 // if the entire move stays in a solid volume, trace.allSolid will be set,
 // trace.startSolid will be set, and trace.fraction will be 0
 
@@ -392,6 +392,8 @@ static void PF_configstring(int index, const char *val)
     memcpy(dst, val, len);
     dst[len] = 0;
 
+    SV_InvalidateGamestate();
+
     if (sv.serverState == ServerState::Loading) {
         return;
     }
@@ -881,6 +883,7 @@ void SV_InitGameProgs(void)
     importAPI.UnlinkEntity = PF_UnlinkEntity;
     importAPI.BoxEntities = SV_AreaEntities;
     importAPI.Trace = SV_Trace;
+    importAPI.TraceRewound = SV_TraceRewound;
     importAPI.PointContents = SV_PointContents;
     importAPI.SetModel = PF_setmodel;
     importAPI.InPVS = PF_InPVS;
@@ -906,6 +909,10 @@ void SV_InitGameProgs(void)
     importAPI.TagFree = Z_Free;
     importAPI.FreeTags = PF_FreeTags;
 
+    importAPI.WriteSaveFile = PF_WriteSaveFile;
+    importAPI.LoadSaveFile = PF_LoadSaveFile;
+    importAPI.FreeSaveFile = PF_FreeSaveFile;
+
     importAPI.cvar = PF_cvar;
     importAPI.cvar_set = Cvar_UserSet;
     importAPI.cvar_forceset = Cvar_Set;
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // sv_user.c -- server code for moving users
 
 #include "server.h"
+#include "common/jobs.h"
 
 /*
 ============================================================
@@ -64,6 +65,75 @@ sv_client and sv_player will be valid.
 ============================================================
 */
 
+/*
+Gamestate shared by connecting clients. On map change every client sends
+"new" at about the same time, so the configstrings and baselines are
+encoded once and copied to each of them. Encoded blobs are rebuilt after
+PF_configstring changes an entry or the baseline snapshot is refreshed.
+Baselines are only used as delta references, so the snapshot is allowed
+to lag behind the game by up to a second.
+*/
+static struct {
+    PackedEntity    *baselines[SV_BASELINES_CHUNKS];
+    int32_t         baselineFrame;
+    qboolean        haveBaselines;
+
+    // svc_configstring and svc_spawnbaseline records for clients without zlib
+    byte        *plain;
+    size_t      plainSize, plainAlloc;
+    uint32_t    *plainEnds;             // end offset of each record
+    int         numPlain, numPlainAlloc;
+    int         numPlainConfigstrings;
+    EntityStateMessageFlags plainFlags; // flags the records were encoded with
+    qboolean    havePlain;
+
+#if USE_ZLIB_PACKET_COMPRESSION
+    // deflated svc_gamestate body
+    byte        *deflated;
+    size_t      deflatedSize, rawSize;
+    EntityStateMessageFlags deflatedFlags;
+    qboolean    haveDeflated;
+#endif
+} sv_gamestate;
+
+/*
+================
+SV_InvalidateGamestate
+
+Called when a configstring changes.
+================
+*/
+void SV_InvalidateGamestate(void)
+{
+    sv_gamestate.havePlain = false;
+#if USE_ZLIB_PACKET_COMPRESSION
+    sv_gamestate.haveDeflated = false;
+#endif
+}
+
+/*
+================
+SV_FreeGamestate
+
+Called on map change and shutdown.
+================
+*/
+void SV_FreeGamestate(void)
+{
+    int i;
+
+    for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
+        Z_Free(sv_gamestate.baselines[i]);
+    }
+    Z_Free(sv_gamestate.plain);
+    Z_Free(sv_gamestate.plainEnds);
+#if USE_ZLIB_PACKET_COMPRESSION
+    Z_Free(sv_gamestate.deflated);
+#endif
+
+    memset(&sv_gamestate, 0, sizeof(sv_gamestate));
+}
+
 /*
 ================
 SV_CreateBaselines
@@ -73,15 +143,19 @@ to the clients -- only the fields that differ from the
 baseline will be transmitted
 ================
 */
-static void create_baselines(void)
+static void update_baselines(void)
 {
     int        i;
     Entity    *ent;
     PackedEntity *base, **chunk;
 
-    // clear entityBaselines from previous level
+    if (sv_gamestate.haveBaselines && sv.frameNumber - sv_gamestate.baselineFrame < SV_FRAMERATE) {
+        return;
+    }
+
+    // clear entityBaselines from previous snapshot
     for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
-        base = sv_client->entityBaselines[i];
+        base = sv_gamestate.baselines[i];
         if (!base) {
             continue;
         }
@@ -101,7 +175,7 @@ static void create_baselines(void)
 
         ent->state.number = i;
 
-        chunk = &sv_client->entityBaselines[i >> SV_BASELINES_SHIFT];
+        chunk = &sv_gamestate.baselines[i >> SV_BASELINES_SHIFT];
         if (*chunk == NULL) {
             *chunk = (PackedEntity*)SV_Mallocz(sizeof(*base) * SV_BASELINES_PER_CHUNK); // CPP: Cast
         }
@@ -111,15 +185,74 @@ static void create_baselines(void)
 
         base->solid = sv.entities[i].solid32;
     }
+
+    sv_gamestate.baselineFrame = sv.frameNumber;
+    sv_gamestate.haveBaselines = true;
+    SV_InvalidateGamestate();
 }
 
-static void write_plain_configstrings(void)
+static void create_baselines(void)
 {
-    int     i;
+    int        i;
+    PackedEntity *base, **chunk;
+
+    update_baselines();
+
+    // copy the snapshot, clearing entityBaselines from previous level
+    for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
+        base = sv_gamestate.baselines[i];
+        chunk = &sv_client->entityBaselines[i];
+        if (!base) {
+            if (*chunk) {
+                memset(*chunk, 0, sizeof(*base) * SV_BASELINES_PER_CHUNK);
+            }
+            continue;
+        }
+        if (*chunk == NULL) {
+            *chunk = (PackedEntity*)SV_Malloc(sizeof(*base) * SV_BASELINES_PER_CHUNK); // CPP: Cast
+        }
+        memcpy(*chunk, base, sizeof(*base) * SV_BASELINES_PER_CHUNK);
+    }
+}
+
+static void write_baseline(PackedEntity *base)
+{
+    EntityStateMessageFlags flags = (EntityStateMessageFlags)(sv_client->esFlags | MSG_ES_FORCE); // CPP: Cast
+
+    MSG_WriteDeltaEntity(NULL, base, flags);
+}
+
+// moves the record in msg_write to the plain blob
+static void append_plain_record(void)
+{
+    size_t size = sv_gamestate.plainSize + msg_write.currentSize;
+
+    if (size > sv_gamestate.plainAlloc) {
+        sv_gamestate.plainAlloc = max(size, sv_gamestate.plainAlloc * 2);
+        sv_gamestate.plain = (byte*)Z_Realloc(sv_gamestate.plain, sv_gamestate.plainAlloc); // CPP: Cast
+    }
+    if (sv_gamestate.numPlain == sv_gamestate.numPlainAlloc) {
+        sv_gamestate.numPlainAlloc = max(256, sv_gamestate.numPlainAlloc * 2);
+        sv_gamestate.plainEnds = (uint32_t*)Z_Realloc(sv_gamestate.plainEnds,
+                                 sizeof(uint32_t) * sv_gamestate.numPlainAlloc); // CPP: Cast
+    }
+
+    memcpy(sv_gamestate.plain + sv_gamestate.plainSize, msg_write.data, msg_write.currentSize);
+    sv_gamestate.plainSize = size;
+    sv_gamestate.plainEnds[sv_gamestate.numPlain++] = size;
+    SZ_Clear(&msg_write);
+}
+
+static void build_plain_gamestate(void)
+{
+    int     i, j;
     char    *string;
     size_t  length;
+    PackedEntity *base;
+
+    sv_gamestate.plainSize = 0;
+    sv_gamestate.numPlain = 0;
 
-    // write a packet full of data
     string = sv_client->configstrings;
     for (i = 0; i < ConfigStrings::MaxConfigStrings; i++, string += MAX_QPATH) {
         if (!string[0]) {
@@ -129,64 +262,71 @@ static void write_plain_configstrings(void)
         if (length > MAX_QPATH) {
             length = MAX_QPATH;
         }
-        // check if this configstring will overflow
-        if (msg_write.currentSize + length + 64 > sv_client->netchan->maximumPacketLength) {
-            SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
-        }
 
         MSG_WriteByte(svc_configstring);
         MSG_WriteShort(i);
         MSG_WriteData(string, length);
         MSG_WriteByte(0);
+        append_plain_record();
     }
 
-    SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
-}
-
-static void write_baseline(PackedEntity *base)
-{
-    EntityStateMessageFlags flags = (EntityStateMessageFlags)(sv_client->esFlags | MSG_ES_FORCE); // CPP: Cast
-
-    MSG_WriteDeltaEntity(NULL, base, flags);
-}
+    sv_gamestate.numPlainConfigstrings = sv_gamestate.numPlain;
 
-static void write_plain_baselines(void)
-{
-    int i, j;
-    PackedEntity *base;
-
-    // write a packet full of data
     for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
-        base = sv_client->entityBaselines[i];
+        base = sv_gamestate.baselines[i];
         if (!base) {
             continue;
         }
         for (j = 0; j < SV_BASELINES_PER_CHUNK; j++) {
             if (base->number) {
-                // check if this baseline will overflow
-                if (msg_write.currentSize + 64 > sv_client->netchan->maximumPacketLength) {
-                    SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
-                }
-
                 MSG_WriteByte(svc_spawnbaseline);
                 write_baseline(base);
+                append_plain_record();
             }
             base++;
         }
     }
 
+    sv_gamestate.plainFlags = sv_client->esFlags;
+    sv_gamestate.havePlain = true;
+}
+
+static void write_plain_gamestate(void)
+{
+    int         i;
+    uint32_t    start, length;
+
+    if (!sv_gamestate.havePlain || sv_gamestate.plainFlags != sv_client->esFlags) {
+        build_plain_gamestate();
+    }
+
+    // write packets full of data, configstrings and baselines separately
+    for (i = 0, start = 0; i < sv_gamestate.numPlain; i++) {
+        length = sv_gamestate.plainEnds[i] - start;
+
+        // check if this record will overflow
+        if (msg_write.currentSize + length + 64 > sv_client->netchan->maximumPacketLength) {
+            SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
+        }
+
+        MSG_WriteData(sv_gamestate.plain + start, length);
+        start += length;
+
+        if (i == sv_gamestate.numPlainConfigstrings - 1) {
+            SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
+        }
+    }
+
     SV_ClientAddMessage(sv_client, MSG_RELIABLE | MSG_CLEAR);
 }
 
 #if USE_ZLIB_PACKET_COMPRESSION // MSG: !! Changed from USE_ZLIB
 
-static void write_compressed_gamestate(void)
+static qboolean build_compressed_gamestate(void)
 {
-    SizeBuffer   *buf = &sv_client->netchan->message;
     PackedEntity  *base;
     int         i, j;
     size_t      length;
-    uint8_t     *patch;
     char        *string;
 
     MSG_WriteByte(svc_gamestate);
@@ -202,11 +342,6 @@ static void write_compressed_gamestate(void)
             length = MAX_QPATH;
         }
 
-        //// MSGFRAG: !! Check if this configstring will overflow
-        //if (msg_write.currentSize + length + 64 > sv_client->netchan->maximumPacketLength) {
-        //    SV_ClientAddMessage(sv_client, 0);
-        //}
-
         MSG_WriteShort(i);
         MSG_WriteData(string, length);
         MSG_WriteByte(0);
@@ -215,14 +350,10 @@ static void write_compressed_gamestate(void)
 
     // write entityBaselines
     for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
-        base = sv_client->entityBaselines[i];
+        base = sv_gamestate.baselines[i];
         if (!base) {
             continue;
         }
-        //// MSGFRAG: !! Check if this baseline will overflow
-        //if (msg_write.currentSize + 64 > sv_client->netchan->maximumPacketLength) {
-        //    SV_ClientAddMessage(sv_client, 0);
-        //}
         for (j = 0; j < SV_BASELINES_PER_CHUNK; j++) {
             if (base->number) {
                 write_baseline(base);
@@ -232,31 +363,50 @@ static void write_compressed_gamestate(void)
     }
     MSG_WriteShort(0);   // end of entityBaselines
 
-    SZ_WriteByte(buf, svc_zpacket);
-    patch = (uint8_t*)SZ_GetSpace(buf, 2); // CPP: Cast
-    SZ_WriteShort(buf, msg_write.currentSize);
-
     deflateReset(&svs.z);
+    length = deflateBound(&svs.z, (uLong)msg_write.currentSize);
+    Z_Free(sv_gamestate.deflated);
+    sv_gamestate.deflated = (byte*)SV_Malloc(length); // CPP: Cast
+
     svs.z.next_in = msg_write.data;
     svs.z.avail_in = (uInt)msg_write.currentSize;
-    svs.z.next_out = buf->data + buf->currentSize;
-    svs.z.avail_out = (uInt)(buf->maximumSize - buf->currentSize);
+    svs.z.next_out = sv_gamestate.deflated;
+    svs.z.avail_out = (uInt)length;
     SZ_Clear(&msg_write);
 
     if (deflate(&svs.z, Z_FINISH) != Z_STREAM_END) {
-        SV_DropClient(sv_client, "deflate() failed on gamestate");
-        return;
+        return false;
     }
 
-    SV_DPrintf(0, "%s: comp: %lu into %lu\n",
-               sv_client->name, svs.z.total_in, svs.z.total_out);
+    SV_DPrintf(0, "gamestate: comp: %lu into %lu\n", svs.z.total_in, svs.z.total_out);
 
-    patch[0] = svs.z.total_out & 255;
-    patch[1] = (svs.z.total_out >> 8) & 255;
-    buf->currentSize += svs.z.total_out;
-    
-    //// MSGFRAG: !! Add final send.
-    //SV_ClientAddMessage(sv_client, 0);
+    sv_gamestate.deflatedSize = svs.z.total_out;
+    sv_gamestate.rawSize = svs.z.total_in;
+    sv_gamestate.deflatedFlags = sv_client->esFlags;
+    sv_gamestate.haveDeflated = true;
+    return true;
+}
+
+static void write_compressed_gamestate(void)
+{
+    SizeBuffer   *buf = &sv_client->netchan->message;
+
+    if (!sv_gamestate.haveDeflated || sv_gamestate.deflatedFlags != sv_client->esFlags) {
+        if (!build_compressed_gamestate()) {
+            SV_DropClient(sv_client, "deflate() failed on gamestate");
+            return;
+        }
+    }
+
+    if (buf->currentSize + sv_gamestate.deflatedSize + 6 > buf->maximumSize) {
+        SV_DropClient(sv_client, "gamestate does not fit into message");
+        return;
+    }
+
+    SZ_WriteByte(buf, svc_zpacket);
+    SZ_WriteShort(buf, sv_gamestate.deflatedSize);
+    SZ_WriteShort(buf, sv_gamestate.rawSize);
+    SZ_Write(buf, sv_gamestate.deflated, sv_gamestate.deflatedSize);
 }
 
 static inline int z_flush(byte *buffer)
@@ -487,8 +637,7 @@ void SV_New_f(void)
     } else
 #endif //USE_ZLIB_PACKET_COMPRESSION // MSG: !! Changed from USE_ZLIB
     {
-        write_plain_configstrings();
-        write_plain_baselines();
+        write_plain_gamestate();
     }
 
     // send next command
@@ -554,12 +703,103 @@ void SV_Begin_f(void)
 
 //=============================================================================
 
+/*
+Files being downloaded are shared between clients. When a map goes live
+many clients tend to fetch the same files at once, so each file is read
+once and every downloader streams from the same read-only copy. Entries
+are keyed by path and deflate variant, and freed when the last client
+releases them. Map change detaches all entries from the lookup list so
+that new downloads pick up files changed on disk, clients still holding
+the old copy keep it until they finish.
+*/
+typedef struct downloadcache_s {
+    list_t      entry;
+    int         refcount;
+    int32_t     size;
+    qboolean    deflate;
+    qboolean    detached;
+    byte        *data;
+    char        name[1];
+} downloadcache_t;
+
+static LIST_DECL(sv_downloadcache);
+
+static downloadcache_t *SV_FindDownload(const char *name, qboolean deflate)
+{
+    downloadcache_t *dl;
+
+    LIST_FOR_EACH(downloadcache_t, dl, &sv_downloadcache, entry) {
+        if (dl->deflate == deflate && !FS_pathcmp(dl->name, name)) {
+            dl->refcount++;
+            return dl;
+        }
+    }
+
+    return NULL;
+}
+
+static downloadcache_t *SV_LoadDownload(const char *name, qboolean deflate, qhandle_t f, ssize_t size)
+{
+    size_t len = strlen(name);
+    downloadcache_t *dl;
+
+    dl = (downloadcache_t*)SV_Malloc(sizeof(*dl) + len); // CPP: Cast
+    dl->data = (byte*)SV_Malloc(size); // CPP: Cast
+    if (FS_Read(dl->data, size, f) != size) {
+        Z_Free(dl->data);
+        Z_Free(dl);
+        return NULL;
+    }
+
+    memcpy(dl->name, name, len + 1);
+    dl->refcount = 1;
+    dl->size = size;
+    dl->deflate = deflate;
+    dl->detached = false;
+    List_Append(&sv_downloadcache, &dl->entry);
+
+    return dl;
+}
+
+static void SV_ReleaseDownload(downloadcache_t *dl)
+{
+    if (--dl->refcount > 0) {
+        return;
+    }
+
+    if (!dl->detached) {
+        List_Remove(&dl->entry);
+    }
+
+    Z_Free(dl->data);
+    Z_Free(dl);
+}
+
+/*
+==================
+SV_FlushDownloadCache
+
+Called on map change and shutdown.
+==================
+*/
+void SV_FlushDownloadCache(void)
+{
+    downloadcache_t *dl;
+
+    LIST_FOR_EACH(downloadcache_t, dl, &sv_downloadcache, entry) {
+        dl->detached = true;
+    }
+
+    List_Init(&sv_downloadcache);
+}
+
 void SV_CloseDownload(client_t *client)
 {
-    if (client->download.bytes) {
-        Z_Free(client->download.bytes);
-        client->download.bytes = NULL;
+    if (client->download.cache) {
+        SV_ReleaseDownload(client->download.cache);
+        client->download.cache = NULL;
     }
+    client->download.bytes = NULL;
     if (client->download.fileName) {
         Z_Free(client->download.fileName);
         client->download.fileName = NULL;
@@ -591,9 +831,9 @@ SV_BeginDownload_f
 static void SV_BeginDownload_f(void)
 {
     char    name[MAX_QPATH];
-    byte    *download;
+    downloadcache_t *dl;
     int     downloadcmd;
-    ssize_t downloadsize, maxdownloadsize, result;
+    ssize_t downloadsize = 0, maxdownloadsize;
     int     offset = 0;
     cvar_t  *allow;
     size_t  len;
@@ -663,57 +903,74 @@ static void SV_BeginDownload_f(void)
     }
 
     f = 0;
+    dl = NULL;
     downloadcmd = svc_download;
 
 #if USE_ZLIB
     // prefer raw deflate stream from .pkz if supported
     if (sv_client->has_zlib && offset == 0) {
     //if (offset == 0) { //#if USE_ZLIB_PACKET_COMPRESSION // MSG: !! Changed from USE_ZLIB
-        downloadsize = FS_FOpenFile(name, &f, FS_MODE_READ | FS_FLAG_DEFLATE);
-        if (f) {
+        dl = SV_FindDownload(name, true);
+        if (!dl) {
+            downloadsize = FS_FOpenFile(name, &f, FS_MODE_READ | FS_FLAG_DEFLATE);
+        }
+        if (dl || f) {
             Com_DPrintf("Serving compressed download to %s\n", sv_client->name);
             downloadcmd = svc_zdownload;
         }
     }
 #endif
 
-    if (!f) {
-        downloadsize = FS_FOpenFile(name, &f, FS_MODE_READ);
-        if (!f) {
-            Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
-            goto fail1;
+    if (!dl && !f) {
+        dl = SV_FindDownload(name, false);
+        if (!dl) {
+            downloadsize = FS_FOpenFile(name, &f, FS_MODE_READ);
+            if (!f) {
+                Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
+                goto fail1;
+            }
         }
     }
 
-    maxdownloadsize = MAX_LOADFILE;
+    if (!dl) {
+        maxdownloadsize = MAX_LOADFILE;
 #if 0
-    if (sv_max_download_size->integer) {
-        maxdownloadsize = Cvar_ClampInteger(sv_max_download_size, 1, MAX_LOADFILE);
-    }
+        if (sv_max_download_size->integer) {
+            maxdownloadsize = Cvar_ClampInteger(sv_max_download_size, 1, MAX_LOADFILE);
+        }
 #endif
 
-    if (downloadsize == 0) {
-        Com_DPrintf("Refusing empty download of %s to %s\n", name, sv_client->name);
-        goto fail2;
-    }
+        if (downloadsize == 0) {
+            Com_DPrintf("Refusing empty download of %s to %s\n", name, sv_client->name);
+            goto fail2;
+        }
+
+        if (downloadsize > maxdownloadsize) {
+            Com_DPrintf("Refusing oversize download of %s to %s\n", name, sv_client->name);
+            goto fail2;
+        }
 
-    if (downloadsize > maxdownloadsize) {
-        Com_DPrintf("Refusing oversize download of %s to %s\n", name, sv_client->name);
-        goto fail2;
+        // read the whole file even if the client resumes, others may want it
+        dl = SV_LoadDownload(name, downloadcmd == svc_zdownload, f, downloadsize);
+        FS_FCloseFile(f);
+        if (!dl) {
+            Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
+            goto fail1;
+        }
     }
 
-    if (offset > downloadsize) {
+    if (offset > dl->size) {
         Com_DPrintf("Refusing download, %s has wrong version of %s (%d > %d)\n",
-                    sv_client->name, name, offset, (int)downloadsize);
+                    sv_client->name, name, offset, dl->size);
         SV_ClientPrintf(sv_client, PRINT_HIGH, "File size differs from server.\n"
                         "Please delete the corresponding .tmp file from your system.\n");
-        goto fail2;
+        goto fail3;
     }
 
-    if (offset == downloadsize) {
+    if (offset == dl->size) {
         Com_DPrintf("Refusing download, %s already has %s (%d bytes)\n",
                     sv_client->name, name, offset);
-        FS_FCloseFile(f);
+        SV_ReleaseDownload(dl);
         MSG_WriteByte(svc_download);
         MSG_WriteShort(0);
         MSG_WriteByte(100);
@@ -721,27 +978,20 @@ static void SV_BeginDownload_f(void)
         return;
     }
 
-    download = (byte*)SV_Malloc(downloadsize); // CPP: Cast
-    result = FS_Read(download, downloadsize, f);
-    if (result != downloadsize) {
-        Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
-        goto fail3;
-    }
-
-    FS_FCloseFile(f);
-
-    sv_client->download.bytes = download;
-    sv_client->download.fileSize = downloadsize;
+    sv_client->download.cache = dl;
+    sv_client->download.bytes = dl->data;
+    sv_client->download.fileSize = dl->size;
     sv_client->download.bytesSent = offset;
     sv_client->download.fileName = SV_CopyString(name);
     sv_client->download.command = downloadcmd;
     sv_client->download.isPending = true;
 
-    Com_DPrintf("Downloading %s to %s\n", name, sv_client->name);
+    Com_DPrintf("Downloading %s to %s (%d in use)\n", name, sv_client->name, dl->refcount);
     return;
 
 fail3:
-    Z_Free(download);
+    SV_ReleaseDownload(dl);
+    goto fail1;
 fail2:
     FS_FCloseFile(f);
 fail1:
@@ -1033,6 +1283,9 @@ static qboolean    moveIssued;
 static int         stringCmdCount;
 static int         userinfoUpdateCount;
 
+// queued packet being executed, NULL when parsing inline
+static const clientpacket_t *sv_packet;
+
 /*
 ==================
 SV_ClientThink
@@ -1108,11 +1361,20 @@ static void SV_ExecuteMove(void)
 
     moveIssued = true;
 
-    lastFrame = MSG_ReadLong();
+    if (sv_packet && sv_packet->moveStart == msg_read.readCount) {
+        // already decoded, skip over it
+        lastFrame = sv_packet->lastFrame;
+        oldest = sv_packet->cmds[0];
+        oldcmd = sv_packet->cmds[1];
+        newcmd = sv_packet->cmds[2];
+        msg_read.readCount = sv_packet->moveEnd;
+    } else {
+        lastFrame = MSG_ReadLong();
 
-    MSG_ReadDeltaClientMoveCommand(NULL, &oldest);
-    MSG_ReadDeltaClientMoveCommand(&oldest, &oldcmd);
-    MSG_ReadDeltaClientMoveCommand(&oldcmd, &newcmd);
+        MSG_ReadDeltaClientMoveCommand(NULL, &oldest);
+        MSG_ReadDeltaClientMoveCommand(&oldest, &oldcmd);
+        MSG_ReadDeltaClientMoveCommand(&oldcmd, &newcmd);
+    }
 
     if (sv_client->connectionState != ConnectionState::Spawned) {
         SV_SetLastFrame(-1);
@@ -1122,7 +1384,8 @@ static void SV_ExecuteMove(void)
     SV_SetLastFrame(lastFrame);
     
     // Determine drop rate, on whether we should be predicting or not.
-    net_drop = sv_client->netchan->deltaFramePacketDrops;
+    // The netchan may have processed later packets of a queued one.
+    net_drop = sv_packet ? sv_packet->drops : sv_client->netchan->deltaFramePacketDrops;
     if (net_drop > 2) {
         sv_client->frameFlags |= FF_CLIENTPRED;
     }
@@ -1146,6 +1409,8 @@ static void SV_ExecuteMove(void)
 
     // Store it.
     sv_client->lastClientUserCommand = newcmd;
+
+    SV_RecordMove(sv_client, &newcmd);
 }
 
 /*
@@ -1351,3 +1616,192 @@ void SV_ExecuteClientMessage(client_t *client)
     sv_player = NULL;
 }
 
+/*
+============================================================
+
+PACKET QUEUE
+
+Sequenced packets are not executed as they arrive. They are
+passed through the netchan and copied into a queue, where
+clc_move commands are decoded for all of them at once, on job
+threads if there are enough. Decoding only reads the packet
+and touches no client or game state.
+
+Packets are then executed on the main thread strictly in the
+order they arrived, so commands from one client run in the
+order they were sent and the interleaving between clients is
+the same as if each was executed on arrival. The queue is run
+at the end of every batch of network packets, and before any
+connectionless packet or other event that may add, remove or
+reuse a client slot.
+============================================================
+*/
+
+#define DECODE_JOB_PACKETS  8   // fewer than this are decoded inline
+
+static clientpacket_t   sv_packets[MAX_PACKET_QUEUE];
+static int              sv_numpackets;
+static byte             sv_packetdata[PACKET_QUEUE_BYTES];
+static size_t           sv_packetbytes;
+
+/*
+===================
+SV_QueueClientPacket
+
+Queues what is left in msg_read after Netchan_Process for later execution.
+===================
+*/
+void SV_QueueClientPacket(client_t *client)
+{
+    clientpacket_t *p;
+    size_t length = msg_read.currentSize - msg_read.readCount;
+
+    if (msg_read.readCount > msg_read.currentSize) {
+        length = 0;
+    }
+
+    if (sv_numpackets == MAX_PACKET_QUEUE ||
+        sv_packetbytes + length > PACKET_QUEUE_BYTES) {
+        SV_RunClientPackets();
+    }
+
+    p = &sv_packets[sv_numpackets++];
+    p->client = client;
+    p->drops = client->netchan->deltaFramePacketDrops;
+    p->offset = sv_packetbytes;
+    p->length = length;
+
+    memcpy(sv_packetdata + sv_packetbytes, msg_read.data + msg_read.readCount, length);
+    sv_packetbytes += length;
+}
+
+// msg_read is thread local, so this can run on any thread
+static void decode_packet(clientpacket_t *p)
+{
+    int c;
+
+    SZ_Init(&msg_read, sv_packetdata + p->offset, p->length);
+    msg_read.currentSize = p->length;
+    p->moveStart = 0;
+
+    // skip over everything until the first move, a second
+    // one will drop the client anyway
+    while (msg_read.readCount <= msg_read.currentSize) {
+        c = MSG_ReadByte();
+        if (c == -1)
+            break;
+
+        switch (c & SVCMD_MASK) {
+        case clc_move:
+            p->moveStart = msg_read.readCount;
+            p->lastFrame = MSG_ReadLong();
+            MSG_ReadDeltaClientMoveCommand(NULL, &p->cmds[0]);
+            MSG_ReadDeltaClientMoveCommand(&p->cmds[0], &p->cmds[1]);
+            MSG_ReadDeltaClientMoveCommand(&p->cmds[1], &p->cmds[2]);
+            p->moveEnd = msg_read.readCount;
+            return;
+
+        case clc_userinfo:
+        case clc_stringcmd:
+            MSG_ReadString(NULL, 0);
+            break;
+
+        case clc_userinfo_delta:
+            MSG_ReadString(NULL, 0);
+            MSG_ReadString(NULL, 0);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+static void decode_job(void *arg, int index)
+{
+    decode_packet(&sv_packets[index]);
+}
+
+/*
+===================
+SV_DecodeClientPackets
+
+Decodes moves of all queued packets, on job threads if allowed.
+===================
+*/
+void SV_DecodeClientPackets(qboolean jobs)
+{
+    SizeBuffer saved = msg_read;
+    int i;
+
+    PROF_ZONE("SV_DecodeClientPackets");
+
+    if (jobs && Job_NumThreads() && sv_numpackets >= DECODE_JOB_PACKETS) {
+        Job_ParallelFor(decode_job, NULL, sv_numpackets, JOB_PRIORITY_HIGH);
+    } else {
+        for (i = 0; i < sv_numpackets; i++) {
+            decode_packet(&sv_packets[i]);
+        }
+    }
+
+    // the calling thread may have decoded some of them
+    msg_read = saved;
+}
+
+/*
+===================
+SV_RunClientPackets
+
+Decodes and executes queued packets in the order they arrived.
+===================
+*/
+void SV_RunClientPackets(void)
+{
+    SizeBuffer saved;
+    clientpacket_t *p;
+    int i;
+
+    if (!sv_numpackets) {
+        return;
+    }
+
+    PROF_ZONE("SV_RunClientPackets");
+
+    SV_DecodeClientPackets(true);
+
+    saved = msg_read;
+
+    // the queue may be cleared by a server restart on the way
+    for (i = 0; i < sv_numpackets; i++) {
+        p = &sv_packets[i];
+
+        // dropped by an earlier packet
+        if (p->client->connectionState <= ConnectionState::Zombie) {
+            continue;
+        }
+
+        SZ_Init(&msg_read, sv_packetdata + p->offset, p->length);
+        msg_read.currentSize = p->length;
+
+        sv_packet = p;
+        SV_ExecuteClientMessage(p->client);
+        sv_packet = NULL;
+    }
+
+    sv_numpackets = 0;
+    sv_packetbytes = 0;
+
+    msg_read = saved;
+}
+
+void SV_ClearClientPackets(void)
+{
+    sv_numpackets = 0;
+    sv_packetbytes = 0;
+}
+
+const clientpacket_t *SV_GetClientPackets(int *count)
+{
+    *count = sv_numpackets;
+    return sv_packets;
+}
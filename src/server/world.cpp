@@ -42,6 +42,19 @@ typedef struct areanode_s {
 static areanode_t   sv_areanodes[AREA_NODES];
 static int          sv_numareanodes;
 
+#define VIS_CACHE_SIZE  16  // must be power of 2
+
+// decompressed vis rows, rows never change during a map
+static struct {
+    int     cluster;
+    int     vis;
+    byte    mask[VIS_MAX_BYTES];
+} sv_viscache[VIS_CACHE_SIZE];
+
+#ifdef _DEBUG
+unsigned sv_visgeneration;
+#endif
+
 static vec3_t    area_mins, area_maxs; // MATHLIB: No more float* pointers to local func arrays.
 static Entity  **area_list;
 static int      area_count, area_maxcount;
@@ -107,6 +120,12 @@ void SV_ClearWorld(void)
     memset(sv_areanodes, 0, sizeof(sv_areanodes));
     sv_numareanodes = 0;
 
+    for (i = 0; i < VIS_CACHE_SIZE; i++) {
+        sv_viscache[i].cluster = INT_MIN;
+    }
+
+    SV_ClearLagFrames();
+
     if (sv.cm.cache) {
         cm = &sv.cm.cache->models[0];
         SV_CreateAreaNode(0, cm->mins, cm->maxs);
@@ -145,6 +164,49 @@ qboolean SV_EntityIsVisible(cm_t *cm, Entity *ent, byte *mask)
     return false;  // not visible
 }
 
+/*
+===============
+SV_ClusterVis
+
+Multicasts from the same spot and clients sharing a cluster ask for the
+same rows over and over, so keep the last few around.
+===============
+*/
+const byte *SV_ClusterVis(int cluster, int vis)
+{
+    unsigned index = ((unsigned)cluster * 31 + vis) & (VIS_CACHE_SIZE - 1);
+
+#ifdef _DEBUG
+    sv_visgeneration++;
+#endif
+
+    if (sv_viscache[index].cluster != cluster || sv_viscache[index].vis != vis) {
+        BSP_ClusterVis(sv.cm.cache, sv_viscache[index].mask, cluster, vis);
+        sv_viscache[index].cluster = cluster;
+        sv_viscache[index].vis = vis;
+    }
+
+    return sv_viscache[index].mask;
+}
+
+/*
+===============
+SV_ClientLeaf
+===============
+*/
+mleaf_t *SV_ClientLeaf(client_t *client)
+{
+    const vec3_t &org = client->edict->state.origin;
+
+    if (!client->leaf || client->leafSpawncount != sv.spawncount || !VectorCompare(client->leafOrigin, org)) {
+        client->leaf = CM_PointLeaf(&sv.cm, org);
+        client->leafOrigin = org;
+        client->leafSpawncount = sv.spawncount;
+    }
+
+    return client->leaf;
+}
+
 /*
 ===============
 SV_LinkEdict
@@ -471,7 +533,7 @@ SV_ClipMoveToEntities
 ====================
 */
 static void SV_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end,
-                                  Entity *passedict, int contentmask, trace_t *tr)
+                                  Entity *passedict, int contentmask, const byte *skip, trace_t *tr)
 {
     vec3_t      boxmins, boxmaxs;
     int         i, num;
@@ -499,6 +561,8 @@ static void SV_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, const
             continue;
         if (touch == passedict)
             continue;
+        if (skip && Q_IsBitSet(skip, NUM_FOR_EDICT(touch)))
+            continue;   // clipped against its past position instead
         if (tr->allSolid)
             return;
         if (passedict) {
@@ -534,6 +598,8 @@ trace_t q_gameabi SV_Trace(const vec3_t &start, const vec3_t &mins, const vec3_t
 {
     trace_t     trace;
 
+    PROF_ZONE("SV_Trace");
+
     if (!sv.cm.cache) {
         Com_Error(ERR_DROP, "%s: no map loaded", __func__);
     }
@@ -557,7 +623,227 @@ trace_t q_gameabi SV_Trace(const vec3_t &start, const vec3_t &mins, const vec3_t
     }
 
     // clip to other solid entities
-    SV_ClipMoveToEntities(start, mins, maxs, end, passedict, contentmask, &trace);
+    SV_ClipMoveToEntities(start, mins, maxs, end, passedict, contentmask, NULL, &trace);
+    return trace;
+}
+
+/*
+===============================================================================
+
+LAG COMPENSATION
+
+Bounding boxes of clients and monsters are recorded after every game frame
+into a ring of frames. Each frame stores its boxes as separate arrays per
+field and axis, so the broad phase of a rewound trace only streams through
+the absolute bounds. Entities found there are clipped against a box hull
+at their past origin, nothing is relinked.
+
+===============================================================================
+*/
+
+#define LAG_FRAMES      64      // must be power of two
+#define LAG_ENTITIES    256     // per frame, further ones are not recorded
+
+typedef struct {
+    int         frameNumber;    // -1 if not recorded
+    int         count;
+    uint16_t    number[LAG_ENTITIES];
+    float       absMin[3][LAG_ENTITIES];
+    float       absMax[3][LAG_ENTITIES];
+    vec3_t      origin[LAG_ENTITIES];
+    vec3_t      mins[LAG_ENTITIES];
+    vec3_t      maxs[LAG_ENTITIES];
+} lagframe_t;
+
+static lagframe_t   sv_lagframes[LAG_FRAMES];
+
+/*
+===============
+SV_ClearLagFrames
+===============
+*/
+void SV_ClearLagFrames(void)
+{
+    int i;
+
+    for (i = 0; i < LAG_FRAMES; i++) {
+        sv_lagframes[i].frameNumber = -1;
+        sv_lagframes[i].count = 0;
+    }
+}
+
+/*
+===============
+SV_RecordLagFrame
+
+Called after the game has run the current frame.
+===============
+*/
+void SV_RecordLagFrame(void)
+{
+    lagframe_t *f = &sv_lagframes[sv.frameNumber & (LAG_FRAMES - 1)];
+    Entity *ent;
+    int i, j, n;
+
+    PROF_ZONE("SV_RecordLagFrame");
+
+    f->frameNumber = sv.frameNumber;
+
+    for (i = 1, n = 0; i < ge->numberOfEntities && n < LAG_ENTITIES; i++) {
+        ent = EDICT_NUM(i);
+        if (!ent->inUse || !ent->area.prev || ent->solid != Solid::BoundingBox)
+            continue;
+        if (!ent->client && !(ent->serverFlags & EntityServerFlags::Monster))
+            continue;
+
+        f->number[n] = i;
+        for (j = 0; j < 3; j++) {
+            f->absMin[j][n] = ent->absMin[j];
+            f->absMax[j][n] = ent->absMax[j];
+        }
+        f->origin[n] = ent->state.origin;
+        f->mins[n] = ent->mins;
+        f->maxs[n] = ent->maxs;
+        n++;
+    }
+
+    f->count = n;
+}
+
+// finds the recorded frame closest to the given time in the past
+static const lagframe_t *SV_FindLagFrame(int msec)
+{
+    const lagframe_t *f;
+    int back;
+
+    if (msec > sv_maxrewind->integer)
+        msec = sv_maxrewind->integer;
+    if (msec <= 0)
+        return NULL;
+
+    back = (int)(msec / BASE_FRAMETIME + 0.5);
+    if (back <= 0)
+        return NULL;
+    if (back > LAG_FRAMES - 1)
+        back = LAG_FRAMES - 1;
+
+    // fall back to newer frames if not recorded yet
+    for (; back > 0; back--) {
+        f = &sv_lagframes[(sv.frameNumber - back) & (LAG_FRAMES - 1)];
+        if (f->frameNumber == sv.frameNumber - back)
+            return f;
+    }
+
+    return NULL;
+}
+
+static void SV_ClipMoveToLagFrame(const lagframe_t *f, const vec3_t &start, const vec3_t &mins, const vec3_t &maxs,
+                                  const vec3_t &end, Entity *passedict, int contentmask, trace_t *tr)
+{
+    float       boxmins[3], boxmaxs[3];
+    int         i, j;
+    Entity      *touch;
+    trace_t     trace;
+
+    for (j = 0; j < 3; j++) {
+        if (end[j] > start[j]) {
+            boxmins[j] = start[j] + mins[j] - 1;
+            boxmaxs[j] = end[j] + maxs[j] + 1;
+        } else {
+            boxmins[j] = end[j] + mins[j] - 1;
+            boxmaxs[j] = start[j] + maxs[j] + 1;
+        }
+    }
+
+    for (i = 0; i < f->count; i++) {
+        if (f->absMin[0][i] > boxmaxs[0] || f->absMax[0][i] < boxmins[0] ||
+            f->absMin[1][i] > boxmaxs[1] || f->absMax[1][i] < boxmins[1] ||
+            f->absMin[2][i] > boxmaxs[2] || f->absMax[2][i] < boxmins[2])
+            continue;
+
+        // the entity may have been freed or changed since
+        touch = EDICT_NUM(f->number[i]);
+        if (!touch->inUse || touch->solid == Solid::Not)
+            continue;
+        if (touch == passedict)
+            continue;
+        if (tr->allSolid)
+            return;
+        if (passedict) {
+            if (touch->owner == passedict)
+                continue;
+            if (passedict->owner == touch)
+                continue;
+        }
+
+        if (!(contentmask & CONTENTS_DEADMONSTER)
+            && (touch->serverFlags & EntityServerFlags::DeadMonster))
+            continue;
+
+        CM_TransformedBoxTrace(&trace, start, end, mins, maxs,
+                               CM_HeadnodeForBox(f->mins[i], f->maxs[i]), contentmask,
+                               f->origin[i], vec3_zero());
+
+        CM_ClipEntity(tr, &trace, touch);
+    }
+}
+
+/*
+==================
+SV_TraceRewound
+
+Like SV_Trace, but clients and monsters are where they were the given
+number of milliseconds ago, limited by sv_maxrewind. The world and all
+other entities are at their current positions.
+==================
+*/
+trace_t q_gameabi SV_TraceRewound(int msec, const vec3_t &start, const vec3_t &mins, const vec3_t &maxs,
+                                  const vec3_t &end, Entity *passedict, int contentmask)
+{
+    static byte skip[MAX_EDICTS / 8];
+    const lagframe_t *f;
+    trace_t trace;
+    int i;
+
+    f = SV_FindLagFrame(msec);
+    if (!f) {
+        return SV_Trace(start, mins, maxs, end, passedict, contentmask);
+    }
+
+    PROF_ZONE("SV_TraceRewound");
+
+    if (!sv.cm.cache) {
+        Com_Error(ERR_DROP, "%s: no map loaded", __func__);
+    }
+
+    if (++sv.tracecount > 10000) {
+        Com_EPrintf("%s: runaway loop avoided\n", __func__);
+        memset(&trace, 0, sizeof(trace));
+        trace.fraction = 1;
+        trace.ent = ge->entities;
+        VectorCopy(end, trace.endPosition);
+        sv.tracecount = 0;
+        return trace;
+    }
+
+    CM_BoxTrace(&trace, start, end, mins, maxs, sv.cm.cache->nodes, contentmask);
+    trace.ent = ge->entities;
+    if (trace.fraction == 0) {
+        return trace;
+    }
+
+    // entities recorded in that frame are only clipped in the past
+    for (i = 0; i < f->count; i++) {
+        Q_SetBit(skip, f->number[i]);
+    }
+
+    SV_ClipMoveToEntities(start, mins, maxs, end, passedict, contentmask, skip, &trace);
+    SV_ClipMoveToLagFrame(f, start, mins, maxs, end, passedict, contentmask, &trace);
+
+    for (i = 0; i < f->count; i++) {
+        Q_ClearBit(skip, f->number[i]);
+    }
+
     return trace;
 }
 
@@ -74,19 +74,12 @@ std::vector<SVGBaseEntity*> SVG_BoxEntities(const vec3_t& mins, const vec3_t& ma
 
 //
 //===============
-// SVG_Trace
+// SVG_ConvertTrace
 //
-// The defacto trace function to use, for SVGBaseEntity and its derived family & friends.
+// Converts the results of a server trace to a Server Game Trace.
 //===============
 //
-SVGTrace SVG_Trace(const vec3_t& start, const vec3_t& mins, const vec3_t& maxs, const vec3_t& end, SVGBaseEntity* passent, const int32_t& contentMask) {
-    // Fetch server entity in case one was passed to us.
-    Entity* serverPassEntity = (passent ? passent->GetServerEntity() : NULL);
-
-    // Execute server trace.
-    trace_t trace = gi.Trace(start, mins, maxs, end, serverPassEntity, contentMask);
-
-    // Convert results to Server Game Trace.
+static SVGTrace SVG_ConvertTrace(const trace_t& trace) {
     SVGTrace svgTrace;
     svgTrace.allSolid = trace.allSolid;
     svgTrace.contents = trace.contents;
@@ -120,6 +113,38 @@ SVGTrace SVG_Trace(const vec3_t& start, const vec3_t& mins, const vec3_t& maxs,
     return svgTrace;
 }
 
+//
+//===============
+// SVG_Trace
+//
+// The defacto trace function to use, for SVGBaseEntity and its derived family & friends.
+//===============
+//
+SVGTrace SVG_Trace(const vec3_t& start, const vec3_t& mins, const vec3_t& maxs, const vec3_t& end, SVGBaseEntity* passent, const int32_t& contentMask) {
+    // Fetch server entity in case one was passed to us.
+    Entity* serverPassEntity = (passent ? passent->GetServerEntity() : NULL);
+
+    // Execute server trace.
+    return SVG_ConvertTrace(gi.Trace(start, mins, maxs, end, serverPassEntity, contentMask));
+}
+
+//
+//===============
+// SVG_TraceRewound
+//
+// Same as SVG_Trace, but clients and monsters are moved back to where they
+// were the given amount of milliseconds ago. Used for hitscan weapons, so
+// that they hit what the shooter saw.
+//===============
+//
+SVGTrace SVG_TraceRewound(int32_t msec, const vec3_t& start, const vec3_t& mins, const vec3_t& maxs, const vec3_t& end, SVGBaseEntity* passent, const int32_t& contentMask) {
+    // Fetch server entity in case one was passed to us.
+    Entity* serverPassEntity = (passent ? passent->GetServerEntity() : NULL);
+
+    // Execute rewound server trace.
+    return SVG_ConvertTrace(gi.TraceRewound(msec, start, mins, maxs, end, serverPassEntity, contentMask));
+}
+
 //
 //===============
 // SVG_SetConfigString
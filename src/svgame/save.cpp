@@ -376,32 +376,47 @@ static const save_field_t gamefields[] = {
 
 //=========================================================
 
-static void write_data(void *buf, size_t len, FILE *f)
+//
+// Savegames are serialized into memory in a single pass over the field
+// tables, then handed to the server in one call. The server takes care of
+// compressing and writing the snapshot on its save thread, so none of the
+// per-field work below touches the disk.
+//
+typedef std::vector<byte> save_writer_t;
+
+typedef struct {
+    const byte  *data;
+    size_t      size;
+    size_t      readcount;
+} save_reader_t;
+
+// kept around between saves so autosaves don't reallocate
+static save_writer_t save_buffer;
+
+static void write_data(const void *buf, size_t len, save_writer_t *f)
 {
-    if (fwrite(buf, 1, len, f) != len) {
-        gi.Error("%s: couldn't write %" PRIz " bytes", __func__, len); // CPP: String fix.
-    }
+    f->insert(f->end(), (const byte *)buf, (const byte *)buf + len);
 }
 
-static void write_short(FILE *f, short v)
+static void write_short(save_writer_t *f, short v)
 {
     v = LittleShort(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_int(FILE *f, int v)
+static void write_int(save_writer_t *f, int v)
 {
     v = LittleLong(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_float(FILE *f, float v)
+static void write_float(save_writer_t *f, float v)
 {
     v = LittleFloat(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_string(FILE *f, char *s)
+static void write_string(save_writer_t *f, char *s)
 {
     size_t len;
 
@@ -415,14 +430,14 @@ static void write_string(FILE *f, char *s)
     write_data(s, len, f);
 }
 
-static void write_vector(FILE *f, vec_t *v)
+static void write_vector(save_writer_t *f, vec_t *v)
 {
     write_float(f, v[0]);
     write_float(f, v[1]);
     write_float(f, v[2]);
 }
 
-static void write_index(FILE *f, void *p, size_t size, void *start, int max_index)
+static void write_index(save_writer_t *f, void *p, size_t size, void *start, int max_index)
 {
     size_t diff;
 
@@ -442,7 +457,7 @@ static void write_index(FILE *f, void *p, size_t size, void *start, int max_inde
     write_int(f, (int)(diff / size));
 }
 
-static void write_pointer(FILE *f, void *p, ptr_type_t type)
+static void write_pointer(save_writer_t *f, void *p, ptr_type_t type)
 {
     const save_ptr_t *ptr;
     int i;
@@ -463,7 +478,7 @@ static void write_pointer(FILE *f, void *p, ptr_type_t type)
     gi.Error("%s: unknown pointer: %p", __func__, p);
 }
 
-static void write_field(FILE *f, const save_field_t *field, void *base)
+static void write_field(save_writer_t *f, const save_field_t *field, void *base)
 {
     void *p = (byte *)base + field->ofs;
     int i;
@@ -520,7 +535,7 @@ static void write_field(FILE *f, const save_field_t *field, void *base)
     }
 }
 
-static void write_fields(FILE *f, const save_field_t *fields, void *base)
+static void write_fields(save_writer_t *f, const save_field_t *fields, void *base)
 {
     const save_field_t *field;
 
@@ -529,14 +544,16 @@ static void write_fields(FILE *f, const save_field_t *fields, void *base)
     }
 }
 
-static void read_data(void *buf, size_t len, FILE *f)
+static void read_data(void *buf, size_t len, save_reader_t *f)
 {
-    if (fread(buf, 1, len, f) != len) {
+    if (len > f->size - f->readcount) {
         gi.Error("%s: couldn't read %" PRIz " bytes", __func__, len); // CPP: String fix.
     }
+    memcpy(buf, f->data + f->readcount, len);
+    f->readcount += len;
 }
 
-static int read_short(FILE *f)
+static int read_short(save_reader_t *f)
 {
     short v;
 
@@ -546,7 +563,7 @@ static int read_short(FILE *f)
     return v;
 }
 
-static int read_int(FILE *f)
+static int read_int(save_reader_t *f)
 {
     int v;
 
@@ -556,7 +573,7 @@ static int read_int(FILE *f)
     return v;
 }
 
-static float read_float(FILE *f)
+static float read_float(save_reader_t *f)
 {
     float v;
 
@@ -567,7 +584,7 @@ static float read_float(FILE *f)
 }
 
 
-static char *read_string(FILE *f)
+static char *read_string(save_reader_t *f)
 {
     int len;
     char *s;
@@ -588,7 +605,7 @@ static char *read_string(FILE *f)
     return s;
 }
 
-static void read_zstring(FILE *f, char *s, size_t size)
+static void read_zstring(save_reader_t *f, char *s, size_t size)
 {
     int len;
 
@@ -601,14 +618,14 @@ static void read_zstring(FILE *f, char *s, size_t size)
     s[len] = 0;
 }
 
-static void read_vector(FILE *f, vec_t *v)
+static void read_vector(save_reader_t *f, vec_t *v)
 {
     v[0] = read_float(f);
     v[1] = read_float(f);
     v[2] = read_float(f);
 }
 
-static void *read_index(FILE *f, size_t size, void *start, int max_index)
+static void *read_index(save_reader_t *f, size_t size, void *start, int max_index)
 {
     int index;
     byte *p;
@@ -626,7 +643,7 @@ static void *read_index(FILE *f, size_t size, void *start, int max_index)
     return p;
 }
 
-static void *read_pointer(FILE *f, ptr_type_t type)
+static void *read_pointer(save_reader_t *f, ptr_type_t type)
 {
     int index;
     const save_ptr_t *ptr;
@@ -648,7 +665,7 @@ static void *read_pointer(FILE *f, ptr_type_t type)
     return ptr->ptr;
 }
 
-static void read_field(FILE *f, const save_field_t *field, void *base)
+static void read_field(save_reader_t *f, const save_field_t *field, void *base)
 {
     void *p = (byte *)base + field->ofs;
     int i;
@@ -705,7 +722,7 @@ static void read_field(FILE *f, const save_field_t *field, void *base)
     }
 }
 
-static void read_fields(FILE *f, const save_field_t *fields, void *base)
+static void read_fields(save_reader_t *f, const save_field_t *fields, void *base)
 {
     const save_field_t *field;
 
@@ -736,15 +753,13 @@ last save position.
 */
 void SVG_WriteGame(const char *filename, qboolean autosave)
 {
-    FILE    *f;
+    save_writer_t *f = &save_buffer;
     int     i;
 
     if (!autosave)
         SVG_SaveClientData();
 
-    f = fopen(filename, "wb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    f->clear();
 
     write_int(f, SAVE_MAGIC1);
     write_int(f, SAVE_VERSION);
@@ -757,29 +772,34 @@ void SVG_WriteGame(const char *filename, qboolean autosave)
         write_fields(f, clientfields, &game.clients[i]);
     }
 
-    fclose(f);
+    if (!gi.WriteSaveFile(filename, f->data(), f->size()))
+        gi.Error("Couldn't write %s", filename);
 }
 
 void SVG_ReadGame(const char *filename)
 {
-    FILE    *f;
+    save_reader_t   reader;
+    save_reader_t   *f = &reader;
+    void    *data;
     int     i;
 
     gi.FreeTags(TAG_GAME);
 
-    f = fopen(filename, "rb");
-    if (!f)
+    data = gi.LoadSaveFile(filename, &reader.size);
+    if (!data)
         gi.Error("Couldn't open %s", filename);
+    reader.data = (const byte *)data;
+    reader.readcount = 0;
 
     i = read_int(f);
     if (i != SAVE_MAGIC1) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Not a save game");
     }
 
     i = read_int(f);
     if (i != SAVE_VERSION) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Savegame from an older version");
     }
 
@@ -787,11 +807,11 @@ void SVG_ReadGame(const char *filename)
 
     // should agree with server's version
     if (game.maximumClients != (int)maximumClients->value) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Savegame has bad maximumClients");
     }
     if (game.maxEntities <= game.maximumClients || game.maxEntities > MAX_EDICTS) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Savegame has bad maxEntities");
     }
 
@@ -803,7 +823,7 @@ void SVG_ReadGame(const char *filename)
         read_fields(f, clientfields, &game.clients[i]);
     }
 
-    fclose(f);
+    gi.FreeSaveFile(data);
 }
 
 //==========================================================
@@ -819,11 +839,9 @@ void SVG_WriteLevel(const char *filename)
 {
     int     i;
     Entity *ent;
-    FILE    *f;
+    save_writer_t *f = &save_buffer;
 
-    f = fopen(filename, "wb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    f->clear();
 
     write_int(f, SAVE_MAGIC2);
     write_int(f, SAVE_VERSION);
@@ -841,7 +859,8 @@ void SVG_WriteLevel(const char *filename)
     }
     write_int(f, -1);
 
-    fclose(f);
+    if (!gi.WriteSaveFile(filename, f->data(), f->size()))
+        gi.Error("Couldn't write %s", filename);
 }
 
 
@@ -864,7 +883,9 @@ No clients are connected yet.
 void SVG_ReadLevel(const char *filename)
 {
     int     entnum;
-    FILE    *f;
+    save_reader_t   reader;
+    save_reader_t   *f = &reader;
+    void    *data;
     int     i;
     Entity *ent;
 
@@ -872,9 +893,11 @@ void SVG_ReadLevel(const char *filename)
     // base state
     gi.FreeTags(TAG_LEVEL);
 
-    f = fopen(filename, "rb");
-    if (!f)
+    data = gi.LoadSaveFile(filename, &reader.size);
+    if (!data)
         gi.Error("Couldn't open %s", filename);
+    reader.data = (const byte *)data;
+    reader.readcount = 0;
 
     // Ensure all entities have a clean slate in memory.
     for (int32_t i = 0; i < game.maxEntities; i++) {
@@ -887,13 +910,13 @@ void SVG_ReadLevel(const char *filename)
 
     i = read_int(f);
     if (i != SAVE_MAGIC2) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Not a save game");
     }
 
     i = read_int(f);
     if (i != SAVE_VERSION) {
-        fclose(f);
+        gi.FreeSaveFile(data);
         gi.Error("Savegame from an older version");
     }
 
@@ -921,7 +944,7 @@ void SVG_ReadLevel(const char *filename)
         gi.LinkEntity(ent);
     }
 
-    fclose(f);
+    gi.FreeSaveFile(data);
 
     // mark all clients as unconnected
     for (i = 0 ; i < maximumClients->value ; i++) {
@@ -143,6 +143,11 @@ static void fire_lead(SVGBaseEntity *self, const vec3_t& start, const vec3_t& ai
     vec3_t      water_start;
     qboolean    water = false;
     int         content_mask = CONTENTS_MASK_SHOT | CONTENTS_MASK_LIQUID;
+    int         rewind = 0;
+
+    // Players hit what they saw: their ping plus the frame they interpolate over.
+    if (self->GetClient())
+        rewind = self->GetClient()->ping + (int)BASE_FRAMETIME;
 
     tr = SVG_Trace(self->GetOrigin(), vec3_zero(), vec3_zero(), start, self, CONTENTS_MASK_SHOT);
     if (!(tr.fraction < 1.0)) {
@@ -161,7 +166,7 @@ static void fire_lead(SVGBaseEntity *self, const vec3_t& start, const vec3_t& ai
             content_mask &= ~CONTENTS_MASK_LIQUID;
         }
 
-        tr = SVG_Trace(start, vec3_zero(), vec3_zero(), end, self, content_mask);
+        tr = SVG_TraceRewound(rewind, start, vec3_zero(), vec3_zero(), end, self, content_mask);
 
         // see if we hit water
         if (tr.contents & CONTENTS_MASK_LIQUID) {
@@ -204,7 +209,7 @@ static void fire_lead(SVGBaseEntity *self, const vec3_t& start, const vec3_t& ai
             }
 
             // re-trace ignoring water this time
-            tr = SVG_Trace(water_start, vec3_zero(), vec3_zero(), end, self, CONTENTS_MASK_SHOT);
+            tr = SVG_TraceRewound(rewind, water_start, vec3_zero(), vec3_zero(), end, self, CONTENTS_MASK_SHOT);
         }
     }
 